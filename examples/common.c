@@ -19,12 +19,23 @@
  * MA 02110-1301 USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <string.h>
 #include <stdio.h>
 
 #ifdef _WIN32
 #include <io.h>
 #include <fcntl.h>
+#include <windows.h>
+#elif defined(HAVE_SYS_MMAN_H)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 #include "common.h"
@@ -340,3 +351,143 @@ dctool_file_read (const char *filename)
 
 	return buffer;
 }
+
+dc_status_t
+dctool_file_map (dctool_mapping_t *mapping, const char *filename)
+{
+	mapping->data = NULL;
+	mapping->size = 0;
+	mapping->buffer = NULL;
+
+	if (filename) {
+#if defined(_WIN32)
+		HANDLE hFile = CreateFileA (filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hFile == INVALID_HANDLE_VALUE)
+			return DC_STATUS_IO;
+
+		LARGE_INTEGER size;
+		if (GetFileSizeEx (hFile, &size) && size.QuadPart > 0 && (ULONGLONG) size.QuadPart <= (SIZE_T) -1) {
+			HANDLE hMapping = CreateFileMappingA (hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (hMapping != NULL) {
+				const unsigned char *data = (const unsigned char *) MapViewOfFile (hMapping, FILE_MAP_READ, 0, 0, 0);
+				CloseHandle (hMapping);
+				if (data != NULL) {
+					CloseHandle (hFile);
+					mapping->data = data;
+					mapping->size = (size_t) size.QuadPart;
+					return DC_STATUS_SUCCESS;
+				}
+			}
+		}
+
+		CloseHandle (hFile);
+#elif defined(HAVE_SYS_MMAN_H)
+		int fd = open (filename, O_RDONLY);
+		if (fd == -1)
+			return DC_STATUS_IO;
+
+		struct stat st;
+		if (fstat (fd, &st) == 0 && S_ISREG (st.st_mode) && st.st_size > 0 && (unsigned long long) st.st_size <= (size_t) -1) {
+			void *data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED) {
+				close (fd);
+				mapping->data = (const unsigned char *) data;
+				mapping->size = st.st_size;
+				return DC_STATUS_SUCCESS;
+			}
+		}
+
+		close (fd);
+#endif
+	}
+
+	// Fall back to reading the file (e.g. empty files, pipes or stdin).
+	mapping->buffer = dctool_file_read (filename);
+	if (mapping->buffer == NULL)
+		return DC_STATUS_IO;
+
+	mapping->data = dc_buffer_get_data (mapping->buffer);
+	mapping->size = dc_buffer_get_size (mapping->buffer);
+
+	return DC_STATUS_SUCCESS;
+}
+
+void
+dctool_file_unmap (dctool_mapping_t *mapping)
+{
+	if (mapping->buffer) {
+		dc_buffer_free (mapping->buffer);
+	} else if (mapping->data) {
+#if defined(_WIN32)
+		UnmapViewOfFile (mapping->data);
+#elif defined(HAVE_SYS_MMAN_H)
+		munmap ((void *) mapping->data, mapping->size);
+#endif
+	}
+
+	mapping->data = NULL;
+	mapping->size = 0;
+	mapping->buffer = NULL;
+}
+
+typedef struct transcript_data_t {
+	FILE *fp;
+	unsigned long long start;
+} transcript_data_t;
+
+static void
+transcript_cb (dc_context_t *context, dc_trace_t type, unsigned long long timestamp, const unsigned char data[], unsigned int size, const char *file, unsigned int line, const char *function, void *userdata)
+{
+	transcript_data_t *transcript = (transcript_data_t *) userdata;
+
+	if (transcript->start == 0)
+		transcript->start = timestamp;
+
+	unsigned long long elapsed = timestamp - transcript->start;
+
+	static const char hex[] = "0123456789ABCDEF";
+
+	// Format the line into a local buffer, and write it at once. Only a
+	// very long transfer is written in several pieces.
+	char buffer[1024];
+	int n = snprintf (buffer, sizeof (buffer), "%llu.%06llu %c ", elapsed / 1000000, elapsed % 1000000,
+		type == DC_TRACE_WRITE ? 'W' : 'R');
+	if (n < 0)
+		return;
+
+	size_t length = n;
+	for (unsigned int i = 0; i < size; ++i) {
+		if (length + 2 > sizeof (buffer)) {
+			fwrite (buffer, 1, length, transcript->fp);
+			length = 0;
+		}
+		buffer[length++] = hex[(data[i] >> 4) & 0x0F];
+		buffer[length++] = hex[data[i] & 0x0F];
+	}
+
+	if (length + 1 > sizeof (buffer)) {
+		fwrite (buffer, 1, length, transcript->fp);
+		length = 0;
+	}
+	buffer[length++] = '\n';
+
+	fwrite (buffer, 1, length, transcript->fp);
+}
+
+void
+dctool_transcript_write (const char *filename, dc_context_t *context)
+{
+	transcript_data_t transcript = {0};
+
+	// Open the file.
+	transcript.fp = fopen (filename, "w");
+	if (transcript.fp == NULL)
+		return;
+
+	// Write all the recorded transfers to the file.
+	fprintf (transcript.fp, "# libdivecomputer transcript\n");
+	dc_context_get_trace (context, transcript_cb, &transcript);
+
+	// Close the file.
+	fclose (transcript.fp);
+}
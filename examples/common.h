@@ -22,9 +22,12 @@
 #ifndef DCTOOL_COMMON_H
 #define DCTOOL_COMMON_H
 
+#include <stddef.h>
+
 #include <libdivecomputer/context.h>
 #include <libdivecomputer/descriptor.h>
 #include <libdivecomputer/device.h>
+#include <libdivecomputer/buffer.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -57,6 +60,25 @@ dctool_file_write (const char *filename, dc_buffer_t *buffer);
 dc_buffer_t *
 dctool_file_read (const char *filename);
 
+/*
+ * A read-only view of the contents of a file. The file is mapped into
+ * memory when possible, and read into a buffer otherwise.
+ */
+typedef struct dctool_mapping_t {
+	const unsigned char *data;
+	size_t size;
+	dc_buffer_t *buffer;
+} dctool_mapping_t;
+
+dc_status_t
+dctool_file_map (dctool_mapping_t *mapping, const char *filename);
+
+void
+dctool_file_unmap (dctool_mapping_t *mapping);
+
+void
+dctool_transcript_write (const char *filename, dc_context_t *context);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
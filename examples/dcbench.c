@@ -0,0 +1,844 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/time.h>
+#endif
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/parser.h>
+
+#include "generator.h"
+#include "output.h"
+#include "common.h"
+#include "utils.h"
+
+#include "checksum.h"
+#include "array.h"
+
+#define MINTIME 0.25 /* Seconds */
+
+#define MAXKERNEL 65536 /* Bytes */
+
+#ifdef _WIN32
+#define NULLDEV "NUL"
+#else
+#define NULLDEV "/dev/null"
+#endif
+
+static const dcbench_generator_t *g_generators[] = {
+	&dcbench_uwatec_smartpro,
+	&dcbench_uwatec_galileo,
+	&dcbench_hw_ostc3,
+	&dcbench_shearwater_petrel,
+	&dcbench_suunto_eonsteel,
+	&dcbench_oceanic_atom2,
+	&dcbench_oceanic_a300cs,
+	NULL
+};
+
+/*
+ * The internal routines for the kernel benchmarks, each called on a
+ * buffer of random data. The result is only returned to keep the
+ * compiler from optimizing the call away.
+ */
+typedef struct dcbench_kernel_t {
+	const char *name;
+	unsigned int (*run) (const unsigned char data[], unsigned int size);
+} dcbench_kernel_t;
+
+static unsigned int
+kernel_add_uint4 (const unsigned char data[], unsigned int size)
+{
+	return checksum_add_uint4 (data, size, 0);
+}
+
+static unsigned int
+kernel_add_uint8 (const unsigned char data[], unsigned int size)
+{
+	return checksum_add_uint8 (data, size, 0);
+}
+
+static unsigned int
+kernel_add_uint16 (const unsigned char data[], unsigned int size)
+{
+	return checksum_add_uint16 (data, size, 0);
+}
+
+static unsigned int
+kernel_xor_uint8 (const unsigned char data[], unsigned int size)
+{
+	return checksum_xor_uint8 (data, size, 0);
+}
+
+static unsigned int
+kernel_crc_ccitt (const unsigned char data[], unsigned int size)
+{
+	return checksum_crc_ccitt_uint16 (data, size);
+}
+
+/*
+ * A marker that is not present in the random data, to measure a search
+ * through the whole buffer (e.g. for a dive header that does not exist).
+ */
+static const unsigned char g_marker[] = {0xA5, 0x5A, 0xA5, 0x5A, 0xA5, 0x5A};
+
+static unsigned int
+kernel_search_forward (const unsigned char data[], unsigned int size)
+{
+	return array_search_forward (data, size, g_marker, sizeof (g_marker)) != NULL;
+}
+
+static unsigned int
+kernel_search_backward (const unsigned char data[], unsigned int size)
+{
+	return array_search_backward (data, size, g_marker, sizeof (g_marker)) != NULL;
+}
+
+/*
+ * The hex conversions work on hex digits, and array_isequal on a block
+ * of erased memory (all 0xFF), to scan the whole buffer.
+ */
+static unsigned char g_hex[MAXKERNEL];
+static unsigned char g_blank[MAXKERNEL];
+static unsigned char g_output[2 * MAXKERNEL];
+
+static unsigned int
+kernel_bin2hex (const unsigned char data[], unsigned int size)
+{
+	return array_convert_bin2hex (data, size, g_output, 2 * size);
+}
+
+static unsigned int
+kernel_hex2bin (const unsigned char data[], unsigned int size)
+{
+	return array_convert_hex2bin (g_hex, size, g_output, size / 2);
+}
+
+static unsigned int
+kernel_isequal (const unsigned char data[], unsigned int size)
+{
+	return array_isequal (g_blank, size, 0xFF);
+}
+
+static volatile unsigned int g_sink = 0;
+
+static const dcbench_kernel_t g_kernels[] = {
+	{"add_uint4",       kernel_add_uint4},
+	{"add_uint8",       kernel_add_uint8},
+	{"add_uint16",      kernel_add_uint16},
+	{"xor_uint8",       kernel_xor_uint8},
+	{"crc_ccitt",       kernel_crc_ccitt},
+	{"search_forward",  kernel_search_forward},
+	{"search_backward", kernel_search_backward},
+	{"bin2hex",         kernel_bin2hex},
+	{"hex2bin",         kernel_hex2bin},
+	{"isequal",         kernel_isequal},
+	{NULL,              NULL}
+};
+
+/*
+ * The buffer sizes for the kernel benchmarks: a single packet, a memory
+ * page of a typical dive computer, and a complete memory dump.
+ */
+static const unsigned int g_sizes[] = {
+	16, 256, 4096, MAXKERNEL
+};
+
+/*
+ * The default dive lengths (minutes): a typical recreational dive, a
+ * long technical dive, and an extreme length (e.g. a dive computer
+ * which was left in dive mode) to expose any non-linear behaviour.
+ */
+static const unsigned int g_durations[] = {
+	45, 4 * 60, 48 * 60
+};
+
+#ifdef __GLIBC__
+/*
+ * Count the heap allocations by interposing the malloc functions. The
+ * definitions in the executable take precedence over the ones in the
+ * C library, also for the calls from inside libdivecomputer.
+ */
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+#define HAVE_ALLOC_STATS
+
+static unsigned long long g_nallocs = 0;
+static unsigned long long g_nbytes = 0;
+
+void *
+malloc (size_t size)
+{
+	g_nallocs++;
+	g_nbytes += size;
+	return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+	g_nallocs++;
+	g_nbytes += nmemb * size;
+	return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+	g_nallocs++;
+	g_nbytes += size;
+	return __libc_realloc (ptr, size);
+}
+#endif
+
+typedef struct dcbench_result_t {
+	unsigned int niterations;
+	unsigned int nsamples;
+	double elapsed;
+	unsigned long long nallocs;
+	unsigned long long nbytes;
+} dcbench_result_t;
+
+static double
+dcbench_clock (void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER now, frequency;
+	QueryPerformanceFrequency (&frequency);
+	QueryPerformanceCounter (&now);
+	return (double) now.QuadPart / (double) frequency.QuadPart;
+#elif defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1000000000.0;
+#else
+	struct timeval now;
+	gettimeofday (&now, NULL);
+	return now.tv_sec + now.tv_usec / 1000000.0;
+#endif
+}
+
+static void
+sample_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	unsigned int *nsamples = (unsigned int *) userdata;
+
+	if (type == DC_SAMPLE_TIME)
+		(*nsamples)++;
+}
+
+/*
+ * Retrieve all fields, the same way an application (or the dctool xml
+ * output) does. The description of a string field is static, but the
+ * value is allocated by the parser, and freed here with free().
+ */
+static dc_status_t
+fields_sweep (dc_parser_t *parser)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_datetime_t dt = {0};
+	unsigned int divetime = 0;
+	double maxdepth = 0.0, avgdepth = 0.0, atmospheric = 0.0;
+	double temperature = 0.0;
+	unsigned int ngases = 0, ntanks = 0;
+	dc_gasmix_t gasmix = {0};
+	dc_tank_t tank = {0};
+	dc_salinity_t salinity = {DC_WATER_FRESH, 0.0};
+	dc_divemode_t divemode = DC_DIVEMODE_OC;
+	dc_field_string_t string = {0};
+
+	rc = dc_parser_get_datetime (parser, &dt);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+		return rc;
+
+	rc = dc_parser_get_field (parser, DC_FIELD_DIVETIME, 0, &divetime);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+		return rc;
+
+	rc = dc_parser_get_field (parser, DC_FIELD_MAXDEPTH, 0, &maxdepth);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+		return rc;
+
+	rc = dc_parser_get_field (parser, DC_FIELD_AVGDEPTH, 0, &avgdepth);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+		return rc;
+
+	rc = dc_parser_get_field (parser, DC_FIELD_GASMIX_COUNT, 0, &ngases);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+		return rc;
+
+	for (unsigned int i = 0; i < ngases; ++i) {
+		rc = dc_parser_get_field (parser, DC_FIELD_GASMIX, i, &gasmix);
+		if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+			return rc;
+	}
+
+	rc = dc_parser_get_field (parser, DC_FIELD_TANK_COUNT, 0, &ntanks);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+		return rc;
+
+	for (unsigned int i = 0; i < ntanks; ++i) {
+		rc = dc_parser_get_field (parser, DC_FIELD_TANK, i, &tank);
+		if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+			return rc;
+	}
+
+	rc = dc_parser_get_field (parser, DC_FIELD_TEMPERATURE_SURFACE, 0, &temperature);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+		return rc;
+
+	rc = dc_parser_get_field (parser, DC_FIELD_TEMPERATURE_MINIMUM, 0, &temperature);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+		return rc;
+
+	rc = dc_parser_get_field (parser, DC_FIELD_TEMPERATURE_MAXIMUM, 0, &temperature);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+		return rc;
+
+	rc = dc_parser_get_field (parser, DC_FIELD_SALINITY, 0, &salinity);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+		return rc;
+
+	rc = dc_parser_get_field (parser, DC_FIELD_ATMOSPHERIC, 0, &atmospheric);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+		return rc;
+
+	rc = dc_parser_get_field (parser, DC_FIELD_DIVEMODE, 0, &divemode);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+		return rc;
+
+	for (unsigned int i = 0; i < 100; ++i) {
+		rc = dc_parser_get_field (parser, DC_FIELD_STRING, i, &string);
+		if (rc == DC_STATUS_UNSUPPORTED)
+			break;
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+		free ((void *) string.value);
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+measure (dc_parser_t *parser, dc_buffer_t *buffer, int fields, unsigned int count, dcbench_result_t *result)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	const unsigned char *data = dc_buffer_get_data (buffer);
+	unsigned int size = dc_buffer_get_size (buffer);
+
+	memset (result, 0, sizeof (*result));
+
+#ifdef HAVE_ALLOC_STATS
+	unsigned long long nallocs = g_nallocs;
+	unsigned long long nbytes = g_nbytes;
+#endif
+
+	double start = dcbench_clock ();
+	while (count ? result->niterations < count : result->elapsed < MINTIME) {
+		unsigned int nsamples = 0;
+
+		rc = dc_parser_set_data (parser, data, size);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+
+		if (fields) {
+			rc = fields_sweep (parser);
+		} else {
+			rc = dc_parser_samples_foreach (parser, sample_cb, &nsamples);
+		}
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+
+		result->nsamples = nsamples;
+		result->niterations++;
+		result->elapsed = dcbench_clock () - start;
+	}
+
+#ifdef HAVE_ALLOC_STATS
+	result->nallocs = g_nallocs - nallocs;
+	result->nbytes = g_nbytes - nbytes;
+#endif
+
+	return DC_STATUS_SUCCESS;
+}
+
+static void
+report (const dcbench_generator_t *generator, unsigned int duration, unsigned int size, unsigned int nsamples, const char *mode, const dcbench_result_t *result)
+{
+	double elapsed = result->elapsed / result->niterations;
+
+	printf ("%-18s %6u %9u %8u  %-7s %11.1f %12.0f %9.1f",
+		generator->name, duration, size, nsamples, mode,
+		elapsed * 1000000.0,
+		nsamples / elapsed,
+		size / elapsed / 1000000.0);
+#ifdef HAVE_ALLOC_STATS
+	printf (" %9.1f %11.0f\n",
+		(double) result->nallocs / result->niterations,
+		(double) result->nbytes / result->niterations);
+#else
+	printf (" %9s %11s\n", "n/a", "n/a");
+#endif
+}
+
+static dc_status_t
+benchmark (dc_context_t *context, const dcbench_generator_t *generator, const dcbench_profile_t *profile, unsigned int count)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_descriptor_t *descriptor = NULL;
+	dc_parser_t *parser = NULL;
+	dc_buffer_t *buffer = NULL;
+	dcbench_result_t samples = {0}, fields = {0};
+
+	// The descriptors of the models with a transport which is not
+	// available on this platform are not built, so skip those.
+	rc = dctool_descriptor_search (&descriptor, NULL, generator->family, generator->model);
+	if (rc != DC_STATUS_SUCCESS)
+		goto cleanup;
+	if (descriptor == NULL) {
+		message ("Skipping '%s' (no device descriptor).\n", generator->name);
+		rc = DC_STATUS_UNSUPPORTED;
+		goto cleanup;
+	}
+
+	buffer = dc_buffer_new (0);
+	if (buffer == NULL) {
+		ERROR ("Failed to allocate memory.");
+		rc = DC_STATUS_NOMEMORY;
+		goto cleanup;
+	}
+
+	rc = generator->generate (buffer, profile);
+	if (rc != DC_STATUS_SUCCESS) {
+		message ("Failed to generate the '%s' dive.\n", generator->name);
+		goto cleanup;
+	}
+
+	rc = dc_parser_new2 (&parser, context, descriptor, 0, 0);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error creating the parser.");
+		goto cleanup;
+	}
+
+	rc = measure (parser, buffer, 0, count, &samples);
+	if (rc != DC_STATUS_SUCCESS) {
+		message ("Error parsing the '%s' samples: %s\n", generator->name, dctool_errmsg (rc));
+		goto cleanup;
+	}
+
+	rc = measure (parser, buffer, 1, count, &fields);
+	if (rc != DC_STATUS_SUCCESS) {
+		message ("Error parsing the '%s' fields: %s\n", generator->name, dctool_errmsg (rc));
+		goto cleanup;
+	}
+
+	report (generator, profile->duration / 60, dc_buffer_get_size (buffer), samples.nsamples, "samples", &samples);
+	report (generator, profile->duration / 60, dc_buffer_get_size (buffer), samples.nsamples, "fields", &fields);
+
+cleanup:
+	dc_parser_destroy (parser);
+	dc_buffer_free (buffer);
+	dc_descriptor_free (descriptor);
+	return rc;
+}
+
+/*
+ * Export the dive many times with the dctool xml output, the same way
+ * as "dctool parse" does for a large logbook. The output is discarded.
+ */
+static dc_status_t
+benchmark_xml (dc_context_t *context, const dcbench_generator_t *generator, const dcbench_profile_t *profile, unsigned int count)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_descriptor_t *descriptor = NULL;
+	dc_parser_t *parser = NULL;
+	dc_buffer_t *buffer = NULL;
+	dctool_output_t *output = NULL;
+	dcbench_result_t samples = {0}, xml = {0};
+
+	rc = dctool_descriptor_search (&descriptor, NULL, generator->family, generator->model);
+	if (rc != DC_STATUS_SUCCESS)
+		goto cleanup;
+	if (descriptor == NULL) {
+		message ("Skipping '%s' (no device descriptor).\n", generator->name);
+		rc = DC_STATUS_UNSUPPORTED;
+		goto cleanup;
+	}
+
+	buffer = dc_buffer_new (0);
+	if (buffer == NULL) {
+		ERROR ("Failed to allocate memory.");
+		rc = DC_STATUS_NOMEMORY;
+		goto cleanup;
+	}
+
+	rc = generator->generate (buffer, profile);
+	if (rc != DC_STATUS_SUCCESS) {
+		message ("Failed to generate the '%s' dive.\n", generator->name);
+		goto cleanup;
+	}
+
+	rc = dc_parser_new2 (&parser, context, descriptor, 0, 0);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error creating the parser.");
+		goto cleanup;
+	}
+
+	// Count the samples.
+	rc = measure (parser, buffer, 0, 1, &samples);
+	if (rc != DC_STATUS_SUCCESS) {
+		message ("Error parsing the '%s' samples: %s\n", generator->name, dctool_errmsg (rc));
+		goto cleanup;
+	}
+
+	output = dctool_xml_output_new (NULLDEV, DCTOOL_UNITS_METRIC);
+	if (output == NULL) {
+		ERROR ("Failed to create the output.");
+		rc = DC_STATUS_IO;
+		goto cleanup;
+	}
+
+	const unsigned char *data = dc_buffer_get_data (buffer);
+	unsigned int size = dc_buffer_get_size (buffer);
+
+#ifdef HAVE_ALLOC_STATS
+	unsigned long long nallocs = g_nallocs;
+	unsigned long long nbytes = g_nbytes;
+#endif
+
+	double start = dcbench_clock ();
+	while (xml.niterations < count) {
+		rc = dc_parser_set_data (parser, data, size);
+		if (rc != DC_STATUS_SUCCESS)
+			goto cleanup;
+
+		rc = dctool_output_write (output, parser, data, size, NULL, 0);
+		if (rc != DC_STATUS_SUCCESS) {
+			message ("Error exporting the '%s' dive: %s\n", generator->name, dctool_errmsg (rc));
+			goto cleanup;
+		}
+
+		xml.niterations++;
+	}
+
+	dctool_output_free (output);
+	output = NULL;
+
+	xml.elapsed = dcbench_clock () - start;
+
+#ifdef HAVE_ALLOC_STATS
+	xml.nallocs = g_nallocs - nallocs;
+	xml.nbytes = g_nbytes - nbytes;
+#endif
+
+	report (generator, profile->duration / 60, size, samples.nsamples, "xml", &xml);
+
+cleanup:
+	dctool_output_free (output);
+	dc_parser_destroy (parser);
+	dc_buffer_free (buffer);
+	dc_descriptor_free (descriptor);
+	return rc;
+}
+
+static void
+benchmark_kernel (const dcbench_kernel_t *kernel, const unsigned char data[], unsigned int size, unsigned int count)
+{
+	unsigned int niterations = 0;
+	double elapsed = 0.0;
+
+	double start = dcbench_clock ();
+	while (count ? niterations < count : elapsed < MINTIME) {
+		// Measure in batches, to keep the overhead of the clock out of
+		// the results for the small buffers.
+		for (unsigned int i = 0; i < 64; ++i)
+			g_sink = kernel->run (data, size);
+		niterations += 64;
+		elapsed = dcbench_clock () - start;
+	}
+
+	elapsed /= niterations;
+
+	printf ("%-18s %9u %11.1f %9.1f\n",
+		kernel->name, size,
+		elapsed * 1000000000.0,
+		size / elapsed / 1000000.0);
+}
+
+static int
+benchmark_kernels (const char *names[], unsigned int count)
+{
+	unsigned char *data = (unsigned char *) malloc (MAXKERNEL);
+	if (data == NULL) {
+		message ("Failed to allocate memory.\n");
+		return EXIT_FAILURE;
+	}
+
+	unsigned int seed = 1;
+	for (unsigned int i = 0; i < MAXKERNEL; ++i) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = seed >> 16;
+	}
+
+	array_convert_bin2hex (data, MAXKERNEL / 2, g_hex, MAXKERNEL);
+	memset (g_blank, 0xFF, MAXKERNEL);
+
+	for (size_t i = 0; names[i] != NULL; ++i) {
+		size_t j = 0;
+		while (g_kernels[j].name != NULL && strcmp (g_kernels[j].name, names[i]) != 0)
+			j++;
+		if (g_kernels[j].name == NULL) {
+			message ("Unknown kernel '%s'.\n", names[i]);
+			free (data);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf ("%-18s %9s %11s %9s\n",
+		"Kernel", "Size", "ns/call", "MB/s");
+
+	for (size_t i = 0; g_kernels[i].name != NULL; ++i) {
+		int selected = names[0] == NULL;
+		for (size_t j = 0; names[j] != NULL; ++j) {
+			if (strcmp (g_kernels[i].name, names[j]) == 0)
+				selected = 1;
+		}
+		if (!selected)
+			continue;
+
+		for (size_t j = 0; j < sizeof (g_sizes) / sizeof (g_sizes[0]); ++j) {
+			benchmark_kernel (g_kernels + i, data, g_sizes[j], count);
+		}
+	}
+
+	free (data);
+
+	return EXIT_SUCCESS;
+}
+
+static const dcbench_generator_t *
+generator_find (const char *name)
+{
+	size_t i = 0;
+	while (g_generators[i] != NULL) {
+		if (strcmp (g_generators[i]->name, name) == 0)
+			break;
+		i++;
+	}
+
+	return g_generators[i];
+}
+
+static void
+showhelp (void)
+{
+	printf (
+		"Benchmark the parsers with synthetic dives\n"
+		"\n"
+		"Usage:\n"
+		"   dcbench [options] [<generator>...]\n"
+		"   dcbench [options] -k [<kernel>...]\n"
+		"\n"
+		"Options:\n"
+#ifdef HAVE_GETOPT_LONG
+		"   -h, --help                 Show help message\n"
+		"   -n, --count <count>        Number of iterations (default: at least %.2f s)\n"
+		"   -t, --duration <minutes>   Dive length (default: 45, 240 and 2880 minutes)\n"
+		"   -d, --depth <meters>       Maximum depth (default: 40 m)\n"
+		"   -s, --seed <seed>          Seed for the noise and the events\n"
+		"   -x, --xml <count>          Export <count> dives to xml instead\n"
+		"   -k, --kernels              Benchmark the internal routines instead\n"
+#else
+		"   -h                 Show help message\n"
+		"   -n <count>         Number of iterations (default: at least %.2f s)\n"
+		"   -t <minutes>       Dive length (default: 45, 240 and 2880 minutes)\n"
+		"   -d <meters>        Maximum depth (default: 40 m)\n"
+		"   -s <seed>          Seed for the noise and the events\n"
+		"   -x <count>         Export <count> dives to xml instead\n"
+		"   -k                 Benchmark the internal routines instead\n"
+#endif
+		"\n"
+		"Available generators:\n", MINTIME);
+	for (size_t i = 0; g_generators[i] != NULL; ++i) {
+		printf ("   %-22s%s\n", g_generators[i]->name, g_generators[i]->description);
+	}
+	printf ("\n");
+	printf ("Available kernels:\n");
+	for (size_t i = 0; g_kernels[i].name != NULL; ++i) {
+		printf ("   %s\n", g_kernels[i].name);
+	}
+	printf ("\n");
+}
+
+int
+main (int argc, char *argv[])
+{
+	int exitcode = EXIT_SUCCESS;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dc_context_t *context = NULL;
+
+	// Default option values.
+	unsigned int help = 0;
+	unsigned int count = 0;
+	unsigned int duration = 0;
+	double maxdepth = 40.0;
+	unsigned int seed = 1;
+	unsigned int xml = 0;
+	unsigned int kernels = 0;
+
+	// Parse the command-line options.
+	int opt = 0;
+	const char *optstring = "hn:t:d:s:x:k";
+#ifdef HAVE_GETOPT_LONG
+	struct option options[] = {
+		{"help",        no_argument,       0, 'h'},
+		{"count",       required_argument, 0, 'n'},
+		{"duration",    required_argument, 0, 't'},
+		{"depth",       required_argument, 0, 'd'},
+		{"seed",        required_argument, 0, 's'},
+		{"xml",         required_argument, 0, 'x'},
+		{"kernels",     no_argument,       0, 'k'},
+		{0,             0,                 0,  0 }
+	};
+	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
+#else
+	while ((opt = getopt (argc, argv, optstring)) != -1) {
+#endif
+		switch (opt) {
+		case 'h':
+			help = 1;
+			break;
+		case 'n':
+			count = strtoul (optarg, NULL, 0);
+			break;
+		case 't':
+			duration = strtoul (optarg, NULL, 0);
+			break;
+		case 'd':
+			maxdepth = strtod (optarg, NULL);
+			break;
+		case 's':
+			seed = strtoul (optarg, NULL, 0);
+			break;
+		case 'x':
+			xml = strtoul (optarg, NULL, 0);
+			break;
+		case 'k':
+			kernels = 1;
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	// Show help message.
+	if (help) {
+		showhelp ();
+		return EXIT_SUCCESS;
+	}
+
+	// Benchmark the internal routines.
+	if (kernels) {
+		return benchmark_kernels ((const char **) argv, count);
+	}
+
+	// Select the generators.
+	const dcbench_generator_t **generators = g_generators;
+	const dcbench_generator_t **selection = NULL;
+	if (argc > 0) {
+		selection = (const dcbench_generator_t **) malloc ((argc + 1) * sizeof (*selection));
+		if (selection == NULL) {
+			message ("Failed to allocate memory.\n");
+			return EXIT_FAILURE;
+		}
+		for (int i = 0; i < argc; ++i) {
+			selection[i] = generator_find (argv[i]);
+			if (selection[i] == NULL) {
+				message ("Unknown generator '%s'.\n", argv[i]);
+				free (selection);
+				return EXIT_FAILURE;
+			}
+		}
+		selection[argc] = NULL;
+		generators = selection;
+	}
+
+	status = dc_context_new (&context);
+	if (status != DC_STATUS_SUCCESS) {
+		message ("Failed to create the context.\n");
+		free (selection);
+		return EXIT_FAILURE;
+	}
+
+	printf ("%-18s %6s %9s %8s  %-7s %11s %12s %9s %9s %11s\n",
+		"Generator", "Length", "Size", "Samples", "Mode",
+		"us/dive", "samples/s", "MB/s", "allocs", "alloc bytes");
+
+	for (size_t i = 0; generators[i] != NULL; ++i) {
+		for (size_t j = 0; j < sizeof (g_durations) / sizeof (g_durations[0]); ++j) {
+			dcbench_profile_t profile;
+			profile.duration = (duration ? duration : g_durations[j]) * 60;
+			profile.maxdepth = maxdepth;
+			profile.seed = seed;
+
+			if (xml) {
+				status = benchmark_xml (context, generators[i], &profile, xml);
+			} else {
+				status = benchmark (context, generators[i], &profile, count);
+			}
+			if (status == DC_STATUS_UNSUPPORTED)
+				break;
+			if (status != DC_STATUS_SUCCESS)
+				exitcode = EXIT_FAILURE;
+
+			if (duration)
+				break;
+		}
+	}
+
+	dc_context_free (context);
+	free (selection);
+
+	return exitcode;
+}
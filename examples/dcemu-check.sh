@@ -0,0 +1,54 @@
+#!/bin/sh
+#
+# Download the synthesized dive from every emulator backend, and check
+# that it arrives without errors.
+#
+
+DCEMU=./dcemu
+DCTOOL=./dctool
+
+TMPDIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMPDIR"' EXIT
+
+failed=0
+
+check ()
+{
+	backend=$1
+	family=$2
+
+	$DCEMU -b 0 $backend > "$TMPDIR/$backend.pty" 2> "$TMPDIR/$backend.emu" &
+	pid=$!
+
+	# Wait for the name of the pseudo terminal.
+	n=0
+	while [ ! -s "$TMPDIR/$backend.pty" ] && [ $n -lt 50 ]; do
+		sleep 0.1
+		n=$((n + 1))
+	done
+	pty=$(head -n 1 "$TMPDIR/$backend.pty")
+
+	$DCTOOL -f $family download -o "$TMPDIR/$backend.xml" "$pty" > "$TMPDIR/$backend.log" 2>&1
+	rc=$?
+
+	kill $pid 2> /dev/null
+	wait $pid 2> /dev/null
+
+	if [ $rc -ne 0 ] || grep -q ERROR "$TMPDIR/$backend.log" || ! grep -q '<dive>' "$TMPDIR/$backend.xml"; then
+		echo "FAIL: $backend"
+		cat "$TMPDIR/$backend.emu" "$TMPDIR/$backend.log"
+		failed=1
+	else
+		echo "PASS: $backend"
+	fi
+}
+
+check oceanic_atom2 atom2
+check suunto_d9 d9
+check suunto_vyper2 vyper2
+check mares_iconhd iconhd
+check hw_ostc3 ostc3
+check cochran_commander cochran
+check reefnet_sensusultra sensusultra
+
+exit $failed
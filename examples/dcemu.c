@@ -0,0 +1,264 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#endif
+
+#include <libdivecomputer/buffer.h>
+
+#include "emulator.h"
+#include "common.h"
+#include "utils.h"
+
+static const dcemu_backend_t *g_backends[] = {
+	&dcemu_oceanic_atom2,
+	&dcemu_suunto_d9,
+	&dcemu_suunto_vyper2,
+	&dcemu_mares_iconhd,
+	&dcemu_hw_ostc3,
+	&dcemu_cochran_commander,
+	&dcemu_reefnet_sensusultra,
+	NULL
+};
+
+static volatile sig_atomic_t g_cancel = 0;
+
+static int
+cancel_cb (void *userdata)
+{
+	return g_cancel;
+}
+
+static void
+sighandler (int signum)
+{
+	g_cancel = 1;
+}
+
+static const dcemu_backend_t *
+backend_find (const char *name)
+{
+	size_t i = 0;
+	while (g_backends[i] != NULL) {
+		if (strcmp (g_backends[i]->name, name) == 0)
+			break;
+		i++;
+	}
+
+	return g_backends[i];
+}
+
+static void
+showhelp (void)
+{
+	printf (
+		"Emulate a dive computer on a pseudo terminal\n"
+		"\n"
+		"Usage:\n"
+		"   dcemu [options] <backend> [<image>]\n"
+		"\n"
+		"Options:\n"
+#ifdef HAVE_GETOPT_LONG
+		"   -h, --help                 Show help message\n"
+		"   -m, --model <model>        Device model\n"
+		"   -b, --baudrate <baudrate>  Baudrate (0 to disable the simulation)\n"
+		"   -l, --latency <ms>         Processing time per response\n"
+		"   -c, --corrupt <rate>       Probability to corrupt a response\n"
+		"   -d, --drop <rate>          Probability to drop a response\n"
+		"   -s, --seed <seed>          Seed for the fault injection\n"
+#else
+		"   -h                 Show help message\n"
+		"   -m <model>         Device model\n"
+		"   -b <baudrate>      Baudrate (0 to disable the simulation)\n"
+		"   -l <ms>            Processing time per response\n"
+		"   -c <rate>          Probability to corrupt a response\n"
+		"   -d <rate>          Probability to drop a response\n"
+		"   -s <seed>          Seed for the fault injection\n"
+#endif
+		"\n"
+		"Without a baudrate, the baudrate configured by the host is used.\n"
+		"Without an image, a memory image with a single dive is synthesized.\n"
+		"Connect with a libdivecomputer build configured with --enable-pty:\n"
+		"\n"
+		"   dctool -f <family> download /dev/pts/<n>\n"
+		"\n"
+		"Available backends:\n");
+	for (size_t i = 0; g_backends[i] != NULL; ++i) {
+		printf ("   %-22s%s\n", g_backends[i]->name, g_backends[i]->description);
+	}
+	printf ("\n");
+}
+
+int
+main (int argc, char *argv[])
+{
+	int exitcode = EXIT_SUCCESS;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dcemu_t *emu = NULL;
+	dc_buffer_t *memory = NULL;
+
+	// Default option values.
+	unsigned int help = 0;
+	const char *model = NULL;
+	unsigned int baudrate = 0, have_baudrate = 0;
+	unsigned int latency = 0;
+	double corrupt = 0.0;
+	double drop = 0.0;
+	unsigned int seed = 1;
+
+	// Parse the command-line options.
+	int opt = 0;
+	const char *optstring = "hm:b:l:c:d:s:";
+#ifdef HAVE_GETOPT_LONG
+	struct option options[] = {
+		{"help",        no_argument,       0, 'h'},
+		{"model",       required_argument, 0, 'm'},
+		{"baudrate",    required_argument, 0, 'b'},
+		{"latency",     required_argument, 0, 'l'},
+		{"corrupt",     required_argument, 0, 'c'},
+		{"drop",        required_argument, 0, 'd'},
+		{"seed",        required_argument, 0, 's'},
+		{0,             0,                 0,  0 }
+	};
+	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
+#else
+	while ((opt = getopt (argc, argv, optstring)) != -1) {
+#endif
+		switch (opt) {
+		case 'h':
+			help = 1;
+			break;
+		case 'm':
+			model = optarg;
+			break;
+		case 'b':
+			baudrate = strtoul (optarg, NULL, 0);
+			have_baudrate = 1;
+			break;
+		case 'l':
+			latency = strtoul (optarg, NULL, 0);
+			break;
+		case 'c':
+			corrupt = strtod (optarg, NULL);
+			break;
+		case 'd':
+			drop = strtod (optarg, NULL);
+			break;
+		case 's':
+			seed = strtoul (optarg, NULL, 0);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	// Show help message.
+	if (help || argc < 1) {
+		showhelp ();
+		return help ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	const dcemu_backend_t *backend = backend_find (argv[0]);
+	if (backend == NULL) {
+		message ("Unknown backend '%s'.\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// Load the memory image.
+	if (argc > 1) {
+		memory = dctool_file_read (argv[1]);
+		if (memory == NULL) {
+			message ("Failed to read the memory image.\n");
+			return EXIT_FAILURE;
+		}
+	} else {
+		memory = dc_buffer_new (0);
+		if (memory == NULL) {
+			message ("Failed to allocate memory.\n");
+			return EXIT_FAILURE;
+		}
+
+		// Synthesize a memory image with a single dive.
+		status = backend->image (memory, model);
+		if (status != DC_STATUS_SUCCESS) {
+			message ("Failed to synthesize the memory image (%s).\n", dctool_errmsg (status));
+			dc_buffer_free (memory);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Install the signal handler, without restarting the
+	// interrupted system calls.
+	struct sigaction sa;
+	memset (&sa, 0, sizeof (sa));
+	sa.sa_handler = sighandler;
+	sigemptyset (&sa.sa_mask);
+	sigaction (SIGINT, &sa, NULL);
+	sigaction (SIGTERM, &sa, NULL);
+
+	status = dcemu_open (&emu, memory);
+	if (status != DC_STATUS_SUCCESS) {
+		message ("ERROR: %s\n", dctool_errmsg (status));
+		dc_buffer_free (memory);
+		return EXIT_FAILURE;
+	}
+
+	if (have_baudrate)
+		dcemu_set_baudrate (emu, baudrate);
+	dcemu_set_latency (emu, latency);
+	dcemu_set_faults (emu, corrupt, drop, seed);
+	dcemu_set_cancel (emu, cancel_cb, NULL);
+
+	printf ("%s\n", dcemu_get_name (emu));
+	fflush (stdout);
+
+	status = backend->run (emu, model);
+	if (status != DC_STATUS_SUCCESS) {
+		message ("ERROR: %s\n", dctool_errmsg (status));
+		exitcode = EXIT_FAILURE;
+	}
+
+	// Report the statistics.
+	dcemu_stats_t stats;
+	dcemu_get_stats (emu, &stats);
+	message ("Read:      %llu bytes (%u calls)\n", stats.nread, stats.nreads);
+	message ("Written:   %llu bytes (%u calls)\n", stats.nwritten, stats.nwrites);
+	message ("Purges:    %u\n", stats.npurges);
+	message ("Corrupted: %u\n", stats.ncorrupted);
+	message ("Dropped:   %u\n", stats.ndropped);
+
+	dcemu_close (emu);
+
+	return exitcode;
+}
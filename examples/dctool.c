@@ -54,6 +54,8 @@
 #define NOPERMUTATION ""
 #endif
 
+#define TRANSCRIPT_SIZE (16 * 1024 * 1024)
+
 static const dctool_command_t *g_commands[] = {
 	&dctool_help,
 	&dctool_version,
@@ -64,11 +66,14 @@ static const dctool_command_t *g_commands[] = {
 	&dctool_read,
 	&dctool_write,
 	&dctool_fwupdate,
+	&dctool_benchmark,
 	NULL
 };
 
 static volatile sig_atomic_t g_cancel = 0;
 
+static dc_loglevel_t g_loglevel = DC_LOGLEVEL_WARNING;
+
 const dctool_command_t *
 dctool_command_find (const char *name)
 {
@@ -109,6 +114,7 @@ dctool_command_showhelp (const dctool_command_t *command)
 			"   -f, --family <family>     Device family type\n"
 			"   -m, --model <model>       Device model number\n"
 			"   -l, --logfile <logfile>   Logfile\n"
+			"   -t, --transcript <file>   Transcript file\n"
 			"   -q, --quiet               Quiet mode\n"
 			"   -v, --verbose             Verbose mode\n"
 #else
@@ -117,6 +123,7 @@ dctool_command_showhelp (const dctool_command_t *command)
 			"   -f <family>    Family type\n"
 			"   -m <model>     Model number\n"
 			"   -l <logfile>   Logfile\n"
+			"   -t <file>      Transcript file\n"
 			"   -q             Quiet mode\n"
 			"   -v             Verbose mode\n"
 #endif
@@ -160,6 +167,19 @@ logfunc (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsign
 	}
 }
 
+dc_status_t
+dctool_context_new (dc_context_t **context)
+{
+	dc_status_t status = dc_context_new (context);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	dc_context_set_loglevel (*context, g_loglevel);
+	dc_context_set_logfunc (*context, logfunc, NULL);
+
+	return DC_STATUS_SUCCESS;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -172,6 +192,7 @@ main (int argc, char *argv[])
 	unsigned int help = 0;
 	dc_loglevel_t loglevel = DC_LOGLEVEL_WARNING;
 	const char *logfile = NULL;
+	const char *transcript = NULL;
 	const char *device = NULL;
 	dc_family_t family = DC_FAMILY_NULL;
 	unsigned int model = 0;
@@ -179,7 +200,7 @@ main (int argc, char *argv[])
 
 	// Parse the command-line options.
 	int opt = 0;
-	const char *optstring = NOPERMUTATION "hd:f:m:l:qv";
+	const char *optstring = NOPERMUTATION "hd:f:m:l:t:qv";
 #ifdef HAVE_GETOPT_LONG
 	struct option options[] = {
 		{"help",        no_argument,       0, 'h'},
@@ -187,6 +208,7 @@ main (int argc, char *argv[])
 		{"family",      required_argument, 0, 'f'},
 		{"model",       required_argument, 0, 'm'},
 		{"logfile",     required_argument, 0, 'l'},
+		{"transcript",  required_argument, 0, 't'},
 		{"quiet",       no_argument,       0, 'q'},
 		{"verbose",     no_argument,       0, 'v'},
 		{0,             0,                 0,  0 }
@@ -213,6 +235,9 @@ main (int argc, char *argv[])
 		case 'l':
 			logfile = optarg;
 			break;
+		case 't':
+			transcript = optarg;
+			break;
 		case 'q':
 			loglevel = DC_LOGLEVEL_NONE;
 			break;
@@ -263,16 +288,23 @@ main (int argc, char *argv[])
 	// Initialize the logfile.
 	message_set_logfile (logfile);
 
-	// Initialize a library context.
-	status = dc_context_new (&context);
+	// Initialize a library context, with the logging setup.
+	g_loglevel = loglevel;
+	status = dctool_context_new (&context);
 	if (status != DC_STATUS_SUCCESS) {
 		exitcode = EXIT_FAILURE;
 		goto cleanup;
 	}
 
-	// Setup the logging.
-	dc_context_set_loglevel (context, loglevel);
-	dc_context_set_logfunc (context, logfunc, NULL);
+	// Setup the transcript recording.
+	if (transcript) {
+		status = dc_context_set_trace (context, TRANSCRIPT_SIZE);
+		if (status != DC_STATUS_SUCCESS) {
+			message ("Failed to enable the transcript recording.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	}
 
 	if (command->config & DCTOOL_CONFIG_DESCRIPTOR) {
 		// Check mandatory arguments.
@@ -307,6 +339,9 @@ main (int argc, char *argv[])
 	exitcode = command->run (argc, argv, context, descriptor);
 
 cleanup:
+	if (transcript && context) {
+		dctool_transcript_write (transcript, context);
+	}
 	dc_descriptor_free (descriptor);
 	dc_context_free (context);
 	message_set_logfile (NULL);
@@ -51,6 +51,7 @@ extern const dctool_command_t dctool_parse;
 extern const dctool_command_t dctool_read;
 extern const dctool_command_t dctool_write;
 extern const dctool_command_t dctool_fwupdate;
+extern const dctool_command_t dctool_benchmark;
 
 const dctool_command_t *
 dctool_command_find (const char *name);
@@ -61,6 +62,13 @@ dctool_command_showhelp (const dctool_command_t *command);
 int
 dctool_cancel_cb (void *userdata);
 
+/*
+ * Create a new library context, with the same logging setup as the
+ * context passed to the commands (e.g. for worker threads).
+ */
+dc_status_t
+dctool_context_new (dc_context_t **context);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
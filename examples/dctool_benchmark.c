@@ -0,0 +1,249 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#endif
+
+#ifdef _WIN32
+#define NOGDI
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/time.h>
+#endif
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/descriptor.h>
+#include <libdivecomputer/device.h>
+
+#include "dctool.h"
+#include "common.h"
+#include "replay.h"
+#include "utils.h"
+
+static double
+benchmark_clock (void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER now, frequency;
+	QueryPerformanceFrequency (&frequency);
+	QueryPerformanceCounter (&now);
+	return (double) now.QuadPart / (double) frequency.QuadPart;
+#elif defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1000000000.0;
+#else
+	struct timeval now;
+	gettimeofday (&now, NULL);
+	return now.tv_sec + now.tv_usec / 1000000.0;
+#endif
+}
+
+static int
+dive_cb (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata)
+{
+	unsigned int *ndives = (unsigned int *) userdata;
+
+	(*ndives)++;
+
+	return 1;
+}
+
+static dc_status_t
+benchmark (dc_context_t *context, dc_descriptor_t *descriptor, dctool_replay_t *replay)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_device_t *device = NULL;
+	dc_stats_t stats = {0};
+	dctool_replay_stats_t rstats = {0};
+	unsigned int ndives = 0;
+
+	// Replay the transcript instead of using the real device.
+	rc = dctool_replay_register (replay, context);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error registering the replay transport.");
+		return rc;
+	}
+
+	double start = benchmark_clock ();
+
+	// Open the device.
+	rc = dc_device_open (&device, context, descriptor, "replay");
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error opening the device.");
+		goto cleanup;
+	}
+
+	// Register the cancellation handler.
+	rc = dc_device_set_cancel (device, dctool_cancel_cb, NULL);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error registering the cancellation handler.");
+		goto cleanup;
+	}
+
+	// Download the dives.
+	rc = dc_device_foreach (device, dive_cb, &ndives);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR ("Error downloading the dives.");
+		goto cleanup;
+	}
+
+cleanup:
+	if (device) {
+		dc_device_get_stats (device, &stats);
+	}
+	dc_device_close (device);
+
+	double elapsed = benchmark_clock () - start;
+
+	// Report the results.
+	dctool_replay_get_stats (replay, &rstats);
+	printf ("Family:      %s\n", dctool_family_name (dc_descriptor_get_type (descriptor)));
+	printf ("Dives:       %u\n", ndives);
+	printf ("Elapsed:     %.3f s\n", elapsed);
+	printf ("Read:        %llu bytes\n", rstats.nread);
+	printf ("Written:     %llu bytes\n", rstats.nwritten);
+	printf ("Throughput:  %.0f bytes/s\n", elapsed > 0 ? rstats.nread / elapsed : 0.0);
+	printf ("Round trips: %u\n", rstats.roundtrips);
+	printf ("Transfers:   %u\n", stats.ntransfers);
+	printf ("Retries:     %u\n", stats.nretries);
+	printf ("Timeouts:    %u\n", stats.ntimeouts);
+	printf ("Sleeping:    %.3f s\n", stats.sleeping / 1000000.0);
+	printf ("Mismatches:  %u\n", rstats.mismatches);
+
+	return rc;
+}
+
+static int
+dctool_benchmark_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t *descriptor)
+{
+	int exitcode = EXIT_SUCCESS;
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dctool_replay_t *replay = NULL;
+
+	// Default option values.
+	unsigned int help = 0;
+	unsigned int packetsize = 0;
+	unsigned int byte = 0;
+	unsigned int roundtrip = 0;
+
+	// Parse the command-line options.
+	int opt = 0;
+	const char *optstring = "hs:b:r:";
+#ifdef HAVE_GETOPT_LONG
+	struct option options[] = {
+		{"help",        no_argument,       0, 'h'},
+		{"packetsize",  required_argument, 0, 's'},
+		{"byte",        required_argument, 0, 'b'},
+		{"roundtrip",   required_argument, 0, 'r'},
+		{0,             0,                 0,  0 }
+	};
+	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
+#else
+	while ((opt = getopt (argc, argv, optstring)) != -1) {
+#endif
+		switch (opt) {
+		case 'h':
+			help = 1;
+			break;
+		case 's':
+			packetsize = strtoul (optarg, NULL, 0);
+			break;
+		case 'b':
+			byte = strtoul (optarg, NULL, 0);
+			break;
+		case 'r':
+			roundtrip = strtoul (optarg, NULL, 0);
+			break;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	// Show help message.
+	if (help) {
+		dctool_command_showhelp (&dctool_benchmark);
+		return EXIT_SUCCESS;
+	}
+
+	// Check mandatory arguments.
+	if (argc < 1) {
+		message ("No transcript file specified.\n");
+		return EXIT_FAILURE;
+	}
+
+	// Load the transcript.
+	status = dctool_replay_new (&replay, argv[0], packetsize);
+	if (status != DC_STATUS_SUCCESS) {
+		message ("ERROR: %s\n", dctool_errmsg (status));
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	dctool_replay_set_latency (replay, byte, roundtrip);
+
+	// Run the benchmark.
+	status = benchmark (context, descriptor, replay);
+	if (status != DC_STATUS_SUCCESS) {
+		message ("ERROR: %s\n", dctool_errmsg (status));
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+cleanup:
+	dctool_replay_free (replay);
+	return exitcode;
+}
+
+const dctool_command_t dctool_benchmark = {
+	dctool_benchmark_run,
+	DCTOOL_CONFIG_DESCRIPTOR,
+	"bench-download",
+	"Benchmark a download by replaying a transcript",
+	"Usage:\n"
+	"   dctool bench-download [options] <transcript>\n"
+	"\n"
+	"Options:\n"
+#ifdef HAVE_GETOPT_LONG
+	"   -h, --help                 Show help message\n"
+	"   -s, --packetsize <size>    Packet size (0 for serial mode)\n"
+	"   -b, --byte <us>            Latency per byte (microseconds)\n"
+	"   -r, --roundtrip <us>       Latency per round trip (microseconds)\n"
+#else
+	"   -h                 Show help message\n"
+	"   -s <size>          Packet size (0 for serial mode)\n"
+	"   -b <us>            Latency per byte (microseconds)\n"
+	"   -r <us>            Latency per round trip (microseconds)\n"
+#endif
+};
@@ -234,6 +234,15 @@ download (dc_context_t *context, dc_descriptor_t *descriptor, const char *devnam
 	}
 
 cleanup:
+	// Report the transfer statistics.
+	if (device) {
+		dc_stats_t stats;
+		dc_device_get_stats (device, &stats);
+		message ("Statistics: read=%llu, written=%llu, transfers=%u, retries=%u, timeouts=%u, waiting=%llu ms, sleeping=%llu ms\n",
+			stats.nread, stats.nwritten, stats.ntransfers, stats.nretries, stats.ntimeouts,
+			stats.waiting / 1000, stats.sleeping / 1000);
+	}
+
 	dc_buffer_free (ofingerprint);
 	dc_device_close (device);
 	return rc;
@@ -316,6 +325,8 @@ dctool_download_run (int argc, char *argv[], dc_context_t *context, dc_descripto
 		output = dctool_raw_output_new (filename);
 	} else if (strcasecmp(format, "xml") == 0) {
 		output = dctool_xml_output_new (filename, units);
+	} else if (strcasecmp(format, "archive") == 0) {
+		output = dctool_archive_output_new (filename, context);
 	} else {
 		message ("Unknown output format: %s\n", format);
 		exitcode = EXIT_FAILURE;
@@ -378,6 +389,11 @@ const dctool_command_t dctool_download = {
 	"      files, the filename is interpreted as a template and should\n"
 	"      contain one or more placeholders.\n"
 	"\n"
+	"   ARCHIVE\n"
+	"\n"
+	"      All dives are exported to a single binary archive, which can\n"
+	"      be read back with the dc_archive functions.\n"
+	"\n"
 	"Supported template placeholders:\n"
 	"\n"
 	"   %f   Fingerprint (hexadecimal format)\n"
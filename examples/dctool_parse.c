@@ -30,10 +30,20 @@
 #ifdef HAVE_GETOPT_H
 #include <getopt.h>
 #endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+#if defined(HAVE_PTHREAD_H) && !defined(_WIN32)
+#include <pthread.h>
+#define HAVE_THREADS
+#endif
 
 #include <libdivecomputer/context.h>
 #include <libdivecomputer/descriptor.h>
 #include <libdivecomputer/parser.h>
+#include <libdivecomputer/cache.h>
 
 #include "dctool.h"
 #include "output.h"
@@ -42,33 +52,96 @@
 
 #define REACTPROWHITE 0x4354
 
+// Number of formatted dives per worker thread, that can be waiting to
+// be written to the output.
+#define WINDOW 4
+
+typedef struct filelist_t {
+	char **names;
+	unsigned int count;
+	unsigned int capacity;
+} filelist_t;
+
+#ifdef HAVE_THREADS
+typedef struct job_t {
+	const char *filename;
+	dc_buffer_t *buffer;
+	dc_status_t status;
+	unsigned int done;
+} job_t;
+
+typedef struct queue_t {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	job_t *jobs;
+	unsigned int njobs;
+	unsigned int next;
+	unsigned int written;
+	unsigned int window;
+	dc_descriptor_t *descriptor;
+	unsigned int devtime;
+	dc_ticks_t systime;
+	dc_cache_t *cache;
+	dctool_output_t *output;
+} queue_t;
+
+// The cache is shared by all worker threads.
+static pthread_mutex_t g_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
 static dc_status_t
-parse (dc_buffer_t *buffer, dc_context_t *context, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, dctool_output_t *output)
+parser_new_cached (dc_parser_t **parser, dc_cache_t *cache, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, const unsigned char data[], unsigned int size)
+{
+#ifdef HAVE_THREADS
+	pthread_mutex_lock (&g_cache_mutex);
+#endif
+	dc_status_t rc = dc_cache_parser_new (parser, cache, descriptor, devtime, systime, data, size);
+#ifdef HAVE_THREADS
+	pthread_mutex_unlock (&g_cache_mutex);
+#endif
+	return rc;
+}
+
+static dc_status_t
+parse (const unsigned char data[], unsigned int size, dc_context_t *context, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, dc_cache_t *cache, dctool_output_t *output, unsigned int number, dc_buffer_t *formatted)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	dc_parser_t *parser = NULL;
-	unsigned char *data = dc_buffer_get_data (buffer);
-	unsigned int size = dc_buffer_get_size (buffer);
 
-	// Create the parser.
-	message ("Creating the parser.\n");
-	rc = dc_parser_new2 (&parser, context, descriptor, devtime, systime);
-	if (rc != DC_STATUS_SUCCESS) {
-		ERROR ("Error creating the parser.");
-		goto cleanup;
-	}
+	if (cache) {
+		// Look up the dive in the cache. The parser has the data
+		// registered already.
+		message ("Creating the cached parser.\n");
+		rc = parser_new_cached (&parser, cache, descriptor, devtime, systime, data, size);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR ("Error creating the parser.");
+			goto cleanup;
+		}
+	} else {
+		// Create the parser.
+		message ("Creating the parser.\n");
+		rc = dc_parser_new2 (&parser, context, descriptor, devtime, systime);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR ("Error creating the parser.");
+			goto cleanup;
+		}
 
-	// Register the data.
-	message ("Registering the data.\n");
-	rc = dc_parser_set_data (parser, data, size);
-	if (rc != DC_STATUS_SUCCESS) {
-		ERROR ("Error registering the data.");
-		goto cleanup;
+		// Register the data.
+		message ("Registering the data.\n");
+		rc = dc_parser_set_data (parser, data, size);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR ("Error registering the data.");
+			goto cleanup;
+		}
 	}
 
 	// Parse the dive data.
 	message ("Parsing the dive data.\n");
-	rc = dctool_output_write (output, parser, data, size, NULL, 0);
+	if (formatted) {
+		rc = dctool_output_format (output, number, parser, data, size, NULL, 0, formatted);
+	} else {
+		rc = dctool_output_write (output, parser, data, size, NULL, 0);
+	}
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR ("Error parsing the dive data.");
 		goto cleanup;
@@ -79,6 +152,285 @@ cleanup:
 	return rc;
 }
 
+static dc_status_t
+parse_file (const char *filename, dc_context_t *context, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, dc_cache_t *cache, dctool_output_t *output, unsigned int number, dc_buffer_t *formatted)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dctool_mapping_t mapping;
+
+	// Map the input file. The parser reads the data directly from the
+	// mapping, without making a copy.
+	rc = dctool_file_map (&mapping, filename);
+	if (rc != DC_STATUS_SUCCESS) {
+		message ("Failed to open the input file '%s'.\n", filename);
+		return rc;
+	}
+
+	rc = parse (mapping.data, mapping.size, context, descriptor, devtime, systime, cache, output, number, formatted);
+
+	dctool_file_unmap (&mapping);
+
+	return rc;
+}
+
+static int
+filelist_add (filelist_t *list, const char *name, size_t length)
+{
+	if (list->count == list->capacity) {
+		unsigned int capacity = list->capacity ? list->capacity * 2 : 64;
+		char **names = (char **) realloc (list->names, capacity * sizeof (char *));
+		if (names == NULL)
+			return -1;
+		list->names = names;
+		list->capacity = capacity;
+	}
+
+	char *copy = (char *) malloc (length + 1);
+	if (copy == NULL)
+		return -1;
+
+	memcpy (copy, name, length);
+	copy[length] = 0;
+
+	list->names[list->count++] = copy;
+
+	return 0;
+}
+
+static int
+filelist_cmp (const void *a, const void *b)
+{
+	return strcmp (*(char * const *) a, *(char * const *) b);
+}
+
+/*
+ * Add a file, or all the files in a directory (sorted by name, without
+ * the hidden files and the subdirectories).
+ */
+static int
+filelist_expand (filelist_t *list, const char *name)
+{
+#ifdef HAVE_DIRENT_H
+	struct stat st;
+	if (stat (name, &st) == 0 && S_ISDIR (st.st_mode)) {
+		DIR *dir = opendir (name);
+		if (dir == NULL) {
+			message ("Failed to open the directory '%s'.\n", name);
+			return -1;
+		}
+
+		size_t length = strlen (name);
+		while (length > 1 && name[length - 1] == '/')
+			length--;
+
+		unsigned int first = list->count;
+		struct dirent *entry = NULL;
+		while ((entry = readdir (dir)) != NULL) {
+			if (entry->d_name[0] == '.')
+				continue;
+
+			size_t n = strlen (entry->d_name);
+			char *path = (char *) malloc (length + 1 + n + 1);
+			if (path == NULL) {
+				closedir (dir);
+				return -1;
+			}
+			memcpy (path, name, length);
+			path[length] = '/';
+			memcpy (path + length + 1, entry->d_name, n + 1);
+
+			if (stat (path, &st) == 0 && S_ISREG (st.st_mode)) {
+				if (filelist_add (list, path, length + 1 + n) != 0) {
+					free (path);
+					closedir (dir);
+					return -1;
+				}
+			}
+
+			free (path);
+		}
+
+		closedir (dir);
+
+		qsort (list->names + first, list->count - first, sizeof (char *), filelist_cmp);
+
+		return 0;
+	}
+#endif
+
+	return filelist_add (list, name, strlen (name));
+}
+
+static void
+filelist_free (filelist_t *list)
+{
+	for (unsigned int i = 0; i < list->count; ++i) {
+		free (list->names[i]);
+	}
+	free (list->names);
+}
+
+#ifdef HAVE_THREADS
+static void *
+worker (void *userdata)
+{
+	queue_t *queue = (queue_t *) userdata;
+
+	// Each worker has its own context, because the logging
+	// functions are not thread-safe.
+	dc_context_t *context = NULL;
+	dctool_context_new (&context);
+
+	pthread_mutex_lock (&queue->mutex);
+	while (1) {
+		// Don't run too far ahead of the output.
+		while (queue->next < queue->njobs && queue->next >= queue->written + queue->window)
+			pthread_cond_wait (&queue->cond, &queue->mutex);
+
+		if (queue->next >= queue->njobs)
+			break;
+
+		job_t *job = queue->jobs + queue->next++;
+		unsigned int number = queue->next;
+
+		pthread_mutex_unlock (&queue->mutex);
+
+		job->buffer = dc_buffer_new (0);
+		if (job->buffer == NULL) {
+			job->status = DC_STATUS_NOMEMORY;
+		} else {
+			job->status = parse_file (job->filename, context, queue->descriptor, queue->devtime, queue->systime, queue->cache, queue->output, number, job->buffer);
+		}
+
+		pthread_mutex_lock (&queue->mutex);
+		job->done = 1;
+		pthread_cond_broadcast (&queue->cond);
+	}
+	pthread_mutex_unlock (&queue->mutex);
+
+	dc_context_free (context);
+
+	return NULL;
+}
+
+/*
+ * Parse the files on several worker threads. The dives are formatted
+ * in memory by the workers, and written to the output in order.
+ */
+static unsigned int
+parse_parallel (filelist_t *list, unsigned int nthreads, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, dc_cache_t *cache, dctool_output_t *output)
+{
+	unsigned int nerrors = 0;
+
+	queue_t queue;
+	queue.jobs = (job_t *) calloc (list->count, sizeof (job_t));
+	if (queue.jobs == NULL) {
+		message ("Failed to allocate memory.\n");
+		return list->count;
+	}
+
+	for (unsigned int i = 0; i < list->count; ++i) {
+		queue.jobs[i].filename = list->names[i];
+		queue.jobs[i].buffer = NULL;
+		queue.jobs[i].status = DC_STATUS_SUCCESS;
+		queue.jobs[i].done = 0;
+	}
+
+	queue.njobs = list->count;
+	queue.next = 0;
+	queue.written = 0;
+	queue.window = nthreads * WINDOW;
+	queue.descriptor = descriptor;
+	queue.devtime = devtime;
+	queue.systime = systime;
+	queue.cache = cache;
+	queue.output = output;
+
+	pthread_mutex_init (&queue.mutex, NULL);
+	pthread_cond_init (&queue.cond, NULL);
+
+	pthread_t *threads = (pthread_t *) malloc (nthreads * sizeof (pthread_t));
+	unsigned int nstarted = 0;
+	while (threads && nstarted < nthreads) {
+		if (pthread_create (threads + nstarted, NULL, worker, &queue) != 0)
+			break;
+		nstarted++;
+	}
+
+	if (nstarted == 0) {
+		message ("Failed to start the worker threads.\n");
+		nerrors = list->count;
+	} else {
+		for (unsigned int i = 0; i < queue.njobs; ++i) {
+			job_t *job = queue.jobs + i;
+
+			pthread_mutex_lock (&queue.mutex);
+			while (!job->done)
+				pthread_cond_wait (&queue.cond, &queue.mutex);
+			pthread_mutex_unlock (&queue.mutex);
+
+			if (job->status != DC_STATUS_SUCCESS) {
+				message ("ERROR: %s: %s\n", job->filename, dctool_errmsg (job->status));
+				nerrors++;
+			}
+
+			if (job->buffer) {
+				dctool_output_append (output, job->buffer);
+				dc_buffer_free (job->buffer);
+				job->buffer = NULL;
+			}
+
+			pthread_mutex_lock (&queue.mutex);
+			queue.written++;
+			pthread_cond_broadcast (&queue.cond);
+			pthread_mutex_unlock (&queue.mutex);
+		}
+	}
+
+	for (unsigned int i = 0; i < nstarted; ++i) {
+		pthread_join (threads[i], NULL);
+	}
+
+	pthread_cond_destroy (&queue.cond);
+	pthread_mutex_destroy (&queue.mutex);
+
+	free (threads);
+	free (queue.jobs);
+
+	return nerrors;
+}
+#endif
+
+static void
+parse_cache_close (dc_cache_t *cache, dctool_mapping_t *mapping, const char *filename)
+{
+	dc_buffer_t *buffer = NULL;
+	unsigned int hits = 0, misses = 0;
+
+	if (cache) {
+		dc_cache_get_stats (cache, &hits, &misses);
+		message ("Cache: %u hits, %u misses.\n", hits, misses);
+
+		// Serialize the updated cache, before the old one is unmapped.
+		if (misses) {
+			buffer = dc_buffer_new (0);
+			if (buffer == NULL || dc_cache_write (cache, buffer) != DC_STATUS_SUCCESS) {
+				message ("Failed to write the cache.\n");
+				dc_buffer_free (buffer);
+				buffer = NULL;
+			}
+		}
+	}
+
+	dc_cache_free (cache);
+	dctool_file_unmap (mapping);
+
+	if (buffer) {
+		dctool_file_write (filename, buffer);
+		dc_buffer_free (buffer);
+	}
+}
+
 static int
 dctool_parse_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t *descriptor)
 {
@@ -88,23 +440,33 @@ dctool_parse_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 	dc_buffer_t *buffer = NULL;
 	dctool_output_t *output = NULL;
 	dctool_units_t units = DCTOOL_UNITS_METRIC;
+	filelist_t list = {NULL, 0, 0};
+	unsigned int nerrors = 0;
+	dctool_mapping_t mapping = {NULL, 0, NULL};
+	dc_cache_t *cache = NULL;
 
 	// Default option values.
 	unsigned int help = 0;
 	const char *filename = NULL;
+	const char *format = "xml";
 	unsigned int devtime = 0;
 	dc_ticks_t systime = 0;
+	unsigned int njobs = 1;
+	const char *cachefile = NULL;
 
 	// Parse the command-line options.
 	int opt = 0;
-	const char *optstring = "ho:d:s:u:";
+	const char *optstring = "ho:d:s:f:u:j:c:";
 #ifdef HAVE_GETOPT_LONG
 	struct option options[] = {
 		{"help",        no_argument,       0, 'h'},
 		{"output",      required_argument, 0, 'o'},
 		{"devtime",     required_argument, 0, 'd'},
 		{"systime",     required_argument, 0, 's'},
+		{"format",      required_argument, 0, 'f'},
 		{"units",       required_argument, 0, 'u'},
+		{"jobs",        required_argument, 0, 'j'},
+		{"cache",       required_argument, 0, 'c'},
 		{0,             0,                 0,  0 }
 	};
 	while ((opt = getopt_long (argc, argv, optstring, options, NULL)) != -1) {
@@ -124,12 +486,23 @@ dctool_parse_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		case 's':
 			systime = strtoll (optarg, NULL, 0);
 			break;
+		case 'f':
+			format = optarg;
+			break;
 		case 'u':
 			if (strcmp (optarg, "metric") == 0)
 				units = DCTOOL_UNITS_METRIC;
 			if (strcmp (optarg, "imperial") == 0)
 				units = DCTOOL_UNITS_IMPERIAL;
 			break;
+		case 'j':
+			njobs = strtoul (optarg, NULL, 0);
+			if (njobs == 0)
+				njobs = 1;
+			break;
+		case 'c':
+			cachefile = optarg;
+			break;
 		default:
 			return EXIT_FAILURE;
 		}
@@ -144,39 +517,89 @@ dctool_parse_run (int argc, char *argv[], dc_context_t *context, dc_descriptor_t
 		return EXIT_SUCCESS;
 	}
 
-	// Create the output.
-	output = dctool_xml_output_new (filename, units);
+	// Collect the input files.
+	for (unsigned int i = 0; i < argc; ++i) {
+		if (filelist_expand (&list, argv[i]) != 0) {
+			message ("Failed to collect the input files.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	}
+
+	// Open the cache. A missing cache file is created at the end.
+	if (cachefile) {
+		dctool_file_map (&mapping, cachefile);
+		status = dc_cache_new (&cache, context, mapping.data, mapping.size);
+		if (status != DC_STATUS_SUCCESS) {
+			message ("Failed to open the cache.\n");
+			exitcode = EXIT_FAILURE;
+			goto cleanup;
+		}
+	}
+
+	// Create the output. Only the xml output supports formatting the
+	// dives in memory, which is required for the parallel mode.
+	unsigned int ordered = 0;
+	if (strcasecmp(format, "xml") == 0) {
+		output = dctool_xml_output_new (filename, units);
+		ordered = 1;
+	} else if (strcasecmp(format, "archive") == 0) {
+		output = dctool_archive_output_new (filename, context);
+	} else {
+		message ("Unknown output format: %s\n", format);
+		exitcode = EXIT_FAILURE;
+		goto cleanup;
+	}
 	if (output == NULL) {
 		message ("Failed to create the output.\n");
 		exitcode = EXIT_FAILURE;
 		goto cleanup;
 	}
 
-	for (unsigned int i = 0; i < argc; ++i) {
-		// Read the input file.
-		buffer = dctool_file_read (argv[i]);
+#ifdef HAVE_THREADS
+	if (ordered && njobs > 1 && list.count > 1) {
+		if (njobs > list.count)
+			njobs = list.count;
+		nerrors = parse_parallel (&list, njobs, descriptor, devtime, systime, cache, output);
+		goto cleanup;
+	}
+#endif
+
+	// Parse the files one after the other. The xml output uses the same
+	// code path as the parallel mode, to produce the exact same output.
+	if (ordered) {
+		buffer = dc_buffer_new (0);
 		if (buffer == NULL) {
-			message ("Failed to open the input file.\n");
+			message ("Failed to allocate memory.\n");
 			exitcode = EXIT_FAILURE;
 			goto cleanup;
 		}
+	}
+
+	for (unsigned int i = 0; i < list.count; ++i) {
+		dc_buffer_clear (buffer);
 
 		// Parse the dive.
-		status = parse (buffer, context, descriptor, devtime, systime, output);
+		status = parse_file (list.names[i], context, descriptor, devtime, systime, cache, output, i + 1, buffer);
 		if (status != DC_STATUS_SUCCESS) {
-			message ("ERROR: %s\n", dctool_errmsg (status));
-			exitcode = EXIT_FAILURE;
-			goto cleanup;
+			message ("ERROR: %s: %s\n", list.names[i], dctool_errmsg (status));
+			nerrors++;
 		}
 
-		// Cleanup.
-		dc_buffer_free (buffer);
-		buffer = NULL;
+		if (buffer) {
+			dctool_output_append (output, buffer);
+		}
 	}
 
 cleanup:
+	if (nerrors) {
+		message ("Failed to parse %u of %u files.\n", nerrors, list.count);
+		exitcode = EXIT_FAILURE;
+	}
 	dc_buffer_free (buffer);
 	dctool_output_free (output);
+	filelist_free (&list);
+	parse_cache_close (cache, &mapping, cachefile);
 	return exitcode;
 }
 
@@ -186,7 +609,7 @@ const dctool_command_t dctool_parse = {
 	"parse",
 	"Parse previously downloaded dives",
 	"Usage:\n"
-	"   dctool parse [options] <filename>\n"
+	"   dctool parse [options] <filename|directory>...\n"
 	"\n"
 	"Options:\n"
 #ifdef HAVE_GETOPT_LONG
@@ -194,12 +617,38 @@ const dctool_command_t dctool_parse = {
 	"   -o, --output <filename>    Output filename\n"
 	"   -d, --devtime <timestamp>  Device time\n"
 	"   -s, --systime <timestamp>  System time\n"
+	"   -f, --format <format>      Output format\n"
 	"   -u, --units <units>        Set units (metric or imperial)\n"
+	"   -j, --jobs <count>         Number of worker threads\n"
+	"   -c, --cache <filename>     Cache of the parsed dives\n"
 #else
 	"   -h              Show help message\n"
 	"   -o <filename>   Output filename\n"
 	"   -d <devtime>    Device time\n"
 	"   -s <systime>    System time\n"
+	"   -f <format>     Output format\n"
 	"   -u <units>      Set units (metric or imperial)\n"
+	"   -j <count>      Number of worker threads\n"
+	"   -c <filename>   Cache of the parsed dives\n"
 #endif
+	"\n"
+	"The files in a directory are parsed in alphabetical order. A file\n"
+	"which fails to parse is reported, and the remaining files are still\n"
+	"parsed. With multiple worker threads, the dives are parsed in\n"
+	"parallel, but still written in the same order (xml format only).\n"
+	"\n"
+	"With a cache file, dives parsed before are read from the cache, and\n"
+	"the new dives are added to it. The cached values are rounded to the\n"
+	"resolution of the archive format.\n"
+	"\n"
+	"Supported output formats:\n"
+	"\n"
+	"   XML (default)\n"
+	"\n"
+	"      All dives are exported to a single xml file.\n"
+	"\n"
+	"   ARCHIVE\n"
+	"\n"
+	"      All dives are exported to a single binary archive, which can\n"
+	"      be read back with the dc_archive functions.\n"
 };
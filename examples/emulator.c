@@ -0,0 +1,572 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#define _XOPEN_SOURCE 600 // posix_openpt, grantpt, unlockpt, ptsname
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+
+#include "emulator.h"
+#include "utils.h"
+
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
+#define BAUDRATE_HOST 0xFFFFFFFF
+
+struct dcemu_t {
+	int master;
+	int slave;
+	char name[64];
+	dc_buffer_t *memory;
+	// Input buffer. The first byte of every packet
+	// is the packet mode status byte.
+	unsigned char buffer[1 + 4096];
+	size_t offset;
+	size_t length;
+	// Simulation parameters.
+	unsigned int baudrate;
+	unsigned int latency;
+	double corrupt;
+	double drop;
+	unsigned int seed;
+	dcemu_cancel_callback_t cancel;
+	void *userdata;
+	dcemu_stats_t stats;
+};
+
+// A 30 minute dive to 20 meters.
+const dcbench_profile_t dcemu_profile = {30 * 60, 20.0, 1};
+
+static const struct {
+	speed_t speed;
+	unsigned int baudrate;
+} g_speeds[] = {
+	{B1200,   1200},
+	{B2400,   2400},
+	{B4800,   4800},
+	{B9600,   9600},
+	{B19200,  19200},
+	{B38400,  38400},
+#ifdef B57600
+	{B57600,  57600},
+#endif
+#ifdef B115200
+	{B115200, 115200},
+#endif
+#ifdef B230400
+	{B230400, 230400},
+#endif
+#ifdef B460800
+	{B460800, 460800},
+#endif
+#ifdef B921600
+	{B921600, 921600},
+#endif
+};
+
+static int
+dcemu_is_cancelled (dcemu_t *emu)
+{
+	if (emu->cancel == NULL)
+		return 0;
+
+	return emu->cancel (emu->userdata);
+}
+
+static void
+dcemu_usleep (unsigned long long microseconds)
+{
+	if (microseconds == 0)
+		return;
+
+	struct timespec ts;
+	ts.tv_sec  = microseconds / 1000000;
+	ts.tv_nsec = (microseconds % 1000000) * 1000;
+	while (nanosleep (&ts, &ts) != 0 && errno == EINTR) {
+		/* Retry after an interruption. */
+	}
+}
+
+/*
+ * A simple xorshift generator. The quality is more than good enough to
+ * inject faults, and unlike rand() the sequence is identical on every
+ * platform for the same seed.
+ */
+static double
+dcemu_random (dcemu_t *emu)
+{
+	unsigned int x = emu->seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	emu->seed = x;
+
+	return (double) x / 4294967296.0;
+}
+
+/*
+ * Calculate the transmission time (in microseconds) of the data, using
+ * the framing (data, parity and stop bits) configured by the host.
+ */
+static unsigned long long
+dcemu_transmission_time (dcemu_t *emu, unsigned int size)
+{
+	if (emu->baudrate == 0 || size == 0)
+		return 0;
+
+	struct termios tty;
+	if (tcgetattr (emu->slave, &tty) != 0)
+		return 0;
+
+	unsigned int baudrate = emu->baudrate;
+	if (baudrate == BAUDRATE_HOST) {
+		speed_t speed = cfgetospeed (&tty);
+		baudrate = 0;
+		for (unsigned int i = 0; i < C_ARRAY_SIZE (g_speeds); ++i) {
+			if (g_speeds[i].speed == speed) {
+				baudrate = g_speeds[i].baudrate;
+				break;
+			}
+		}
+		if (baudrate == 0)
+			return 0;
+	}
+
+	unsigned int bits = 1; // Start bit
+	switch (tty.c_cflag & CSIZE) {
+	case CS5: bits += 5; break;
+	case CS6: bits += 6; break;
+	case CS7: bits += 7; break;
+	default:  bits += 8; break;
+	}
+	if (tty.c_cflag & PARENB)
+		bits += 1;
+	if (tty.c_cflag & CSTOPB)
+		bits += 2;
+	else
+		bits += 1;
+
+	return (unsigned long long) size * bits * 1000000 / baudrate;
+}
+
+dc_status_t
+dcemu_open (dcemu_t **out, dc_buffer_t *memory)
+{
+	dcemu_t *emu = NULL;
+
+	if (out == NULL || memory == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	emu = (dcemu_t *) malloc (sizeof (dcemu_t));
+	if (emu == NULL) {
+		ERROR ("Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	memset (emu, 0, sizeof (*emu));
+	emu->slave = -1;
+	emu->memory = memory;
+	emu->baudrate = BAUDRATE_HOST;
+	emu->seed = 1;
+
+	emu->master = posix_openpt (O_RDWR | O_NOCTTY);
+	if (emu->master == -1) {
+		ERROR ("Failed to open the pseudo terminal.");
+		goto error_free;
+	}
+
+	if (grantpt (emu->master) != 0 || unlockpt (emu->master) != 0) {
+		ERROR ("Failed to unlock the pseudo terminal.");
+		goto error_close;
+	}
+
+	const char *name = ptsname (emu->master);
+	if (name == NULL || strlen (name) >= sizeof (emu->name)) {
+		ERROR ("Failed to retrieve the pseudo terminal name.");
+		goto error_close;
+	}
+	strcpy (emu->name, name);
+
+	// Keep the slave side open. Otherwise the master side reports a
+	// hangup every time the host closes the device, and the emulator
+	// would not survive more than one session.
+	emu->slave = open (emu->name, O_RDWR | O_NOCTTY);
+	if (emu->slave == -1) {
+		ERROR ("Failed to open the pseudo terminal.");
+		goto error_close;
+	}
+
+	// Start in raw mode. Otherwise the line discipline would echo our
+	// responses back, until the host configures the terminal. This is
+	// also the state the host restores when closing the device.
+	struct termios tty;
+	if (tcgetattr (emu->slave, &tty) != 0) {
+		ERROR ("Failed to get the terminal attributes.");
+		goto error_close;
+	}
+	tty.c_iflag = 0;
+	tty.c_oflag = 0;
+	tty.c_lflag = 0;
+	tty.c_cflag = (tty.c_cflag & ~(CSIZE | PARENB | CSTOPB)) | CS8 | CREAD | CLOCAL;
+	if (tcsetattr (emu->slave, TCSANOW, &tty) != 0) {
+		ERROR ("Failed to set the terminal attributes.");
+		goto error_close;
+	}
+
+	// Enable packet mode, to get notified when the host purges
+	// its buffers.
+	int enable = 1;
+	if (ioctl (emu->master, TIOCPKT, &enable) != 0) {
+		ERROR ("Failed to enable packet mode.");
+		goto error_close;
+	}
+
+	*out = emu;
+
+	return DC_STATUS_SUCCESS;
+
+error_close:
+	if (emu->slave != -1)
+		close (emu->slave);
+	close (emu->master);
+error_free:
+	free (emu);
+	return DC_STATUS_IO;
+}
+
+void
+dcemu_close (dcemu_t *emu)
+{
+	if (emu == NULL)
+		return;
+
+	close (emu->slave);
+	close (emu->master);
+	dc_buffer_free (emu->memory);
+	free (emu);
+}
+
+const char *
+dcemu_get_name (dcemu_t *emu)
+{
+	if (emu == NULL)
+		return NULL;
+
+	return emu->name;
+}
+
+void
+dcemu_set_baudrate (dcemu_t *emu, unsigned int baudrate)
+{
+	if (emu == NULL)
+		return;
+
+	emu->baudrate = baudrate;
+}
+
+void
+dcemu_set_latency (dcemu_t *emu, unsigned int latency)
+{
+	if (emu == NULL)
+		return;
+
+	emu->latency = latency;
+}
+
+void
+dcemu_set_faults (dcemu_t *emu, double corrupt, double drop, unsigned int seed)
+{
+	if (emu == NULL)
+		return;
+
+	emu->corrupt = corrupt;
+	emu->drop = drop;
+	emu->seed = seed ? seed : 1;
+}
+
+void
+dcemu_set_cancel (dcemu_t *emu, dcemu_cancel_callback_t callback, void *userdata)
+{
+	if (emu == NULL)
+		return;
+
+	emu->cancel = callback;
+	emu->userdata = userdata;
+}
+
+void
+dcemu_get_stats (dcemu_t *emu, dcemu_stats_t *stats)
+{
+	if (emu == NULL || stats == NULL)
+		return;
+
+	*stats = emu->stats;
+}
+
+dcemu_status_t
+dcemu_read (dcemu_t *emu, unsigned char data[], unsigned int size)
+{
+	unsigned int nbytes = 0;
+	while (nbytes < size) {
+		if (emu->offset == emu->length) {
+			if (dcemu_is_cancelled (emu))
+				return DCEMU_STOP;
+
+			ssize_t n = read (emu->master, emu->buffer, sizeof (emu->buffer));
+			if (n < 0) {
+				if (errno == EINTR || errno == EAGAIN)
+					continue;
+				ERROR ("Failed to read from the pseudo terminal.");
+				return DCEMU_STOP;
+			} else if (n == 0) {
+				continue;
+			}
+
+			emu->stats.nreads++;
+
+			if (emu->buffer[0] != TIOCPKT_DATA) {
+				// Drop the pending input, and abandon the request.
+				if (emu->buffer[0] & TIOCPKT_FLUSHREAD) {
+					emu->offset = emu->length = 0;
+					emu->stats.npurges++;
+					return DCEMU_PURGE;
+				}
+				continue;
+			}
+
+			emu->offset = 1;
+			emu->length = n;
+			emu->stats.nread += n - 1;
+
+			// The device receives the data only after the transmission.
+			dcemu_usleep (dcemu_transmission_time (emu, n - 1));
+		}
+
+		unsigned int len = emu->length - emu->offset;
+		if (len > size - nbytes)
+			len = size - nbytes;
+
+		memcpy (data + nbytes, emu->buffer + emu->offset, len);
+		emu->offset += len;
+		nbytes += len;
+	}
+
+	return DCEMU_SUCCESS;
+}
+
+dcemu_status_t
+dcemu_write (dcemu_t *emu, const unsigned char data[], unsigned int size)
+{
+	if (dcemu_is_cancelled (emu))
+		return DCEMU_STOP;
+
+	if (emu->latency)
+		dcemu_usleep ((unsigned long long) emu->latency * 1000);
+
+	// Drop the response.
+	if (emu->drop > 0.0 && dcemu_random (emu) < emu->drop) {
+		emu->stats.ndropped++;
+		return DCEMU_SUCCESS;
+	}
+
+	// The host receives the data only after the transmission.
+	dcemu_usleep (dcemu_transmission_time (emu, size));
+
+	// Corrupt a single byte of the response.
+	unsigned int corrupt = size;
+	if (size && emu->corrupt > 0.0 && dcemu_random (emu) < emu->corrupt) {
+		corrupt = (unsigned int) (dcemu_random (emu) * size);
+		emu->stats.ncorrupted++;
+	}
+
+	unsigned int nbytes = 0;
+	while (nbytes < size) {
+		ssize_t n = 0;
+		if (nbytes == corrupt) {
+			unsigned char byte = data[nbytes] ^ 0x5A;
+			n = write (emu->master, &byte, 1);
+		} else {
+			size_t len = size - nbytes;
+			if (corrupt > nbytes && corrupt < size)
+				len = corrupt - nbytes;
+			n = write (emu->master, data + nbytes, len);
+		}
+		if (n < 0) {
+			if (errno == EINTR) {
+				if (dcemu_is_cancelled (emu))
+					return DCEMU_STOP;
+				continue;
+			}
+			ERROR ("Failed to write to the pseudo terminal.");
+			return DCEMU_STOP;
+		}
+
+		emu->stats.nwrites++;
+		emu->stats.nwritten += n;
+		nbytes += n;
+	}
+
+	return DCEMU_SUCCESS;
+}
+
+dcemu_status_t
+dcemu_drain (dcemu_t *emu, unsigned int milliseconds)
+{
+	emu->offset = emu->length = 0;
+
+	while (1) {
+		if (dcemu_is_cancelled (emu))
+			return DCEMU_STOP;
+
+		struct pollfd fd = {emu->master, POLLIN, 0};
+		int rc = poll (&fd, 1, milliseconds);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			ERROR ("Failed to poll the pseudo terminal.");
+			return DCEMU_STOP;
+		} else if (rc == 0) {
+			break;
+		}
+
+		ssize_t n = read (emu->master, emu->buffer, sizeof (emu->buffer));
+		if (n < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			ERROR ("Failed to read from the pseudo terminal.");
+			return DCEMU_STOP;
+		} else if (n == 0) {
+			continue;
+		}
+
+		emu->stats.nreads++;
+
+		if (emu->buffer[0] == TIOCPKT_DATA) {
+			emu->stats.nread += n - 1;
+		} else if (emu->buffer[0] & TIOCPKT_FLUSHREAD) {
+			emu->stats.npurges++;
+		}
+	}
+
+	return DCEMU_SUCCESS;
+}
+
+void
+dcemu_sleep (dcemu_t *emu, unsigned int milliseconds)
+{
+	dcemu_usleep ((unsigned long long) milliseconds * 1000);
+}
+
+void
+dcemu_memory_read (dcemu_t *emu, unsigned int address, unsigned char data[], unsigned int size)
+{
+	const unsigned char *memory = dc_buffer_get_data (emu->memory);
+	size_t length = dc_buffer_get_size (emu->memory);
+
+	// Memory beyond the end of the image is erased.
+	for (unsigned int i = 0; i < size; ++i) {
+		size_t offset = (size_t) address + i;
+		data[i] = offset < length ? memory[offset] : 0xFF;
+	}
+}
+
+void
+dcemu_memory_write (dcemu_t *emu, unsigned int address, const unsigned char data[], unsigned int size)
+{
+	size_t length = dc_buffer_get_size (emu->memory);
+	size_t end = (size_t) address + size;
+
+	if (end > length) {
+		if (!dc_buffer_resize (emu->memory, end)) {
+			WARNING ("Failed to grow the memory image.");
+			return;
+		}
+		memset (dc_buffer_get_data (emu->memory) + length, 0xFF, end - length);
+	}
+
+	memcpy (dc_buffer_get_data (emu->memory) + address, data, size);
+}
+
+unsigned char *
+dcemu_image_erase (dc_buffer_t *memory, unsigned int size)
+{
+	if (!dc_buffer_clear (memory) || !dc_buffer_resize (memory, size))
+		return NULL;
+
+	unsigned char *data = dc_buffer_get_data (memory);
+	memset (data, 0xFF, size);
+
+	return data;
+}
+
+unsigned char
+dcemu_checksum_add_uint8 (const unsigned char data[], unsigned int size, unsigned char init)
+{
+	unsigned char crc = init;
+	for (unsigned int i = 0; i < size; ++i)
+		crc += data[i];
+
+	return crc;
+}
+
+unsigned short
+dcemu_checksum_add_uint16 (const unsigned char data[], unsigned int size, unsigned short init)
+{
+	unsigned short crc = init;
+	for (unsigned int i = 0; i < size; ++i)
+		crc += data[i];
+
+	return crc;
+}
+
+unsigned char
+dcemu_checksum_xor_uint8 (const unsigned char data[], unsigned int size, unsigned char init)
+{
+	unsigned char crc = init;
+	for (unsigned int i = 0; i < size; ++i)
+		crc ^= data[i];
+
+	return crc;
+}
+
+unsigned short
+dcemu_checksum_crc_ccitt_uint16 (const unsigned char data[], unsigned int size)
+{
+	unsigned short crc = 0xFFFF;
+	for (unsigned int i = 0; i < size; ++i) {
+		crc ^= data[i] << 8;
+		for (unsigned int j = 0; j < 8; ++j) {
+			if (crc & 0x8000)
+				crc = (crc << 1) ^ 0x1021;
+			else
+				crc = (crc << 1);
+		}
+	}
+
+	return crc;
+}
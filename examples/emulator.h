@@ -0,0 +1,173 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DCEMU_EMULATOR_H
+#define DCEMU_EMULATOR_H
+
+#include <libdivecomputer/common.h>
+#include <libdivecomputer/buffer.h>
+
+#include "generator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct dcemu_t dcemu_t;
+
+typedef enum dcemu_status_t {
+	DCEMU_SUCCESS,
+	DCEMU_PURGE, /* The host purged its input buffer. */
+	DCEMU_STOP,  /* The emulator is shutting down. */
+} dcemu_status_t;
+
+typedef int (*dcemu_cancel_callback_t) (void *userdata);
+
+typedef struct dcemu_stats_t {
+	unsigned long long nread;
+	unsigned long long nwritten;
+	unsigned int nreads;
+	unsigned int nwrites;
+	unsigned int npurges;
+	unsigned int ncorrupted;
+	unsigned int ndropped;
+} dcemu_stats_t;
+
+/*
+ * An emulator backend implements the device side of the protocol of
+ * one family. The run function serves requests until the emulator is
+ * stopped. Whenever the host purges its buffers, the pending request
+ * is abandoned, which is also how a real device resynchronizes.
+ *
+ * Without a memory image, the image function synthesizes the memory of
+ * a device containing a single dive (the dcemu_profile dive), laid out
+ * the way the driver expects it for the given model.
+ */
+typedef struct dcemu_backend_t {
+	const char *name;
+	const char *description;
+	dc_status_t (*run) (dcemu_t *emu, const char *model);
+	dc_status_t (*image) (dc_buffer_t *memory, const char *model);
+} dcemu_backend_t;
+
+extern const dcemu_backend_t dcemu_oceanic_atom2;
+extern const dcemu_backend_t dcemu_suunto_d9;
+extern const dcemu_backend_t dcemu_suunto_vyper2;
+extern const dcemu_backend_t dcemu_mares_iconhd;
+extern const dcemu_backend_t dcemu_hw_ostc3;
+extern const dcemu_backend_t dcemu_cochran_commander;
+extern const dcemu_backend_t dcemu_reefnet_sensusultra;
+
+/*
+ * The dive stored in the synthesized memory images.
+ */
+extern const dcbench_profile_t dcemu_profile;
+
+/*
+ * Create a pseudo terminal, and serve the memory image on it. The
+ * memory buffer is owned by the emulator.
+ */
+dc_status_t
+dcemu_open (dcemu_t **emu, dc_buffer_t *memory);
+
+void
+dcemu_close (dcemu_t *emu);
+
+const char *
+dcemu_get_name (dcemu_t *emu);
+
+/*
+ * Simulate the transmission time at the given baudrate. A zero
+ * baudrate disables the simulation. By default, the baudrate
+ * configured by the host is used.
+ */
+void
+dcemu_set_baudrate (dcemu_t *emu, unsigned int baudrate);
+
+/*
+ * Processing time (in milliseconds) before every response.
+ */
+void
+dcemu_set_latency (dcemu_t *emu, unsigned int latency);
+
+/*
+ * Corrupt a random byte of a response, or drop the entire response,
+ * with the given probabilities.
+ */
+void
+dcemu_set_faults (dcemu_t *emu, double corrupt, double drop, unsigned int seed);
+
+void
+dcemu_set_cancel (dcemu_t *emu, dcemu_cancel_callback_t callback, void *userdata);
+
+void
+dcemu_get_stats (dcemu_t *emu, dcemu_stats_t *stats);
+
+/*
+ * Functions for the backends.
+ */
+
+dcemu_status_t
+dcemu_read (dcemu_t *emu, unsigned char data[], unsigned int size);
+
+dcemu_status_t
+dcemu_write (dcemu_t *emu, const unsigned char data[], unsigned int size);
+
+/*
+ * Wait until the host has been quiet for the given time, and drop the
+ * input and the purges received in the meantime.
+ */
+dcemu_status_t
+dcemu_drain (dcemu_t *emu, unsigned int milliseconds);
+
+void
+dcemu_sleep (dcemu_t *emu, unsigned int milliseconds);
+
+void
+dcemu_memory_read (dcemu_t *emu, unsigned int address, unsigned char data[], unsigned int size);
+
+void
+dcemu_memory_write (dcemu_t *emu, unsigned int address, const unsigned char data[], unsigned int size);
+
+/*
+ * Resize the memory image, and erase all bytes to 0xFF, like the
+ * memory of a device without any dives. Returns a pointer to the
+ * memory, or NULL on failure.
+ */
+unsigned char *
+dcemu_image_erase (dc_buffer_t *memory, unsigned int size);
+
+unsigned char
+dcemu_checksum_add_uint8 (const unsigned char data[], unsigned int size, unsigned char init);
+
+unsigned short
+dcemu_checksum_add_uint16 (const unsigned char data[], unsigned int size, unsigned short init);
+
+unsigned char
+dcemu_checksum_xor_uint8 (const unsigned char data[], unsigned int size, unsigned char init);
+
+unsigned short
+dcemu_checksum_crc_ccitt_uint16 (const unsigned char data[], unsigned int size);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DCEMU_EMULATOR_H */
@@ -0,0 +1,308 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "emulator.h"
+#include "generator.h"
+#include "utils.h"
+
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
+#define SZ_ID     67
+#define SZ_CONFIG 1024
+
+#define HEARTBEAT 0xAA
+
+#define FEET 0.3048
+
+#define CMD_ID     0x05
+#define CMD_CONFIG 0x96
+#define CMD_READ   0x15
+
+// Processing time before a high speed answer. This gives the host
+// the time to switch to the higher baudrate.
+#define T_COMMAND 50
+
+// Config and logbook offsets of the EMC models.
+#define CF_DIVE_COUNT     0x0D2
+#define CF_LAST_LOG       0x13E
+#define CF_SERIAL_NUMBER  0x1E6
+
+#define SZ_LOGBOOK        512
+#define LOG_DATETIME      0
+#define LOG_PROFILE_BEGIN 6
+#define LOG_CONDUCTIVITY  24
+#define LOG_PROFILE_PRE   30
+#define LOG_START_TEMP    55
+#define LOG_DIVE_NUMBER   86
+#define LOG_OXYGEN        144
+#define LOG_PROFILE_END   256
+#define LOG_END_TEMP      293
+#define LOG_DIVETIME      304
+#define LOG_MAX_DEPTH     306
+#define LOG_AVG_DEPTH     310
+#define LOG_MIN_TEMP      403
+#define LOG_MAX_TEMP      407
+
+typedef struct cochran_commander_model_t {
+	const char *name;
+	unsigned char id[3 + 1];
+	unsigned int address_bits;
+	unsigned int rb_profile_begin;
+} cochran_commander_model_t;
+
+static const cochran_commander_model_t g_models[] = {
+	{"emc20",      "230",      32, 0x94000},
+	{"emc16",      "A30",      32, 0x94000},
+	{"emc14",      "730",      32, 0x22000},
+	{"commander",  "\x11""22", 24, 0},
+	{"commander1", "\x11""21", 24, 0},
+};
+
+static const cochran_commander_model_t *
+cochran_commander_model (const char *name)
+{
+	if (name == NULL)
+		return &g_models[0];
+
+	for (unsigned int i = 0; i < C_ARRAY_SIZE (g_models); ++i) {
+		if (strcmp (name, g_models[i].name) == 0)
+			return &g_models[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * The EMC models return the id block on the first id command. For the
+ * Commander models, the host detects the missing copyright notice,
+ * and sends a second id command for a different location.
+ */
+static void
+cochran_commander_id (const cochran_commander_model_t *model, const unsigned char command[], unsigned char id[])
+{
+	memset (id, 0x00, SZ_ID);
+
+	if (model->address_bits == 32 || command[1] == 0xBD) {
+		if (model->address_bits == 32)
+			memcpy (id, "(C)", 3);
+		memcpy (id + 0x3D, model->id, 3);
+	}
+}
+
+/*
+ * The memory image consists of the config block, followed by
+ * the memory dump.
+ */
+static dcemu_status_t
+cochran_commander_request (dcemu_t *emu, const cochran_commander_model_t *model)
+{
+	dcemu_status_t status = DCEMU_SUCCESS;
+
+	// Receive the command byte.
+	unsigned char command[10] = {0};
+	status = dcemu_read (emu, command, 1);
+	if (status != DCEMU_SUCCESS)
+		return status;
+
+	unsigned int csize = 0;
+	switch (command[0]) {
+	case CMD_ID:
+		csize = 6;
+		break;
+	case CMD_CONFIG:
+		csize = 2;
+		break;
+	case CMD_READ:
+		csize = (model->address_bits == 32 ? 10 : 8);
+		break;
+	default:
+		return DCEMU_SUCCESS;
+	}
+
+	// Receive the remainder of the command.
+	status = dcemu_read (emu, command + 1, csize - 1);
+	if (status != DCEMU_SUCCESS)
+		return status;
+
+	if (command[0] == CMD_ID) {
+		unsigned char id[SZ_ID];
+		cochran_commander_id (model, command, id);
+		return dcemu_write (emu, id, sizeof (id));
+	} else if (command[0] == CMD_CONFIG) {
+		unsigned char config[SZ_CONFIG / 2];
+		dcemu_memory_read (emu, (command[1] & 0x01) * sizeof (config), config, sizeof (config));
+		return dcemu_write (emu, config, sizeof (config));
+	}
+
+	unsigned int address = 0, size = 0;
+	if (model->address_bits == 32) {
+		address = command[1] | (command[2] << 8) | (command[3] << 16) | ((unsigned int) command[4] << 24);
+		size = command[5] | (command[6] << 8) | (command[7] << 16) | ((unsigned int) command[8] << 24);
+	} else {
+		address = command[1] | (command[2] << 8) | (command[3] << 16);
+		size = command[4] | (command[5] << 8) | (command[6] << 16);
+	}
+
+	unsigned char *data = (unsigned char *) malloc (size ? size : 1);
+	if (data == NULL) {
+		ERROR ("Failed to allocate memory.");
+		return DCEMU_STOP;
+	}
+
+	dcemu_memory_read (emu, SZ_CONFIG + address, data, size);
+
+	dcemu_sleep (emu, T_COMMAND);
+
+	status = dcemu_write (emu, data, size);
+
+	free (data);
+
+	return status;
+}
+
+static dc_status_t
+cochran_commander_run (dcemu_t *emu, const char *name)
+{
+	const cochran_commander_model_t *model = cochran_commander_model (name);
+	if (model == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dcemu_status_t status = DCEMU_SUCCESS;
+	while (status != DCEMU_STOP) {
+		status = cochran_commander_request (emu, model);
+		if (status == DCEMU_PURGE) {
+			// After the break and purge, the host is waiting
+			// for a heartbeat.
+			unsigned char heartbeat[1] = {HEARTBEAT};
+			status = dcemu_write (emu, heartbeat, sizeof (heartbeat));
+		}
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * The EMC models store a 512 byte logbook entry per dive, which points
+ * to the samples in the profile ringbuffer. A sample is recorded every
+ * second: the depth change (1/4 ft), alternating the ascent rate and
+ * the temperature, and the tissue and deco data. The Commander models
+ * use a different format, and are not supported.
+ */
+static dc_status_t
+cochran_commander_image (dc_buffer_t *memory, const char *name)
+{
+	const dcbench_profile_t *profile = &dcemu_profile;
+
+	const cochran_commander_model_t *model = cochran_commander_model (name);
+	if (model == NULL)
+		return DC_STATUS_INVALIDARGS;
+	if (model->address_bits != 32)
+		return DC_STATUS_UNSUPPORTED;
+
+	unsigned int nsamples = profile->duration;
+	unsigned int begin = model->rb_profile_begin;
+	unsigned int end = begin + nsamples * 3;
+
+	unsigned char *p = dcemu_image_erase (memory, SZ_CONFIG + end);
+	if (p == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	// Config: number of dives, pointer to the last dive and serial number.
+	unsigned char *config = p;
+	memset (config, 0x00, SZ_CONFIG);
+	dcbench_put_uint16_le (config + CF_DIVE_COUNT, 1);
+	dcbench_put_uint32_le (config + CF_LAST_LOG, begin);
+	dcbench_put_uint32_le (config + CF_SERIAL_NUMBER, 123456);
+
+	// Samples. The temperature is stored in half degrees Fahrenheit
+	// above 20 °F.
+	unsigned int maxdepth = 0, sumdepth = 0;
+	unsigned int mintemp = 0xFF, maxtemp = 0;
+	unsigned int previous = 0;
+	unsigned char *s = p + SZ_CONFIG + begin;
+	for (unsigned int time = 0; time < nsamples; ++time) {
+		unsigned int depth = (unsigned int) (dcbench_profile_depth (profile, time) / FEET * 4.0 + 0.5);
+		unsigned int temperature = (unsigned int) ((dcbench_profile_temperature (profile, time) * 1.8 + 32.0 - 20.0) * 2.0);
+
+		unsigned int delta = 0;
+		if (depth < previous) {
+			delta = previous - depth;
+			if (delta > 0x3F)
+				delta = 0x3F;
+			previous -= delta;
+			delta |= 0x40;
+		} else {
+			delta = depth - previous;
+			if (delta > 0x3F)
+				delta = 0x3F;
+			previous += delta;
+		}
+
+		s[0] = delta;
+		s[1] = (time % 2) ? temperature : 0x80;
+		s[2] = 0x00;
+		s += 3;
+
+		if (previous > maxdepth)
+			maxdepth = previous;
+		if (temperature < mintemp)
+			mintemp = temperature;
+		if (temperature > maxtemp)
+			maxtemp = temperature;
+		sumdepth += previous;
+	}
+
+	// Logbook entry.
+	unsigned char *log = p + SZ_CONFIG;
+	memset (log, 0x00, SZ_LOGBOOK);
+	log[LOG_DATETIME + 0] = 0; /* 2017-06-15 10:30:00 */
+	log[LOG_DATETIME + 1] = 30;
+	log[LOG_DATETIME + 2] = 10;
+	log[LOG_DATETIME + 3] = 15;
+	log[LOG_DATETIME + 4] = 6;
+	log[LOG_DATETIME + 5] = 17;
+	dcbench_put_uint32_le (log + LOG_PROFILE_BEGIN, begin);
+	log[LOG_CONDUCTIVITY] = 2; /* Salt water */
+	dcbench_put_uint32_le (log + LOG_PROFILE_PRE, begin);
+	log[LOG_START_TEMP] = 75;
+	dcbench_put_uint16_le (log + LOG_DIVE_NUMBER, 1);
+	dcbench_put_uint16_le (log + LOG_OXYGEN + 0, 21 * 256);
+	dcbench_put_uint16_le (log + LOG_OXYGEN + 2, 21 * 256);
+	dcbench_put_uint32_le (log + LOG_PROFILE_END, end);
+	log[LOG_END_TEMP] = 75;
+	dcbench_put_uint16_le (log + LOG_DIVETIME, profile->duration / 60);
+	dcbench_put_uint16_le (log + LOG_MAX_DEPTH, maxdepth);
+	dcbench_put_uint16_le (log + LOG_AVG_DEPTH, sumdepth / nsamples);
+	log[LOG_MIN_TEMP] = mintemp;
+	log[LOG_MAX_TEMP] = maxtemp;
+
+	return DC_STATUS_SUCCESS;
+}
+
+const dcemu_backend_t dcemu_cochran_commander = {
+	"cochran_commander",
+	"Cochran Commander and EMC family (models: emc20, emc16, emc14, commander, commander1)",
+	cochran_commander_run,
+	cochran_commander_image,
+};
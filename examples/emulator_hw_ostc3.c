@@ -0,0 +1,375 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "emulator.h"
+#include "generator.h"
+#include "utils.h"
+
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
+#define SZ_CUSTOMTEXT 60
+#define SZ_VERSION    (SZ_CUSTOMTEXT + 4)
+#define SZ_HARDWARE2  5
+#define SZ_MEMORY     0x400000
+
+// The memory image is a service mode dump. Every logbook header is
+// stored at the start of a flash sector, and the profiles are stored
+// in the ringbuffer after the logbook area.
+#define RB_LOGBOOK_BEGIN         0x000000
+#define RB_LOGBOOK_SECTOR        0x1000
+#define RB_LOGBOOK_SIZE_COMPACT  16
+#define RB_LOGBOOK_SIZE_FULL     256
+#define RB_LOGBOOK_COUNT         256
+
+#define RB_PROFILE_BEGIN 0x200000
+#define RB_PROFILE_END   0x3E0000
+
+#define S_BLOCK_READ 0x20
+#define S_READY    0x4C
+#define READY      0x4D
+#define HARDWARE2  0x60
+#define HEADER     0x61
+#define DIVE       0x66
+#define IDENTITY   0x69
+#define HARDWARE   0x6A
+#define COMPACT    0x6D
+#define INIT       0xBB
+#define EXIT       0xFF
+
+#define SERVICE    0xAA
+
+typedef struct hw_ostc3_model_t {
+	const char *name;
+	unsigned int hardware;
+	unsigned int feature;
+	unsigned int model;
+} hw_ostc3_model_t;
+
+static const hw_ostc3_model_t g_models[] = {
+	{"ostc3", 0x0A, 0x0000, 0x00},
+	{"sport", 0x12, 0x0000, 0x00},
+	{"cr",    0x05, 0x0000, 0x00},
+};
+
+static const hw_ostc3_model_t *
+hw_ostc3_model (const char *name)
+{
+	if (name == NULL)
+		return &g_models[0];
+
+	for (unsigned int i = 0; i < C_ARRAY_SIZE (g_models); ++i) {
+		if (strcmp (name, g_models[i].name) == 0)
+			return &g_models[i];
+	}
+
+	return NULL;
+}
+
+static void
+hw_ostc3_logbook (dcemu_t *emu, unsigned int idx, unsigned char data[])
+{
+	dcemu_memory_read (emu, RB_LOGBOOK_BEGIN + idx * RB_LOGBOOK_SECTOR, data, RB_LOGBOOK_SIZE_FULL);
+}
+
+/*
+ * The compact header is a subset of the full logbook header.
+ */
+static void
+hw_ostc3_logbook_compact (dcemu_t *emu, unsigned int idx, unsigned char data[])
+{
+	unsigned char header[RB_LOGBOOK_SIZE_FULL];
+	hw_ostc3_logbook (emu, idx, header);
+
+	memset (data, 0xFF, RB_LOGBOOK_SIZE_COMPACT);
+	if (header[0] == 0xFF && header[1] == 0xFF)
+		return;
+
+	memcpy (data + 0, header + 9, 3);   // Profile length
+	memcpy (data + 3, header + 12, 5);  // Date and time
+	memcpy (data + 8, header + 17, 5);  // Maximum depth and divetime
+	memcpy (data + 13, header + 80, 2); // Dive number
+	data[15] = 0x00;
+}
+
+/*
+ * Send the dive: the full logbook header, followed by the profile data
+ * from the ringbuffer, starting at the begin pointer in the header.
+ */
+static dcemu_status_t
+hw_ostc3_dive (dcemu_t *emu, unsigned int idx)
+{
+	unsigned char header[RB_LOGBOOK_SIZE_FULL];
+	hw_ostc3_logbook (emu, idx, header);
+
+	unsigned int begin = header[2] | (header[3] << 8) | (header[4] << 16);
+	unsigned int length = header[9] | (header[10] << 8) | (header[11] << 16);
+	if (length < 3 || length > RB_PROFILE_END - RB_PROFILE_BEGIN)
+		length = 3;
+	length -= 3;
+
+	unsigned char *data = (unsigned char *) malloc (RB_LOGBOOK_SIZE_FULL + length);
+	if (data == NULL) {
+		ERROR ("Failed to allocate memory.");
+		return DCEMU_STOP;
+	}
+
+	memcpy (data, header, RB_LOGBOOK_SIZE_FULL);
+
+	unsigned int address = begin;
+	unsigned int nbytes = 0;
+	while (nbytes < length) {
+		if (address < RB_PROFILE_BEGIN || address >= RB_PROFILE_END)
+			address = RB_PROFILE_BEGIN;
+
+		unsigned int len = RB_PROFILE_END - address;
+		if (len > length - nbytes)
+			len = length - nbytes;
+
+		dcemu_memory_read (emu, address, data + RB_LOGBOOK_SIZE_FULL + nbytes, len);
+
+		nbytes += len;
+		address += len;
+	}
+
+	dcemu_status_t status = dcemu_write (emu, data, RB_LOGBOOK_SIZE_FULL + length);
+
+	free (data);
+
+	return status;
+}
+
+static dcemu_status_t
+hw_ostc3_request (dcemu_t *emu, const hw_ostc3_model_t *model, unsigned int *service)
+{
+	dcemu_status_t status = DCEMU_SUCCESS;
+
+	// Receive the command.
+	unsigned char command[1] = {0};
+	status = dcemu_read (emu, command, sizeof (command));
+	if (status != DCEMU_SUCCESS)
+		return status;
+
+	unsigned char ready[1] = {*service ? S_READY : READY};
+
+	// Enter service mode.
+	if (command[0] == SERVICE) {
+		unsigned char magic[3] = {0};
+		status = dcemu_read (emu, magic, sizeof (magic));
+		if (status != DCEMU_SUCCESS)
+			return status;
+
+		if (magic[0] != 0xAB || magic[1] != 0xCD || magic[2] != 0xEF)
+			return DCEMU_SUCCESS;
+
+		*service = 1;
+
+		unsigned char answer[5] = {0x4B, 0xAB, 0xCD, 0xEF, S_READY};
+		return dcemu_write (emu, answer, sizeof (answer));
+	}
+
+	switch (command[0]) {
+	case INIT:
+	case EXIT:
+	case HARDWARE:
+	case HARDWARE2:
+	case IDENTITY:
+	case HEADER:
+	case COMPACT:
+	case DIVE:
+		break;
+	case S_BLOCK_READ:
+		if (*service)
+			break;
+		/* Fall-through */
+	default:
+		// Unsupported commands are answered with the ready byte.
+		return dcemu_write (emu, ready, sizeof (ready));
+	}
+
+	// Echo the command.
+	status = dcemu_write (emu, command, sizeof (command));
+	if (status != DCEMU_SUCCESS)
+		return status;
+
+	switch (command[0]) {
+	case EXIT:
+		*service = 0;
+		return DCEMU_SUCCESS;
+	case HARDWARE:
+		{
+			unsigned char answer[1] = {model->hardware};
+			status = dcemu_write (emu, answer, sizeof (answer));
+		}
+		break;
+	case HARDWARE2:
+		{
+			unsigned char answer[SZ_HARDWARE2] = {
+				(model->hardware >> 8) & 0xFF, model->hardware & 0xFF,
+				(model->feature >> 8) & 0xFF, model->feature & 0xFF,
+				model->model};
+			status = dcemu_write (emu, answer, sizeof (answer));
+		}
+		break;
+	case IDENTITY:
+		{
+			// Serial number (little endian), firmware version (big
+			// endian) and the custom text.
+			unsigned char answer[SZ_VERSION] = {0x39, 0x30, 0x0A, 0x2B};
+			memset (answer + 4, ' ', SZ_CUSTOMTEXT);
+			memcpy (answer + 4, "libdivecomputer", 15);
+			status = dcemu_write (emu, answer, sizeof (answer));
+		}
+		break;
+	case HEADER:
+	case COMPACT:
+		{
+			unsigned int size = (command[0] == HEADER ?
+				RB_LOGBOOK_SIZE_FULL : RB_LOGBOOK_SIZE_COMPACT);
+			unsigned char *answer = (unsigned char *) malloc (size * RB_LOGBOOK_COUNT);
+			if (answer == NULL) {
+				ERROR ("Failed to allocate memory.");
+				return DCEMU_STOP;
+			}
+			for (unsigned int i = 0; i < RB_LOGBOOK_COUNT; ++i) {
+				if (command[0] == HEADER)
+					hw_ostc3_logbook (emu, i, answer + i * size);
+				else
+					hw_ostc3_logbook_compact (emu, i, answer + i * size);
+			}
+			status = dcemu_write (emu, answer, size * RB_LOGBOOK_COUNT);
+			free (answer);
+		}
+		break;
+	case DIVE:
+		{
+			unsigned char number[1] = {0};
+			status = dcemu_read (emu, number, sizeof (number));
+			if (status != DCEMU_SUCCESS)
+				return status;
+
+			status = hw_ostc3_dive (emu, number[0]);
+		}
+		break;
+	case S_BLOCK_READ:
+		{
+			unsigned char input[6] = {0};
+			status = dcemu_read (emu, input, sizeof (input));
+			if (status != DCEMU_SUCCESS)
+				return status;
+
+			unsigned int address = (input[0] << 16) | (input[1] << 8) | input[2];
+			unsigned int size = (input[3] << 16) | (input[4] << 8) | input[5];
+			if (address + size > SZ_MEMORY)
+				return DCEMU_SUCCESS;
+
+			unsigned char *answer = (unsigned char *) malloc (size ? size : 1);
+			if (answer == NULL) {
+				ERROR ("Failed to allocate memory.");
+				return DCEMU_STOP;
+			}
+			dcemu_memory_read (emu, address, answer, size);
+			status = dcemu_write (emu, answer, size);
+			free (answer);
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (status != DCEMU_SUCCESS)
+		return status;
+
+	// Send the ready byte.
+	return dcemu_write (emu, ready, sizeof (ready));
+}
+
+static dc_status_t
+hw_ostc3_run (dcemu_t *emu, const char *name)
+{
+	const hw_ostc3_model_t *model = hw_ostc3_model (name);
+	if (model == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	unsigned int service = 0;
+	while (hw_ostc3_request (emu, model, &service) != DCEMU_STOP) {
+		/* Serve the next request. */
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * The generated dive is the logbook header followed by the profile
+ * data. The header is stored in the first logbook sector, and the
+ * profile at the begin of the profile ringbuffer. The profile length
+ * in the header includes three extra bytes, which the device doesn't
+ * send.
+ */
+static dc_status_t
+hw_ostc3_image (dc_buffer_t *memory, const char *name)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	if (hw_ostc3_model (name) == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_buffer_t *dive = dc_buffer_new (0);
+	if (dive == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	status = dcbench_hw_ostc3.generate (dive, &dcemu_profile);
+	if (status != DC_STATUS_SUCCESS)
+		goto error_free;
+
+	const unsigned char *data = dc_buffer_get_data (dive);
+	unsigned int length = dc_buffer_get_size (dive) - RB_LOGBOOK_SIZE_FULL;
+
+	unsigned char *p = dcemu_image_erase (memory, RB_PROFILE_BEGIN + length);
+	if (p == NULL) {
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	unsigned char *header = p + RB_LOGBOOK_BEGIN;
+	memcpy (header, data, RB_LOGBOOK_SIZE_FULL);
+	header[2] = (RB_PROFILE_BEGIN      ) & 0xFF;
+	header[3] = (RB_PROFILE_BEGIN >>  8) & 0xFF;
+	header[4] = (RB_PROFILE_BEGIN >> 16) & 0xFF;
+	header[9]  = ((length + 3)      ) & 0xFF;
+	header[10] = ((length + 3) >>  8) & 0xFF;
+	header[11] = ((length + 3) >> 16) & 0xFF;
+
+	memcpy (p + RB_PROFILE_BEGIN, data + RB_LOGBOOK_SIZE_FULL, length);
+
+error_free:
+	dc_buffer_free (dive);
+	return status;
+}
+
+const dcemu_backend_t dcemu_hw_ostc3 = {
+	"hw_ostc3",
+	"Heinrichs Weikamp OSTC 3 family (models: ostc3, sport, cr)",
+	hw_ostc3_run,
+	hw_ostc3_image,
+};
@@ -0,0 +1,182 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "emulator.h"
+#include "generator.h"
+#include "utils.h"
+
+#define SZ_VERSION 140
+#define SZ_PACKET  4096
+
+#define ACK 0xAA
+#define EOF 0xEA
+
+#define CF_SERIAL        0x000C
+#define CF_POINTER       0x2001
+#define RB_PROFILE_BEGIN 0x00A000
+
+#define SZ_HEADER  0x5C
+#define SZ_SAMPLE  8
+#define INTERVAL   5
+
+static dcemu_status_t
+mares_iconhd_request (dcemu_t *emu, const unsigned char version[])
+{
+	dcemu_status_t status = DCEMU_SUCCESS;
+
+	// Receive the command header.
+	unsigned char header[2] = {0};
+	status = dcemu_read (emu, header, sizeof (header));
+	if (status != DCEMU_SUCCESS)
+		return status;
+
+	unsigned char ack[1] = {ACK};
+	unsigned char answer[SZ_PACKET + 1] = {0};
+	unsigned int asize = 0;
+
+	if (header[0] == 0xC2 && header[1] == 0x67) {
+		status = dcemu_write (emu, ack, sizeof (ack));
+		if (status != DCEMU_SUCCESS)
+			return status;
+
+		memcpy (answer, version, SZ_VERSION);
+		asize = SZ_VERSION;
+	} else if (header[0] == 0xE7 && header[1] == 0x42) {
+		status = dcemu_write (emu, ack, sizeof (ack));
+		if (status != DCEMU_SUCCESS)
+			return status;
+
+		// Receive the address and length.
+		unsigned char payload[8] = {0};
+		status = dcemu_read (emu, payload, sizeof (payload));
+		if (status != DCEMU_SUCCESS)
+			return status;
+
+		unsigned int address = payload[0] | (payload[1] << 8) | (payload[2] << 16) | ((unsigned int) payload[3] << 24);
+		unsigned int length = payload[4] | (payload[5] << 8) | (payload[6] << 16) | ((unsigned int) payload[7] << 24);
+		if (length > SZ_PACKET)
+			return DCEMU_SUCCESS;
+
+		dcemu_memory_read (emu, address, answer, length);
+		asize = length;
+	} else {
+		// Unknown commands are not answered.
+		return DCEMU_SUCCESS;
+	}
+
+	answer[asize] = EOF;
+
+	return dcemu_write (emu, answer, asize + 1);
+}
+
+static dc_status_t
+mares_iconhd_run (dcemu_t *emu, const char *model)
+{
+	// The product name in the version packet selects the model.
+	unsigned char version[SZ_VERSION] = {0};
+	const char *name = model ? model : "Icon HD";
+	if (strlen (name) > SZ_VERSION - 0x46)
+		return DC_STATUS_INVALIDARGS;
+	memcpy (version + 0x46, name, strlen (name));
+
+	while (mares_iconhd_request (emu, version) != DCEMU_STOP) {
+		/* Serve the next request. */
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * A dive consists of its total length, the samples and the dive header.
+ * The pointer in the config area points to the end of the last dive.
+ * The Icon HD Net Ready and the Smart models use a different format,
+ * and are not supported.
+ */
+static dc_status_t
+mares_iconhd_image (dc_buffer_t *memory, const char *model)
+{
+	const dcbench_profile_t *profile = &dcemu_profile;
+
+	if (model && (strcmp (model, "Icon AIR") == 0 ||
+		strncmp (model, "Smart", 5) == 0))
+		return DC_STATUS_UNSUPPORTED;
+
+	unsigned int nsamples = profile->duration / INTERVAL;
+	unsigned int length = 4 + nsamples * SZ_SAMPLE + SZ_HEADER;
+	unsigned int end = RB_PROFILE_BEGIN + length;
+
+	unsigned char *p = dcemu_image_erase (memory, end);
+	if (p == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	dcbench_put_uint32_le (p + CF_SERIAL, 123456);
+	dcbench_put_uint32_le (p + CF_POINTER, end);
+
+	unsigned char *dive = p + RB_PROFILE_BEGIN;
+	memset (dive, 0x00, length);
+	dcbench_put_uint32_le (dive, length);
+
+	// Depth (1/10 m) and temperature (1/10 °C).
+	unsigned int maxdepth = 0, mintemp = 0xFFFF, maxtemp = 0;
+	unsigned char *s = dive + 4;
+	for (unsigned int i = 0; i < nsamples; ++i) {
+		unsigned int time = (i + 1) * INTERVAL;
+		unsigned int depth = (unsigned int) (dcbench_profile_depth (profile, time) * 10.0);
+		unsigned int temperature = (unsigned int) (dcbench_profile_temperature (profile, time) * 10.0);
+		dcbench_put_uint16_le (s + 0, depth);
+		dcbench_put_uint16_le (s + 2, temperature);
+		if (depth > maxdepth)
+			maxdepth = depth;
+		if (temperature < mintemp)
+			mintemp = temperature;
+		if (temperature > maxtemp)
+			maxtemp = temperature;
+		s += SZ_SAMPLE;
+	}
+
+	// Dive header: type (air), number of samples, date and time, and
+	// the dive settings (5 second interval, metric units).
+	unsigned char *header = s;
+	dcbench_put_uint16_le (header + 0x00, 0);
+	dcbench_put_uint16_le (header + 0x02, nsamples);
+	dcbench_put_uint16_le (header + 0x04, maxdepth);
+	dcbench_put_uint16_le (header + 0x06, 10); /* 2017-06-15 10:30 */
+	dcbench_put_uint16_le (header + 0x08, 30);
+	dcbench_put_uint16_le (header + 0x0A, 15);
+	dcbench_put_uint16_le (header + 0x0C, 6 - 1);
+	dcbench_put_uint16_le (header + 0x0E, 2017 - 1900);
+	dcbench_put_uint16_le (header + 0x10, 0x0100 | (1 << 10));
+	dcbench_put_uint16_le (header + 0x26, 1013 * 8);
+	dcbench_put_uint16_le (header + 0x46, mintemp);
+	dcbench_put_uint16_le (header + 0x48, maxtemp);
+
+	return DC_STATUS_SUCCESS;
+}
+
+const dcemu_backend_t dcemu_mares_iconhd = {
+	"mares_iconhd",
+	"Mares Icon HD family (model: product name)",
+	mares_iconhd_run,
+	mares_iconhd_image,
+};
@@ -0,0 +1,278 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "emulator.h"
+#include "generator.h"
+#include "utils.h"
+
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
+#define PAGESIZE 0x10
+
+#define CMD_INIT      0xA8
+#define CMD_VERSION   0x84
+#define CMD_READ1     0xB1
+#define CMD_READ8     0xB4
+#define CMD_READ16    0xB8
+#define CMD_WRITE     0xB2
+#define CMD_KEEPALIVE 0x91
+#define CMD_QUIT      0x6A
+
+#define ACK 0x5A
+#define NAK 0xA5
+
+#define CF_DEVINFO  0x0000
+#define CF_POINTERS 0x0040
+
+typedef struct oceanic_atom2_model_t {
+	const char *name;
+	unsigned char version[PAGESIZE + 1];
+	// Generator and memory layout of the synthesized image.
+	const dcbench_generator_t *generator;
+	unsigned int memsize;
+	unsigned int rb_logbook_begin;
+	unsigned int rb_logbook_entry_size;
+	unsigned int rb_profile_begin;
+	unsigned int pt_mode_logbook;
+} oceanic_atom2_model_t;
+
+// The version string selects the memory layout and the read command
+// (READ1, READ8 or READ16) used by the driver.
+static const oceanic_atom2_model_t g_models[] = {
+	{"atom2",  "2M ATOM r" "\x33\x49" " 512K", &dcbench_oceanic_atom2,  0xFFF0,  0x0240, 8,  0x0A40, 0},
+	{"atom3",  "OCEATOM3 " "\x00\x01" " 1024", NULL,                    0,       0,      0,  0,      0},
+	{"f11",    "AERISF11 " "\x00\x01" " 1024", NULL,                    0,       0,      0,  0,      0},
+	{"a300cs", "AER300CS " "\x00\x01" " 2048", &dcbench_oceanic_a300cs, 0x40000, 0x0900, 16, 0x1000, 1},
+};
+
+static const oceanic_atom2_model_t *
+oceanic_atom2_model (const char *name)
+{
+	if (name == NULL)
+		return &g_models[0];
+
+	for (unsigned int i = 0; i < C_ARRAY_SIZE (g_models); ++i) {
+		if (strcmp (name, g_models[i].name) == 0)
+			return &g_models[i];
+	}
+
+	return NULL;
+}
+
+static dcemu_status_t
+oceanic_atom2_answer (dcemu_t *emu, unsigned int address, unsigned int size)
+{
+	unsigned char answer[1 + 256 + 2] = {ACK};
+
+	dcemu_memory_read (emu, address, answer + 1, size);
+
+	// The big page command uses a 16 bit checksum.
+	unsigned int crc_size = 1;
+	if (size > 8 * PAGESIZE) {
+		unsigned short crc = dcemu_checksum_add_uint16 (answer + 1, size, 0x0000);
+		answer[1 + size + 0] = (crc     ) & 0xFF;
+		answer[1 + size + 1] = (crc >> 8) & 0xFF;
+		crc_size = 2;
+	} else {
+		answer[1 + size] = dcemu_checksum_add_uint8 (answer + 1, size, 0x00);
+	}
+
+	return dcemu_write (emu, answer, 1 + size + crc_size);
+}
+
+static dcemu_status_t
+oceanic_atom2_request (dcemu_t *emu, const oceanic_atom2_model_t *model)
+{
+	dcemu_status_t status = DCEMU_SUCCESS;
+	unsigned char command[PAGESIZE + 2] = {0};
+
+	status = dcemu_read (emu, command, 1);
+	if (status != DCEMU_SUCCESS)
+		return status;
+
+	// Receive the remainder of the command.
+	unsigned int csize = (command[0] == CMD_VERSION ? 2 : 4);
+	status = dcemu_read (emu, command + 1, csize - 1);
+	if (status != DCEMU_SUCCESS)
+		return status;
+
+	unsigned int number = (command[1] << 8) | command[2];
+	unsigned char response[1] = {ACK};
+
+	switch (command[0]) {
+	case CMD_VERSION:
+		{
+			unsigned char answer[1 + PAGESIZE + 1] = {ACK};
+			memcpy (answer + 1, model->version, PAGESIZE);
+			answer[1 + PAGESIZE] = dcemu_checksum_add_uint8 (answer + 1, PAGESIZE, 0x00);
+			status = dcemu_write (emu, answer, sizeof (answer));
+		}
+		break;
+	case CMD_READ1:
+		status = oceanic_atom2_answer (emu, number * PAGESIZE, PAGESIZE);
+		break;
+	case CMD_READ8:
+		status = oceanic_atom2_answer (emu, number * PAGESIZE, 8 * PAGESIZE);
+		break;
+	case CMD_READ16:
+		status = oceanic_atom2_answer (emu, number * PAGESIZE, 16 * PAGESIZE);
+		break;
+	case CMD_WRITE:
+		status = dcemu_write (emu, response, sizeof (response));
+		if (status != DCEMU_SUCCESS)
+			break;
+
+		// Receive the data packet.
+		status = dcemu_read (emu, command, PAGESIZE + 2);
+		if (status != DCEMU_SUCCESS)
+			break;
+
+		if (command[PAGESIZE] == dcemu_checksum_add_uint8 (command, PAGESIZE, 0x00)) {
+			dcemu_memory_write (emu, number * PAGESIZE, command, PAGESIZE);
+		} else {
+			response[0] = NAK;
+		}
+		status = dcemu_write (emu, response, sizeof (response));
+		break;
+	case CMD_KEEPALIVE:
+		status = dcemu_write (emu, response, sizeof (response));
+		break;
+	case CMD_INIT:
+	case CMD_QUIT:
+		// These commands are acknowledged with a NAK byte.
+		response[0] = NAK;
+		status = dcemu_write (emu, response, sizeof (response));
+		break;
+	default:
+		response[0] = NAK;
+		status = dcemu_write (emu, response, sizeof (response));
+		break;
+	}
+
+	return status;
+}
+
+static dc_status_t
+oceanic_atom2_run (dcemu_t *emu, const char *name)
+{
+	const oceanic_atom2_model_t *model = oceanic_atom2_model (name);
+	if (model == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	while (oceanic_atom2_request (emu, model) != DCEMU_STOP) {
+		/* Serve the next request. */
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * The logbook entry is the first part of the generated dive, and the
+ * remainder is stored in the profile ringbuffer. The logbook entry
+ * points to the first and last page of the profile.
+ */
+static dc_status_t
+oceanic_atom2_image (dc_buffer_t *memory, const char *name)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	const oceanic_atom2_model_t *model = oceanic_atom2_model (name);
+	if (model == NULL)
+		return DC_STATUS_INVALIDARGS;
+	if (model->generator == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	dc_buffer_t *dive = dc_buffer_new (0);
+	if (dive == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	// The profile ringbuffer stores whole pages. Extend the dive with
+	// an extra sample when necessary.
+	dcbench_profile_t profile = dcemu_profile;
+	do {
+		dc_buffer_clear (dive);
+		status = model->generator->generate (dive, &profile);
+		if (status != DC_STATUS_SUCCESS)
+			goto error_free;
+		profile.duration++;
+	} while ((dc_buffer_get_size (dive) - model->rb_logbook_entry_size) % PAGESIZE);
+
+	const unsigned char *data = dc_buffer_get_data (dive);
+	unsigned int size = dc_buffer_get_size (dive) - model->rb_logbook_entry_size;
+
+	unsigned char *p = dcemu_image_erase (memory, model->memsize);
+	if (p == NULL) {
+		status = DC_STATUS_NOMEMORY;
+		goto error_free;
+	}
+
+	// Device info: model number and serial number (BCD).
+	unsigned char *devinfo = p + CF_DEVINFO;
+	devinfo[8]  = (model->generator->model >> 8) & 0xFF;
+	devinfo[9]  = (model->generator->model     ) & 0xFF;
+	devinfo[10] = 0x01;
+	devinfo[11] = 0x23;
+	devinfo[12] = 0x45;
+
+	// The first and last logbook entry.
+	unsigned char *pointers = p + CF_POINTERS;
+	pointers[4] = (model->rb_logbook_begin     ) & 0xFF;
+	pointers[5] = (model->rb_logbook_begin >> 8) & 0xFF;
+	pointers[6] = (model->rb_logbook_begin     ) & 0xFF;
+	pointers[7] = (model->rb_logbook_begin >> 8) & 0xFF;
+
+	// The profile pointers are page numbers, stored as two 12 bit
+	// values or as two 16 bit values.
+	unsigned char *logbook = p + model->rb_logbook_begin;
+	unsigned int first = model->rb_profile_begin / PAGESIZE;
+	unsigned int last = first + size / PAGESIZE - 1;
+	memcpy (logbook, data, model->rb_logbook_entry_size);
+	if (model->pt_mode_logbook == 0) {
+		logbook[3] = 0x15; /* 2017-06-15 */
+		logbook[4] = 0x67;
+		logbook[5] = first & 0xFF;
+		logbook[6] = ((first >> 8) & 0x0F) | ((last & 0x0F) << 4);
+		logbook[7] = (last >> 4) & 0xFF;
+	} else {
+		logbook[4] = (first     ) & 0xFF;
+		logbook[5] = (first >> 8) & 0xFF;
+		logbook[6] = (last     ) & 0xFF;
+		logbook[7] = (last >> 8) & 0xFF;
+		logbook[8] = 6; /* 2017-06-15 */
+		logbook[9] = 15;
+		logbook[10] = 17;
+	}
+
+	memcpy (p + model->rb_profile_begin, data + model->rb_logbook_entry_size, size);
+
+error_free:
+	dc_buffer_free (dive);
+	return status;
+}
+
+const dcemu_backend_t dcemu_oceanic_atom2 = {
+	"oceanic_atom2",
+	"Oceanic Atom 2.0 family (models: atom2, atom3, f11, a300cs)",
+	oceanic_atom2_run,
+	oceanic_atom2_image,
+};
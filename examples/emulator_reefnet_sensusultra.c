@@ -0,0 +1,272 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "emulator.h"
+#include "generator.h"
+#include "utils.h"
+
+#define SZ_PACKET    512
+#define SZ_MEMORY    2080768
+#define SZ_USER      16384
+#define SZ_HANDSHAKE 24
+
+#define PROMPT 0xA5
+#define ACCEPT PROMPT
+#define REJECT 0x00
+
+#define INTERVAL  10
+#define THRESHOLD 1100 /* mbar */
+#define UPTIME    (7 * 86400)
+
+#define CMD_USER_READ  0xB420
+#define CMD_DATA_READ  0xB421
+#define CMD_USER_WRITE 0xB430
+
+typedef struct reefnet_sensusultra_t {
+	unsigned char handshake[SZ_HANDSHAKE];
+	unsigned char user[SZ_USER];
+	time_t start;
+} reefnet_sensusultra_t;
+
+/*
+ * Send the prompt byte, and receive the answer from the host.
+ */
+static dcemu_status_t
+reefnet_sensusultra_prompt (dcemu_t *emu, unsigned char *value)
+{
+	unsigned char prompt[1] = {PROMPT};
+	dcemu_status_t status = dcemu_write (emu, prompt, sizeof (prompt));
+	if (status != DCEMU_SUCCESS)
+		return status;
+
+	return dcemu_read (emu, value, 1);
+}
+
+static dcemu_status_t
+reefnet_sensusultra_handshake (dcemu_t *emu, reefnet_sensusultra_t *device)
+{
+	// Update the device clock.
+	unsigned int devtime = time (NULL) - device->start;
+	device->handshake[4] = (devtime      ) & 0xFF;
+	device->handshake[5] = (devtime >>  8) & 0xFF;
+	device->handshake[6] = (devtime >> 16) & 0xFF;
+	device->handshake[7] = (devtime >> 24) & 0xFF;
+
+	unsigned char packet[SZ_HANDSHAKE + 2];
+	memcpy (packet, device->handshake, SZ_HANDSHAKE);
+	unsigned short crc = dcemu_checksum_crc_ccitt_uint16 (packet, SZ_HANDSHAKE);
+	packet[SZ_HANDSHAKE + 0] = (crc     ) & 0xFF;
+	packet[SZ_HANDSHAKE + 1] = (crc >> 8) & 0xFF;
+
+	return dcemu_write (emu, packet, sizeof (packet));
+}
+
+/*
+ * Send the data pages, until the host stops accepting them. The pages
+ * are sent in reverse order, starting at the end of the memory.
+ */
+static dcemu_status_t
+reefnet_sensusultra_pages (dcemu_t *emu, reefnet_sensusultra_t *device, int user)
+{
+	dcemu_status_t status = DCEMU_SUCCESS;
+
+	unsigned int npages = (user ? SZ_USER : SZ_MEMORY) / SZ_PACKET;
+	unsigned int page = 0;
+	while (page < npages) {
+		unsigned char packet[SZ_PACKET + 4];
+		packet[0] = (page     ) & 0xFF;
+		packet[1] = (page >> 8) & 0xFF;
+		if (user) {
+			memcpy (packet + 2, device->user + page * SZ_PACKET, SZ_PACKET);
+		} else {
+			dcemu_memory_read (emu, SZ_MEMORY - (page + 1) * SZ_PACKET, packet + 2, SZ_PACKET);
+		}
+		unsigned short crc = dcemu_checksum_crc_ccitt_uint16 (packet + 2, SZ_PACKET);
+		packet[SZ_PACKET + 2] = (crc     ) & 0xFF;
+		packet[SZ_PACKET + 3] = (crc >> 8) & 0xFF;
+
+		status = dcemu_write (emu, packet, sizeof (packet));
+		if (status != DCEMU_SUCCESS)
+			return status;
+
+		unsigned char answer = 0;
+		status = reefnet_sensusultra_prompt (emu, &answer);
+		if (status != DCEMU_SUCCESS)
+			return status;
+
+		// Resend a rejected page.
+		if (answer == ACCEPT)
+			page++;
+		else if (answer != REJECT)
+			break;
+	}
+
+	return DCEMU_SUCCESS;
+}
+
+static dcemu_status_t
+reefnet_sensusultra_request (dcemu_t *emu, reefnet_sensusultra_t *device)
+{
+	dcemu_status_t status = DCEMU_SUCCESS;
+
+	// Receive the instruction code.
+	unsigned char code[2] = {0};
+	for (unsigned int i = 0; i < sizeof (code); ++i) {
+		status = reefnet_sensusultra_prompt (emu, code + i);
+		if (status != DCEMU_SUCCESS)
+			return status;
+	}
+
+	switch (code[0] | (code[1] << 8)) {
+	case CMD_DATA_READ:
+		status = reefnet_sensusultra_pages (emu, device, 0);
+		break;
+	case CMD_USER_READ:
+		status = reefnet_sensusultra_pages (emu, device, 1);
+		break;
+	case CMD_USER_WRITE:
+		{
+			// Receive the data and the checksum.
+			unsigned char data[SZ_USER + 2];
+			for (unsigned int i = 0; i < sizeof (data); ++i) {
+				status = reefnet_sensusultra_prompt (emu, data + i);
+				if (status != DCEMU_SUCCESS)
+					return status;
+			}
+
+			unsigned short crc = data[SZ_USER] | (data[SZ_USER + 1] << 8);
+			if (crc == dcemu_checksum_crc_ccitt_uint16 (data, SZ_USER))
+				memcpy (device->user, data, SZ_USER);
+		}
+		break;
+	default:
+		// The parameters are followed by the new value.
+		if (code[1] == 0xB4 && code[0] >= 0x10 && code[0] <= 0x13) {
+			unsigned char value[2] = {0};
+			for (unsigned int i = 0; i < sizeof (value); ++i) {
+				status = reefnet_sensusultra_prompt (emu, value + i);
+				if (status != DCEMU_SUCCESS)
+					return status;
+			}
+		}
+		break;
+	}
+
+	return status;
+}
+
+static dc_status_t
+reefnet_sensusultra_run (dcemu_t *emu, const char *model)
+{
+	if (model)
+		return DC_STATUS_INVALIDARGS;
+
+	reefnet_sensusultra_t device;
+	memset (&device, 0, sizeof (device));
+	device.start = time (NULL) - UPTIME;
+
+	// Firmware version, model and serial number.
+	device.handshake[0] = 0x0F;
+	device.handshake[1] = 0x03;
+	device.handshake[2] = 0x39;
+	device.handshake[3] = 0x30;
+
+	// The device repeats the handshake packet, until the host answers
+	// the prompt byte. The host always purges its buffers before
+	// waiting for the handshake, so there is no need to repeat it. It
+	// purges twice in a row when opening the device, so the handshake
+	// is sent only once the host stopped purging.
+	dcemu_status_t status = DCEMU_SUCCESS;
+	int awake = 0;
+	while (status != DCEMU_STOP) {
+		if (awake) {
+			status = reefnet_sensusultra_request (emu, &device);
+			awake = 0;
+		} else {
+			unsigned char dummy = 0;
+			status = dcemu_read (emu, &dummy, 1);
+		}
+
+		if (status == DCEMU_PURGE) {
+			status = dcemu_drain (emu, 100);
+			if (status == DCEMU_SUCCESS)
+				status = reefnet_sensusultra_handshake (emu, &device);
+			awake = 1;
+		}
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * The dives are stored in chronological order, with the most recent
+ * dive at the end of the memory. A dive starts with a header marker
+ * (four zero bytes), the device time, the sample interval and the
+ * depth threshold, and ends with a footer marker (four 0xFF bytes).
+ * A sample is the temperature (0.01 K) and the absolute pressure
+ * (mbar). The device clock started a week ago, and the dive was made
+ * a day ago.
+ */
+static dc_status_t
+reefnet_sensusultra_image (dc_buffer_t *memory, const char *model)
+{
+	const dcbench_profile_t *profile = &dcemu_profile;
+
+	if (model)
+		return DC_STATUS_INVALIDARGS;
+
+	unsigned int nsamples = profile->duration / INTERVAL;
+	unsigned int size = 16 + nsamples * 4 + 4;
+
+	unsigned char *p = dcemu_image_erase (memory, SZ_MEMORY);
+	if (p == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	unsigned char *dive = p + SZ_MEMORY - size;
+	memset (dive, 0x00, 16);
+	dcbench_put_uint32_le (dive + 4, UPTIME - 86400);
+	dcbench_put_uint16_le (dive + 8, INTERVAL);
+	dcbench_put_uint16_le (dive + 10, THRESHOLD);
+	dcbench_put_uint32_le (dive + 12, 0x01010101);
+
+	unsigned char *s = dive + 16;
+	for (unsigned int i = 0; i < nsamples; ++i) {
+		unsigned int time = (i + 1) * INTERVAL;
+		double depth = dcbench_profile_depth (profile, time);
+		double temperature = dcbench_profile_temperature (profile, time);
+		dcbench_put_uint16_le (s + 0, (unsigned int) ((temperature + 273.15) * 100.0));
+		dcbench_put_uint16_le (s + 2, (unsigned int) (1013.25 + depth * 100.5));
+		s += 4;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+const dcemu_backend_t dcemu_reefnet_sensusultra = {
+	"reefnet_sensusultra",
+	"Reefnet Sensus Ultra",
+	reefnet_sensusultra_run,
+	reefnet_sensusultra_image,
+};
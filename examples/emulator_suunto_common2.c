@@ -0,0 +1,282 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "emulator.h"
+#include "generator.h"
+#include "utils.h"
+
+#define SZ_VERSION 0x04
+#define SZ_PACKET  0x78
+
+#define CMD_VERSION 0x0F
+#define CMD_RESET   0x20
+#define CMD_READ    0x05
+#define CMD_WRITE   0x06
+
+#define D9       0x0E
+#define D6       0x0F
+#define VYPER2   0x10
+#define COBRA2   0x11
+#define VYPERAIR 0x13
+#define COBRA3   0x14
+
+#define SZ_MEMORY        0x8000
+#define CF_SERIAL        0x0023
+#define CF_POINTERS      0x0190
+#define RB_PROFILE_BEGIN 0x019A
+
+// Dive header offsets.
+#define HDR_MAXDEPTH 0x09
+#define HDR_DIVETIME 0x0B
+#define HDR_DATETIME 0x11
+#define HDR_INTERVAL 0x18
+#define HDR_GASMODE  0x19
+#define HDR_CONFIG   0x3A
+
+#define INTERVAL 10
+
+/*
+ * Both the D9 and Vyper2 family use the same packet format:
+ *
+ *   command, length (big endian), parameters, xor checksum
+ *
+ * The only difference is the D9 interface echoing the command.
+ */
+static dcemu_status_t
+suunto_common2_request (dcemu_t *emu, const unsigned char version[], int echo)
+{
+	dcemu_status_t status = DCEMU_SUCCESS;
+	unsigned char command[SZ_PACKET + 7] = {0};
+
+	// Receive the header.
+	status = dcemu_read (emu, command, 3);
+	if (status != DCEMU_SUCCESS)
+		return status;
+
+	// Receive the parameters and the checksum.
+	unsigned int length = (command[1] << 8) | command[2];
+	if (length > SZ_PACKET + 3)
+		return DCEMU_SUCCESS;
+	status = dcemu_read (emu, command + 3, length + 1);
+	if (status != DCEMU_SUCCESS)
+		return status;
+
+	unsigned int csize = length + 4;
+
+	// Echo the command.
+	if (echo) {
+		status = dcemu_write (emu, command, csize);
+		if (status != DCEMU_SUCCESS)
+			return status;
+	}
+
+	// Ignore packets with an invalid checksum.
+	if (command[csize - 1] != dcemu_checksum_xor_uint8 (command, csize - 1, 0x00))
+		return DCEMU_SUCCESS;
+
+	unsigned char answer[SZ_PACKET + 7] = {command[0]};
+	unsigned int asize = 0;
+
+	switch (command[0]) {
+	case CMD_VERSION:
+		answer[2] = SZ_VERSION;
+		memcpy (answer + 3, version, SZ_VERSION);
+		asize = SZ_VERSION + 4;
+		break;
+	case CMD_RESET:
+		asize = 4;
+		break;
+	case CMD_READ:
+		if (length != 3 || command[5] > SZ_PACKET)
+			return DCEMU_SUCCESS;
+		answer[2] = command[5] + 3;
+		memcpy (answer + 3, command + 3, 3);
+		dcemu_memory_read (emu, (command[3] << 8) | command[4], answer + 6, command[5]);
+		asize = command[5] + 7;
+		break;
+	case CMD_WRITE:
+		if (length != command[5] + 3u)
+			return DCEMU_SUCCESS;
+		dcemu_memory_write (emu, (command[3] << 8) | command[4], command + 6, command[5]);
+		answer[2] = 3;
+		memcpy (answer + 3, command + 3, 3);
+		asize = 7;
+		break;
+	default:
+		return DCEMU_SUCCESS;
+	}
+
+	answer[asize - 1] = dcemu_checksum_xor_uint8 (answer, asize - 1, 0x00);
+
+	return dcemu_write (emu, answer, asize);
+}
+
+static int
+suunto_common2_model (const char *model, unsigned int defmodel)
+{
+	if (model == NULL)
+		return defmodel;
+
+	char *end = NULL;
+	unsigned long value = strtoul (model, &end, 0);
+	if (*end != '\0' || value > 0xFF)
+		return -1;
+
+	return value;
+}
+
+static dc_status_t
+suunto_common2_run (dcemu_t *emu, const char *model, unsigned int defmodel, int echo)
+{
+	unsigned char version[SZ_VERSION] = {defmodel, 0x01, 0x02, 0x03};
+
+	// The first byte of the version is the model number.
+	int value = suunto_common2_model (model, defmodel);
+	if (value < 0)
+		return DC_STATUS_INVALIDARGS;
+	version[0] = value;
+
+	while (suunto_common2_request (emu, version, echo) != DCEMU_STOP) {
+		/* Serve the next request. */
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * The profile ringbuffer contains a linked list of dives. Each dive
+ * starts with the pointers to the previous and the next dive, followed
+ * by the dive header, the sample configuration and the samples. The
+ * newer models with a different header layout are not supported.
+ */
+static dc_status_t
+suunto_common2_image (dc_buffer_t *memory, const char *model, unsigned int defmodel)
+{
+	const dcbench_profile_t *profile = &dcemu_profile;
+
+	int value = suunto_common2_model (model, defmodel);
+	if (value < 0)
+		return DC_STATUS_INVALIDARGS;
+	if (value != D9 && value != D6 && value != VYPER2 &&
+		value != COBRA2 && value != VYPERAIR && value != COBRA3)
+		return DC_STATUS_UNSUPPORTED;
+
+	unsigned char *p = dcemu_image_erase (memory, SZ_MEMORY);
+	if (p == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	// Serial number.
+	p[CF_SERIAL + 0] = 12;
+	p[CF_SERIAL + 1] = 34;
+	p[CF_SERIAL + 2] = 56;
+	p[CF_SERIAL + 3] = 78;
+
+	// Sample configuration: the depth (cm) and the temperature (°C)
+	// in every sample, without any events.
+	unsigned int nsamples = profile->duration / INTERVAL;
+	unsigned int header = HDR_CONFIG + 2 + 2 * 3 + 5;
+	unsigned int size = 4 + header + nsamples * 3;
+	unsigned int begin = RB_PROFILE_BEGIN;
+	unsigned int end = begin + size;
+
+	unsigned char *dive = p + begin;
+	memset (dive, 0x00, 4 + header);
+	dcbench_put_uint16_le (dive + 0, begin);
+	dcbench_put_uint16_le (dive + 2, end);
+
+	unsigned char *data = dive + 4;
+	dcbench_put_uint16_le (data + HDR_MAXDEPTH, (unsigned int) (profile->maxdepth * 100.0));
+	dcbench_put_uint16_le (data + HDR_DIVETIME, profile->duration / 60);
+	data[HDR_DATETIME + 0] = 10; /* 2017-06-15 10:30:00 */
+	data[HDR_DATETIME + 1] = 30;
+	data[HDR_DATETIME + 2] = 0;
+	dcbench_put_uint16_le (data + HDR_DATETIME + 3, 2017);
+	data[HDR_DATETIME + 5] = 6;
+	data[HDR_DATETIME + 6] = 15;
+	data[HDR_INTERVAL] = INTERVAL;
+	data[HDR_GASMODE] = 0; /* Air */
+	data[HDR_CONFIG + 0] = 2;
+	data[HDR_CONFIG + 2] = 0x64; /* Depth */
+	data[HDR_CONFIG + 3] = 1;
+	data[HDR_CONFIG + 4] = 0x18; /* Divisor 100 */
+	data[HDR_CONFIG + 5] = 0x74; /* Temperature */
+	data[HDR_CONFIG + 6] = 1;
+	data[HDR_CONFIG + 7] = 0x00; /* Divisor 1 */
+
+	unsigned char *s = data + header;
+	for (unsigned int i = 0; i < nsamples; ++i) {
+		unsigned int time = i * INTERVAL;
+		dcbench_put_uint16_le (s, (unsigned int) (dcbench_profile_depth (profile, time) * 100.0));
+		s[2] = (unsigned int) dcbench_profile_temperature (profile, time);
+		s += 3;
+	}
+
+	// Last dive, number of dives, and the end and begin of the
+	// profile ringbuffer.
+	unsigned char *pointers = p + CF_POINTERS;
+	dcbench_put_uint16_le (pointers + 0, begin);
+	dcbench_put_uint16_le (pointers + 2, 1);
+	dcbench_put_uint16_le (pointers + 4, end);
+	dcbench_put_uint16_le (pointers + 6, begin);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+suunto_d9_run (dcemu_t *emu, const char *model)
+{
+	return suunto_common2_run (emu, model, D9, 1);
+}
+
+static dc_status_t
+suunto_d9_image (dc_buffer_t *memory, const char *model)
+{
+	return suunto_common2_image (memory, model, D9);
+}
+
+static dc_status_t
+suunto_vyper2_run (dcemu_t *emu, const char *model)
+{
+	return suunto_common2_run (emu, model, VYPER2, 0);
+}
+
+static dc_status_t
+suunto_vyper2_image (dc_buffer_t *memory, const char *model)
+{
+	return suunto_common2_image (memory, model, VYPER2);
+}
+
+const dcemu_backend_t dcemu_suunto_d9 = {
+	"suunto_d9",
+	"Suunto D9 family (model: model number)",
+	suunto_d9_run,
+	suunto_d9_image,
+};
+
+const dcemu_backend_t dcemu_suunto_vyper2 = {
+	"suunto_vyper2",
+	"Suunto Vyper 2 family (model: model number)",
+	suunto_vyper2_run,
+	suunto_vyper2_image,
+};
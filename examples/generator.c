@@ -0,0 +1,163 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "generator.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define RATE_DESCENT 0.30 /* m/s */
+#define RATE_ASCENT  0.15 /* m/s */
+#define DEPTH_STOP   5.0
+#define TIME_STOP    180.0
+#define TIME_SURFACE 30.0
+
+/*
+ * The dive is a descent to the maximum depth, a bottom phase which
+ * alternates between the maximum depth and 60% of it every 20
+ * minutes, an ascent to the safety stop, and the final ascent. For
+ * short dives, all phases are scaled down proportionally.
+ */
+double
+dcbench_profile_depth (const dcbench_profile_t *profile, unsigned int time)
+{
+	double maxdepth = profile->maxdepth;
+	double duration = profile->duration;
+
+	double descent = maxdepth / RATE_DESCENT;
+	double ascent = maxdepth / RATE_ASCENT;
+	double stop = TIME_STOP;
+	double surface = TIME_SURFACE;
+	double total = descent + ascent + stop + surface;
+	if (total > duration) {
+		double factor = duration / total;
+		descent *= factor;
+		ascent *= factor;
+		stop *= factor;
+		surface *= factor;
+	}
+
+	double t = time;
+	if (t >= duration)
+		return 0.0;
+
+	// Descent.
+	if (t < descent)
+		return maxdepth * t / descent;
+
+	// Final ascent from the safety stop.
+	double remaining = duration - t;
+	if (remaining < surface)
+		return DEPTH_STOP * remaining / surface;
+
+	// Safety stop.
+	remaining -= surface;
+	if (remaining < stop)
+		return DEPTH_STOP;
+
+	// Ascent to the safety stop.
+	remaining -= stop;
+	if (remaining < ascent)
+		return DEPTH_STOP + (maxdepth - DEPTH_STOP) * remaining / ascent;
+
+	// Bottom phase.
+	return maxdepth * (0.8 + 0.2 * cos (2.0 * M_PI * (t - descent) / 2400.0));
+}
+
+double
+dcbench_profile_temperature (const dcbench_profile_t *profile, unsigned int time)
+{
+	double depth = dcbench_profile_depth (profile, time);
+	if (depth > 30.0)
+		depth = 30.0;
+
+	return 24.0 - 14.0 * depth / 30.0;
+}
+
+double
+dcbench_profile_pressure (const dcbench_profile_t *profile, unsigned int time)
+{
+	if (profile->duration == 0 || time >= profile->duration)
+		return 50.0;
+
+	return 200.0 - 150.0 * time / profile->duration;
+}
+
+unsigned int
+dcbench_random (unsigned int *state)
+{
+	unsigned int x = *state ? *state : 1;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	*state = x;
+
+	return x;
+}
+
+unsigned char *
+dcbench_append (dc_buffer_t *buffer, unsigned int size)
+{
+	size_t offset = dc_buffer_get_size (buffer);
+
+	if (!dc_buffer_resize (buffer, offset + size))
+		return NULL;
+
+	return dc_buffer_get_data (buffer) + offset;
+}
+
+void
+dcbench_put_uint16_le (unsigned char data[], unsigned int value)
+{
+	data[0] = (value     ) & 0xFF;
+	data[1] = (value >> 8) & 0xFF;
+}
+
+void
+dcbench_put_uint16_be (unsigned char data[], unsigned int value)
+{
+	data[0] = (value >> 8) & 0xFF;
+	data[1] = (value     ) & 0xFF;
+}
+
+void
+dcbench_put_uint32_le (unsigned char data[], unsigned int value)
+{
+	data[0] = (value      ) & 0xFF;
+	data[1] = (value >>  8) & 0xFF;
+	data[2] = (value >> 16) & 0xFF;
+	data[3] = (value >> 24) & 0xFF;
+}
+
+void
+dcbench_put_uint32_be (unsigned char data[], unsigned int value)
+{
+	data[0] = (value >> 24) & 0xFF;
+	data[1] = (value >> 16) & 0xFF;
+	data[2] = (value >>  8) & 0xFF;
+	data[3] = (value      ) & 0xFF;
+}
@@ -0,0 +1,106 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DCBENCH_GENERATOR_H
+#define DCBENCH_GENERATOR_H
+
+#include <libdivecomputer/common.h>
+#include <libdivecomputer/buffer.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * The synthetic dive. All generators sample the same depth and
+ * temperature curves, so the results of the different families can
+ * be compared with each other.
+ */
+typedef struct dcbench_profile_t {
+	unsigned int duration; /* Seconds */
+	double maxdepth;       /* Meters */
+	unsigned int seed;
+} dcbench_profile_t;
+
+/*
+ * A generator synthesizes a valid dive in the native format of one
+ * parser family. The dive is appended to the (empty) buffer.
+ */
+typedef struct dcbench_generator_t {
+	const char *name;
+	const char *description;
+	dc_family_t family;
+	unsigned int model;
+	dc_status_t (*generate) (dc_buffer_t *buffer, const dcbench_profile_t *profile);
+} dcbench_generator_t;
+
+extern const dcbench_generator_t dcbench_uwatec_smartpro;
+extern const dcbench_generator_t dcbench_uwatec_galileo;
+extern const dcbench_generator_t dcbench_hw_ostc3;
+extern const dcbench_generator_t dcbench_shearwater_petrel;
+extern const dcbench_generator_t dcbench_suunto_eonsteel;
+extern const dcbench_generator_t dcbench_oceanic_atom2;
+extern const dcbench_generator_t dcbench_oceanic_a300cs;
+
+/*
+ * Depth (meters) and temperature (degrees Celsius) at the given time.
+ */
+double
+dcbench_profile_depth (const dcbench_profile_t *profile, unsigned int time);
+
+double
+dcbench_profile_temperature (const dcbench_profile_t *profile, unsigned int time);
+
+/*
+ * Tank pressure (bar), from 200 bar at the start to 50 bar at the end.
+ */
+double
+dcbench_profile_pressure (const dcbench_profile_t *profile, unsigned int time);
+
+/*
+ * Pseudo random numbers (xorshift32) for the noise and the events.
+ */
+unsigned int
+dcbench_random (unsigned int *state);
+
+/*
+ * Append a zero initialized block to the buffer, and return a pointer
+ * to it. The pointer is only valid until the next append.
+ */
+unsigned char *
+dcbench_append (dc_buffer_t *buffer, unsigned int size);
+
+void
+dcbench_put_uint16_le (unsigned char data[], unsigned int value);
+
+void
+dcbench_put_uint16_be (unsigned char data[], unsigned int value);
+
+void
+dcbench_put_uint32_le (unsigned char data[], unsigned int value);
+
+void
+dcbench_put_uint32_be (unsigned char data[], unsigned int value);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DCBENCH_GENERATOR_H */
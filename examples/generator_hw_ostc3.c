@@ -0,0 +1,224 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "generator.h"
+
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
+#define OSTC3 0x0A
+
+#define SZ_HEADER 256
+#define INTERVAL  2
+#define SALINITY  3 /* 1.03 kg/l */
+
+#define EVENT_MARKER    0x06
+#define EVENT_GASCHANGE 0x20
+
+typedef struct hw_ostc3_sample_info_t {
+	unsigned int type;
+	unsigned int size;
+	unsigned int divisor;
+} hw_ostc3_sample_info_t;
+
+/*
+ * The extended sample configuration of an open circuit dive with the
+ * factory defaults: temperature and deco/ndl every 6 samples, and the
+ * CNS every 12 samples. The ppO2, GF, decoplan and tank data are
+ * disabled.
+ */
+static const hw_ostc3_sample_info_t g_config[] = {
+	{0,  2,  6}, /* Temperature */
+	{1,  2,  6}, /* Deco / NDL */
+	{2,  1,  0}, /* GF */
+	{3,  9,  0}, /* ppO2 */
+	{4, 15,  0}, /* Decoplan */
+	{5,  2, 12}, /* CNS */
+	{6,  2,  0}, /* Tank */
+};
+
+static void
+hw_ostc3_header (unsigned char header[], const dcbench_profile_t *profile, unsigned int length)
+{
+	unsigned int maxdepth = (unsigned int) (profile->maxdepth * 100.0);
+	unsigned int avgdepth = (unsigned int) (profile->maxdepth * 70.0);
+	unsigned int divetime = profile->duration;
+	int temperature = (int) (dcbench_profile_temperature (profile, profile->duration / 2) * 10.0);
+
+	header[0] = 0xFA;
+	header[1] = 0xFA;
+	header[2] = 0x00; /* Begin pointer */
+	header[3] = 0x00;
+	header[4] = 0x20;
+	header[8] = 0x24; /* Profile version */
+	header[9] = (length      ) & 0xFF;
+	header[10] = (length >>  8) & 0xFF;
+	header[11] = (length >> 16) & 0xFF;
+	header[12] = 17; /* 2017-06-15 10:30 */
+	header[13] = 6;
+	header[14] = 15;
+	header[15] = 10;
+	header[16] = 30;
+	dcbench_put_uint16_le (header + 17, maxdepth);
+	dcbench_put_uint16_le (header + 19, divetime / 60);
+	header[21] = divetime % 60;
+	dcbench_put_uint16_le (header + 22, temperature);
+	dcbench_put_uint16_le (header + 24, 1013);
+	dcbench_put_uint16_le (header + 26, 720);
+
+	// Gas mixes: oxygen, helium, change depth and type (1 = first).
+	static const unsigned char gasmixes[5][4] = {
+		{21,  0,  0, 1},
+		{50,  0, 21, 2},
+		{100, 0,  6, 2},
+		{0,   0,  0, 0},
+		{0,   0,  0, 0}};
+	memcpy (header + 28, gasmixes, sizeof (gasmixes));
+
+	header[48] = 2; /* Firmware 2.90 */
+	header[49] = 90;
+	dcbench_put_uint16_le (header + 50, 3900);
+	header[59] = 80;
+	header[70] = SALINITY;
+	dcbench_put_uint16_le (header + 73, avgdepth);
+	dcbench_put_uint16_le (header + 75, divetime);
+	header[77] = 30; /* GF low */
+	header[78] = 85; /* GF high */
+	header[79] = 1;  /* ZHL16-GF */
+	dcbench_put_uint16_le (header + 80, 1 + profile->seed % 1000);
+	header[82] = 0;  /* Open circuit */
+	header[254] = 0xFB;
+	header[255] = 0xFB;
+}
+
+static dc_status_t
+hw_ostc3_generate (dc_buffer_t *buffer, const dcbench_profile_t *profile)
+{
+	unsigned int rng = profile->seed;
+
+	unsigned int nconfig = C_ARRAY_SIZE (g_config);
+	unsigned char *p = dcbench_append (buffer, SZ_HEADER + 5 + 3 * nconfig);
+	if (p == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	// Profile header.
+	p[SZ_HEADER + 3] = INTERVAL;
+	p[SZ_HEADER + 4] = nconfig;
+	for (unsigned int i = 0; i < nconfig; ++i) {
+		p[SZ_HEADER + 5 + 3 * i + 0] = g_config[i].type;
+		p[SZ_HEADER + 5 + 3 * i + 1] = g_config[i].size;
+		p[SZ_HEADER + 5 + 3 * i + 2] = g_config[i].divisor;
+	}
+
+	// The hydrostatic pressure (mbar) per meter.
+	double hydrostatic = 9.80665 * (1000.0 + SALINITY * 10.0) / 100.0;
+
+	unsigned int gasmix = 1;
+	unsigned int nsamples = 0;
+	for (unsigned int time = INTERVAL; time <= profile->duration; time += INTERVAL) {
+		double depth = dcbench_profile_depth (profile, time);
+
+		nsamples++;
+
+		// Events: a gas change to the deco gas at the start of the
+		// ascent, and an occasional manual marker.
+		unsigned int events = 0;
+		if (gasmix == 1 && time > profile->duration / 2 && depth < 21.0) {
+			events |= EVENT_GASCHANGE;
+		}
+		if ((dcbench_random (&rng) % 2000) == 0) {
+			events |= EVENT_MARKER;
+		}
+
+		unsigned int length = events ? 1 : 0;
+		if (events & EVENT_GASCHANGE)
+			length++;
+		for (unsigned int i = 0; i < nconfig; ++i) {
+			if (g_config[i].divisor && (nsamples % g_config[i].divisor) == 0)
+				length += g_config[i].size;
+		}
+
+		p = dcbench_append (buffer, 3 + length);
+		if (p == NULL)
+			return DC_STATUS_NOMEMORY;
+
+		dcbench_put_uint16_le (p, (unsigned int) (depth * hydrostatic + 0.5));
+		p[2] = length | (events ? 0x80 : 0x00);
+		p += 3;
+
+		if (events) {
+			*p++ = events;
+		}
+		if (events & EVENT_GASCHANGE) {
+			gasmix = 2;
+			*p++ = gasmix;
+		}
+
+		for (unsigned int i = 0; i < nconfig; ++i) {
+			if (g_config[i].divisor == 0 || (nsamples % g_config[i].divisor) != 0)
+				continue;
+
+			switch (g_config[i].type) {
+			case 0: /* Temperature (0.1 °C) */
+				dcbench_put_uint16_le (p, (unsigned int) (dcbench_profile_temperature (profile, time) * 10.0));
+				break;
+			case 1: /* NDL (minutes) */
+				p[0] = 0;
+				p[1] = depth > 0.0 ? 99 - (unsigned int) depth : 99;
+				break;
+			case 5: /* CNS (%) */
+				dcbench_put_uint16_le (p, time * 100 / profile->duration);
+				break;
+			default:
+				break;
+			}
+
+			p += g_config[i].size;
+		}
+	}
+
+	// End marker.
+	p = dcbench_append (buffer, 2);
+	if (p == NULL)
+		return DC_STATUS_NOMEMORY;
+	p[0] = 0xFD;
+	p[1] = 0xFD;
+
+	// Profile length.
+	unsigned char *data = dc_buffer_get_data (buffer);
+	unsigned int length = dc_buffer_get_size (buffer) - SZ_HEADER;
+	data[SZ_HEADER + 0] = (length      ) & 0xFF;
+	data[SZ_HEADER + 1] = (length >>  8) & 0xFF;
+	data[SZ_HEADER + 2] = (length >> 16) & 0xFF;
+	hw_ostc3_header (data, profile, length);
+
+	return DC_STATUS_SUCCESS;
+}
+
+const dcbench_generator_t dcbench_hw_ostc3 = {
+	"hw_ostc3",
+	"Heinrichs Weikamp OSTC 3 (extended sample configuration)",
+	DC_FAMILY_HW_OSTC3, OSTC3,
+	hw_ostc3_generate,
+};
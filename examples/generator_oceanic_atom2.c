@@ -0,0 +1,191 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "generator.h"
+
+#define ATOM2  0x4342
+#define A300CS 0x454C
+
+#define PAGESIZE 16
+#define INTERVAL 2
+
+#define FEET 0.3048
+#define PSI  6894.75729
+#define BAR  100000.0
+
+/*
+ * Both models store a logbook header (of which the last half page is
+ * a sample with the initial values), the fixed size samples and a
+ * footer. The Atom 2 stores the temperature and the tank pressure as
+ * deltas in 8 byte samples, the A300CS uses 16 byte samples with
+ * absolute values and deco information.
+ */
+typedef struct oceanic_atom2_layout_t {
+	unsigned int model;
+	unsigned int headersize;
+	unsigned int footersize;
+	unsigned int samplesize;
+	unsigned int interval; /* Offset of the sample interval */
+} oceanic_atom2_layout_t;
+
+static const oceanic_atom2_layout_t oceanic_atom2_layout = {
+	ATOM2, 9 * PAGESIZE / 2, PAGESIZE, PAGESIZE / 2, 0x17,
+};
+
+static const oceanic_atom2_layout_t oceanic_a300cs_layout = {
+	A300CS, 5 * PAGESIZE, PAGESIZE, PAGESIZE, 0x1F,
+};
+
+static unsigned int
+oceanic_atom2_depth (double depth)
+{
+	unsigned int value = (unsigned int) (depth / FEET * 16.0 + 0.5);
+	return value > 0x0FFF ? 0x0FFF : value;
+}
+
+static unsigned int
+oceanic_atom2_temperature (const dcbench_profile_t *profile, unsigned int time)
+{
+	return (unsigned int) (dcbench_profile_temperature (profile, time) * 9.0 / 5.0 + 32.5);
+}
+
+static unsigned int
+oceanic_atom2_pressure (const dcbench_profile_t *profile, unsigned int time)
+{
+	return (unsigned int) (dcbench_profile_pressure (profile, time) * BAR / PSI + 0.5);
+}
+
+static dc_status_t
+oceanic_atom2_generate_common (dc_buffer_t *buffer, const dcbench_profile_t *profile, const oceanic_atom2_layout_t *layout)
+{
+	unsigned int rng = profile->seed;
+
+	unsigned char *p = dcbench_append (buffer, layout->headersize);
+	if (p == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	// Logbook header.
+	unsigned int header = layout->headersize - PAGESIZE / 2;
+	unsigned int temperature = oceanic_atom2_temperature (profile, 0);
+	unsigned int pressure = oceanic_atom2_pressure (profile, 0);
+	p[0] = 0x30; /* 10:30 */
+	p[1] = 0x10;
+	p[layout->interval] = 0x00; /* 2 seconds */
+	p[header + 7] = temperature;
+	if (layout->model == A300CS) {
+		p[0x18] = 0x00; /* Salt water */
+		p[0x2A] = 21;
+		p[0x2B] = 50;
+		p[0x39] = 0x08; /* Two gas mixes */
+	} else {
+		dcbench_put_uint16_le (p + header + 2, pressure);
+		p[header + 4] = 21;
+		p[header + 5] = 50;
+		p[header + 6] = 100;
+	}
+
+	unsigned int maxdepth = 0;
+	for (unsigned int time = INTERVAL; time < profile->duration; time += INTERVAL) {
+		double d = dcbench_profile_depth (profile, time);
+		unsigned int depth = oceanic_atom2_depth (d);
+		if (depth > 16 && (dcbench_random (&rng) & 0x07) == 0)
+			depth += (dcbench_random (&rng) & 0x01) ? 1 : -1;
+		if (depth > maxdepth)
+			maxdepth = depth;
+
+		p = dcbench_append (buffer, layout->samplesize);
+		if (p == NULL)
+			return DC_STATUS_NOMEMORY;
+
+		dcbench_put_uint16_le (p + 2, depth);
+
+		if (layout->model == A300CS) {
+			unsigned int remaining = (profile->duration - time) / 60;
+			p[0] = 0x01;
+			dcbench_put_uint16_le (p + 4, oceanic_atom2_pressure (profile, time));
+			dcbench_put_uint16_le (p + 6, remaining > 99 ? 99 : remaining);
+			p[11] = oceanic_atom2_temperature (profile, time);
+		} else {
+			// Temperature delta (°F), with the sign in the first byte.
+			unsigned int t = oceanic_atom2_temperature (profile, time);
+			unsigned int delta = 0;
+			if (t < temperature) {
+				delta = temperature - t;
+				if (delta > 3)
+					delta = 3;
+				temperature -= delta;
+				p[0] |= 0x80;
+			} else {
+				delta = t - temperature;
+				if (delta > 3)
+					delta = 3;
+				temperature += delta;
+			}
+			p[7] = delta << 2;
+
+			// Pressure delta (psi).
+			unsigned int target = oceanic_atom2_pressure (profile, time);
+			if (target < pressure) {
+				delta = pressure - target;
+				if (delta > 0xFF)
+					delta = 0xFF;
+				pressure -= delta;
+				p[1] = delta;
+			}
+		}
+	}
+
+	p = dcbench_append (buffer, layout->footersize);
+	if (p == NULL)
+		return DC_STATUS_NOMEMORY;
+	dcbench_put_uint16_le (p + 4, maxdepth);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+oceanic_atom2_generate (dc_buffer_t *buffer, const dcbench_profile_t *profile)
+{
+	return oceanic_atom2_generate_common (buffer, profile, &oceanic_atom2_layout);
+}
+
+static dc_status_t
+oceanic_a300cs_generate (dc_buffer_t *buffer, const dcbench_profile_t *profile)
+{
+	return oceanic_atom2_generate_common (buffer, profile, &oceanic_a300cs_layout);
+}
+
+const dcbench_generator_t dcbench_oceanic_atom2 = {
+	"oceanic_atom2",
+	"Oceanic Atom 2.0 (8 byte samples)",
+	DC_FAMILY_OCEANIC_ATOM2, ATOM2,
+	oceanic_atom2_generate,
+};
+
+const dcbench_generator_t dcbench_oceanic_a300cs = {
+	"oceanic_a300cs",
+	"Aeris A300CS (16 byte samples)",
+	DC_FAMILY_OCEANIC_ATOM2, A300CS,
+	oceanic_a300cs_generate,
+};
@@ -0,0 +1,124 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "generator.h"
+
+#define PERDIXAI 7
+
+#define SZ_BLOCK  0x80
+#define SZ_SAMPLE 0x20
+#define INTERVAL  10
+
+#define OC 0x10
+
+#define LOGVERSION 7
+
+#define PSI 6894.75729
+#define BAR 100000.0
+
+/*
+ * A Perdix AI dive: a header block, one fixed size record every 10
+ * seconds, and the footer and final blocks. With log version 7, the
+ * samples also contain the transmitter pressure and the gas time
+ * remaining.
+ */
+static void
+shearwater_header (unsigned char header[], const dcbench_profile_t *profile)
+{
+	header[0] = 0xFF;
+	header[1] = 0xFF;
+	header[4] = 30; /* GF low */
+	header[5] = 70; /* GF high */
+	header[8] = 0;  /* Metric */
+	header[9] = 41; /* Battery (0.1 V) */
+	dcbench_put_uint32_be (header + 12, 1497522600 + profile->seed);
+	header[19] = 0x44;
+	dcbench_put_uint16_be (header + 47, 1013);
+	header[67] = 0; /* GF */
+	dcbench_put_uint16_be (header + 83, 1025);
+	header[120] = 5; /* Li-Ion */
+	header[127] = LOGVERSION;
+}
+
+static void
+shearwater_footer (unsigned char footer[], const dcbench_profile_t *profile)
+{
+	dcbench_put_uint16_be (footer, 0xFFFE);
+	dcbench_put_uint16_be (footer + 4, (unsigned int) (profile->maxdepth + 0.5));
+	dcbench_put_uint16_be (footer + 6, profile->duration / 60);
+	dcbench_put_uint16_be (footer + SZ_BLOCK, 0xFFFD);
+}
+
+static dc_status_t
+shearwater_petrel_generate (dc_buffer_t *buffer, const dcbench_profile_t *profile)
+{
+	unsigned int rng = profile->seed;
+
+	unsigned char *p = dcbench_append (buffer, SZ_BLOCK);
+	if (p == NULL)
+		return DC_STATUS_NOMEMORY;
+	shearwater_header (p, profile);
+
+	unsigned int o2 = 21;
+	for (unsigned int time = INTERVAL; time <= profile->duration; time += INTERVAL) {
+		double depth = dcbench_profile_depth (profile, time);
+
+		p = dcbench_append (buffer, SZ_SAMPLE);
+		if (p == NULL)
+			return DC_STATUS_NOMEMORY;
+
+		// Switch to the deco gas at the start of the ascent.
+		if (o2 == 21 && time > profile->duration / 2 && depth < 21.0)
+			o2 = 50;
+
+		unsigned int remaining = (profile->duration - time) / 60;
+		unsigned int noise = dcbench_random (&rng) & 0x01;
+		unsigned int pressure = dcbench_profile_pressure (profile, time) * BAR / PSI / 2.0;
+
+		dcbench_put_uint16_be (p, (unsigned int) (depth * 10.0 + 0.5) + noise);
+		p[7] = o2;
+		p[8] = 0;
+		p[9] = remaining > 99 ? 99 : remaining;
+		p[11] = OC;
+		p[13] = (unsigned int) (dcbench_profile_temperature (profile, time) + 0.5);
+		dcbench_put_uint16_be (p + 19, 0xFFFF); /* T2 not paired */
+		p[21] = remaining > 0xFA ? 0xFA : remaining;
+		p[22] = time * 100 / profile->duration;
+		dcbench_put_uint16_be (p + 27, pressure & 0x0FFF);
+	}
+
+	p = dcbench_append (buffer, 2 * SZ_BLOCK);
+	if (p == NULL)
+		return DC_STATUS_NOMEMORY;
+	shearwater_footer (p, profile);
+
+	return DC_STATUS_SUCCESS;
+}
+
+const dcbench_generator_t dcbench_shearwater_petrel = {
+	"shearwater_petrel",
+	"Shearwater Perdix AI (fixed size records)",
+	DC_FAMILY_SHEARWATER_PETREL, PERDIXAI,
+	shearwater_petrel_generate,
+};
@@ -0,0 +1,220 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "generator.h"
+
+#define INTERVAL 10
+
+/*
+ * The type numbers of the descriptors. A record type byte of zero
+ * terminates the records of an entry, so the numbering starts at one.
+ */
+enum eonsteel_type {
+	T_SERIAL = 1,
+	T_DATETIME,
+	T_MAXDEPTH,
+	T_SURFACE,
+	T_GAS_STATE,
+	T_GAS_OXYGEN,
+	T_GAS_HELIUM,
+	T_TIME,
+	T_DEPTH,
+	T_TEMPERATURE,
+	T_NDL,
+	T_GASNUMBER,
+	T_PRESSURE,
+	T_NOTIFY_TYPE,
+	T_NOTIFY_ACTIVE,
+	T_GASSWITCH,
+	T_GRP_SAMPLE,
+	T_GRP_CYLINDER,
+};
+
+static const struct {
+	enum eonsteel_type type;
+	const char *text;
+} g_descriptors[] = {
+	{T_SERIAL,        "<PTH>sml.DeviceLog.Device.SerialNumber\n<FRM>utf8"},
+	{T_DATETIME,      "<PTH>sml.DeviceLog.Header.DateTime\n<FRM>utf8"},
+	{T_MAXDEPTH,      "<PTH>sml.DeviceLog.Header.Depth.Max\n<FRM>float32,precision=2"},
+	{T_SURFACE,       "<PTH>sml.DeviceLog.Header.Diving.SurfacePressure\n<FRM>uint32"},
+	{T_GAS_STATE,     "<PTH>sml.DeviceLog.Header.Diving.Gases+Gas.State\n<FRM>enum:0=Off,1=Primary,3=Diluent,4=Oxygen"},
+	{T_GAS_OXYGEN,    "<PTH>sml.DeviceLog.Header.Diving.Gases.Gas.Oxygen\n<FRM>uint8,precision=2"},
+	{T_GAS_HELIUM,    "<PTH>sml.DeviceLog.Header.Diving.Gases.Gas.Helium\n<FRM>uint8,precision=2"},
+	{T_TIME,          "<PTH>sml.DeviceLog.Samples+Sample.Time\n<FRM>duint16,precision=3"},
+	{T_DEPTH,         "<PTH>sml.DeviceLog.Samples.Sample.Depth\n<FRM>uint16,precision=2,nillable=65535"},
+	{T_TEMPERATURE,   "<PTH>sml.DeviceLog.Samples.Sample.Temperature\n<FRM>int16,precision=2,nillable=-3000"},
+	{T_NDL,           "<PTH>sml.DeviceLog.Samples.Sample.NoDecTime\n<FRM>int16,nillable=-1"},
+	{T_GASNUMBER,     "<PTH>sml.DeviceLog.Samples.Sample.Cylinders+Cylinder.GasNumber\n<FRM>uint8"},
+	{T_PRESSURE,      "<PTH>sml.DeviceLog.Samples.Sample.Cylinders.Cylinder.Pressure\n<FRM>uint16,nillable=65535"},
+	{T_NOTIFY_TYPE,   "<PTH>sml.DeviceLog.Samples.Sample.Events+Notify.Type\n"
+	                  "<FRM>enum:0=NoFly Time,1=Depth,2=Surface Time,3=Tissue Level,4=Deco,5=Deco Window,"
+	                  "6=Safety Stop Ahead,7=Safety Stop,8=Safety Stop Broken,9=Deep Stop Ahead,10=Deep Stop,"
+	                  "11=Dive Time,12=Gas Available,13=SetPoint Switch,14=Diluent Hypoxia,15=Air Time,16=Tank Pressure"},
+	{T_NOTIFY_ACTIVE, "<PTH>sml.DeviceLog.Samples.Sample.Events.Notify.Active\n<FRM>bool"},
+	{T_GASSWITCH,     "<PTH>sml.DeviceLog.Samples.Sample.Events.GasSwitch.GasNumber\n<FRM>uint16"},
+	{T_GRP_SAMPLE,    "<GRP>8,9,10,11"},
+	{T_GRP_CYLINDER,  "<GRP>12,13"},
+};
+
+/*
+ * An entry is a zero byte, the length of the descriptor (including
+ * the two type bytes and the terminating NUL character), the type and
+ * the descriptor text. The data records follow, up to the zero byte
+ * of the next entry.
+ */
+static int
+eonsteel_entry (dc_buffer_t *buffer, unsigned int type, const char *text)
+{
+	unsigned int textlen = 2 + strlen (text) + 1;
+	unsigned int nbytes = textlen < 0xFF ? 2 : 6;
+
+	unsigned char *p = dcbench_append (buffer, nbytes + textlen);
+	if (p == NULL)
+		return 0;
+
+	if (textlen < 0xFF) {
+		p[1] = textlen;
+	} else {
+		p[1] = 0xFF;
+		dcbench_put_uint32_le (p + 2, textlen);
+	}
+	p += nbytes;
+
+	dcbench_put_uint16_le (p, type);
+	memcpy (p + 2, text, textlen - 2);
+
+	return 1;
+}
+
+static int
+eonsteel_record (dc_buffer_t *buffer, unsigned int type, const void *data, unsigned int size)
+{
+	unsigned char *p = dcbench_append (buffer, 2 + size);
+	if (p == NULL)
+		return 0;
+
+	p[0] = type;
+	p[1] = size;
+	memcpy (p + 2, data, size);
+
+	return 1;
+}
+
+static int
+eonsteel_gas (dc_buffer_t *buffer, unsigned int state, unsigned int oxygen, unsigned int helium)
+{
+	unsigned char s = state, o2 = oxygen, he = helium;
+
+	return eonsteel_record (buffer, T_GAS_STATE, &s, 1) &&
+		eonsteel_record (buffer, T_GAS_OXYGEN, &o2, 1) &&
+		eonsteel_record (buffer, T_GAS_HELIUM, &he, 1);
+}
+
+static int
+eonsteel_header (dc_buffer_t *buffer, const dcbench_profile_t *profile)
+{
+	unsigned char maxdepth[4], surface[4];
+	float value = (float) profile->maxdepth;
+	unsigned int bits = 0;
+
+	memcpy (&bits, &value, sizeof (bits));
+	dcbench_put_uint32_le (maxdepth, bits);
+	dcbench_put_uint32_le (surface, 101300);
+
+	static const char serial[] = "1234567890";
+	static const char datetime[] = "2017-06-15T10:30:00";
+
+	return eonsteel_record (buffer, T_SERIAL, serial, sizeof (serial)) &&
+		eonsteel_record (buffer, T_DATETIME, datetime, sizeof (datetime)) &&
+		eonsteel_record (buffer, T_MAXDEPTH, maxdepth, sizeof (maxdepth)) &&
+		eonsteel_record (buffer, T_SURFACE, surface, sizeof (surface)) &&
+		eonsteel_gas (buffer, 1, 21, 0) &&
+		eonsteel_gas (buffer, 1, 50, 0);
+}
+
+static dc_status_t
+suunto_eonsteel_generate (dc_buffer_t *buffer, const dcbench_profile_t *profile)
+{
+	unsigned int rng = profile->seed;
+
+	unsigned char *p = dcbench_append (buffer, 12);
+	if (p == NULL)
+		return DC_STATUS_NOMEMORY;
+	dcbench_put_uint32_le (p, 1497522600 + profile->seed);
+	memcpy (p + 4, "SBEM", 4);
+
+	// The descriptors, with the header records after the last one.
+	int ok = 1;
+	for (size_t i = 0; ok && i < sizeof (g_descriptors) / sizeof (g_descriptors[0]); ++i) {
+		ok = eonsteel_entry (buffer, g_descriptors[i].type, g_descriptors[i].text);
+	}
+	ok = ok && eonsteel_header (buffer, profile);
+
+	unsigned int gasnumber = 0;
+	for (unsigned int time = INTERVAL; ok && time <= profile->duration; time += INTERVAL) {
+		double depth = dcbench_profile_depth (profile, time);
+		unsigned int remaining = (profile->duration - time) / 60;
+		unsigned char data[5];
+
+		// Time delta (ms), depth (cm), temperature (0.1 °C) and NDL (minutes).
+		unsigned char sample[8];
+		dcbench_put_uint16_le (sample + 0, INTERVAL * 1000);
+		dcbench_put_uint16_le (sample + 2, (unsigned int) (depth * 100.0 + 0.5) + (dcbench_random (&rng) & 0x03));
+		dcbench_put_uint16_le (sample + 4, (unsigned int) (dcbench_profile_temperature (profile, time) * 10.0));
+		dcbench_put_uint16_le (sample + 6, remaining > 99 ? 99 : remaining);
+		ok = eonsteel_record (buffer, T_GRP_SAMPLE, sample, sizeof (sample));
+
+		// Switch to the deco gas at the start of the ascent.
+		if (ok && gasnumber == 0 && time > profile->duration / 2 && depth < 21.0) {
+			gasnumber = 1;
+			dcbench_put_uint16_le (data, gasnumber + 1);
+			ok = eonsteel_record (buffer, T_GASSWITCH, data, 2);
+		}
+
+		// Cylinder pressure (centibar), every 30 seconds.
+		if (ok && (time % 30) == 0) {
+			data[0] = gasnumber;
+			dcbench_put_uint16_le (data + 1, (unsigned int) (dcbench_profile_pressure (profile, time) * 100.0));
+			ok = eonsteel_record (buffer, T_GRP_CYLINDER, data, 3);
+		}
+
+		// An occasional notification.
+		if (ok && (dcbench_random (&rng) % 500) == 0) {
+			data[0] = dcbench_random (&rng) % 17;
+			data[1] = 1;
+			ok = eonsteel_record (buffer, T_NOTIFY_TYPE, data + 0, 1) &&
+				eonsteel_record (buffer, T_NOTIFY_ACTIVE, data + 1, 1);
+		}
+	}
+
+	return ok ? DC_STATUS_SUCCESS : DC_STATUS_NOMEMORY;
+}
+
+const dcbench_generator_t dcbench_suunto_eonsteel = {
+	"suunto_eonsteel",
+	"Suunto EON Steel (SBEM records)",
+	DC_FAMILY_SUUNTO_EONSTEEL, 0,
+	suunto_eonsteel_generate,
+};
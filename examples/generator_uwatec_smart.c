@@ -0,0 +1,288 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "generator.h"
+
+#define SMARTPRO 0x10
+#define GALILEO  0x11
+
+#define SZ_HEADER_SMARTPRO 92
+#define SZ_HEADER_GALILEO  152
+
+#define INTERVAL 4
+#define MAXRUN   15
+
+#define SALINITY 0x00100000
+
+/*
+ * The samples are a bitstream of variable length type bits, followed
+ * by the data bits. The total number of bits is always a multiple of
+ * eight, and the data is stored in big endian byte order.
+ */
+static int
+uwatec_smart_sample (dc_buffer_t *buffer, unsigned int type, unsigned int ntypebits, unsigned int value, unsigned int nbits)
+{
+	unsigned int total = ntypebits + nbits;
+	unsigned int nbytes = total / 8;
+	unsigned char *p = dcbench_append (buffer, nbytes);
+	if (p == NULL)
+		return 0;
+
+	unsigned int mask = nbits < 32 ? (1u << nbits) - 1 : 0xFFFFFFFF;
+	unsigned long long bits = ((unsigned long long) type << nbits) | (value & mask);
+	for (unsigned int i = 0; i < nbytes; ++i) {
+		p[i] = (bits >> (8 * (nbytes - 1 - i))) & 0xFF;
+	}
+
+	return 1;
+}
+
+static int
+uwatec_smart_fits (int value, unsigned int nbits)
+{
+	int limit = 1 << (nbits - 1);
+	return value >= -limit && value < limit;
+}
+
+static void
+uwatec_smart_header (unsigned char header[], unsigned int model, const dcbench_profile_t *profile)
+{
+	unsigned int maxdepth = (unsigned int) (profile->maxdepth * 100.0);
+	unsigned int divetime = profile->duration / 60;
+	int tmin = (int) (dcbench_profile_temperature (profile, profile->duration / 2) * 10.0);
+	int tmax = (int) (dcbench_profile_temperature (profile, 0) * 10.0);
+
+	header[0] = 0xA5;
+	header[1] = 0xA5;
+	header[2] = 0x5A;
+	header[3] = 0x5A;
+	dcbench_put_uint32_le (header + 8, 0x01000000 - profile->duration * 2);
+
+	if (model == SMARTPRO) {
+		dcbench_put_uint16_le (header + 18, maxdepth);
+		dcbench_put_uint16_le (header + 20, divetime);
+		dcbench_put_uint16_le (header + 22, tmin);
+		dcbench_put_uint16_le (header + 24, 32);
+	} else {
+		header[16] = 4; /* UTC+1 */
+		dcbench_put_uint16_le (header + 22, maxdepth);
+		dcbench_put_uint16_le (header + 26, divetime);
+		dcbench_put_uint16_le (header + 28, tmax);
+		dcbench_put_uint16_le (header + 30, tmin);
+		dcbench_put_uint16_le (header + 32, tmax);
+		dcbench_put_uint16_le (header + 44, 32);
+		dcbench_put_uint16_le (header + 50, (unsigned int) (dcbench_profile_pressure (profile, profile->duration) * 128.0));
+		dcbench_put_uint16_le (header + 56, (unsigned int) (dcbench_profile_pressure (profile, 0) * 128.0));
+		dcbench_put_uint32_le (header + 92, SALINITY);
+	}
+}
+
+/*
+ * Smart Pro (Smart bitstream with a unary type prefix):
+ *
+ *   0ddddddd                     depth delta
+ *   10dddddd                     temperature delta
+ *   110ddddd                     repeat the sample
+ *   11110ddd dddddddd            depth delta
+ *   111110dd dddddddd            temperature delta
+ *   1111110- dddddddd dddddddd   absolute depth
+ *   11111110 dddddddd dddddddd   absolute temperature
+ */
+static dc_status_t
+uwatec_smartpro_generate (dc_buffer_t *buffer, const dcbench_profile_t *profile)
+{
+	unsigned int rng = profile->seed;
+
+	unsigned char *header = dcbench_append (buffer, SZ_HEADER_SMARTPRO);
+	if (header == NULL)
+		return DC_STATUS_NOMEMORY;
+	uwatec_smart_header (header, SMARTPRO, profile);
+
+	// Initial values.
+	int depth = 0;
+	int temperature = (int) floor (dcbench_profile_temperature (profile, 0) * 2.5 + 0.5);
+	int ok = uwatec_smart_sample (buffer, 0xFE, 8, temperature, 16) &&
+		uwatec_smart_sample (buffer, 0x7E, 7, depth, 17);
+
+	unsigned int run = 0;
+	for (unsigned int time = INTERVAL; ok && time < profile->duration; time += INTERVAL) {
+		int d = (int) floor (dcbench_profile_depth (profile, time) * 50.0 + 0.5);
+		if (d > 0 && (dcbench_random (&rng) & 0x07) == 0)
+			d += (dcbench_random (&rng) & 0x01) ? 1 : -1;
+		int t = (int) floor (dcbench_profile_temperature (profile, time) * 2.5 + 0.5);
+
+		// Identical samples are stored as a repeat count.
+		if (d == depth && t == temperature && run < MAXRUN) {
+			run++;
+			continue;
+		}
+		if (run) {
+			ok = uwatec_smart_sample (buffer, 0x06, 3, run, 5);
+			run = 0;
+		}
+
+		if (t != temperature) {
+			int delta = t - temperature;
+			if (uwatec_smart_fits (delta, 6))
+				ok = ok && uwatec_smart_sample (buffer, 0x02, 2, delta, 6);
+			else if (uwatec_smart_fits (delta, 10))
+				ok = ok && uwatec_smart_sample (buffer, 0x3E, 6, delta, 10);
+			else
+				ok = ok && uwatec_smart_sample (buffer, 0xFE, 8, t, 16);
+			temperature = t;
+		}
+
+		int delta = d - depth;
+		if (uwatec_smart_fits (delta, 7))
+			ok = ok && uwatec_smart_sample (buffer, 0x00, 1, delta, 7);
+		else if (uwatec_smart_fits (delta, 11))
+			ok = ok && uwatec_smart_sample (buffer, 0x1E, 5, delta, 11);
+		else
+			ok = ok && uwatec_smart_sample (buffer, 0x7E, 7, d, 17);
+		depth = d;
+	}
+
+	if (ok && run)
+		ok = uwatec_smart_sample (buffer, 0x06, 3, run, 5);
+
+	return ok ? DC_STATUS_SUCCESS : DC_STATUS_NOMEMORY;
+}
+
+/*
+ * Galileo (type nibble, with an extended type byte for 1111):
+ *
+ *   0ddd dddd                        depth delta
+ *   100d dddd                        rbt delta
+ *   1010 dddd                        pressure delta
+ *   1011 dddd                        temperature delta
+ *   1100 dddd                        repeat the sample
+ *   1110 dddd                        alarms
+ *   1111 0001 dddddddd dddddddd      absolute depth
+ *   1111 0010 dddddddd               absolute rbt
+ *   1111 0011 dddddddd dddddddd      absolute temperature
+ *   1111 0100 dddddddd dddddddd      absolute pressure (tank 1)
+ *   1111 1000 dddddddd dddddddd      bearing
+ */
+static dc_status_t
+uwatec_galileo_generate (dc_buffer_t *buffer, const dcbench_profile_t *profile)
+{
+	unsigned int rng = profile->seed;
+
+	unsigned char *header = dcbench_append (buffer, SZ_HEADER_GALILEO);
+	if (header == NULL)
+		return DC_STATUS_NOMEMORY;
+	uwatec_smart_header (header, GALILEO, profile);
+
+	// Initial values.
+	int depth = 0;
+	int rbt = 99;
+	int temperature = (int) floor (dcbench_profile_temperature (profile, 0) * 2.5 + 0.5);
+	int pressure = (int) floor (dcbench_profile_pressure (profile, 0) * 4.0 + 0.5);
+	int ok = uwatec_smart_sample (buffer, 0xF3, 8, temperature, 16) &&
+		uwatec_smart_sample (buffer, 0xF4, 8, pressure, 16) &&
+		uwatec_smart_sample (buffer, 0xF2, 8, rbt, 8) &&
+		uwatec_smart_sample (buffer, 0xF1, 8, depth, 16);
+
+	unsigned int run = 0;
+	unsigned int n = 0;
+	for (unsigned int time = INTERVAL; ok && time < profile->duration; time += INTERVAL, n++) {
+		int d = (int) floor (dcbench_profile_depth (profile, time) * 50.0 + 0.5);
+		if (d > 0 && (dcbench_random (&rng) & 0x07) == 0)
+			d += (dcbench_random (&rng) & 0x01) ? 1 : -1;
+		int t = (int) floor (dcbench_profile_temperature (profile, time) * 2.5 + 0.5);
+		int p = (int) floor (dcbench_profile_pressure (profile, time) * 4.0 + 0.5);
+		int r = (profile->duration - time) / 60;
+		if (r > 99)
+			r = 99;
+		unsigned int bearing = (n % 150) == 0;
+		unsigned int alarm = (n % 900) == 450;
+
+		// Identical samples are stored as a repeat count.
+		if (d == depth && t == temperature && p == pressure && r == rbt &&
+			!bearing && !alarm && run < MAXRUN) {
+			run++;
+			continue;
+		}
+		if (run) {
+			ok = uwatec_smart_sample (buffer, 0x0C, 4, run, 4);
+			run = 0;
+		}
+
+		if (t != temperature) {
+			if (uwatec_smart_fits (t - temperature, 4))
+				ok = ok && uwatec_smart_sample (buffer, 0x0B, 4, t - temperature, 4);
+			else
+				ok = ok && uwatec_smart_sample (buffer, 0xF3, 8, t, 16);
+			temperature = t;
+		}
+
+		if (p != pressure) {
+			if (uwatec_smart_fits (p - pressure, 4))
+				ok = ok && uwatec_smart_sample (buffer, 0x0A, 4, p - pressure, 4);
+			else
+				ok = ok && uwatec_smart_sample (buffer, 0xF4, 8, p, 16);
+			pressure = p;
+		}
+
+		if (r != rbt) {
+			if (uwatec_smart_fits (r - rbt, 5))
+				ok = ok && uwatec_smart_sample (buffer, 0x04, 3, r - rbt, 5);
+			else
+				ok = ok && uwatec_smart_sample (buffer, 0xF2, 8, r, 8);
+			rbt = r;
+		}
+
+		if (bearing)
+			ok = ok && uwatec_smart_sample (buffer, 0xF8, 8, dcbench_random (&rng) % 360, 16);
+
+		if (alarm)
+			ok = ok && uwatec_smart_sample (buffer, 0x0E, 4, 0x08, 4);
+
+		if (uwatec_smart_fits (d - depth, 7))
+			ok = ok && uwatec_smart_sample (buffer, 0x00, 1, d - depth, 7);
+		else
+			ok = ok && uwatec_smart_sample (buffer, 0xF1, 8, d, 16);
+		depth = d;
+	}
+
+	if (ok && run)
+		ok = uwatec_smart_sample (buffer, 0x0C, 4, run, 4);
+
+	return ok ? DC_STATUS_SUCCESS : DC_STATUS_NOMEMORY;
+}
+
+const dcbench_generator_t dcbench_uwatec_smartpro = {
+	"uwatec_smartpro",
+	"Uwatec Smart Pro (smart bitstream)",
+	DC_FAMILY_UWATEC_SMART, SMARTPRO,
+	uwatec_smartpro_generate,
+};
+
+const dcbench_generator_t dcbench_uwatec_galileo = {
+	"uwatec_galileo",
+	"Uwatec Galileo (galileo bitstream)",
+	DC_FAMILY_UWATEC_SMART, GALILEO,
+	uwatec_galileo_generate,
+};
@@ -44,6 +44,10 @@ struct dctool_output_vtable_t {
 	dc_status_t (*write) (dctool_output_t *output, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
 
 	dc_status_t (*free) (dctool_output_t *output);
+
+	dc_status_t (*format) (dctool_output_t *output, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *buffer);
+
+	dc_status_t (*append) (dctool_output_t *output, const unsigned char data[], size_t size);
 };
 
 dctool_output_t *
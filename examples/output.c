@@ -61,6 +61,26 @@ dctool_output_write (dctool_output_t *output, dc_parser_t *parser, const unsigne
 	return output->vtable->write (output, parser, data, size, fingerprint, fsize);
 }
 
+dc_status_t
+dctool_output_format (dctool_output_t *output, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *buffer)
+{
+	if (output == NULL || output->vtable->format == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	return output->vtable->format (output, number, parser, data, size, fingerprint, fsize, buffer);
+}
+
+dc_status_t
+dctool_output_append (dctool_output_t *output, dc_buffer_t *buffer)
+{
+	if (output == NULL || output->vtable->append == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	output->number++;
+
+	return output->vtable->append (output, dc_buffer_get_data (buffer), dc_buffer_get_size (buffer));
+}
+
 dc_status_t
 dctool_output_free (dctool_output_t *output)
 {
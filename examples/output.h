@@ -23,7 +23,9 @@
 #define DCTOOL_OUTPUT_H
 
 #include <libdivecomputer/common.h>
+#include <libdivecomputer/context.h>
 #include <libdivecomputer/parser.h>
+#include <libdivecomputer/buffer.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -42,9 +44,25 @@ dctool_xml_output_new (const char *filename, dctool_units_t units);
 dctool_output_t *
 dctool_raw_output_new (const char *template);
 
+dctool_output_t *
+dctool_archive_output_new (const char *filename, dc_context_t *context);
+
 dc_status_t
 dctool_output_write (dctool_output_t *output, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
 
+/*
+ * Format a dive into a memory buffer, instead of writing it to the
+ * output. Unlike dctool_output_write, this function can be called from
+ * several threads at the same time (each with its own parser), and the
+ * formatted dives are written in order with dctool_output_append.
+ * Returns DC_STATUS_UNSUPPORTED if the output format doesn't support it.
+ */
+dc_status_t
+dctool_output_format (dctool_output_t *output, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *buffer);
+
+dc_status_t
+dctool_output_append (dctool_output_t *output, dc_buffer_t *buffer);
+
 dc_status_t
 dctool_output_free (dctool_output_t *output);
 
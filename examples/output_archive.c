@@ -0,0 +1,129 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <libdivecomputer/archive.h>
+
+#include "output-private.h"
+#include "utils.h"
+
+static dc_status_t dctool_archive_output_write (dctool_output_t *output, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
+static dc_status_t dctool_archive_output_free (dctool_output_t *output);
+
+typedef struct dctool_archive_output_t {
+	dctool_output_t base;
+	FILE *ostream;
+	dc_archive_writer_t *writer;
+} dctool_archive_output_t;
+
+static const dctool_output_vtable_t archive_vtable = {
+	sizeof(dctool_archive_output_t), /* size */
+	dctool_archive_output_write, /* write */
+	dctool_archive_output_free, /* free */
+	NULL, /* format */
+	NULL, /* append */
+};
+
+dctool_output_t *
+dctool_archive_output_new (const char *filename, dc_context_t *context)
+{
+	dctool_archive_output_t *output = NULL;
+
+	if (filename == NULL)
+		goto error_exit;
+
+	// Allocate memory.
+	output = (dctool_archive_output_t *) dctool_output_allocate (&archive_vtable);
+	if (output == NULL) {
+		goto error_exit;
+	}
+
+	// Create the archive writer.
+	if (dc_archive_writer_new (&output->writer, context) != DC_STATUS_SUCCESS) {
+		goto error_free;
+	}
+
+	// Open the output file.
+	output->ostream = fopen (filename, "wb");
+	if (output->ostream == NULL) {
+		goto error_writer_free;
+	}
+
+	return (dctool_output_t *) output;
+
+error_writer_free:
+	dc_archive_writer_free (output->writer);
+error_free:
+	dctool_output_deallocate ((dctool_output_t *) output);
+error_exit:
+	return NULL;
+}
+
+static dc_status_t
+dctool_archive_output_write (dctool_output_t *abstract, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+{
+	dctool_archive_output_t *output = (dctool_archive_output_t *) abstract;
+
+	message ("Adding the dive to the archive.\n");
+	dc_status_t status = dc_archive_writer_add (output->writer, parser, fingerprint, fingerprint ? fsize : 0);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Error adding the dive to the archive.");
+		return status;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+dctool_archive_output_free (dctool_output_t *abstract)
+{
+	dctool_archive_output_t *output = (dctool_archive_output_t *) abstract;
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	// The index can only be written once all dives are known.
+	dc_buffer_t *buffer = dc_buffer_new (0);
+	if (buffer == NULL) {
+		ERROR ("Failed to allocate memory.");
+		status = DC_STATUS_NOMEMORY;
+		goto cleanup;
+	}
+
+	status = dc_archive_writer_finish (output->writer, buffer);
+	if (status != DC_STATUS_SUCCESS) {
+		ERROR ("Error writing the archive.");
+		goto cleanup;
+	}
+
+	if (fwrite (dc_buffer_get_data (buffer), 1, dc_buffer_get_size (buffer), output->ostream) != dc_buffer_get_size (buffer)) {
+		ERROR ("Failed to write the output file.");
+		status = DC_STATUS_IO;
+		goto cleanup;
+	}
+
+cleanup:
+	dc_buffer_free (buffer);
+	dc_archive_writer_free (output->writer);
+	fclose (output->ostream);
+
+	return status;
+}
@@ -38,6 +38,8 @@ static const dctool_output_vtable_t raw_vtable = {
 	sizeof(dctool_raw_output_t), /* size */
 	dctool_raw_output_write, /* write */
 	dctool_raw_output_free, /* free */
+	NULL, /* format */
+	NULL, /* append */
 };
 
 static int
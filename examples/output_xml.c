@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
 
 #include <libdivecomputer/units.h>
 
@@ -30,25 +31,222 @@
 
 static dc_status_t dctool_xml_output_write (dctool_output_t *output, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize);
 static dc_status_t dctool_xml_output_free (dctool_output_t *output);
+static dc_status_t dctool_xml_output_format (dctool_output_t *output, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *buffer);
+static dc_status_t dctool_xml_output_append (dctool_output_t *output, const unsigned char data[], size_t size);
+
+#define BUFSIZE 65536
+
+/*
+ * A buffered writer with dedicated formatters for the few conversions
+ * used in the output. The generated text is identical to the printf
+ * conversions mentioned next to each formatter, but avoids the
+ * overhead of the format string parsing and the (locale aware) floating
+ * point formatting for every single value.
+ */
+typedef struct xml_writer_t {
+	FILE *ostream;
+	dc_buffer_t *memory;
+	size_t size;
+	char buffer[BUFSIZE];
+} xml_writer_t;
 
 typedef struct dctool_xml_output_t {
 	dctool_output_t base;
-	FILE *ostream;
 	dctool_units_t units;
+	xml_writer_t writer;
 } dctool_xml_output_t;
 
 static const dctool_output_vtable_t xml_vtable = {
 	sizeof(dctool_xml_output_t), /* size */
 	dctool_xml_output_write, /* write */
 	dctool_xml_output_free, /* free */
+	dctool_xml_output_format, /* format */
+	dctool_xml_output_append, /* append */
 };
 
 typedef struct sample_data_t {
-	FILE *ostream;
+	xml_writer_t *writer;
 	dctool_units_t units;
 	unsigned int nsamples;
 } sample_data_t;
 
+static void
+xml_flush (xml_writer_t *writer)
+{
+	if (writer->size) {
+		if (writer->memory) {
+			dc_buffer_append (writer->memory, (const unsigned char *) writer->buffer, writer->size);
+		} else {
+			fwrite (writer->buffer, 1, writer->size, writer->ostream);
+		}
+		writer->size = 0;
+	}
+}
+
+/*
+ * Reserve space for (at most) n characters, and return a pointer to it.
+ */
+static char *
+xml_reserve (xml_writer_t *writer, size_t n)
+{
+	if (writer->size + n > sizeof (writer->buffer))
+		xml_flush (writer);
+
+	return writer->buffer + writer->size;
+}
+
+static void
+xml_write (xml_writer_t *writer, const char data[], size_t length)
+{
+	if (length > sizeof (writer->buffer)) {
+		xml_flush (writer);
+		if (writer->memory) {
+			dc_buffer_append (writer->memory, (const unsigned char *) data, length);
+		} else {
+			fwrite (data, 1, length, writer->ostream);
+		}
+		return;
+	}
+
+	memcpy (xml_reserve (writer, length), data, length);
+	writer->size += length;
+}
+
+/*
+ * Equivalent to printf ("%s").
+ */
+static void
+xml_puts (xml_writer_t *writer, const char *string)
+{
+	xml_write (writer, string, strlen (string));
+}
+
+/*
+ * Equivalent to printf ("%0*u"), with the width including the sign.
+ */
+static void
+xml_number (xml_writer_t *writer, int negative, unsigned long long value, unsigned int width)
+{
+	char digits[24];
+	unsigned int n = 0;
+
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+
+	if (negative && width)
+		width--;
+
+	char *p = xml_reserve (writer, 1 + (n > width ? n : width));
+	char *begin = p;
+	if (negative)
+		*p++ = '-';
+	while (width > n) {
+		*p++ = '0';
+		width--;
+	}
+	while (n) {
+		*p++ = digits[--n];
+	}
+
+	writer->size += p - begin;
+}
+
+/*
+ * Equivalent to printf ("%0*u").
+ */
+static void
+xml_uint (xml_writer_t *writer, unsigned int value, unsigned int width)
+{
+	xml_number (writer, 0, value, width);
+}
+
+/*
+ * Equivalent to printf ("%0*i").
+ */
+static void
+xml_int (xml_writer_t *writer, int value, unsigned int width)
+{
+	if (value < 0) {
+		xml_number (writer, 1, 0 - (unsigned int) value, width);
+	} else {
+		xml_number (writer, 0, value, width);
+	}
+}
+
+/*
+ * Equivalent to printf ("%.*f"), with at most 5 decimals.
+ *
+ * The value is scaled and rounded to an integer. The scaling introduces
+ * a rounding error, which can only change the result when the scaled
+ * value is (very) close to halfway between two integers. Those values,
+ * and the very large or non-finite values, are passed to snprintf to
+ * get the exact same result.
+ */
+static void
+xml_fixed (xml_writer_t *writer, double value, unsigned int decimals)
+{
+	static const unsigned int scale[] = {1, 10, 100, 1000, 10000, 100000};
+
+	double scaled = (value < 0 ? -value : value) * scale[decimals];
+	if (scaled < 1e9) {
+		unsigned long long integer = (unsigned long long) scaled;
+		double fraction = scaled - (double) integer;
+		if (fraction < 0.5 - 1e-6 || fraction > 0.5 + 1e-6) {
+			if (fraction > 0.5)
+				integer++;
+
+			xml_number (writer, signbit (value) != 0, integer / scale[decimals], 0);
+			if (decimals) {
+				char *p = xml_reserve (writer, 1);
+				*p = '.';
+				writer->size++;
+				xml_number (writer, 0, integer % scale[decimals], decimals);
+			}
+			return;
+		}
+	}
+
+	char *p = xml_reserve (writer, 64);
+	int n = snprintf (p, 64, "%.*f", decimals, value);
+	if (n >= 64) {
+		char *string = (char *) malloc (n + 1);
+		if (string) {
+			snprintf (string, n + 1, "%.*f", decimals, value);
+			xml_puts (writer, string);
+			free (string);
+		}
+	} else if (n > 0) {
+		writer->size += n;
+	}
+}
+
+/*
+ * Equivalent to printf ("%02X") for every byte.
+ */
+static void
+xml_hex (xml_writer_t *writer, const unsigned char data[], unsigned int size)
+{
+	static const char hex[] = "0123456789ABCDEF";
+
+	unsigned int nbytes = 0;
+	while (nbytes < size) {
+		unsigned int len = size - nbytes;
+		if (len > sizeof (writer->buffer) / 2)
+			len = sizeof (writer->buffer) / 2;
+
+		char *p = xml_reserve (writer, 2 * len);
+		for (unsigned int i = 0; i < len; ++i) {
+			p[2 * i + 0] = hex[data[nbytes + i] >> 4];
+			p[2 * i + 1] = hex[data[nbytes + i] & 0x0F];
+		}
+		writer->size += 2 * len;
+
+		nbytes += len;
+	}
+}
+
 static double
 convert_depth (double value, dctool_units_t units)
 {
@@ -103,65 +301,103 @@ sample_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
 		"ndl", "safety", "deco", "deep"};
 
 	sample_data_t *sampledata = (sample_data_t *) userdata;
+	xml_writer_t *writer = sampledata->writer;
 
 	switch (type) {
 	case DC_SAMPLE_TIME:
 		if (sampledata->nsamples++)
-			fprintf (sampledata->ostream, "</sample>\n");
-		fprintf (sampledata->ostream, "<sample>\n");
-		fprintf (sampledata->ostream, "   <time>%02u:%02u</time>\n", value.time / 60, value.time % 60);
+			xml_puts (writer, "</sample>\n");
+		xml_puts (writer, "<sample>\n");
+		xml_puts (writer, "   <time>");
+		xml_uint (writer, value.time / 60, 2);
+		xml_puts (writer, ":");
+		xml_uint (writer, value.time % 60, 2);
+		xml_puts (writer, "</time>\n");
 		break;
 	case DC_SAMPLE_DEPTH:
-		fprintf (sampledata->ostream, "   <depth>%.2f</depth>\n",
-			convert_depth(value.depth, sampledata->units));
+		xml_puts (writer, "   <depth>");
+		xml_fixed (writer, convert_depth(value.depth, sampledata->units), 2);
+		xml_puts (writer, "</depth>\n");
 		break;
 	case DC_SAMPLE_PRESSURE:
-		fprintf (sampledata->ostream, "   <pressure tank=\"%u\">%.2f</pressure>\n",
-			value.pressure.tank,
-			convert_pressure(value.pressure.value, sampledata->units));
+		xml_puts (writer, "   <pressure tank=\"");
+		xml_uint (writer, value.pressure.tank, 0);
+		xml_puts (writer, "\">");
+		xml_fixed (writer, convert_pressure(value.pressure.value, sampledata->units), 2);
+		xml_puts (writer, "</pressure>\n");
 		break;
 	case DC_SAMPLE_TEMPERATURE:
-		fprintf (sampledata->ostream, "   <temperature>%.2f</temperature>\n",
-			convert_temperature(value.temperature, sampledata->units));
+		xml_puts (writer, "   <temperature>");
+		xml_fixed (writer, convert_temperature(value.temperature, sampledata->units), 2);
+		xml_puts (writer, "</temperature>\n");
 		break;
 	case DC_SAMPLE_EVENT:
 		if (value.event.type != SAMPLE_EVENT_GASCHANGE && value.event.type != SAMPLE_EVENT_GASCHANGE2) {
-			fprintf (sampledata->ostream, "   <event type=\"%u\" time=\"%u\" flags=\"%u\" value=\"%u\">%s</event>\n",
-				value.event.type, value.event.time, value.event.flags, value.event.value, events[value.event.type]);
+			xml_puts (writer, "   <event type=\"");
+			xml_uint (writer, value.event.type, 0);
+			xml_puts (writer, "\" time=\"");
+			xml_uint (writer, value.event.time, 0);
+			xml_puts (writer, "\" flags=\"");
+			xml_uint (writer, value.event.flags, 0);
+			xml_puts (writer, "\" value=\"");
+			xml_uint (writer, value.event.value, 0);
+			xml_puts (writer, "\">");
+			xml_puts (writer, events[value.event.type]);
+			xml_puts (writer, "</event>\n");
 		}
 		break;
 	case DC_SAMPLE_RBT:
-		fprintf (sampledata->ostream, "   <rbt>%u</rbt>\n", value.rbt);
+		xml_puts (writer, "   <rbt>");
+		xml_uint (writer, value.rbt, 0);
+		xml_puts (writer, "</rbt>\n");
 		break;
 	case DC_SAMPLE_HEARTBEAT:
-		fprintf (sampledata->ostream, "   <heartbeat>%u</heartbeat>\n", value.heartbeat);
+		xml_puts (writer, "   <heartbeat>");
+		xml_uint (writer, value.heartbeat, 0);
+		xml_puts (writer, "</heartbeat>\n");
 		break;
 	case DC_SAMPLE_BEARING:
-		fprintf (sampledata->ostream, "   <bearing>%u</bearing>\n", value.bearing);
+		xml_puts (writer, "   <bearing>");
+		xml_uint (writer, value.bearing, 0);
+		xml_puts (writer, "</bearing>\n");
 		break;
 	case DC_SAMPLE_VENDOR:
-		fprintf (sampledata->ostream, "   <vendor type=\"%u\" size=\"%u\">", value.vendor.type, value.vendor.size);
-		for (unsigned int i = 0; i < value.vendor.size; ++i)
-			fprintf (sampledata->ostream, "%02X", ((unsigned char *) value.vendor.data)[i]);
-		fprintf (sampledata->ostream, "</vendor>\n");
+		xml_puts (writer, "   <vendor type=\"");
+		xml_uint (writer, value.vendor.type, 0);
+		xml_puts (writer, "\" size=\"");
+		xml_uint (writer, value.vendor.size, 0);
+		xml_puts (writer, "\">");
+		xml_hex (writer, (const unsigned char *) value.vendor.data, value.vendor.size);
+		xml_puts (writer, "</vendor>\n");
 		break;
 	case DC_SAMPLE_SETPOINT:
-		fprintf (sampledata->ostream, "   <setpoint>%.2f</setpoint>\n", value.setpoint);
+		xml_puts (writer, "   <setpoint>");
+		xml_fixed (writer, value.setpoint, 2);
+		xml_puts (writer, "</setpoint>\n");
 		break;
 	case DC_SAMPLE_PPO2:
-		fprintf (sampledata->ostream, "   <ppo2>%.2f</ppo2>\n", value.ppo2);
+		xml_puts (writer, "   <ppo2>");
+		xml_fixed (writer, value.ppo2, 2);
+		xml_puts (writer, "</ppo2>\n");
 		break;
 	case DC_SAMPLE_CNS:
-		fprintf (sampledata->ostream, "   <cns>%.1f</cns>\n", value.cns * 100.0);
+		xml_puts (writer, "   <cns>");
+		xml_fixed (writer, value.cns * 100.0, 1);
+		xml_puts (writer, "</cns>\n");
 		break;
 	case DC_SAMPLE_DECO:
-		fprintf (sampledata->ostream, "   <deco time=\"%u\" depth=\"%.2f\">%s</deco>\n",
-			value.deco.time,
-			convert_depth(value.deco.depth, sampledata->units),
-			decostop[value.deco.type]);
+		xml_puts (writer, "   <deco time=\"");
+		xml_uint (writer, value.deco.time, 0);
+		xml_puts (writer, "\" depth=\"");
+		xml_fixed (writer, convert_depth(value.deco.depth, sampledata->units), 2);
+		xml_puts (writer, "\">");
+		xml_puts (writer, decostop[value.deco.type]);
+		xml_puts (writer, "</deco>\n");
 		break;
 	case DC_SAMPLE_GASMIX:
-		fprintf (sampledata->ostream, "   <gasmix>%u</gasmix>\n", value.gasmix);
+		xml_puts (writer, "   <gasmix>");
+		xml_uint (writer, value.gasmix, 0);
+		xml_puts (writer, "</gasmix>\n");
 		break;
 	default:
 		break;
@@ -183,14 +419,16 @@ dctool_xml_output_new (const char *filename, dctool_units_t units)
 	}
 
 	// Open the output file.
-	output->ostream = fopen (filename, "w");
-	if (output->ostream == NULL) {
+	output->writer.ostream = fopen (filename, "w");
+	if (output->writer.ostream == NULL) {
 		goto error_free;
 	}
 
+	output->writer.memory = NULL;
+	output->writer.size = 0;
 	output->units = units;
 
-	fprintf (output->ostream, "<device>\n");
+	xml_puts (&output->writer, "<device>\n");
 
 	return (dctool_output_t *) output;
 
@@ -201,24 +439,26 @@ error_exit:
 }
 
 static dc_status_t
-dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+xml_write_dive (xml_writer_t *writer, dctool_units_t units, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
 {
-	dctool_xml_output_t *output = (dctool_xml_output_t *) abstract;
 	dc_status_t status = DC_STATUS_SUCCESS;
 
 	// Initialize the sample data.
 	sample_data_t sampledata = {0};
 	sampledata.nsamples = 0;
-	sampledata.ostream = output->ostream;
-	sampledata.units = output->units;
+	sampledata.writer = writer;
+	sampledata.units = units;
 
-	fprintf (output->ostream, "<dive>\n<number>%u</number>\n<size>%u</size>\n", abstract->number, size);
+	xml_puts (writer, "<dive>\n<number>");
+	xml_uint (writer, number, 0);
+	xml_puts (writer, "</number>\n<size>");
+	xml_uint (writer, size, 0);
+	xml_puts (writer, "</size>\n");
 
 	if (fingerprint) {
-		fprintf (output->ostream, "<fingerprint>");
-		for (unsigned int i = 0; i < fsize; ++i)
-			fprintf (output->ostream, "%02X", fingerprint[i]);
-		fprintf (output->ostream, "</fingerprint>\n");
+		xml_puts (writer, "<fingerprint>");
+		xml_hex (writer, fingerprint, fsize);
+		xml_puts (writer, "</fingerprint>\n");
 	}
 
 	// Parse the datetime.
@@ -230,9 +470,19 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 		goto cleanup;
 	}
 
-	fprintf (output->ostream, "<datetime>%04i-%02i-%02i %02i:%02i:%02i</datetime>\n",
-		dt.year, dt.month, dt.day,
-		dt.hour, dt.minute, dt.second);
+	xml_puts (writer, "<datetime>");
+	xml_int (writer, dt.year, 4);
+	xml_puts (writer, "-");
+	xml_int (writer, dt.month, 2);
+	xml_puts (writer, "-");
+	xml_int (writer, dt.day, 2);
+	xml_puts (writer, " ");
+	xml_int (writer, dt.hour, 2);
+	xml_puts (writer, ":");
+	xml_int (writer, dt.minute, 2);
+	xml_puts (writer, ":");
+	xml_int (writer, dt.second, 2);
+	xml_puts (writer, "</datetime>\n");
 
 	// Parse the divetime.
 	message ("Parsing the divetime.\n");
@@ -243,8 +493,11 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 		goto cleanup;
 	}
 
-	fprintf (output->ostream, "<divetime>%02u:%02u</divetime>\n",
-		divetime / 60, divetime % 60);
+	xml_puts (writer, "<divetime>");
+	xml_uint (writer, divetime / 60, 2);
+	xml_puts (writer, ":");
+	xml_uint (writer, divetime % 60, 2);
+	xml_puts (writer, "</divetime>\n");
 
 	// Parse the maxdepth.
 	message ("Parsing the maxdepth.\n");
@@ -255,8 +508,9 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 		goto cleanup;
 	}
 
-	fprintf (output->ostream, "<maxdepth>%.2f</maxdepth>\n",
-		convert_depth(maxdepth, output->units));
+	xml_puts (writer, "<maxdepth>");
+	xml_fixed (writer, convert_depth(maxdepth, units), 2);
+	xml_puts (writer, "</maxdepth>\n");
 
 	// Parse the temperature.
 	message ("Parsing the temperature.\n");
@@ -274,9 +528,11 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 		}
 
 		if (status != DC_STATUS_UNSUPPORTED) {
-			fprintf (output->ostream, "<temperature type=\"%s\">%.1f</temperature>\n",
-				names[i],
-				convert_temperature(temperature, output->units));
+			xml_puts (writer, "<temperature type=\"");
+			xml_puts (writer, names[i]);
+			xml_puts (writer, "\">");
+			xml_fixed (writer, convert_temperature(temperature, units), 1);
+			xml_puts (writer, "</temperature>\n");
 		}
 	}
 
@@ -297,15 +553,13 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 			goto cleanup;
 		}
 
-		fprintf (output->ostream,
-			"<gasmix>\n"
-			"   <he>%.1f</he>\n"
-			"   <o2>%.1f</o2>\n"
-			"   <n2>%.1f</n2>\n"
-			"</gasmix>\n",
-			gasmix.helium * 100.0,
-			gasmix.oxygen * 100.0,
-			gasmix.nitrogen * 100.0);
+		xml_puts (writer, "<gasmix>\n   <he>");
+		xml_fixed (writer, gasmix.helium * 100.0, 1);
+		xml_puts (writer, "</he>\n   <o2>");
+		xml_fixed (writer, gasmix.oxygen * 100.0, 1);
+		xml_puts (writer, "</o2>\n   <n2>");
+		xml_fixed (writer, gasmix.nitrogen * 100.0, 1);
+		xml_puts (writer, "</n2>\n</gasmix>\n");
 	}
 
 	// Parse the tanks.
@@ -327,27 +581,26 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 			goto cleanup;
 		}
 
-		fprintf (output->ostream, "<tank>\n");
+		xml_puts (writer, "<tank>\n");
 		if (tank.gasmix != DC_GASMIX_UNKNOWN) {
-			fprintf (output->ostream,
-				"   <gasmix>%u</gasmix>\n",
-				tank.gasmix);
+			xml_puts (writer, "   <gasmix>");
+			xml_uint (writer, tank.gasmix, 0);
+			xml_puts (writer, "</gasmix>\n");
 		}
 		if (tank.type != DC_TANKVOLUME_NONE) {
-			fprintf (output->ostream,
-				"   <type>%s</type>\n"
-				"   <volume>%.1f</volume>\n"
-				"   <workpressure>%.2f</workpressure>\n",
-				names[tank.type],
-				convert_volume(tank.volume, output->units),
-				convert_pressure(tank.workpressure, output->units));
+			xml_puts (writer, "   <type>");
+			xml_puts (writer, names[tank.type]);
+			xml_puts (writer, "</type>\n   <volume>");
+			xml_fixed (writer, convert_volume(tank.volume, units), 1);
+			xml_puts (writer, "</volume>\n   <workpressure>");
+			xml_fixed (writer, convert_pressure(tank.workpressure, units), 2);
+			xml_puts (writer, "</workpressure>\n");
 		}
-		fprintf (output->ostream,
-			"   <beginpressure>%.2f</beginpressure>\n"
-			"   <endpressure>%.2f</endpressure>\n"
-			"</tank>\n",
-			convert_pressure(tank.beginpressure, output->units),
-			convert_pressure(tank.endpressure, output->units));
+		xml_puts (writer, "   <beginpressure>");
+		xml_fixed (writer, convert_pressure(tank.beginpressure, units), 2);
+		xml_puts (writer, "</beginpressure>\n   <endpressure>");
+		xml_fixed (writer, convert_pressure(tank.endpressure, units), 2);
+		xml_puts (writer, "</endpressure>\n</tank>\n");
 	}
 
 	// Parse the dive mode.
@@ -361,8 +614,9 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 
 	if (status != DC_STATUS_UNSUPPORTED) {
 		const char *names[] = {"freedive", "gauge", "oc", "cc"};
-		fprintf (output->ostream, "<divemode>%s</divemode>\n",
-			names[divemode]);
+		xml_puts (writer, "<divemode>");
+		xml_puts (writer, names[divemode]);
+		xml_puts (writer, "</divemode>\n");
 	}
 
 	// Parse the salinity.
@@ -375,8 +629,11 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	}
 
 	if (status != DC_STATUS_UNSUPPORTED) {
-		fprintf (output->ostream, "<salinity type=\"%u\">%.1f</salinity>\n",
-			salinity.type, salinity.density);
+		xml_puts (writer, "<salinity type=\"");
+		xml_uint (writer, salinity.type, 0);
+		xml_puts (writer, "\">");
+		xml_fixed (writer, salinity.density, 1);
+		xml_puts (writer, "</salinity>\n");
 	}
 
 	// Parse the atmospheric pressure.
@@ -389,8 +646,9 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 	}
 
 	if (status != DC_STATUS_UNSUPPORTED) {
-		fprintf (output->ostream, "<atmospheric>%.5f</atmospheric>\n",
-			convert_pressure(atmospheric, output->units));
+		xml_puts (writer, "<atmospheric>");
+		xml_fixed (writer, convert_pressure(atmospheric, units), 5);
+		xml_puts (writer, "</atmospheric>\n");
 	}
 
 	message ("Parsing strings.\n");
@@ -404,10 +662,16 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 		}
 		if (status == DC_STATUS_UNSUPPORTED)
 			break;
-		if (!str.desc || !str.value)
+		if (!str.desc || !str.value) {
+			free ((void *) str.value);
 			break;
-		fprintf (output->ostream, "<extradata key='%s' value='%s' />\n",
-			str.desc, str.value);
+		}
+		xml_puts (writer, "<extradata key='");
+		xml_puts (writer, str.desc);
+		xml_puts (writer, "' value='");
+		xml_puts (writer, str.value);
+		xml_puts (writer, "' />\n");
+		free ((void *) str.value);
 
 	}
 
@@ -422,20 +686,66 @@ dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const u
 cleanup:
 
 	if (sampledata.nsamples)
-		fprintf (output->ostream, "</sample>\n");
-	fprintf (output->ostream, "</dive>\n");
+		xml_puts (writer, "</sample>\n");
+	xml_puts (writer, "</dive>\n");
+
+	return status;
+}
+
+static dc_status_t
+dctool_xml_output_write (dctool_output_t *abstract, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize)
+{
+	dctool_xml_output_t *output = (dctool_xml_output_t *) abstract;
+
+	return xml_write_dive (&output->writer, output->units, abstract->number, parser, data, size, fingerprint, fsize);
+}
+
+static dc_status_t
+dctool_xml_output_format (dctool_output_t *abstract, unsigned int number, dc_parser_t *parser, const unsigned char data[], unsigned int size, const unsigned char fingerprint[], unsigned int fsize, dc_buffer_t *buffer)
+{
+	dctool_xml_output_t *output = (dctool_xml_output_t *) abstract;
+
+	// Each call uses its own writer, to allow formatting several dives
+	// at the same time.
+	xml_writer_t *writer = (xml_writer_t *) malloc (sizeof (xml_writer_t));
+	if (writer == NULL) {
+		ERROR ("Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	writer->ostream = NULL;
+	writer->memory = buffer;
+	writer->size = 0;
+
+	dc_status_t status = xml_write_dive (writer, output->units, number, parser, data, size, fingerprint, fsize);
+
+	xml_flush (writer);
+
+	free (writer);
 
 	return status;
 }
 
+static dc_status_t
+dctool_xml_output_append (dctool_output_t *abstract, const unsigned char data[], size_t size)
+{
+	dctool_xml_output_t *output = (dctool_xml_output_t *) abstract;
+
+	xml_write (&output->writer, (const char *) data, size);
+
+	return DC_STATUS_SUCCESS;
+}
+
 static dc_status_t
 dctool_xml_output_free (dctool_output_t *abstract)
 {
 	dctool_xml_output_t *output = (dctool_xml_output_t *) abstract;
 
-	fprintf (output->ostream, "</device>\n");
+	xml_puts (&output->writer, "</device>\n");
+
+	xml_flush (&output->writer);
 
-	fclose (output->ostream);
+	fclose (output->writer.ostream);
 
 	return DC_STATUS_SUCCESS;
 }
@@ -0,0 +1,47 @@
+#!/bin/sh
+#
+# Replay the recorded transcripts with the bench-download command, and
+# check that all dives arrive, without any unexpected writes. Backends
+# without a descriptor in this build (e.g. the USB HID devices without
+# libusb or hidapi) are skipped.
+#
+
+DCTOOL=./dctool
+TRANSCRIPTS=${srcdir:-.}/transcripts
+
+TMPDIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMPDIR"' EXIT
+
+failed=0
+passed=0
+
+check ()
+{
+	name=$1
+	family=$2
+	packetsize=$3
+	ndives=$4
+
+	$DCTOOL -f $family bench-download -s $packetsize "$TRANSCRIPTS/$name.txt" > "$TMPDIR/$name.log" 2>&1
+	rc=$?
+
+	if grep -q "No supported device found" "$TMPDIR/$name.log"; then
+		echo "SKIP: $name"
+	elif [ $rc -ne 0 ] || ! grep -q "^Dives: *$ndives\$" "$TMPDIR/$name.log" || ! grep -q "^Mismatches: *0\$" "$TMPDIR/$name.log"; then
+		echo "FAIL: $name"
+		cat "$TMPDIR/$name.log"
+		failed=1
+	else
+		echo "PASS: $name"
+		passed=1
+	fi
+}
+
+check suunto_d9 d9 0 1
+check scubapro_g2 g2 64 2
+
+if [ $failed -eq 0 ] && [ $passed -eq 0 ]; then
+	exit 77
+fi
+
+exit $failed
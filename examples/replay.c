@@ -0,0 +1,421 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define NOGDI
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <libdivecomputer/buffer.h>
+
+#include "replay.h"
+#include "common.h"
+#include "utils.h"
+
+typedef struct dctool_replay_record_t {
+	dc_trace_t type;
+	size_t offset;
+	size_t size;
+} dctool_replay_record_t;
+
+struct dctool_replay_t {
+	dc_custom_io_t io;
+	unsigned int packetsize;
+	// Transcript data.
+	dc_buffer_t *data;
+	dctool_replay_record_t *records;
+	size_t nrecords;
+	// Current position.
+	size_t index;
+	size_t offset;
+	// Latency model (microseconds).
+	unsigned int byte;
+	unsigned int roundtrip;
+	dc_trace_t last;
+	dctool_replay_stats_t stats;
+};
+
+static int
+replay_hexdigit (unsigned char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
+static void
+replay_sleep (unsigned long long microseconds)
+{
+	if (microseconds == 0)
+		return;
+
+#ifdef _WIN32
+	Sleep ((DWORD) ((microseconds + 999) / 1000));
+#else
+	struct timespec ts;
+	ts.tv_sec  = microseconds / 1000000;
+	ts.tv_nsec = (microseconds % 1000000) * 1000;
+	while (nanosleep (&ts, &ts) != 0) {
+		/* Retry after an interruption. */
+	}
+#endif
+}
+
+/*
+ * Apply the latency model. The round-trip latency is added once for
+ * every change of direction from writing to reading.
+ */
+static void
+replay_delay (dctool_replay_t *replay, dc_trace_t type, size_t nbytes)
+{
+	unsigned long long delay = (unsigned long long) replay->byte * nbytes;
+
+	if (type == DC_TRACE_READ && replay->last == DC_TRACE_WRITE) {
+		replay->stats.roundtrips++;
+		delay += replay->roundtrip;
+	}
+
+	replay->last = type;
+
+	replay_sleep (delay);
+}
+
+static dc_status_t
+replay_parse (dctool_replay_t *replay, const unsigned char data[], size_t size)
+{
+	size_t capacity = 0;
+
+	size_t i = 0;
+	while (i < size) {
+		// Find the end of the line.
+		size_t eol = i;
+		while (eol < size && data[eol] != '\n')
+			eol++;
+
+		const unsigned char *line = data + i;
+		size_t length = eol - i;
+		i = eol + 1;
+
+		// Skip empty lines and comments.
+		if (length == 0 || line[0] == '#' || line[0] == '\r')
+			continue;
+
+		// Skip the timestamp.
+		size_t n = 0;
+		while (n < length && line[n] != ' ')
+			n++;
+		if (n + 2 > length || line[n + 2] != ' ') {
+			message ("Invalid transcript line.\n");
+			return DC_STATUS_DATAFORMAT;
+		}
+
+		dc_trace_t type;
+		if (line[n + 1] == 'R') {
+			type = DC_TRACE_READ;
+		} else if (line[n + 1] == 'W') {
+			type = DC_TRACE_WRITE;
+		} else {
+			message ("Invalid transcript direction.\n");
+			return DC_STATUS_DATAFORMAT;
+		}
+
+		if (replay->nrecords == capacity) {
+			size_t newcapacity = capacity ? capacity * 2 : 256;
+			dctool_replay_record_t *records = (dctool_replay_record_t *) realloc (replay->records, newcapacity * sizeof (*records));
+			if (records == NULL)
+				return DC_STATUS_NOMEMORY;
+			replay->records = records;
+			capacity = newcapacity;
+		}
+
+		dctool_replay_record_t *record = replay->records + replay->nrecords;
+		record->type = type;
+		record->offset = dc_buffer_get_size (replay->data);
+		record->size = 0;
+
+		// Convert the hexadecimal data to binary.
+		for (size_t j = n + 3; j + 1 < length; j += 2) {
+			int msn = replay_hexdigit (line[j]);
+			int lsn = replay_hexdigit (line[j + 1]);
+			if (msn < 0 || lsn < 0)
+				break;
+
+			unsigned char byte = (msn << 4) | lsn;
+			if (!dc_buffer_append (replay->data, &byte, 1))
+				return DC_STATUS_NOMEMORY;
+
+			record->size++;
+		}
+
+		replay->nrecords++;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+replay_read (dc_custom_io_t *io, void *data, size_t size, size_t *actual)
+{
+	dctool_replay_t *replay = (dctool_replay_t *) io->userdata;
+	const unsigned char *buffer = dc_buffer_get_data (replay->data);
+	dc_status_t status = DC_STATUS_SUCCESS;
+
+	size_t nbytes = 0;
+	while (nbytes < size && replay->index < replay->nrecords) {
+		const dctool_replay_record_t *record = replay->records + replay->index;
+		if (record->type != DC_TRACE_READ)
+			break;
+
+		size_t available = record->size - replay->offset;
+		size_t len = size - nbytes;
+		if (len > available)
+			len = available;
+
+		memcpy ((unsigned char *) data + nbytes, buffer + record->offset + replay->offset, len);
+		replay->offset += len;
+		nbytes += len;
+
+		// Move to the next record. In packet mode, a read never
+		// crosses a record boundary.
+		if (replay->offset == record->size || replay->packetsize) {
+			replay->index++;
+			replay->offset = 0;
+		}
+
+		if (replay->packetsize)
+			break;
+	}
+
+	if (nbytes == 0 || (nbytes != size && replay->packetsize == 0))
+		status = DC_STATUS_TIMEOUT;
+
+	replay_delay (replay, DC_TRACE_READ, nbytes);
+
+	replay->stats.nread += nbytes;
+
+	if (actual)
+		*actual = nbytes;
+
+	return status;
+}
+
+static dc_status_t
+replay_write (dc_custom_io_t *io, const void *data, size_t size, size_t *actual)
+{
+	dctool_replay_t *replay = (dctool_replay_t *) io->userdata;
+	const unsigned char *buffer = dc_buffer_get_data (replay->data);
+
+	// Discard the data that was not read by the driver.
+	while (replay->index < replay->nrecords &&
+		replay->records[replay->index].type == DC_TRACE_READ) {
+		replay->index++;
+		replay->offset = 0;
+	}
+
+	size_t nbytes = 0;
+	while (nbytes < size && replay->index < replay->nrecords) {
+		const dctool_replay_record_t *record = replay->records + replay->index;
+		if (record->type != DC_TRACE_WRITE)
+			break;
+
+		size_t available = record->size - replay->offset;
+		size_t len = size - nbytes;
+		if (len > available)
+			len = available;
+
+		if (memcmp ((const unsigned char *) data + nbytes, buffer + record->offset + replay->offset, len) != 0)
+			replay->stats.mismatches++;
+
+		replay->offset += len;
+		nbytes += len;
+
+		if (replay->offset == record->size || replay->packetsize) {
+			replay->index++;
+			replay->offset = 0;
+		}
+
+		if (replay->packetsize)
+			break;
+	}
+
+	// The data was not recorded, but the device is assumed
+	// to accept the data anyway.
+	if (nbytes != size) {
+		replay->stats.mismatches++;
+	}
+
+	replay_delay (replay, DC_TRACE_WRITE, size);
+
+	replay->stats.nwritten += size;
+
+	if (actual)
+		*actual = size;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+replay_get_available (dc_custom_io_t *io, size_t *value)
+{
+	dctool_replay_t *replay = (dctool_replay_t *) io->userdata;
+
+	size_t available = 0;
+	size_t offset = replay->offset;
+	for (size_t i = replay->index; i < replay->nrecords; ++i) {
+		if (replay->records[i].type != DC_TRACE_READ)
+			break;
+		available += replay->records[i].size - offset;
+		offset = 0;
+	}
+
+	if (value)
+		*value = available;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+replay_open (dc_custom_io_t *io, dc_context_t *context, const char *name)
+{
+	dctool_replay_t *replay = (dctool_replay_t *) io->userdata;
+
+	replay->index = 0;
+	replay->offset = 0;
+	replay->last = DC_TRACE_READ;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+replay_close (dc_custom_io_t *io)
+{
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dctool_replay_new (dctool_replay_t **out, const char *filename, unsigned int packetsize)
+{
+	dc_status_t status = DC_STATUS_SUCCESS;
+	dctool_replay_t *replay = NULL;
+	dc_buffer_t *transcript = NULL;
+
+	if (out == NULL || filename == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	replay = (dctool_replay_t *) malloc (sizeof (dctool_replay_t));
+	if (replay == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	memset (replay, 0, sizeof (*replay));
+	replay->packetsize = packetsize;
+	replay->last = DC_TRACE_READ;
+
+	replay->io.userdata = replay;
+	if (packetsize) {
+		replay->io.packet_size = packetsize;
+		replay->io.packet_open = replay_open;
+		replay->io.packet_close = replay_close;
+		replay->io.packet_read = replay_read;
+		replay->io.packet_write = replay_write;
+	} else {
+		replay->io.serial_open = replay_open;
+		replay->io.serial_close = replay_close;
+		replay->io.serial_read = replay_read;
+		replay->io.serial_write = replay_write;
+		replay->io.serial_get_available = replay_get_available;
+	}
+
+	replay->data = dc_buffer_new (0);
+	if (replay->data == NULL) {
+		status = DC_STATUS_NOMEMORY;
+		goto error;
+	}
+
+	transcript = dctool_file_read (filename);
+	if (transcript == NULL) {
+		message ("Failed to read the transcript file.\n");
+		status = DC_STATUS_IO;
+		goto error;
+	}
+
+	status = replay_parse (replay, dc_buffer_get_data (transcript), dc_buffer_get_size (transcript));
+	if (status != DC_STATUS_SUCCESS)
+		goto error;
+
+	dc_buffer_free (transcript);
+
+	*out = replay;
+
+	return DC_STATUS_SUCCESS;
+
+error:
+	dc_buffer_free (transcript);
+	dctool_replay_free (replay);
+	return status;
+}
+
+void
+dctool_replay_set_latency (dctool_replay_t *replay, unsigned int byte, unsigned int roundtrip)
+{
+	if (replay == NULL)
+		return;
+
+	replay->byte = byte;
+	replay->roundtrip = roundtrip;
+}
+
+dc_status_t
+dctool_replay_register (dctool_replay_t *replay, dc_context_t *context)
+{
+	if (replay == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	return dc_context_set_custom_io (context, &replay->io, NULL);
+}
+
+void
+dctool_replay_get_stats (dctool_replay_t *replay, dctool_replay_stats_t *stats)
+{
+	if (replay == NULL || stats == NULL)
+		return;
+
+	*stats = replay->stats;
+}
+
+void
+dctool_replay_free (dctool_replay_t *replay)
+{
+	if (replay == NULL)
+		return;
+
+	dc_buffer_free (replay->data);
+	free (replay->records);
+	free (replay);
+}
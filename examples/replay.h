@@ -0,0 +1,66 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DCTOOL_REPLAY_H
+#define DCTOOL_REPLAY_H
+
+#include <libdivecomputer/common.h>
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/custom_io.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct dctool_replay_t dctool_replay_t;
+
+typedef struct dctool_replay_stats_t {
+	unsigned int roundtrips;
+	unsigned int mismatches;
+	unsigned long long nread;
+	unsigned long long nwritten;
+} dctool_replay_stats_t;
+
+/*
+ * Replay a transcript (as recorded with the dctool --transcript option)
+ * as a custom I/O backend. With a zero packet size, the transcript is
+ * replayed as a serial byte stream. Otherwise, every record is replayed
+ * as a single packet of at most that size.
+ */
+dc_status_t
+dctool_replay_new (dctool_replay_t **replay, const char *filename, unsigned int packetsize);
+
+void
+dctool_replay_set_latency (dctool_replay_t *replay, unsigned int byte, unsigned int roundtrip);
+
+dc_status_t
+dctool_replay_register (dctool_replay_t *replay, dc_context_t *context);
+
+void
+dctool_replay_get_stats (dctool_replay_t *replay, dctool_replay_stats_t *stats);
+
+void
+dctool_replay_free (dctool_replay_t *replay);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DCTOOL_REPLAY_H */
@@ -0,0 +1,118 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_ARCHIVE_H
+#define DC_ARCHIVE_H
+
+#include <stddef.h>
+
+#include "common.h"
+#include "context.h"
+#include "buffer.h"
+#include "datetime.h"
+#include "parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Dive archive
+ *
+ * A compact binary file with the parsed dives: the header fields and
+ * the samples of each dive, in chronological order, with an index to
+ * look up the dives by fingerprint or date/time. The samples are stored
+ * in the same order as reported by the parser, and all values are
+ * restored exactly. Each dive has a checksum, and a corrupt dive is
+ * reported as DC_STATUS_DATAFORMAT without affecting the other dives.
+ *
+ * The archive is read directly from the memory passed to
+ * dc_archive_open, without copying or decoding it first, so a memory
+ * mapped file can be opened instantly. The memory must remain valid
+ * until the archive is closed.
+ */
+
+#define DC_ARCHIVE_NONE 0xFFFFFFFF
+
+typedef struct dc_archive_t dc_archive_t;
+typedef struct dc_archive_writer_t dc_archive_writer_t;
+
+dc_status_t
+dc_archive_writer_new (dc_archive_writer_t **writer, dc_context_t *context);
+
+dc_status_t
+dc_archive_writer_add (dc_archive_writer_t *writer, dc_parser_t *parser, const unsigned char fingerprint[], unsigned int fsize);
+
+/*
+ * Copy a dive from an existing archive, without decoding it.
+ */
+dc_status_t
+dc_archive_writer_copy (dc_archive_writer_t *writer, dc_archive_t *archive, unsigned int index);
+
+dc_status_t
+dc_archive_writer_finish (dc_archive_writer_t *writer, dc_buffer_t *buffer);
+
+dc_status_t
+dc_archive_writer_free (dc_archive_writer_t *writer);
+
+dc_status_t
+dc_archive_open (dc_archive_t **archive, dc_context_t *context, const unsigned char data[], size_t size);
+
+unsigned int
+dc_archive_get_count (dc_archive_t *archive);
+
+dc_status_t
+dc_archive_find_fingerprint (dc_archive_t *archive, const unsigned char fingerprint[], unsigned int fsize, unsigned int *index);
+
+dc_status_t
+dc_archive_find_datetime (dc_archive_t *archive, const dc_datetime_t *datetime, unsigned int *index);
+
+dc_status_t
+dc_archive_get_fingerprint (dc_archive_t *archive, unsigned int index, const unsigned char **fingerprint, unsigned int *fsize);
+
+/*
+ * Check the checksums of a dive, without decoding it. The fields and
+ * samples are checked when they are used as well, but this detects a
+ * corrupt dive before anything is reported.
+ */
+dc_status_t
+dc_archive_verify (dc_archive_t *archive, unsigned int index);
+
+dc_status_t
+dc_archive_get_datetime (dc_archive_t *archive, unsigned int index, dc_datetime_t *datetime);
+
+/*
+ * Get a field of a dive. Unlike with a parser, the string values point
+ * into the archive data, and must not be freed.
+ */
+dc_status_t
+dc_archive_get_field (dc_archive_t *archive, unsigned int index, dc_field_type_t type, unsigned int flags, void *value);
+
+dc_status_t
+dc_archive_samples_foreach (dc_archive_t *archive, unsigned int index, dc_sample_callback_t callback, void *userdata);
+
+dc_status_t
+dc_archive_close (dc_archive_t *archive);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_ARCHIVE_H */
@@ -0,0 +1,94 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_CACHE_H
+#define DC_CACHE_H
+
+#include <stddef.h>
+
+#include "common.h"
+#include "context.h"
+#include "buffer.h"
+#include "descriptor.h"
+#include "parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Parsed dive cache
+ *
+ * A content addressed cache of parsed dives, to avoid decoding the
+ * same raw dive data again. The key of a dive is a 128 bit hash of the
+ * device family, model and serial number, the device and system time,
+ * the library version and the raw dive data. The parsed dives are
+ * stored in the dive archive format (see archive.h), and the whole
+ * cache is a single file, which can be memory mapped.
+ *
+ * The parsers returned by dc_cache_parser_new are used like any other
+ * parser, but read the dive from the cache, with the values rounded to
+ * the resolution of the archive. A dive which is not in the cache yet
+ * is parsed once, and added to the cache. Those new dives are kept in
+ * memory, until dc_cache_write serializes the updated cache.
+ *
+ * The memory passed to dc_cache_new must remain valid, and the parsers
+ * must be destroyed, before the cache is freed. The cache functions
+ * are not thread-safe.
+ */
+
+typedef struct dc_cache_t dc_cache_t;
+
+/*
+ * Open the cache from the contents of a cache file, or an empty cache
+ * if the size is zero. An outdated or corrupt cache is replaced with
+ * an empty one.
+ */
+dc_status_t
+dc_cache_new (dc_cache_t **cache, dc_context_t *context, const unsigned char data[], size_t size);
+
+/*
+ * Create a parser for the raw dive data. The data doesn't need to
+ * remain valid after the call.
+ */
+dc_status_t
+dc_cache_parser_new (dc_parser_t **parser, dc_cache_t *cache, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, const unsigned char data[], unsigned int size);
+
+/*
+ * Get the number of dives found in the cache, and the number of dives
+ * which had to be parsed.
+ */
+dc_status_t
+dc_cache_get_stats (dc_cache_t *cache, unsigned int *hits, unsigned int *misses);
+
+/*
+ * Write the contents of the cache (the existing and the new dives).
+ */
+dc_status_t
+dc_cache_write (dc_cache_t *cache, dc_buffer_t *buffer);
+
+dc_status_t
+dc_cache_free (dc_cache_t *cache);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_CACHE_H */
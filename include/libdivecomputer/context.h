@@ -43,8 +43,15 @@ typedef enum dc_loglevel_t {
 	DC_LOGLEVEL_ALL
 } dc_loglevel_t;
 
+typedef enum dc_trace_t {
+	DC_TRACE_READ,
+	DC_TRACE_WRITE
+} dc_trace_t;
+
 typedef void (*dc_logfunc_t) (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *message, void *userdata);
 
+typedef void (*dc_tracefunc_t) (dc_context_t *context, dc_trace_t type, unsigned long long timestamp, const unsigned char data[], unsigned int size, const char *file, unsigned int line, const char *function, void *userdata);
+
 dc_status_t
 dc_context_new (dc_context_t **context);
 
@@ -54,12 +61,21 @@ dc_context_free (dc_context_t *context);
 dc_status_t
 dc_context_set_custom_io (dc_context_t *context, dc_custom_io_t *custom_io, dc_user_device_t *);
 
+dc_status_t
+dc_context_set_timing (dc_context_t *context, const char *name, unsigned int value);
+
 dc_status_t
 dc_context_set_loglevel (dc_context_t *context, dc_loglevel_t loglevel);
 
 dc_status_t
 dc_context_set_logfunc (dc_context_t *context, dc_logfunc_t logfunc, void *userdata);
 
+dc_status_t
+dc_context_set_trace (dc_context_t *context, unsigned int size);
+
+dc_status_t
+dc_context_get_trace (dc_context_t *context, dc_tracefunc_t tracefunc, void *userdata);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
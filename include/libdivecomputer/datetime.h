@@ -22,6 +22,8 @@
 #ifndef DC_DATETIME_H
 #define DC_DATETIME_H
 
+#include "common.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -55,6 +57,26 @@ dc_datetime_gmtime (dc_datetime_t *result,
 dc_ticks_t
 dc_datetime_mktime (const dc_datetime_t *dt);
 
+/*
+ * The inverse of dc_datetime_gmtime. Out of range fields are normalized,
+ * like with dc_datetime_mktime.
+ */
+dc_ticks_t
+dc_datetime_timegm (const dc_datetime_t *dt);
+
+/*
+ * Convert an array of timestamps at once. The local time conversion
+ * looks up the UTC offsets of the local time zone only once for each
+ * period without a daylight saving time transition, instead of for
+ * every timestamp, which is much faster for a large number of dives.
+ */
+
+dc_status_t
+dc_datetime_localtime_batch (dc_datetime_t result[], const dc_ticks_t ticks[], unsigned int count);
+
+dc_status_t
+dc_datetime_gmtime_batch (dc_datetime_t result[], const dc_ticks_t ticks[], unsigned int count);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -63,12 +63,43 @@ typedef struct dc_event_vendor_t {
 	unsigned int size;
 } dc_event_vendor_t;
 
+typedef enum dc_stats_class_t {
+	DC_STATS_READ,
+	DC_STATS_WRITE,
+	DC_STATS_COMMAND,
+	DC_STATS_NCLASSES
+} dc_stats_class_t;
+
+#define DC_STATS_NBUCKETS 16
+
+/*
+ * Transfer statistics.
+ *
+ * The read and write classes cover the individual transport operations,
+ * the command class covers the complete command/response exchanges of
+ * the protocol. All times are in microseconds. Bucket 0 of the latency
+ * histogram counts the transfers below 1 ms, bucket n (n > 0) those
+ * between 2^(n-1) and 2^n ms, and the last bucket everything above.
+ */
+typedef struct dc_stats_t {
+	unsigned long long nread;
+	unsigned long long nwritten;
+	unsigned int ntransfers;
+	unsigned int nretries;
+	unsigned int ntimeouts;
+	unsigned long long sleeping;
+	unsigned long long waiting;
+	unsigned int histogram[DC_STATS_NCLASSES][DC_STATS_NBUCKETS];
+} dc_stats_t;
+
 typedef int (*dc_cancel_callback_t) (void *userdata);
 
 typedef void (*dc_event_callback_t) (dc_device_t *device, dc_event_type_t event, const void *data, void *userdata);
 
 typedef int (*dc_dive_callback_t) (const unsigned char *data, unsigned int size, const unsigned char *fingerprint, unsigned int fsize, void *userdata);
 
+typedef void (*dc_timing_callback_t) (const char *name, unsigned int value, unsigned int minimum, unsigned int maximum, void *userdata);
+
 dc_status_t
 dc_device_open (dc_device_t **out, dc_context_t *context, dc_descriptor_t *descriptor, const char *name);
 
@@ -81,9 +112,27 @@ dc_device_set_cancel (dc_device_t *device, dc_cancel_callback_t callback, void *
 dc_status_t
 dc_device_set_events (dc_device_t *device, unsigned int events, dc_event_callback_t callback, void *userdata);
 
+dc_status_t
+dc_device_set_progress (dc_device_t *device, unsigned int interval, unsigned int delta);
+
 dc_status_t
 dc_device_set_fingerprint (dc_device_t *device, const unsigned char data[], unsigned int size);
 
+dc_status_t
+dc_device_set_timing (dc_device_t *device, const char *name, unsigned int value);
+
+dc_status_t
+dc_device_get_timing (dc_device_t *device, const char *name, unsigned int *value);
+
+dc_status_t
+dc_device_timing_foreach (dc_device_t *device, dc_timing_callback_t callback, void *userdata);
+
+dc_status_t
+dc_device_get_stats (dc_device_t *device, dc_stats_t *stats);
+
+dc_status_t
+dc_device_reset_stats (dc_device_t *device);
+
 dc_status_t
 dc_device_version (dc_device_t *device, unsigned char data[], unsigned int size);
 
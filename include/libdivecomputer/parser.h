@@ -199,11 +199,41 @@ typedef struct dc_tank_t {
     double endpressure;   /* End pressure (bar) */
 } dc_tank_t;
 
+/*
+ * String field
+ *
+ * The description is a static string, but the value is allocated by
+ * the parser, and must be freed by the caller with free().
+ */
+
 typedef struct dc_field_string_t {
 	const char *desc;
 	const char *value;
 } dc_field_string_t;
 
+/*
+ * Downsampled profile
+ *
+ * The dive is divided into buckets of equal duration, and the depth and
+ * temperature samples inside each bucket are summarized by their
+ * minimum, maximum and mean value. The count is zero if the bucket has
+ * no samples of that type, and the other values are zero as well.
+ */
+
+typedef struct dc_sample_summary_t {
+	unsigned int count;
+	double minimum;
+	double maximum;
+	double mean;
+} dc_sample_summary_t;
+
+typedef struct dc_sample_bucket_t {
+	unsigned int begin; /* Start time (seconds) */
+	unsigned int end;   /* End time (seconds), exclusive */
+	dc_sample_summary_t depth;       /* Depth (meters) */
+	dc_sample_summary_t temperature; /* Temperature (Celsius) */
+} dc_sample_bucket_t;
+
 typedef union dc_sample_value_t {
 	unsigned int time;
 	double depth;
@@ -263,6 +293,12 @@ dc_parser_get_field (dc_parser_t *parser, dc_field_type_t type, unsigned int fla
 dc_status_t
 dc_parser_samples_foreach (dc_parser_t *parser, dc_sample_callback_t callback, void *userdata);
 
+dc_status_t
+dc_parser_samples_range (dc_parser_t *parser, unsigned int begin, unsigned int end, dc_sample_callback_t callback, void *userdata);
+
+dc_status_t
+dc_parser_samples_decimated (dc_parser_t *parser, dc_sample_bucket_t buckets[], unsigned int nbuckets);
+
 dc_status_t
 dc_parser_destroy (dc_parser_t *parser);
 
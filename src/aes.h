@@ -23,6 +23,12 @@ typedef unsigned int  uint32_t;
   #define ECB 1
 #endif
 
+// CFB enables AES128 decryption in CFB-mode (128 bit segments), with the
+// round keys expanded only once for the whole stream.
+#ifndef CFB
+  #define CFB 1
+#endif
+
 
 
 #if defined(ECB) && ECB
@@ -41,5 +47,19 @@ void AES128_CBC_decrypt_buffer(uint8_t* output, uint8_t* input, uint32_t length,
 #endif // #if defined(CBC) && CBC
 
 
+#if defined(CFB) && CFB
+
+typedef struct AES128_CFB_t {
+  uint32_t RoundKey[44];
+  uint8_t Stream[16];
+} AES128_CFB_t;
+
+void AES128_CFB_init(AES128_CFB_t* cfb, const uint8_t* key, const uint8_t* iv);
+// The length must be a multiple of 16 bytes, except for the last call.
+void AES128_CFB_decrypt_buffer(AES128_CFB_t* cfb, uint8_t* output, const uint8_t* input, uint32_t length);
+
+#endif // #if defined(CFB) && CFB
+
+
 
 #endif //_AES_H_
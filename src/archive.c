@@ -0,0 +1,1744 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include <libdivecomputer/archive.h>
+
+#include "context-private.h"
+#include "array.h"
+#include "hash.h"
+
+/*
+ * File layout (all fixed size integers are little endian):
+ *
+ *   header    "DCAR", version, number of dives, offset of the index
+ *   dives     one block per dive, in chronological order
+ *   index     per dive: offset, size, 64 bit date/time key and checksums
+ *   lookup    per dive: the dive index, sorted by fingerprint
+ *
+ * A dive block is a header block (fingerprint, date/time and fields)
+ * followed by the samples. The sample values are stored in columns, one
+ * for each sample type, as varints or zigzag encoded deltas with the
+ * previous value of the column. The floating point values are stored
+ * in a fixed resolution, with a flag to store the raw IEEE 754 value
+ * as well if the parser reported a value with a higher precision, so
+ * all values are restored exactly. The order in which the parser reported
+ * them is restored from the sequence of sample types between two time
+ * samples (a "shape"). A dive usually has only a handful of different
+ * shapes, so each group is stored as a single shape number.
+ *
+ * The dive header and the samples have a separate checksum (the lower 32
+ * bits of their xxHash), so the fields can be read without hashing all
+ * the samples. A dive with a wrong checksum is reported as corrupt when
+ * it's used, but the other dives remain available.
+ */
+
+#define ARCHIVE_MAGIC "DCAR"
+#define ARCHIVE_VERSION 3
+
+#define SZ_HEADER 16
+#define SZ_ENTRY  24
+#define SZ_LOOKUP 4
+
+// Offset of the checksums in the index entry.
+#define CHECKSUM_HEADER  16
+#define CHECKSUM_SAMPLES 20
+
+#define NSAMPLETYPES (DC_SAMPLE_GASMIX + 1)
+
+// The integer sample types stored as the delta with the previous value.
+#define DELTA_TYPES ( \
+	(1u << DC_SAMPLE_TIME) | (1u << DC_SAMPLE_RBT) | \
+	(1u << DC_SAMPLE_HEARTBEAT) | (1u << DC_SAMPLE_BEARING))
+
+// Resolution of the stored values. A value with a higher precision is
+// stored as the raw double.
+#define DEPTH       1000.0   /* Millimeter */
+#define TEMPERATURE 100.0    /* 0.01 degrees Celsius */
+#define PRESSURE    1000.0   /* Millibar */
+#define VOLUME      1000.0   /* Milliliter */
+#define FRACTION    10000.0  /* 0.01 percent */
+#define DENSITY     10.0     /* 0.1 kg/m3 */
+#define ATMOSPHERIC 100000.0 /* Pascal */
+
+// Valid range of the enums and bitmasks. A value outside this range is
+// refused by the writer, and treated as a corrupt block by the reader.
+#define NWATERTYPES (DC_WATER_SALT + 1)
+#define NDIVEMODES  (DC_DIVEMODE_CC + 1)
+#define NEVENTS     (SAMPLE_EVENT_STRING + 1)
+#define NVENDORS    (SAMPLE_VENDOR_OCEANIC_ATOM2 + 1)
+#define NDECOTYPES  (DC_DECO_DEEPSTOP + 1)
+#define EVENT_FLAGS (SAMPLE_FLAGS_BEGIN | SAMPLE_FLAGS_END | SAMPLE_FLAGS_SEVERITY_MASK)
+#define TANKINFO    (DC_TANKINFO_METRIC | DC_TANKINFO_IMPERIAL | DC_TANKINFO_CC_DILUENT | DC_TANKINFO_CC_O2)
+
+// The fields stored in the dive header, in this order.
+static const dc_field_type_t g_fields[] = {
+	DC_FIELD_DIVETIME,
+	DC_FIELD_MAXDEPTH,
+	DC_FIELD_AVGDEPTH,
+	DC_FIELD_GASMIX_COUNT,
+	DC_FIELD_SALINITY,
+	DC_FIELD_ATMOSPHERIC,
+	DC_FIELD_TEMPERATURE_SURFACE,
+	DC_FIELD_TEMPERATURE_MINIMUM,
+	DC_FIELD_TEMPERATURE_MAXIMUM,
+	DC_FIELD_TANK_COUNT,
+	DC_FIELD_DIVEMODE,
+	DC_FIELD_STRING,
+};
+
+// Maximum number of DC_FIELD_STRING fields per dive.
+#define MAXSTRINGS 100
+
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
+typedef struct archive_entry_t {
+	size_t offset;
+	size_t size;
+	unsigned long long key;
+	unsigned int number;
+} archive_entry_t;
+
+struct dc_archive_writer_t {
+	dc_context_t *context;
+	dc_buffer_t *dives;
+	archive_entry_t *entries;
+	unsigned int nentries;
+	unsigned int capacity;
+	// Per dive encoder state.
+	dc_buffer_t *header;
+	dc_buffer_t *values;
+	dc_buffer_t *columns[NSAMPLETYPES];
+	long long previous[NSAMPLETYPES];
+	dc_buffer_t *shapes;
+	unsigned int nshapes;
+	dc_buffer_t *chunks;
+	unsigned int nchunks;
+	dc_buffer_t *chunk;
+	unsigned int ngasmixes;
+	dc_status_t status;
+};
+
+struct dc_archive_t {
+	dc_context_t *context;
+	const unsigned char *data;
+	size_t size;
+	unsigned int ndives;
+	const unsigned char *index;
+	const unsigned char *lookup;
+};
+
+typedef struct archive_stream_t {
+	const unsigned char *data;
+	const unsigned char *end;
+} archive_stream_t;
+
+typedef struct archive_header_t {
+	const unsigned char *fingerprint;
+	unsigned int fsize;
+	unsigned int have_datetime;
+	dc_datetime_t datetime;
+	unsigned int fields;
+	unsigned int divetime;
+	double maxdepth;
+	double avgdepth;
+	unsigned int ngasmixes;
+	archive_stream_t gasmixes;
+	dc_salinity_t salinity;
+	double atmospheric;
+	double temperature[3];
+	unsigned int ntanks;
+	archive_stream_t tanks;
+	dc_divemode_t divemode;
+	unsigned int nstrings;
+	archive_stream_t strings;
+	archive_stream_t samples;
+} archive_header_t;
+
+
+static long long
+archive_round (double value, double scale)
+{
+	if (value < 0)
+		return -(long long) (-value * scale + 0.5);
+	else
+		return (long long) (value * scale + 0.5);
+}
+
+static int
+archive_gasmix_valid (unsigned int gasmix, unsigned int ngasmixes)
+{
+	// The count is UINT_MAX if the dive has no gas mixes field.
+	return gasmix < ngasmixes || gasmix == DC_GASMIX_UNKNOWN;
+}
+
+static int
+archive_tank_valid (const dc_tank_t *tank, unsigned int ngasmixes)
+{
+	return (tank->type & ~TANKINFO) == 0 &&
+		archive_gasmix_valid (tank->gasmix, ngasmixes);
+}
+
+static int
+archive_sample_valid (dc_sample_type_t type, const dc_sample_value_t *value, unsigned int ngasmixes)
+{
+	// The tank of the pressure samples is not checked, because some
+	// parsers report the pressure before the first gas switch.
+	switch (type) {
+	case DC_SAMPLE_EVENT:
+		return value->event.type < NEVENTS &&
+			(value->event.flags & ~EVENT_FLAGS) == 0;
+	case DC_SAMPLE_VENDOR:
+		return value->vendor.type < NVENDORS;
+	case DC_SAMPLE_DECO:
+		return value->deco.type < NDECOTYPES;
+	case DC_SAMPLE_GASMIX:
+		return archive_gasmix_valid (value->gasmix, ngasmixes);
+	default:
+		return 1;
+	}
+}
+
+static unsigned long long
+archive_datetime_key (const dc_datetime_t *dt)
+{
+	// Increasing with the date/time, without a time zone conversion.
+	unsigned long long key = dt->year;
+	key = key * 12 + dt->month;
+	key = key * 31 + dt->day;
+	key = key * 24 + dt->hour;
+	key = key * 60 + dt->minute;
+	key = key * 60 + dt->second;
+	return key;
+}
+
+static int
+archive_put_uint (dc_buffer_t *buffer, unsigned long long value)
+{
+	unsigned char data[10];
+	unsigned int n = 0;
+
+	while (value >= 0x80) {
+		data[n++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	data[n++] = value;
+
+	return dc_buffer_append (buffer, data, n);
+}
+
+static int
+archive_put_int (dc_buffer_t *buffer, long long value)
+{
+	unsigned long long zigzag = ((unsigned long long) value << 1) ^ (unsigned long long) (value >> 63);
+	return archive_put_uint (buffer, zigzag);
+}
+
+static int
+archive_put_delta (dc_buffer_t *buffer, long long *previous, long long value)
+{
+	long long delta = value - *previous;
+	*previous = value;
+	return archive_put_int (buffer, delta);
+}
+
+/*
+ * A floating point value is stored as the delta with the previous value
+ * in the resolution of the column, shifted left by one bit. If that
+ * doesn't restore the exact same double, the lowest bit is set, and the
+ * raw IEEE 754 value follows. The delta is stored anyway, to keep the
+ * next deltas small.
+ */
+static int
+archive_put_value (dc_buffer_t *buffer, long long *previous, double value, double scale)
+{
+	long long integer = 0;
+	int exact = 0;
+
+	// Values beyond 2^52 (and NaN) are always stored as the raw double.
+	if (fabs (value * scale) < 4503599627370496.0) {
+		integer = archive_round (value, scale);
+		double result = integer / scale;
+		exact = memcmp (&result, &value, sizeof (double)) == 0;
+	}
+
+	long long delta = integer - *previous;
+	unsigned long long zigzag = ((unsigned long long) delta << 1) ^ (unsigned long long) (delta >> 63);
+	*previous = integer;
+
+	if (!archive_put_uint (buffer, (zigzag << 1) | !exact))
+		return 0;
+
+	if (exact)
+		return 1;
+
+	unsigned long long bits = 0;
+	unsigned char data[8];
+	memcpy (&bits, &value, sizeof (double));
+	array_uint32_le_set (data + 0, bits & 0xFFFFFFFF);
+	array_uint32_le_set (data + 4, bits >> 32);
+	return dc_buffer_append (buffer, data, sizeof (data));
+}
+
+static int
+archive_put_double (dc_buffer_t *buffer, double value, double scale)
+{
+	long long previous = 0;
+	return archive_put_value (buffer, &previous, value, scale);
+}
+
+static int
+archive_put_buffer (dc_buffer_t *buffer, dc_buffer_t *data)
+{
+	return archive_put_uint (buffer, dc_buffer_get_size (data)) &&
+		dc_buffer_append (buffer, dc_buffer_get_data (data), dc_buffer_get_size (data));
+}
+
+static int
+archive_put_string (dc_buffer_t *buffer, const char *value)
+{
+	// The length includes the terminating null character, and zero
+	// is a null pointer.
+	size_t length = value ? strlen (value) + 1 : 0;
+	return archive_put_uint (buffer, length) &&
+		dc_buffer_append (buffer, (const unsigned char *) value, length);
+}
+
+static int
+archive_get_varint (archive_stream_t *stream, unsigned long long *value)
+{
+	unsigned long long result = 0;
+	unsigned int shift = 0;
+
+	while (stream->data < stream->end && shift < 64) {
+		unsigned char byte = *stream->data++;
+		result |= (unsigned long long) (byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0) {
+			*value = result;
+			return 1;
+		}
+		shift += 7;
+	}
+
+	return 0;
+}
+
+static int
+archive_get_uint (archive_stream_t *stream, unsigned long long *value)
+{
+	// Most values are small deltas, stored in a single byte. Keeping
+	// this check small enough to be inlined speeds up the decoding.
+	if (stream->data < stream->end && *stream->data < 0x80) {
+		*value = *stream->data++;
+		return 1;
+	}
+
+	return archive_get_varint (stream, value);
+}
+
+static int
+archive_get_uint32 (archive_stream_t *stream, unsigned int *value)
+{
+	unsigned long long result = 0;
+	if (!archive_get_uint (stream, &result) || result > 0xFFFFFFFF)
+		return 0;
+
+	*value = result;
+	return 1;
+}
+
+static int
+archive_get_int (archive_stream_t *stream, long long *value)
+{
+	unsigned long long zigzag = 0;
+	if (!archive_get_uint (stream, &zigzag))
+		return 0;
+
+	*value = (long long) (zigzag >> 1) ^ -(long long) (zigzag & 1);
+	return 1;
+}
+
+static int
+archive_get_value (archive_stream_t *stream, long long *previous, double scale, double *value)
+{
+	unsigned long long data = 0;
+
+	// Fast path for the exact values with a delta stored in a single byte.
+	if (stream->data < stream->end && *stream->data < 0x80) {
+		data = *stream->data++;
+	} else if (!archive_get_uint (stream, &data)) {
+		return 0;
+	}
+
+	unsigned long long zigzag = data >> 1;
+	*previous += (long long) (zigzag >> 1) ^ -(long long) (zigzag & 1);
+
+	if ((data & 1) == 0) {
+		*value = *previous / scale;
+		return 1;
+	}
+
+	if (stream->end - stream->data < 8)
+		return 0;
+
+	unsigned long long bits = array_uint32_le (stream->data) |
+		(unsigned long long) array_uint32_le (stream->data + 4) << 32;
+	memcpy (value, &bits, sizeof (double));
+	stream->data += 8;
+	return 1;
+}
+
+static int
+archive_get_double (archive_stream_t *stream, double scale, double *value)
+{
+	long long previous = 0;
+	return archive_get_value (stream, &previous, scale, value);
+}
+
+static int
+archive_get_delta (archive_stream_t *stream, long long *previous)
+{
+	long long delta = 0;
+	if (!archive_get_int (stream, &delta))
+		return 0;
+
+	*previous += delta;
+	return 1;
+}
+
+static int
+archive_get_string (archive_stream_t *stream, const char **value)
+{
+	unsigned long long length = 0;
+	if (!archive_get_uint (stream, &length) || length > (unsigned long long) (stream->end - stream->data))
+		return 0;
+
+	if (length == 0) {
+		*value = NULL;
+		return 1;
+	}
+
+	// The string is returned in place, and must be null terminated.
+	if (stream->data[length - 1] != 0)
+		return 0;
+
+	*value = (const char *) stream->data;
+	stream->data += length;
+	return 1;
+}
+
+static int
+archive_get_stream (archive_stream_t *stream, archive_stream_t *substream)
+{
+	unsigned long long size = 0;
+	if (!archive_get_uint (stream, &size) || size > (unsigned long long) (stream->end - stream->data))
+		return 0;
+
+	substream->data = stream->data;
+	substream->end = stream->data + size;
+	stream->data += size;
+	return 1;
+}
+
+static unsigned int
+archive_checksum (const archive_stream_t *stream)
+{
+	return hash_xxh64 (stream->data, stream->end - stream->data, 0) & 0xFFFFFFFF;
+}
+
+dc_status_t
+dc_archive_writer_new (dc_archive_writer_t **out, dc_context_t *context)
+{
+	dc_archive_writer_t *writer = NULL;
+
+	if (out == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	writer = (dc_archive_writer_t *) calloc (1, sizeof (dc_archive_writer_t));
+	if (writer == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	writer->context = context;
+	writer->dives = dc_buffer_new (0);
+	writer->header = dc_buffer_new (0);
+	writer->values = dc_buffer_new (0);
+	writer->shapes = dc_buffer_new (0);
+	writer->chunks = dc_buffer_new (0);
+	writer->chunk = dc_buffer_new (0);
+	int ok = writer->dives && writer->header && writer->values &&
+		writer->shapes && writer->chunks && writer->chunk;
+	for (unsigned int i = 0; i < NSAMPLETYPES; ++i) {
+		writer->columns[i] = dc_buffer_new (0);
+		if (writer->columns[i] == NULL)
+			ok = 0;
+	}
+
+	if (!ok) {
+		ERROR (context, "Failed to allocate memory.");
+		dc_archive_writer_free (writer);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	*out = writer;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_archive_writer_free (dc_archive_writer_t *writer)
+{
+	if (writer == NULL)
+		return DC_STATUS_SUCCESS;
+
+	for (unsigned int i = 0; i < NSAMPLETYPES; ++i)
+		dc_buffer_free (writer->columns[i]);
+	dc_buffer_free (writer->chunk);
+	dc_buffer_free (writer->chunks);
+	dc_buffer_free (writer->shapes);
+	dc_buffer_free (writer->values);
+	dc_buffer_free (writer->header);
+	dc_buffer_free (writer->dives);
+	free (writer->entries);
+	free (writer);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+archive_writer_field (dc_archive_writer_t *writer, dc_parser_t *parser, dc_field_type_t type)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_buffer_t *buffer = writer->values;
+	int ok = 1;
+
+	switch (type) {
+	case DC_FIELD_DIVETIME: {
+		unsigned int divetime = 0;
+		rc = dc_parser_get_field (parser, type, 0, &divetime);
+		if (rc == DC_STATUS_SUCCESS)
+			ok = archive_put_uint (buffer, divetime);
+		break; }
+	case DC_FIELD_MAXDEPTH:
+	case DC_FIELD_AVGDEPTH: {
+		double depth = 0.0;
+		rc = dc_parser_get_field (parser, type, 0, &depth);
+		if (rc == DC_STATUS_SUCCESS)
+			ok = archive_put_double (buffer, depth, DEPTH);
+		break; }
+	case DC_FIELD_TEMPERATURE_SURFACE:
+	case DC_FIELD_TEMPERATURE_MINIMUM:
+	case DC_FIELD_TEMPERATURE_MAXIMUM: {
+		double temperature = 0.0;
+		rc = dc_parser_get_field (parser, type, 0, &temperature);
+		if (rc == DC_STATUS_SUCCESS)
+			ok = archive_put_double (buffer, temperature, TEMPERATURE);
+		break; }
+	case DC_FIELD_ATMOSPHERIC: {
+		double atmospheric = 0.0;
+		rc = dc_parser_get_field (parser, type, 0, &atmospheric);
+		if (rc == DC_STATUS_SUCCESS)
+			ok = archive_put_double (buffer, atmospheric, ATMOSPHERIC);
+		break; }
+	case DC_FIELD_SALINITY: {
+		dc_salinity_t salinity = {DC_WATER_FRESH, 0.0};
+		rc = dc_parser_get_field (parser, type, 0, &salinity);
+		if (rc == DC_STATUS_SUCCESS && (unsigned int) salinity.type >= NWATERTYPES)
+			rc = DC_STATUS_DATAFORMAT;
+		if (rc == DC_STATUS_SUCCESS)
+			ok = archive_put_uint (buffer, salinity.type) &&
+				archive_put_double (buffer, salinity.density, DENSITY);
+		break; }
+	case DC_FIELD_DIVEMODE: {
+		dc_divemode_t divemode = DC_DIVEMODE_OC;
+		rc = dc_parser_get_field (parser, type, 0, &divemode);
+		if (rc == DC_STATUS_SUCCESS && (unsigned int) divemode >= NDIVEMODES)
+			rc = DC_STATUS_DATAFORMAT;
+		if (rc == DC_STATUS_SUCCESS)
+			ok = archive_put_uint (buffer, divemode);
+		break; }
+	case DC_FIELD_GASMIX_COUNT: {
+		unsigned int ngasmixes = 0;
+		rc = dc_parser_get_field (parser, type, 0, &ngasmixes);
+		if (rc != DC_STATUS_SUCCESS)
+			break;
+		writer->ngasmixes = ngasmixes;
+		ok = archive_put_uint (buffer, ngasmixes);
+		for (unsigned int i = 0; ok && i < ngasmixes; ++i) {
+			// Each gas mix starts with a flag, because the parser
+			// can report the number of gas mixes without the mixes.
+			dc_gasmix_t gasmix = {0};
+			rc = dc_parser_get_field (parser, DC_FIELD_GASMIX, i, &gasmix);
+			if (rc == DC_STATUS_UNSUPPORTED) {
+				rc = DC_STATUS_SUCCESS;
+				ok = archive_put_uint (buffer, 0);
+				continue;
+			} else if (rc != DC_STATUS_SUCCESS) {
+				return rc;
+			}
+			ok = archive_put_uint (buffer, 1) &&
+				archive_put_double (buffer, gasmix.helium, FRACTION) &&
+				archive_put_double (buffer, gasmix.oxygen, FRACTION) &&
+				archive_put_double (buffer, gasmix.nitrogen, FRACTION);
+		}
+		break; }
+	case DC_FIELD_TANK_COUNT: {
+		unsigned int ntanks = 0;
+		rc = dc_parser_get_field (parser, type, 0, &ntanks);
+		if (rc != DC_STATUS_SUCCESS)
+			break;
+		ok = archive_put_uint (buffer, ntanks);
+		for (unsigned int i = 0; ok && i < ntanks; ++i) {
+			dc_tank_t tank = {0};
+			rc = dc_parser_get_field (parser, DC_FIELD_TANK, i, &tank);
+			if (rc == DC_STATUS_UNSUPPORTED) {
+				rc = DC_STATUS_SUCCESS;
+				ok = archive_put_uint (buffer, 0);
+				continue;
+			} else if (rc != DC_STATUS_SUCCESS) {
+				return rc;
+			}
+			if (!archive_tank_valid (&tank, writer->ngasmixes)) {
+				rc = DC_STATUS_DATAFORMAT;
+				break;
+			}
+			// The unknown gas mix is stored as zero.
+			ok = archive_put_uint (buffer, 1) &&
+				archive_put_uint (buffer, tank.gasmix + 1) &&
+				archive_put_uint (buffer, tank.type) &&
+				archive_put_double (buffer, tank.volume, VOLUME) &&
+				archive_put_double (buffer, tank.workpressure, PRESSURE) &&
+				archive_put_double (buffer, tank.beginpressure, PRESSURE) &&
+				archive_put_double (buffer, tank.endpressure, PRESSURE);
+		}
+		break; }
+	case DC_FIELD_STRING: {
+		// The parsers report the strings until the index is out of
+		// range, so fetch them all first. The values are allocated by
+		// the parser, and freed once they are stored.
+		dc_field_string_t strings[MAXSTRINGS];
+		unsigned int nstrings = 0;
+		while (nstrings < MAXSTRINGS) {
+			dc_field_string_t *str = strings + nstrings;
+			str->desc = NULL;
+			str->value = NULL;
+			rc = dc_parser_get_field (parser, type, nstrings, str);
+			if (rc != DC_STATUS_SUCCESS || str->desc == NULL || str->value == NULL) {
+				free ((void *) str->value);
+				break;
+			}
+			nstrings++;
+		}
+		if (rc == DC_STATUS_SUCCESS || rc == DC_STATUS_UNSUPPORTED) {
+			rc = nstrings ? DC_STATUS_SUCCESS : DC_STATUS_UNSUPPORTED;
+			ok = nstrings == 0 || archive_put_uint (buffer, nstrings);
+			for (unsigned int i = 0; ok && i < nstrings; ++i) {
+				ok = archive_put_string (buffer, strings[i].desc) &&
+					archive_put_string (buffer, strings[i].value);
+			}
+		}
+		for (unsigned int i = 0; i < nstrings; ++i) {
+			free ((void *) strings[i].value);
+		}
+		break; }
+	default:
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	if (!ok) {
+		ERROR (writer->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	if (rc == DC_STATUS_DATAFORMAT)
+		ERROR (writer->context, "Value out of range (field %u).", type);
+
+	return rc;
+}
+
+static int
+archive_writer_flush (dc_archive_writer_t *writer)
+{
+	const unsigned char *types = dc_buffer_get_data (writer->chunk);
+	size_t ntypes = dc_buffer_get_size (writer->chunk);
+
+	if (ntypes == 0)
+		return 1;
+
+	// Find the shape of the group, or add a new one.
+	archive_stream_t shapes = {dc_buffer_get_data (writer->shapes),
+		dc_buffer_get_data (writer->shapes) + dc_buffer_get_size (writer->shapes)};
+	archive_stream_t shape = {NULL, NULL};
+	unsigned int idx = 0;
+	while (idx < writer->nshapes && archive_get_stream (&shapes, &shape)) {
+		if ((size_t) (shape.end - shape.data) == ntypes && memcmp (shape.data, types, ntypes) == 0)
+			break;
+		idx++;
+	}
+
+	if (idx == writer->nshapes) {
+		if (!archive_put_buffer (writer->shapes, writer->chunk))
+			return 0;
+		writer->nshapes++;
+	}
+
+	writer->nchunks++;
+	dc_buffer_clear (writer->chunk);
+
+	return archive_put_uint (writer->chunks, idx);
+}
+
+static void
+archive_writer_sample_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	dc_archive_writer_t *writer = (dc_archive_writer_t *) userdata;
+
+	if (writer->status != DC_STATUS_SUCCESS || (unsigned int) type >= NSAMPLETYPES)
+		return;
+
+	if (!archive_sample_valid (type, &value, writer->ngasmixes)) {
+		ERROR (writer->context, "Value out of range (sample type %u).", type);
+		writer->status = DC_STATUS_DATAFORMAT;
+		return;
+	}
+
+	dc_buffer_t *column = writer->columns[type];
+	long long *previous = writer->previous + type;
+	unsigned char byte = type;
+	int ok = 1;
+
+	if (type == DC_SAMPLE_TIME)
+		ok = archive_writer_flush (writer);
+
+	ok = ok && dc_buffer_append (writer->chunk, &byte, 1);
+
+	switch (type) {
+	case DC_SAMPLE_TIME:
+		ok = ok && archive_put_delta (column, previous, value.time);
+		break;
+	case DC_SAMPLE_DEPTH:
+		ok = ok && archive_put_value (column, previous, value.depth, DEPTH);
+		break;
+	case DC_SAMPLE_PRESSURE:
+		ok = ok && archive_put_uint (column, value.pressure.tank) &&
+			archive_put_value (column, previous, value.pressure.value, PRESSURE);
+		break;
+	case DC_SAMPLE_TEMPERATURE:
+		ok = ok && archive_put_value (column, previous, value.temperature, TEMPERATURE);
+		break;
+	case DC_SAMPLE_EVENT:
+		ok = ok && archive_put_uint (column, value.event.type) &&
+			archive_put_uint (column, value.event.time) &&
+			archive_put_uint (column, value.event.flags) &&
+			archive_put_uint (column, value.event.value);
+		// Only the string events have a name.
+		if (value.event.type == SAMPLE_EVENT_STRING)
+			ok = ok && archive_put_string (column, value.event.name);
+		break;
+	case DC_SAMPLE_RBT:
+		ok = ok && archive_put_delta (column, previous, value.rbt);
+		break;
+	case DC_SAMPLE_HEARTBEAT:
+		ok = ok && archive_put_delta (column, previous, value.heartbeat);
+		break;
+	case DC_SAMPLE_BEARING:
+		ok = ok && archive_put_delta (column, previous, value.bearing);
+		break;
+	case DC_SAMPLE_VENDOR:
+		ok = ok && archive_put_uint (column, value.vendor.type) &&
+			archive_put_uint (column, value.vendor.size) &&
+			dc_buffer_append (column, (const unsigned char *) value.vendor.data, value.vendor.size);
+		break;
+	case DC_SAMPLE_SETPOINT:
+		ok = ok && archive_put_value (column, previous, value.setpoint, PRESSURE);
+		break;
+	case DC_SAMPLE_PPO2:
+		ok = ok && archive_put_value (column, previous, value.ppo2, PRESSURE);
+		break;
+	case DC_SAMPLE_CNS:
+		ok = ok && archive_put_value (column, previous, value.cns, FRACTION);
+		break;
+	case DC_SAMPLE_DECO:
+		ok = ok && archive_put_uint (column, value.deco.type) &&
+			archive_put_uint (column, value.deco.time) &&
+			archive_put_double (column, value.deco.depth, DEPTH);
+		break;
+	case DC_SAMPLE_GASMIX:
+		ok = ok && archive_put_uint (column, value.gasmix);
+		break;
+	default:
+		break;
+	}
+
+	if (!ok)
+		writer->status = DC_STATUS_NOMEMORY;
+}
+
+static int
+archive_writer_entry (dc_archive_writer_t *writer, size_t offset, unsigned long long key)
+{
+	if (writer->nentries == writer->capacity) {
+		unsigned int capacity = writer->capacity ? writer->capacity * 2 : 64;
+		archive_entry_t *entries = (archive_entry_t *) realloc (writer->entries, capacity * sizeof (archive_entry_t));
+		if (entries == NULL)
+			return 0;
+
+		writer->entries = entries;
+		writer->capacity = capacity;
+	}
+
+	archive_entry_t *entry = writer->entries + writer->nentries;
+	entry->offset = offset;
+	entry->size = dc_buffer_get_size (writer->dives) - offset;
+	entry->key = key;
+	entry->number = writer->nentries;
+	writer->nentries++;
+
+	return 1;
+}
+
+dc_status_t
+dc_archive_writer_add (dc_archive_writer_t *writer, dc_parser_t *parser, const unsigned char fingerprint[], unsigned int fsize)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	if (writer == NULL || parser == NULL || (fingerprint == NULL && fsize))
+		return DC_STATUS_INVALIDARGS;
+
+	dc_buffer_clear (writer->header);
+	dc_buffer_clear (writer->values);
+
+	// Fingerprint.
+	int ok = archive_put_uint (writer->header, fsize) &&
+		dc_buffer_append (writer->header, fingerprint, fsize);
+
+	// Date/time.
+	unsigned long long key = 0;
+	dc_datetime_t dt = {0};
+	rc = dc_parser_get_datetime (parser, &dt);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+		return rc;
+
+	if (rc == DC_STATUS_SUCCESS) {
+		key = archive_datetime_key (&dt);
+		ok = ok && archive_put_uint (writer->header, 1) &&
+			archive_put_int (writer->header, dt.year) &&
+			archive_put_int (writer->header, dt.month) &&
+			archive_put_int (writer->header, dt.day) &&
+			archive_put_int (writer->header, dt.hour) &&
+			archive_put_int (writer->header, dt.minute) &&
+			archive_put_int (writer->header, dt.second);
+	} else {
+		ok = ok && archive_put_uint (writer->header, 0);
+	}
+
+	// Fields, with a bitmap of the supported ones. The gas mix indices
+	// are bounded by their count, if the dive has one.
+	unsigned int fields = 0;
+	writer->ngasmixes = UINT_MAX;
+	for (unsigned int i = 0; i < C_ARRAY_SIZE (g_fields); ++i) {
+		size_t size = dc_buffer_get_size (writer->values);
+		rc = archive_writer_field (writer, parser, g_fields[i]);
+		if (rc == DC_STATUS_SUCCESS)
+			fields |= 1u << i;
+		else if (rc == DC_STATUS_UNSUPPORTED)
+			dc_buffer_resize (writer->values, size);
+		else
+			return rc;
+	}
+	ok = ok && archive_put_uint (writer->header, fields) &&
+		dc_buffer_append (writer->header, dc_buffer_get_data (writer->values), dc_buffer_get_size (writer->values));
+
+	// Samples.
+	for (unsigned int i = 0; i < NSAMPLETYPES; ++i) {
+		dc_buffer_clear (writer->columns[i]);
+		writer->previous[i] = 0;
+	}
+	dc_buffer_clear (writer->shapes);
+	dc_buffer_clear (writer->chunks);
+	dc_buffer_clear (writer->chunk);
+	writer->nshapes = 0;
+	writer->nchunks = 0;
+	writer->status = DC_STATUS_SUCCESS;
+
+	rc = dc_parser_samples_foreach (parser, archive_writer_sample_cb, writer);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	if (writer->status == DC_STATUS_DATAFORMAT)
+		return writer->status;
+
+	ok = ok && writer->status == DC_STATUS_SUCCESS && archive_writer_flush (writer);
+
+	// The dive block.
+	size_t offset = dc_buffer_get_size (writer->dives);
+	ok = ok && archive_put_buffer (writer->dives, writer->header) &&
+		archive_put_uint (writer->dives, writer->nshapes) &&
+		dc_buffer_append (writer->dives, dc_buffer_get_data (writer->shapes), dc_buffer_get_size (writer->shapes)) &&
+		archive_put_uint (writer->dives, writer->nchunks) &&
+		archive_put_buffer (writer->dives, writer->chunks);
+
+	unsigned int columns = 0;
+	for (unsigned int i = 0; i < NSAMPLETYPES; ++i) {
+		if (dc_buffer_get_size (writer->columns[i]))
+			columns |= 1u << i;
+	}
+	ok = ok && archive_put_uint (writer->dives, columns);
+	for (unsigned int i = 0; ok && i < NSAMPLETYPES; ++i) {
+		if (columns & (1u << i))
+			ok = archive_put_buffer (writer->dives, writer->columns[i]);
+	}
+
+	if (!ok || !archive_writer_entry (writer, offset, key)) {
+		ERROR (writer->context, "Failed to allocate memory.");
+		dc_buffer_resize (writer->dives, offset);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static int
+archive_entry_cmp (const void *a, const void *b)
+{
+	const archive_entry_t *x = (const archive_entry_t *) a;
+	const archive_entry_t *y = (const archive_entry_t *) b;
+
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+
+	// Keep the dives with the same date/time in their original order.
+	return x->number < y->number ? -1 : (x->number > y->number);
+}
+
+static int
+archive_fingerprint_cmp (const unsigned char a[], unsigned int asize, const unsigned char b[], unsigned int bsize)
+{
+	if (asize != bsize)
+		return asize < bsize ? -1 : 1;
+
+	return asize ? memcmp (a, b, asize) : 0;
+}
+
+typedef struct archive_lookup_t {
+	const unsigned char *fingerprint;
+	unsigned int fsize;
+	unsigned int index;
+} archive_lookup_t;
+
+static int
+archive_lookup_cmp (const void *a, const void *b)
+{
+	const archive_lookup_t *x = (const archive_lookup_t *) a;
+	const archive_lookup_t *y = (const archive_lookup_t *) b;
+
+	int cmp = archive_fingerprint_cmp (x->fingerprint, x->fsize, y->fingerprint, y->fsize);
+	if (cmp)
+		return cmp;
+
+	return x->index < y->index ? -1 : (x->index > y->index);
+}
+
+static void
+archive_header_fingerprint (const unsigned char data[], size_t size, const unsigned char **fingerprint, unsigned int *fsize)
+{
+	// The block was written by this writer, and is always valid.
+	archive_stream_t stream = {data, data + size};
+	archive_stream_t header = {NULL, NULL};
+	archive_get_stream (&stream, &header);
+	archive_get_uint32 (&header, fsize);
+	*fingerprint = header.data;
+}
+
+dc_status_t
+dc_archive_writer_finish (dc_archive_writer_t *writer, dc_buffer_t *buffer)
+{
+	if (writer == NULL || buffer == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	unsigned int ndives = writer->nentries;
+	size_t total = SZ_HEADER + dc_buffer_get_size (writer->dives) + (size_t) ndives * (SZ_ENTRY + SZ_LOOKUP);
+	if (total > 0xFFFFFFFF) {
+		ERROR (writer->context, "Archive too large.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	archive_lookup_t *lookup = (archive_lookup_t *) malloc ((ndives ? ndives : 1) * sizeof (archive_lookup_t));
+	if (lookup == NULL || !dc_buffer_clear (buffer) || !dc_buffer_reserve (buffer, total)) {
+		ERROR (writer->context, "Failed to allocate memory.");
+		free (lookup);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	qsort (writer->entries, ndives, sizeof (archive_entry_t), archive_entry_cmp);
+
+	const unsigned char *dives = dc_buffer_get_data (writer->dives);
+	size_t offset = SZ_HEADER;
+
+	unsigned char header[SZ_HEADER];
+	memcpy (header, ARCHIVE_MAGIC, 4);
+	array_uint32_le_set (header + 4, ARCHIVE_VERSION);
+	array_uint32_le_set (header + 8, ndives);
+	array_uint32_le_set (header + 12, total - (size_t) ndives * (SZ_ENTRY + SZ_LOOKUP));
+	dc_buffer_append (buffer, header, sizeof (header));
+
+	for (unsigned int i = 0; i < ndives; ++i) {
+		const archive_entry_t *entry = writer->entries + i;
+		dc_buffer_append (buffer, dives + entry->offset, entry->size);
+
+		lookup[i].index = i;
+		archive_header_fingerprint (dives + entry->offset, entry->size,
+			&lookup[i].fingerprint, &lookup[i].fsize);
+	}
+
+	for (unsigned int i = 0; i < ndives; ++i) {
+		const archive_entry_t *entry = writer->entries + i;
+		// The block was written by this writer, and is always valid.
+		archive_stream_t samples = {dives + entry->offset, dives + entry->offset + entry->size};
+		archive_stream_t header = {NULL, NULL};
+		archive_get_stream (&samples, &header);
+		unsigned char data[SZ_ENTRY];
+		array_uint32_le_set (data + 0, offset);
+		array_uint32_le_set (data + 4, entry->size);
+		array_uint32_le_set (data + 8, entry->key & 0xFFFFFFFF);
+		array_uint32_le_set (data + 12, entry->key >> 32);
+		array_uint32_le_set (data + CHECKSUM_HEADER, archive_checksum (&header));
+		array_uint32_le_set (data + CHECKSUM_SAMPLES, archive_checksum (&samples));
+		dc_buffer_append (buffer, data, sizeof (data));
+		offset += entry->size;
+	}
+
+	qsort (lookup, ndives, sizeof (archive_lookup_t), archive_lookup_cmp);
+	for (unsigned int i = 0; i < ndives; ++i) {
+		unsigned char data[SZ_LOOKUP];
+		array_uint32_le_set (data, lookup[i].index);
+		dc_buffer_append (buffer, data, sizeof (data));
+	}
+
+	free (lookup);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+dc_archive_open (dc_archive_t **out, dc_context_t *context, const unsigned char data[], size_t size)
+{
+	dc_archive_t *archive = NULL;
+
+	if (out == NULL || (data == NULL && size))
+		return DC_STATUS_INVALIDARGS;
+
+	if (size < SZ_HEADER || memcmp (data, ARCHIVE_MAGIC, 4) != 0) {
+		ERROR (context, "Invalid archive header.");
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	unsigned int version = array_uint32_le (data + 4);
+	if (version != ARCHIVE_VERSION) {
+		ERROR (context, "Unsupported archive version (%u).", version);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	unsigned int ndives = array_uint32_le (data + 8);
+	unsigned int offset = array_uint32_le (data + 12);
+	if (offset < SZ_HEADER || offset > size ||
+		ndives > (size - offset) / (SZ_ENTRY + SZ_LOOKUP)) {
+		ERROR (context, "Invalid archive index.");
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	archive = (dc_archive_t *) malloc (sizeof (dc_archive_t));
+	if (archive == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	archive->context = context;
+	archive->data = data;
+	archive->size = offset;
+	archive->ndives = ndives;
+	archive->index = data + offset;
+	archive->lookup = data + offset + (size_t) ndives * SZ_ENTRY;
+
+	*out = archive;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_archive_close (dc_archive_t *archive)
+{
+	free (archive);
+
+	return DC_STATUS_SUCCESS;
+}
+
+unsigned int
+dc_archive_get_count (dc_archive_t *archive)
+{
+	if (archive == NULL)
+		return 0;
+
+	return archive->ndives;
+}
+
+static dc_status_t
+archive_block (dc_archive_t *archive, unsigned int index, archive_stream_t *stream)
+{
+	if (archive == NULL || index >= archive->ndives)
+		return DC_STATUS_INVALIDARGS;
+
+	const unsigned char *entry = archive->index + (size_t) index * SZ_ENTRY;
+	unsigned int offset = array_uint32_le (entry + 0);
+	unsigned int size = array_uint32_le (entry + 4);
+	if (offset < SZ_HEADER || offset > archive->size || size > archive->size - offset) {
+		ERROR (archive->context, "Invalid archive index entry (%u).", index);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	stream->data = archive->data + offset;
+	stream->end = archive->data + offset + size;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+archive_verify (dc_archive_t *archive, unsigned int index, const archive_stream_t *stream, unsigned int field)
+{
+	const unsigned char *entry = archive->index + (size_t) index * SZ_ENTRY;
+	if (archive_checksum (stream) != array_uint32_le (entry + field)) {
+		ERROR (archive->context, "Invalid dive checksum (%u).", index);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * The fingerprint of a dive, without verifying the checksum of the
+ * block. This keeps the fingerprint lookup fast, and a corrupt block
+ * is still detected once the dive is used.
+ */
+static dc_status_t
+archive_block_fingerprint (dc_archive_t *archive, unsigned int index, const unsigned char **fingerprint, unsigned int *fsize)
+{
+	archive_stream_t block = {NULL, NULL};
+	archive_stream_t stream = {NULL, NULL};
+
+	dc_status_t rc = archive_block (archive, index, &block);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	if (!archive_get_stream (&block, &stream) ||
+		!archive_get_uint32 (&stream, fsize) ||
+		*fsize > (size_t) (stream.end - stream.data)) {
+		ERROR (archive->context, "Invalid dive header (%u).", index);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	*fingerprint = stream.data;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static int
+archive_skip (archive_stream_t *stream, unsigned int count)
+{
+	unsigned long long value = 0;
+	for (unsigned int i = 0; i < count; ++i) {
+		if (!archive_get_uint (stream, &value))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int
+archive_skip_doubles (archive_stream_t *stream, unsigned int count)
+{
+	double value = 0.0;
+	for (unsigned int i = 0; i < count; ++i) {
+		if (!archive_get_double (stream, 1.0, &value))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int
+archive_skip_items (archive_stream_t *stream, unsigned int nitems, unsigned int nintegers, unsigned int ndoubles)
+{
+	// Items are a presence flag, followed by the values if present.
+	unsigned long long present = 0;
+	for (unsigned int i = 0; i < nitems; ++i) {
+		if (!archive_get_uint (stream, &present) ||
+			(present && !(archive_skip (stream, nintegers) && archive_skip_doubles (stream, ndoubles))))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int
+archive_skip_strings (archive_stream_t *stream, unsigned int count)
+{
+	const char *value = NULL;
+	for (unsigned int i = 0; i < count; ++i) {
+		if (!archive_get_string (stream, &value))
+			return 0;
+	}
+
+	return 1;
+}
+
+static dc_status_t
+archive_header (dc_archive_t *archive, unsigned int index, archive_header_t *header)
+{
+	archive_stream_t block = {NULL, NULL};
+	archive_stream_t stream = {NULL, NULL};
+	unsigned int value = 0;
+	long long dt[6] = {0};
+	int ok = 1;
+
+	dc_status_t rc = archive_block (archive, index, &block);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	memset (header, 0, sizeof (*header));
+	header->ngasmixes = UINT_MAX;
+
+	if (!archive_get_stream (&block, &stream)) {
+		ERROR (archive->context, "Invalid dive header (%u).", index);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	rc = archive_verify (archive, index, &stream, CHECKSUM_HEADER);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	ok = archive_get_uint32 (&stream, &header->fsize) &&
+		header->fsize <= (size_t) (stream.end - stream.data);
+	if (ok) {
+		header->fingerprint = stream.data;
+		stream.data += header->fsize;
+	}
+
+	ok = ok && archive_get_uint32 (&stream, &header->have_datetime);
+	for (unsigned int i = 0; ok && header->have_datetime && i < 6; ++i) {
+		ok = archive_get_int (&stream, dt + i);
+	}
+	header->datetime.year = dt[0];
+	header->datetime.month = dt[1];
+	header->datetime.day = dt[2];
+	header->datetime.hour = dt[3];
+	header->datetime.minute = dt[4];
+	header->datetime.second = dt[5];
+
+	ok = ok && archive_get_uint32 (&stream, &header->fields);
+	for (unsigned int i = 0; ok && i < C_ARRAY_SIZE (g_fields); ++i) {
+		if ((header->fields & (1u << i)) == 0)
+			continue;
+
+		switch (g_fields[i]) {
+		case DC_FIELD_DIVETIME:
+			ok = archive_get_uint32 (&stream, &header->divetime);
+			break;
+		case DC_FIELD_MAXDEPTH:
+			ok = archive_get_double (&stream, DEPTH, &header->maxdepth);
+			break;
+		case DC_FIELD_AVGDEPTH:
+			ok = archive_get_double (&stream, DEPTH, &header->avgdepth);
+			break;
+		case DC_FIELD_TEMPERATURE_SURFACE:
+		case DC_FIELD_TEMPERATURE_MINIMUM:
+		case DC_FIELD_TEMPERATURE_MAXIMUM:
+			ok = archive_get_double (&stream, TEMPERATURE,
+				header->temperature + (g_fields[i] - DC_FIELD_TEMPERATURE_SURFACE));
+			break;
+		case DC_FIELD_ATMOSPHERIC:
+			ok = archive_get_double (&stream, ATMOSPHERIC, &header->atmospheric);
+			break;
+		case DC_FIELD_SALINITY:
+			ok = archive_get_uint32 (&stream, &value) &&
+				archive_get_double (&stream, DENSITY, &header->salinity.density) &&
+				value < NWATERTYPES;
+			header->salinity.type = (dc_water_t) value;
+			break;
+		case DC_FIELD_DIVEMODE:
+			ok = archive_get_uint32 (&stream, &value) &&
+				value < NDIVEMODES;
+			header->divemode = (dc_divemode_t) value;
+			break;
+		case DC_FIELD_GASMIX_COUNT:
+			ok = archive_get_uint32 (&stream, &header->ngasmixes);
+			header->gasmixes.data = stream.data;
+			ok = ok && header->ngasmixes <= (size_t) (stream.end - stream.data) &&
+				archive_skip_items (&stream, header->ngasmixes, 0, 3);
+			header->gasmixes.end = stream.data;
+			break;
+		case DC_FIELD_TANK_COUNT:
+			ok = archive_get_uint32 (&stream, &header->ntanks);
+			header->tanks.data = stream.data;
+			ok = ok && header->ntanks <= (size_t) (stream.end - stream.data) &&
+				archive_skip_items (&stream, header->ntanks, 2, 4);
+			header->tanks.end = stream.data;
+			break;
+		case DC_FIELD_STRING:
+			ok = archive_get_uint32 (&stream, &header->nstrings);
+			header->strings.data = stream.data;
+			ok = ok && header->nstrings <= (size_t) (stream.end - stream.data) &&
+				archive_skip_strings (&stream, header->nstrings * 2);
+			header->strings.end = stream.data;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (!ok) {
+		ERROR (archive->context, "Invalid dive header (%u).", index);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	header->samples = block;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_archive_writer_copy (dc_archive_writer_t *writer, dc_archive_t *archive, unsigned int index)
+{
+	archive_stream_t block = {NULL, NULL};
+	archive_header_t header;
+
+	if (writer == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// Validate the dive header, because the fingerprint is needed
+	// again for the lookup table, and the samples, because the copy
+	// gets a new checksum.
+	dc_status_t rc = archive_header (archive, index, &header);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	rc = archive_verify (archive, index, &header.samples, CHECKSUM_SAMPLES);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	archive_block (archive, index, &block);
+
+	const unsigned char *entry = archive->index + (size_t) index * SZ_ENTRY;
+	unsigned long long key = array_uint32_le (entry + 8) |
+		(unsigned long long) array_uint32_le (entry + 12) << 32;
+
+	// The dive block is copied as is.
+	size_t offset = dc_buffer_get_size (writer->dives);
+	if (!dc_buffer_append (writer->dives, block.data, block.end - block.data) ||
+		!archive_writer_entry (writer, offset, key)) {
+		ERROR (writer->context, "Failed to allocate memory.");
+		dc_buffer_resize (writer->dives, offset);
+		return DC_STATUS_NOMEMORY;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_archive_get_fingerprint (dc_archive_t *archive, unsigned int index, const unsigned char **fingerprint, unsigned int *fsize)
+{
+	archive_header_t header;
+
+	dc_status_t rc = archive_header (archive, index, &header);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	if (fingerprint)
+		*fingerprint = header.fingerprint;
+	if (fsize)
+		*fsize = header.fsize;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_archive_verify (dc_archive_t *archive, unsigned int index)
+{
+	archive_header_t header;
+
+	dc_status_t rc = archive_header (archive, index, &header);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	return archive_verify (archive, index, &header.samples, CHECKSUM_SAMPLES);
+}
+
+dc_status_t
+dc_archive_get_datetime (dc_archive_t *archive, unsigned int index, dc_datetime_t *datetime)
+{
+	archive_header_t header;
+
+	dc_status_t rc = archive_header (archive, index, &header);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	if (!header.have_datetime)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (datetime)
+		*datetime = header.datetime;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_archive_find_fingerprint (dc_archive_t *archive, const unsigned char fingerprint[], unsigned int fsize, unsigned int *index)
+{
+	if (archive == NULL || index == NULL || (fingerprint == NULL && fsize))
+		return DC_STATUS_INVALIDARGS;
+
+	// Find the first dive with a fingerprint not lower than the requested one.
+	unsigned int lo = 0, hi = archive->ndives;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		const unsigned char *fp = NULL;
+		unsigned int size = 0;
+
+		dc_status_t rc = archive_block_fingerprint (archive,
+			array_uint32_le (archive->lookup + (size_t) mid * SZ_LOOKUP), &fp, &size);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc == DC_STATUS_INVALIDARGS ? DC_STATUS_DATAFORMAT : rc;
+
+		if (archive_fingerprint_cmp (fp, size, fingerprint, fsize) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	*index = DC_ARCHIVE_NONE;
+	if (lo < archive->ndives) {
+		unsigned int candidate = array_uint32_le (archive->lookup + (size_t) lo * SZ_LOOKUP);
+		const unsigned char *fp = NULL;
+		unsigned int size = 0;
+
+		dc_status_t rc = archive_block_fingerprint (archive, candidate, &fp, &size);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc == DC_STATUS_INVALIDARGS ? DC_STATUS_DATAFORMAT : rc;
+
+		if (archive_fingerprint_cmp (fp, size, fingerprint, fsize) == 0)
+			*index = candidate;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_archive_find_datetime (dc_archive_t *archive, const dc_datetime_t *datetime, unsigned int *index)
+{
+	if (archive == NULL || datetime == NULL || index == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	// Find the first dive not earlier than the requested date/time.
+	unsigned long long key = archive_datetime_key (datetime);
+	unsigned int lo = 0, hi = archive->ndives;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		const unsigned char *entry = archive->index + (size_t) mid * SZ_ENTRY;
+		unsigned long long value = array_uint32_le (entry + 8) |
+			(unsigned long long) array_uint32_le (entry + 12) << 32;
+		if (value < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	*index = lo;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_archive_get_field (dc_archive_t *archive, unsigned int index, dc_field_type_t type, unsigned int flags, void *value)
+{
+	archive_header_t header;
+	unsigned int field = type;
+
+	dc_status_t rc = archive_header (archive, index, &header);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	// The gas mixes and tanks are stored with their count.
+	if (type == DC_FIELD_GASMIX)
+		field = DC_FIELD_GASMIX_COUNT;
+	else if (type == DC_FIELD_TANK)
+		field = DC_FIELD_TANK_COUNT;
+
+	unsigned int i = 0;
+	while (i < C_ARRAY_SIZE (g_fields) && g_fields[i] != field)
+		i++;
+	if (i == C_ARRAY_SIZE (g_fields) || (header.fields & (1u << i)) == 0)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (value == NULL)
+		return DC_STATUS_SUCCESS;
+
+	dc_gasmix_t *gasmix = (dc_gasmix_t *) value;
+	dc_tank_t *tank = (dc_tank_t *) value;
+	dc_salinity_t *salinity = (dc_salinity_t *) value;
+	dc_field_string_t *str = (dc_field_string_t *) value;
+	unsigned int present = 0, gasmixidx = 0, tankinfo = 0;
+	int ok = 1;
+
+	switch (type) {
+	case DC_FIELD_DIVETIME:
+		*((unsigned int *) value) = header.divetime;
+		break;
+	case DC_FIELD_MAXDEPTH:
+		*((double *) value) = header.maxdepth;
+		break;
+	case DC_FIELD_AVGDEPTH:
+		*((double *) value) = header.avgdepth;
+		break;
+	case DC_FIELD_GASMIX_COUNT:
+		*((unsigned int *) value) = header.ngasmixes;
+		break;
+	case DC_FIELD_GASMIX:
+		if (flags >= header.ngasmixes)
+			return DC_STATUS_INVALIDARGS;
+		ok = archive_skip_items (&header.gasmixes, flags, 0, 3) &&
+			archive_get_uint32 (&header.gasmixes, &present);
+		if (ok && !present)
+			return DC_STATUS_UNSUPPORTED;
+		ok = ok && archive_get_double (&header.gasmixes, FRACTION, &gasmix->helium) &&
+			archive_get_double (&header.gasmixes, FRACTION, &gasmix->oxygen) &&
+			archive_get_double (&header.gasmixes, FRACTION, &gasmix->nitrogen);
+		break;
+	case DC_FIELD_SALINITY:
+		*salinity = header.salinity;
+		break;
+	case DC_FIELD_ATMOSPHERIC:
+		*((double *) value) = header.atmospheric;
+		break;
+	case DC_FIELD_TEMPERATURE_SURFACE:
+	case DC_FIELD_TEMPERATURE_MINIMUM:
+	case DC_FIELD_TEMPERATURE_MAXIMUM:
+		*((double *) value) = header.temperature[type - DC_FIELD_TEMPERATURE_SURFACE];
+		break;
+	case DC_FIELD_TANK_COUNT:
+		*((unsigned int *) value) = header.ntanks;
+		break;
+	case DC_FIELD_TANK:
+		if (flags >= header.ntanks)
+			return DC_STATUS_INVALIDARGS;
+		ok = archive_skip_items (&header.tanks, flags, 2, 4) &&
+			archive_get_uint32 (&header.tanks, &present);
+		if (ok && !present)
+			return DC_STATUS_UNSUPPORTED;
+		ok = ok && archive_get_uint32 (&header.tanks, &gasmixidx) &&
+			archive_get_uint32 (&header.tanks, &tankinfo) &&
+			archive_get_double (&header.tanks, VOLUME, &tank->volume) &&
+			archive_get_double (&header.tanks, PRESSURE, &tank->workpressure) &&
+			archive_get_double (&header.tanks, PRESSURE, &tank->beginpressure) &&
+			archive_get_double (&header.tanks, PRESSURE, &tank->endpressure);
+		tank->gasmix = gasmixidx - 1;
+		tank->type = (dc_tankinfo_t) tankinfo;
+		ok = ok && archive_tank_valid (tank, header.ngasmixes);
+		break;
+	case DC_FIELD_DIVEMODE:
+		*((dc_divemode_t *) value) = header.divemode;
+		break;
+	case DC_FIELD_STRING:
+		if (flags >= header.nstrings)
+			return DC_STATUS_UNSUPPORTED;
+		ok = archive_skip_strings (&header.strings, flags * 2) &&
+			archive_get_string (&header.strings, &str->desc) &&
+			archive_get_string (&header.strings, &str->value);
+		break;
+	default:
+		return DC_STATUS_UNSUPPORTED;
+	}
+
+	if (!ok) {
+		ERROR (archive->context, "Invalid dive header (%u).", index);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_archive_samples_foreach (dc_archive_t *archive, unsigned int index, dc_sample_callback_t callback, void *userdata)
+{
+	archive_header_t header;
+	archive_stream_t *shapes = NULL;
+	archive_stream_t chunks = {NULL, NULL};
+	archive_stream_t columns[NSAMPLETYPES];
+	long long previous[NSAMPLETYPES] = {0};
+	dc_sample_value_t sample = {0};
+	unsigned int nshapes = 0, nchunks = 0, mask = 0;
+	int ok = 1;
+
+	dc_status_t rc = archive_header (archive, index, &header);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	rc = archive_verify (archive, index, &header.samples, CHECKSUM_SAMPLES);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	archive_stream_t *stream = &header.samples;
+
+	// The shapes.
+	ok = archive_get_uint32 (stream, &nshapes) &&
+		nshapes <= (size_t) (stream->end - stream->data);
+	if (ok && nshapes) {
+		shapes = (archive_stream_t *) malloc (nshapes * sizeof (archive_stream_t));
+		if (shapes == NULL) {
+			ERROR (archive->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+	}
+	for (unsigned int i = 0; ok && i < nshapes; ++i) {
+		ok = archive_get_stream (stream, shapes + i);
+	}
+
+	// The groups and the columns.
+	ok = ok && archive_get_uint32 (stream, &nchunks) &&
+		archive_get_stream (stream, &chunks) &&
+		archive_get_uint32 (stream, &mask);
+	for (unsigned int i = 0; i < NSAMPLETYPES; ++i) {
+		columns[i].data = columns[i].end = NULL;
+		if (ok && (mask & (1u << i)))
+			ok = archive_get_stream (stream, columns + i);
+	}
+
+	for (unsigned int i = 0; ok && i < nchunks; ++i) {
+		unsigned int idx = 0;
+		ok = archive_get_uint32 (&chunks, &idx) && idx < nshapes;
+		if (!ok)
+			break;
+
+		for (const unsigned char *p = shapes[idx].data; ok && p < shapes[idx].end; ++p) {
+			dc_sample_type_t type = (dc_sample_type_t) *p;
+			if (*p >= NSAMPLETYPES) {
+				ok = 0;
+				break;
+			}
+
+			archive_stream_t *column = columns + type;
+			long long *prev = previous + type;
+			unsigned long long size = 0;
+
+			if (DELTA_TYPES & (1u << type)) {
+				// Fast path for the deltas stored in a single byte.
+				if (column->data < column->end && *column->data < 0x80) {
+					unsigned int zigzag = *column->data++;
+					*prev += (long long) (zigzag >> 1) ^ -(long long) (zigzag & 1);
+				} else {
+					ok = archive_get_delta (column, prev);
+				}
+			}
+
+			switch (type) {
+			case DC_SAMPLE_TIME:
+				sample.time = *prev;
+				break;
+			case DC_SAMPLE_DEPTH:
+				ok = archive_get_value (column, prev, DEPTH, &sample.depth);
+				break;
+			case DC_SAMPLE_PRESSURE:
+				ok = archive_get_uint32 (column, &sample.pressure.tank) &&
+					archive_get_value (column, prev, PRESSURE, &sample.pressure.value);
+				break;
+			case DC_SAMPLE_TEMPERATURE:
+				ok = archive_get_value (column, prev, TEMPERATURE, &sample.temperature);
+				break;
+			case DC_SAMPLE_EVENT:
+				sample.event.name = NULL;
+				ok = archive_get_uint32 (column, &sample.event.type) &&
+					archive_get_uint32 (column, &sample.event.time) &&
+					archive_get_uint32 (column, &sample.event.flags) &&
+					archive_get_uint32 (column, &sample.event.value);
+				if (ok && sample.event.type == SAMPLE_EVENT_STRING)
+					ok = archive_get_string (column, &sample.event.name);
+				break;
+			case DC_SAMPLE_RBT:
+				sample.rbt = *prev;
+				break;
+			case DC_SAMPLE_HEARTBEAT:
+				sample.heartbeat = *prev;
+				break;
+			case DC_SAMPLE_BEARING:
+				sample.bearing = *prev;
+				break;
+			case DC_SAMPLE_VENDOR:
+				ok = archive_get_uint32 (column, &sample.vendor.type) &&
+					archive_get_uint (column, &size) &&
+					size <= (unsigned long long) (column->end - column->data);
+				if (ok) {
+					sample.vendor.size = size;
+					sample.vendor.data = column->data;
+					column->data += size;
+				}
+				break;
+			case DC_SAMPLE_SETPOINT:
+				ok = archive_get_value (column, prev, PRESSURE, &sample.setpoint);
+				break;
+			case DC_SAMPLE_PPO2:
+				ok = archive_get_value (column, prev, PRESSURE, &sample.ppo2);
+				break;
+			case DC_SAMPLE_CNS:
+				ok = archive_get_value (column, prev, FRACTION, &sample.cns);
+				break;
+			case DC_SAMPLE_DECO:
+				ok = archive_get_uint32 (column, &sample.deco.type) &&
+					archive_get_uint32 (column, &sample.deco.time) &&
+					archive_get_double (column, DEPTH, &sample.deco.depth);
+				break;
+			case DC_SAMPLE_GASMIX:
+				ok = archive_get_uint32 (column, &sample.gasmix);
+				break;
+			default:
+				ok = 0;
+				break;
+			}
+
+			ok = ok && archive_sample_valid (type, &sample, header.ngasmixes);
+
+			if (ok && callback)
+				callback (type, sample, userdata);
+		}
+	}
+
+	free (shapes);
+
+	if (!ok) {
+		ERROR (archive->context, "Invalid dive samples (%u).", index);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
@@ -55,7 +55,17 @@ array_reverse_bits (unsigned char data[], unsigned int size)
 int
 array_isequal (const unsigned char data[], unsigned int size, unsigned char value)
 {
-	for (unsigned int i = 0; i < size; ++i) {
+	// Compare eight bytes at once, against the value repeated eight times.
+	const unsigned long long pattern = 0x0101010101010101ULL * value;
+	unsigned int i = 0;
+	for (; i + 8 <= size; i += 8) {
+		unsigned long long word = 0;
+		memcpy (&word, data + i, sizeof (word));
+		if (word != pattern)
+			return 0;
+	}
+
+	for (; i < size; ++i) {
 		if (data[i] != value)
 			return 0;
 	}
@@ -68,11 +78,21 @@ const unsigned char *
 array_search_forward (const unsigned char *data, unsigned int size,
                       const unsigned char *marker, unsigned int msize)
 {
+	if (msize == 0)
+		return data;
+
+	// Locate the candidates with memchr, which is usually optimized to
+	// scan many bytes at once, and compare only those.
 	while (size >= msize) {
-		if (memcmp (data, marker, msize) == 0)
-			return data;
-		size--;
-		data++;
+		const unsigned char *p = (const unsigned char *) memchr (data, marker[0], size - msize + 1);
+		if (p == NULL)
+			return NULL;
+
+		if (memcmp (p + 1, marker + 1, msize - 1) == 0)
+			return p;
+
+		size -= p + 1 - data;
+		data = p + 1;
 	}
 	return NULL;
 }
@@ -82,12 +102,38 @@ const unsigned char *
 array_search_backward (const unsigned char *data, unsigned int size,
                        const unsigned char *marker, unsigned int msize)
 {
-	data += size;
-	while (size >= msize) {
-		if (memcmp (data - msize, marker, msize) == 0)
-			return data;
-		size--;
-		data--;
+	if (msize == 0)
+		return data + size;
+
+	if (size < msize)
+		return NULL;
+
+	// There is no portable memrchr, so skip the candidate positions
+	// eight at a time, as long as none of them contains the first byte
+	// of the marker (the zero byte test of the xor with that byte).
+	const unsigned long long ones = 0x0101010101010101ULL;
+	const unsigned long long mask = ones * marker[0];
+	unsigned int offset = size - msize + 1;
+	while (offset >= 8) {
+		unsigned long long word = 0;
+		memcpy (&word, data + offset - 8, sizeof (word));
+		word ^= mask;
+		if (((word - ones) & ~word & (ones << 7)) == 0) {
+			offset -= 8;
+			continue;
+		}
+
+		for (unsigned int i = 0; i < 8; ++i) {
+			offset--;
+			if (data[offset] == marker[0] && memcmp (data + offset + 1, marker + 1, msize - 1) == 0)
+				return data + offset + msize;
+		}
+	}
+
+	while (offset > 0) {
+		offset--;
+		if (data[offset] == marker[0] && memcmp (data + offset + 1, marker + 1, msize - 1) == 0)
+			return data + offset + msize;
 	}
 	return NULL;
 }
@@ -99,18 +145,27 @@ array_convert_bin2hex (const unsigned char input[], unsigned int isize, unsigned
 	if (osize != 2 * isize)
 		return -1;
 
-	const unsigned char ascii[] = {
-		'0', '1', '2', '3', '4', '5', '6', '7',
-		'8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
+	// The two hex digits of every byte value.
+	static const char ascii[] =
+		"000102030405060708090A0B0C0D0E0F"
+		"101112131415161718191A1B1C1D1E1F"
+		"202122232425262728292A2B2C2D2E2F"
+		"303132333435363738393A3B3C3D3E3F"
+		"404142434445464748494A4B4C4D4E4F"
+		"505152535455565758595A5B5C5D5E5F"
+		"606162636465666768696A6B6C6D6E6F"
+		"707172737475767778797A7B7C7D7E7F"
+		"808182838485868788898A8B8C8D8E8F"
+		"909192939495969798999A9B9C9D9E9F"
+		"A0A1A2A3A4A5A6A7A8A9AAABACADAEAF"
+		"B0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+		"C0C1C2C3C4C5C6C7C8C9CACBCCCDCECF"
+		"D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+		"E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEF"
+		"F0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
 
 	for (unsigned int i = 0; i < isize; ++i) {
-		// Set the most-significant nibble.
-		unsigned char msn = (input[i] >> 4) & 0x0F;
-		output[i * 2 + 0] = ascii[msn];
-
-		// Set the least-significant nibble.
-		unsigned char lsn = input[i] & 0x0F;
-		output[i * 2 + 1] = ascii[lsn];
+		memcpy (output + i * 2, ascii + input[i] * 2, 2);
 	}
 
 	return 0;
@@ -123,24 +178,33 @@ array_convert_hex2bin (const unsigned char input[], unsigned int isize, unsigned
 	if (isize != 2 * osize)
 		return -1;
 
+	// The value of every hex digit, or 0xFF for an invalid character.
+	static const unsigned char number[] = {
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+	};
+
 	for (unsigned int i = 0; i < osize; ++i) {
-		unsigned char value = 0;
-		for (unsigned int j = 0; j < 2; ++j) {
-			unsigned char number = 0;
-			unsigned char ascii = input[i * 2 + j];
-			if (ascii >= '0' && ascii <= '9')
-				number = ascii - '0';
-			else if (ascii >= 'A' && ascii <= 'F')
-				number = 10 + ascii - 'A';
-			else if (ascii >= 'a' && ascii <= 'f')
-				number = 10 + ascii - 'a';
-			else
-				return -1; /* Invalid character */
-
-			value <<= 4;
-			value += number;
-		}
-		output[i] = value;
+		unsigned char msn = number[input[i * 2 + 0]];
+		unsigned char lsn = number[input[i * 2 + 1]];
+		if ((msn | lsn) & 0xF0)
+			return -1; /* Invalid character */
+
+		output[i] = (msn << 4) | lsn;
 	}
 
 	return 0;
@@ -95,6 +95,7 @@ typedef int s_errcode_t;
 
 struct dc_bluetooth_t {
 	dc_context_t *context;
+	dc_stats_t *stats;
 #ifdef _WIN32
 	SOCKET fd;
 #else
@@ -167,6 +168,7 @@ dc_bluetooth_open (dc_bluetooth_t **out, dc_context_t *context)
 
 	// Library context.
 	device->context = context;
+	device->stats = NULL;
 
 	// Default to blocking reads.
 	device->timeout = -1;
@@ -276,6 +278,21 @@ dc_bluetooth_set_timeout (dc_bluetooth_t *device, int timeout)
 #endif
 }
 
+dc_status_t
+dc_bluetooth_set_stats (dc_bluetooth_t *device, dc_stats_t *stats)
+{
+#ifdef BLUETOOTH
+	if (device == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	device->stats = stats;
+
+	return DC_STATUS_SUCCESS;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
 dc_status_t
 dc_bluetooth_discover (dc_bluetooth_t *device, dc_bluetooth_callback_t callback, void *userdata)
 {
@@ -485,6 +502,8 @@ dc_bluetooth_read (dc_bluetooth_t *device, void *data, size_t size, size_t *actu
 		goto out_invalidargs;
 	}
 
+	unsigned long long start = dc_stats_clock (device->stats);
+
 	while (nbytes < size) {
 		fd_set fds;
 		FD_ZERO (&fds);
@@ -530,7 +549,8 @@ dc_bluetooth_read (dc_bluetooth_t *device, void *data, size_t size, size_t *actu
 	}
 
 out:
-	HEXDUMP (device->context, DC_LOGLEVEL_INFO, "Read", (unsigned char *) data, nbytes);
+	dc_stats_transfer (device->stats, DC_STATS_READ, start, nbytes, status);
+	TRACE (device->context, DC_TRACE_READ, "Read", (unsigned char *) data, nbytes);
 
 out_invalidargs:
 	if (actual)
@@ -554,6 +574,8 @@ dc_bluetooth_write (dc_bluetooth_t *device, const void *data, size_t size, size_
 		goto out_invalidargs;
 	}
 
+	unsigned long long start = dc_stats_clock (device->stats);
+
 	while (nbytes < size) {
 		fd_set fds;
 		FD_ZERO (&fds);
@@ -591,7 +613,8 @@ dc_bluetooth_write (dc_bluetooth_t *device, const void *data, size_t size, size_
 	}
 
 out:
-	HEXDUMP (device->context, DC_LOGLEVEL_INFO, "Write", (unsigned char *) data, nbytes);
+	dc_stats_transfer (device->stats, DC_STATS_WRITE, start, nbytes, status);
+	TRACE (device->context, DC_TRACE_WRITE, "Write", (unsigned char *) data, nbytes);
 
 out_invalidargs:
 	if (actual)
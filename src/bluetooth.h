@@ -24,6 +24,7 @@
 
 #include <libdivecomputer/common.h>
 #include <libdivecomputer/context.h>
+#include <libdivecomputer/device.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -104,6 +105,17 @@ dc_bluetooth_close (dc_bluetooth_t *bluetooth);
 dc_status_t
 dc_bluetooth_set_timeout (dc_bluetooth_t *bluetooth, int timeout);
 
+/**
+ * Set the statistics buffer for the transfers of the connection.
+ *
+ * @param[in]  bluetooth  A valid bluetooth connection.
+ * @param[in]  stats      The statistics buffer, or NULL to disable them.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_bluetooth_set_stats (dc_bluetooth_t *bluetooth, dc_stats_t *stats);
+
 /**
  * Enumerate the bluetooth devices.
  *
@@ -0,0 +1,466 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libdivecomputer/cache.h>
+#include <libdivecomputer/archive.h>
+#include <libdivecomputer/version.h>
+
+#include "context-private.h"
+#include "parser-private.h"
+#include "hash.h"
+#include "array.h"
+
+/*
+ * File layout (all fixed size integers are little endian):
+ *
+ *   header    "DCCA", version, library version (null padded)
+ *   archive   the parsed dives, with the cache key as the fingerprint
+ *
+ * The library version is part of the key as well, but a cache written
+ * by another version is discarded completely, instead of keeping all
+ * the dives which can't be found anymore.
+ */
+
+#define CACHE_MAGIC   "DCCA"
+#define CACHE_VERSION 3
+
+#define SZ_HEADER  32
+#define SZ_VERSION (SZ_HEADER - 8)
+#define SZ_KEY     16
+
+typedef struct cache_entry_t {
+	unsigned char key[SZ_KEY];
+	dc_buffer_t *buffer;
+	dc_archive_t *archive;
+} cache_entry_t;
+
+struct dc_cache_t {
+	dc_context_t *context;
+	dc_archive_t *archive;
+	cache_entry_t *entries;
+	unsigned int nentries;
+	unsigned int capacity;
+	unsigned int hits;
+	unsigned int misses;
+};
+
+typedef struct cache_parser_t {
+	dc_parser_t base;
+	dc_parser_vtable_t vtable;
+	dc_archive_t *archive;
+	unsigned int index;
+} cache_parser_t;
+
+static dc_status_t cache_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
+static dc_status_t cache_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
+static dc_status_t cache_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+
+static const dc_parser_vtable_t cache_parser_vtable = {
+	sizeof(cache_parser_t),
+	DC_FAMILY_NULL,
+	NULL, /* set_data */
+	cache_parser_get_datetime, /* datetime */
+	cache_parser_get_field, /* fields */
+	cache_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_range */
+	NULL /* destroy */
+};
+
+static void
+cache_version (unsigned char version[SZ_VERSION])
+{
+	size_t length = strlen (DC_VERSION);
+	if (length > SZ_VERSION)
+		length = SZ_VERSION;
+
+	memset (version, 0, SZ_VERSION);
+	memcpy (version, DC_VERSION, length);
+}
+
+static void
+cache_key (unsigned char key[SZ_KEY], dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, const unsigned char data[], unsigned int size)
+{
+	unsigned char header[8 + SZ_VERSION + 28];
+
+	memcpy (header, CACHE_MAGIC, 4);
+	array_uint32_le_set (header + 4, CACHE_VERSION);
+	cache_version (header + 8);
+	array_uint32_le_set (header + 8 + SZ_VERSION + 0, dc_descriptor_get_type (descriptor));
+	array_uint32_le_set (header + 8 + SZ_VERSION + 4, dc_descriptor_get_model (descriptor));
+	array_uint32_le_set (header + 8 + SZ_VERSION + 8, dc_descriptor_get_serial (descriptor));
+	array_uint32_le_set (header + 8 + SZ_VERSION + 12, devtime);
+	array_uint32_le_set (header + 8 + SZ_VERSION + 16, (unsigned long long) systime & 0xFFFFFFFF);
+	array_uint32_le_set (header + 8 + SZ_VERSION + 20, (unsigned long long) systime >> 32);
+	array_uint32_le_set (header + 8 + SZ_VERSION + 24, size);
+
+	// Two 64 bit hashes of the data, seeded with the hash of the
+	// header, form the 128 bit key.
+	unsigned long long seed = hash_xxh64 (header, sizeof (header), 0);
+	unsigned long long h1 = hash_xxh64 (data, size, seed);
+	unsigned long long h2 = hash_xxh64 (data, size, ~seed);
+	array_uint32_le_set (key + 0, h1 & 0xFFFFFFFF);
+	array_uint32_le_set (key + 4, h1 >> 32);
+	array_uint32_le_set (key + 8, h2 & 0xFFFFFFFF);
+	array_uint32_le_set (key + 12, h2 >> 32);
+}
+
+static dc_status_t
+cache_parser_create (dc_parser_t **out, dc_context_t *context, dc_family_t family, dc_archive_t *archive, unsigned int index)
+{
+	cache_parser_t *parser = (cache_parser_t *) dc_parser_allocate (context, &cache_parser_vtable);
+	if (parser == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	// Report the family of the cached dive, instead of the family of
+	// the cache parser itself.
+	parser->vtable = cache_parser_vtable;
+	parser->vtable.type = family;
+	parser->base.vtable = &parser->vtable;
+
+	parser->archive = archive;
+	parser->index = index;
+
+	*out = (dc_parser_t *) parser;
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+cache_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime)
+{
+	cache_parser_t *parser = (cache_parser_t *) abstract;
+
+	return dc_archive_get_datetime (parser->archive, parser->index, datetime);
+}
+
+static dc_status_t
+cache_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value)
+{
+	cache_parser_t *parser = (cache_parser_t *) abstract;
+
+	dc_status_t rc = dc_archive_get_field (parser->archive, parser->index, type, flags, value);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	// The archive strings point into the archive data, but the caller
+	// owns the strings returned by a parser.
+	if (type == DC_FIELD_STRING) {
+		dc_field_string_t *string = (dc_field_string_t *) value;
+		string->value = strdup (string->value);
+		if (string->value == NULL) {
+			ERROR (abstract->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+cache_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+{
+	cache_parser_t *parser = (cache_parser_t *) abstract;
+
+	return dc_archive_samples_foreach (parser->archive, parser->index, callback, userdata);
+}
+
+dc_status_t
+dc_cache_new (dc_cache_t **out, dc_context_t *context, const unsigned char data[], size_t size)
+{
+	dc_cache_t *cache = NULL;
+
+	if (out == NULL || (data == NULL && size))
+		return DC_STATUS_INVALIDARGS;
+
+	cache = (dc_cache_t *) malloc (sizeof (dc_cache_t));
+	if (cache == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	cache->context = context;
+	cache->archive = NULL;
+	cache->entries = NULL;
+	cache->nentries = 0;
+	cache->capacity = 0;
+	cache->hits = 0;
+	cache->misses = 0;
+
+	if (size) {
+		unsigned char version[SZ_VERSION];
+		cache_version (version);
+
+		if (size < SZ_HEADER || memcmp (data, CACHE_MAGIC, 4) != 0 ||
+			array_uint32_le (data + 4) != CACHE_VERSION) {
+			WARNING (context, "Ignoring the invalid cache.");
+		} else if (memcmp (data + 8, version, SZ_VERSION) != 0) {
+			INFO (context, "Ignoring the cache of another library version.");
+		} else if (dc_archive_open (&cache->archive, context, data + SZ_HEADER, size - SZ_HEADER) != DC_STATUS_SUCCESS) {
+			WARNING (context, "Ignoring the invalid cache.");
+			cache->archive = NULL;
+		}
+	}
+
+	*out = cache;
+
+	return DC_STATUS_SUCCESS;
+}
+
+/*
+ * Find a dive in the new dives, which are sorted by key. Without a
+ * match, the position where the dive should be inserted is returned.
+ */
+static int
+cache_find (dc_cache_t *cache, const unsigned char key[SZ_KEY], unsigned int *position)
+{
+	unsigned int lo = 0, hi = cache->nentries;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		int cmp = memcmp (cache->entries[mid].key, key, SZ_KEY);
+		if (cmp == 0) {
+			*position = mid;
+			return 1;
+		} else if (cmp < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	*position = lo;
+
+	return 0;
+}
+
+static dc_status_t
+cache_add (dc_cache_t *cache, const unsigned char key[SZ_KEY], unsigned int position, dc_parser_t *parser, cache_entry_t **out)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_archive_writer_t *writer = NULL;
+	dc_buffer_t *buffer = NULL;
+	dc_archive_t *archive = NULL;
+
+	if (cache->nentries == cache->capacity) {
+		unsigned int capacity = cache->capacity ? cache->capacity * 2 : 64;
+		cache_entry_t *entries = (cache_entry_t *) realloc (cache->entries, capacity * sizeof (cache_entry_t));
+		if (entries == NULL) {
+			ERROR (cache->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+
+		cache->entries = entries;
+		cache->capacity = capacity;
+	}
+
+	// Store the dive as an archive with a single dive.
+	buffer = dc_buffer_new (0);
+	if (buffer == NULL) {
+		ERROR (cache->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	rc = dc_archive_writer_new (&writer, cache->context);
+	if (rc != DC_STATUS_SUCCESS)
+		goto error;
+
+	rc = dc_archive_writer_add (writer, parser, key, SZ_KEY);
+	if (rc != DC_STATUS_SUCCESS)
+		goto error;
+
+	rc = dc_archive_writer_finish (writer, buffer);
+	if (rc != DC_STATUS_SUCCESS)
+		goto error;
+
+	rc = dc_archive_open (&archive, cache->context, dc_buffer_get_data (buffer), dc_buffer_get_size (buffer));
+	if (rc != DC_STATUS_SUCCESS)
+		goto error;
+
+	dc_archive_writer_free (writer);
+
+	cache_entry_t *entry = cache->entries + position;
+	memmove (entry + 1, entry, (cache->nentries - position) * sizeof (cache_entry_t));
+	cache->nentries++;
+	memcpy (entry->key, key, SZ_KEY);
+	entry->buffer = buffer;
+	entry->archive = archive;
+
+	*out = entry;
+
+	return DC_STATUS_SUCCESS;
+
+error:
+	dc_archive_writer_free (writer);
+	dc_buffer_free (buffer);
+	return rc;
+}
+
+dc_status_t
+dc_cache_parser_new (dc_parser_t **out, dc_cache_t *cache, dc_descriptor_t *descriptor, unsigned int devtime, dc_ticks_t systime, const unsigned char data[], unsigned int size)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_parser_t *parser = NULL;
+	cache_entry_t *entry = NULL;
+	unsigned char key[SZ_KEY];
+	unsigned int position = 0;
+
+	if (out == NULL || cache == NULL || (data == NULL && size))
+		return DC_STATUS_INVALIDARGS;
+
+	dc_family_t family = dc_descriptor_get_type (descriptor);
+
+	cache_key (key, descriptor, devtime, systime, data, size);
+
+	// Look up the dive in the cache.
+	if (cache->archive) {
+		unsigned int index = DC_ARCHIVE_NONE;
+		rc = dc_archive_find_fingerprint (cache->archive, key, sizeof (key), &index);
+		if (rc == DC_STATUS_SUCCESS && index != DC_ARCHIVE_NONE) {
+			// A corrupt dive is parsed again, like a dive which isn't
+			// cached, and is replaced when the cache is written.
+			rc = dc_archive_verify (cache->archive, index);
+			if (rc == DC_STATUS_SUCCESS) {
+				cache->hits++;
+				return cache_parser_create (out, cache->context, family, cache->archive, index);
+			}
+			WARNING (cache->context, "Ignoring the invalid dive in the cache (%u).", index);
+		}
+	}
+
+	// Look up the dive in the new dives, to parse it only once.
+	if (cache_find (cache, key, &position)) {
+		cache->hits++;
+		return cache_parser_create (out, cache->context, family, cache->entries[position].archive, 0);
+	}
+
+	cache->misses++;
+
+	// Parse the dive.
+	rc = dc_parser_new2 (&parser, cache->context, descriptor, devtime, systime);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	rc = dc_parser_set_data (parser, data, size);
+	if (rc != DC_STATUS_SUCCESS) {
+		dc_parser_destroy (parser);
+		return rc;
+	}
+
+	// A dive which can't be stored (for example because the parser
+	// fails) isn't cached, and the parser itself is returned instead,
+	// to report the same errors as without the cache.
+	rc = cache_add (cache, key, position, parser, &entry);
+	if (rc != DC_STATUS_SUCCESS) {
+		DEBUG (cache->context, "Failed to add the dive to the cache.");
+		*out = parser;
+		return DC_STATUS_SUCCESS;
+	}
+
+	dc_parser_destroy (parser);
+
+	return cache_parser_create (out, cache->context, family, entry->archive, 0);
+}
+
+dc_status_t
+dc_cache_get_stats (dc_cache_t *cache, unsigned int *hits, unsigned int *misses)
+{
+	if (cache == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (hits)
+		*hits = cache->hits;
+	if (misses)
+		*misses = cache->misses;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_cache_write (dc_cache_t *cache, dc_buffer_t *buffer)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_archive_writer_t *writer = NULL;
+
+	if (cache == NULL || buffer == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	rc = dc_archive_writer_new (&writer, cache->context);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	// The existing dives are copied without decoding them.
+	unsigned int count = dc_archive_get_count (cache->archive);
+	for (unsigned int i = 0; i < count; ++i) {
+		rc = dc_archive_writer_copy (writer, cache->archive, i);
+		if (rc == DC_STATUS_DATAFORMAT) {
+			WARNING (cache->context, "Dropping the invalid dive (%u).", i);
+		} else if (rc != DC_STATUS_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
+	// The new dives are unique, and already sorted by key.
+	for (unsigned int i = 0; i < cache->nentries; ++i) {
+		rc = dc_archive_writer_copy (writer, cache->entries[i].archive, 0);
+		if (rc != DC_STATUS_SUCCESS)
+			goto cleanup;
+	}
+
+	rc = dc_archive_writer_finish (writer, buffer);
+	if (rc != DC_STATUS_SUCCESS)
+		goto cleanup;
+
+	unsigned char header[SZ_HEADER];
+	memcpy (header, CACHE_MAGIC, 4);
+	array_uint32_le_set (header + 4, CACHE_VERSION);
+	cache_version (header + 8);
+	if (!dc_buffer_prepend (buffer, header, sizeof (header))) {
+		ERROR (cache->context, "Failed to allocate memory.");
+		rc = DC_STATUS_NOMEMORY;
+		goto cleanup;
+	}
+
+cleanup:
+	dc_archive_writer_free (writer);
+	return rc;
+}
+
+dc_status_t
+dc_cache_free (dc_cache_t *cache)
+{
+	if (cache == NULL)
+		return DC_STATUS_SUCCESS;
+
+	for (unsigned int i = 0; i < cache->nentries; ++i) {
+		dc_archive_close (cache->entries[i].archive);
+		dc_buffer_free (cache->entries[i].buffer);
+	}
+
+	dc_archive_close (cache->archive);
+	free (cache->entries);
+	free (cache);
+
+	return DC_STATUS_SUCCESS;
+}
@@ -82,6 +82,8 @@ citizen_aqualand_device_open (dc_device_t **out, dc_context_t *context, const ch
 		goto error_free;
 	}
 
+	dc_serial_set_stats (device->port, &device->base.stats);
+
 	// Set the serial communication protocol (4800 8N1).
 	status = dc_serial_configure (device->port, 4800, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -34,6 +34,11 @@
 
 #define MAXRETRIES 2
 
+#define T_BREAK     0
+#define T_BYTE      1
+#define T_COMMAND   2
+#define T_RECONNECT 3
+
 #define COCHRAN_MODEL_COMMANDER_PRE21000 0
 #define COCHRAN_MODEL_COMMANDER_AIR_NITROX 1
 #define COCHRAN_MODEL_EMC_14 2
@@ -116,6 +121,13 @@ static const dc_device_vtable_t cochran_commander_device_vtable = {
 	cochran_commander_device_close /* close */
 };
 
+static const dc_timing_t cochran_commander_timing[] = {
+	{"cochran.break",      16,   8,  100,  0, 0}, // Break duration to wake up the DC.
+	{"cochran.byte",       16,   4,  100,  0, 0}, // Gap between the command bytes.
+	{"cochran.command",    45,  15,  500, 15, 0}, // Processing time before the baudrate switch.
+	{"cochran.reconnect", 800, 100, 2000,  0, 0}, // Settle time before returning to 9600 baud.
+};
+
 // Cochran Commander pre-21000 s/n
 static const cochran_device_layout_t cochran_cmdr_1_device_layout = {
 	COCHRAN_MODEL_COMMANDER_PRE21000, // model
@@ -282,7 +294,7 @@ cochran_commander_serial_setup (cochran_commander_device_t *device)
 
 	// Wake up DC and trigger heartbeat
 	dc_serial_set_break(device->port, 1);
-	dc_serial_sleep(device->port, 16);
+	dc_serial_sleep(device->port, device_timing (&device->base, T_BREAK));
 	dc_serial_set_break(device->port, 0);
 
 	// Clear old heartbeats
@@ -321,7 +333,7 @@ cochran_commander_packet (cochran_commander_device_t *device, dc_event_progress_
 	// has no buffering.
 	for (unsigned int i = 0; i < csize; i++) {
 		// Give the DC time to read the character.
-		if (i) dc_serial_sleep(device->port, 16); // 16 ms
+		if (i) dc_serial_sleep(device->port, device_timing (abstract, T_BYTE));
 
 		status = dc_serial_write(device->port, command + i, 1, NULL);
 		if (status != DC_STATUS_SUCCESS) {
@@ -332,7 +344,7 @@ cochran_commander_packet (cochran_commander_device_t *device, dc_event_progress_
 
 	if (high_speed) {
 		// Give the DC time to process the command.
-		dc_serial_sleep(device->port, 45);
+		dc_serial_sleep(device->port, device_timing (abstract, T_COMMAND));
 
 		// Rates are odd, like 806400 for the EMC, 115200 for commander
 		status = dc_serial_configure(device->port, device->layout->baudrate, 8, DC_PARITY_NONE, DC_STOPBITS_TWO, DC_FLOWCONTROL_NONE);
@@ -458,7 +470,7 @@ cochran_commander_read (cochran_commander_device_t *device, dc_event_progress_t
 		return DC_STATUS_UNSUPPORTED;
 	}
 
-	dc_serial_sleep(device->port, 800);
+	dc_serial_sleep(device->port, device_timing (&device->base, T_RECONNECT));
 
 	// set back to 9600 baud
 	rc = cochran_commander_serial_setup(device);
@@ -479,22 +491,31 @@ cochran_commander_read_retry (cochran_commander_device_t *device, dc_event_progr
 	// Save the state of the progress events.
 	unsigned int saved = progress->current;
 
+	unsigned long long start = device_stats_begin (&device->base);
+
 	unsigned int nretries = 0;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	while ((rc = cochran_commander_read (device, progress, address, data, size)) != DC_STATUS_SUCCESS) {
 		// Automatically discard a corrupted packet,
 		// and request a new one.
 		if (rc != DC_STATUS_PROTOCOL && rc != DC_STATUS_TIMEOUT)
-			return rc;
+			break;
 
 		// Abort if the maximum number of retries is reached.
 		if (nretries++ >= MAXRETRIES)
-			return rc;
+			break;
+
+		device_stats_retry (&device->base);
+
+		// Give the DC more time to process the next command.
+		device_timing_backoff (&device->base, T_COMMAND);
 
 		// Restore the state of the progress events.
 		progress->current = saved;
 	}
 
+	device_stats_end (&device->base, start, rc);
+
 	return rc;
 }
 
@@ -713,6 +734,7 @@ cochran_commander_device_open (dc_device_t **out, dc_context_t *context, const c
 	// Set the default values.
 	device->port = NULL;
 	cochran_commander_device_set_fingerprint((dc_device_t *) device, NULL, 0);
+	device_timing_init ((dc_device_t *) device, cochran_commander_timing, C_ARRAY_SIZE(cochran_commander_timing));
 
 	// Open the device.
 	status = dc_serial_open (&device->port, device->base.context, name);
@@ -721,6 +743,8 @@ cochran_commander_device_open (dc_device_t **out, dc_context_t *context, const c
 		goto error_free;
 	}
 
+	dc_serial_set_stats (device->port, &device->base.stats);
+
 	status = cochran_commander_serial_setup(device);
 	if (status != DC_STATUS_SUCCESS) {
 		goto error_close;
@@ -20,12 +20,14 @@
  */
 
 #include <stdlib.h>
+#include <limits.h>
 #include <math.h>
 
 #include <libdivecomputer/units.h>
 
 #include "cochran_commander.h"
 #include "context-private.h"
+#include "datetime-private.h"
 #include "parser-private.h"
 #include "array.h"
 
@@ -98,10 +100,24 @@ typedef struct cochran_commander_parser_t {
 	unsigned int nevents;
 } cochran_commander_parser_t ;
 
+typedef struct cochran_commander_state_t {
+	unsigned int offset;
+	unsigned int size;
+	unsigned int corrupt_dive;
+	double start_depth;
+	unsigned int time, last_sample_time;
+	int depth;
+	unsigned int deco_obligation;
+	unsigned int deco_ceiling;
+	unsigned int last_gasmix;
+	const unsigned char *last_sample;
+} cochran_commander_state_t;
+
 static dc_status_t cochran_commander_parser_set_data (dc_parser_t *parser, const unsigned char *data, unsigned int size);
 static dc_status_t cochran_commander_parser_get_datetime (dc_parser_t *parser, dc_datetime_t *datetime);
 static dc_status_t cochran_commander_parser_get_field (dc_parser_t *parser, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t cochran_commander_parser_samples_foreach (dc_parser_t *parser, dc_sample_callback_t callback, void *userdata);
+static dc_status_t cochran_commander_parser_samples_range (dc_parser_t *parser, unsigned int begin, unsigned int end, dc_sample_callback_t callback, void *userdata);
 
 static const dc_parser_vtable_t cochran_commander_parser_vtable = {
 	sizeof(cochran_commander_parser_t),
@@ -110,6 +126,7 @@ static const dc_parser_vtable_t cochran_commander_parser_vtable = {
 	cochran_commander_parser_get_datetime, /* datetime */
 	cochran_commander_parser_get_field, /* fields */
 	cochran_commander_parser_samples_foreach, /* samples_foreach */
+	cochran_commander_parser_samples_range, /* samples_range */
 	NULL /* destroy */
 };
 
@@ -406,7 +423,7 @@ cochran_commander_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *dat
 			break;
 		case DATE_ENCODING_TICKS:
 			ts = array_uint32_le(data + layout->datetime) + COCHRAN_EPOCH;
-			dc_datetime_localtime(datetime, ts);
+			dc_datetime_localtime_cached(abstract->context, datetime, ts);
 			break;
 		}
 	}
@@ -505,82 +522,56 @@ cochran_commander_parser_get_field (dc_parser_t *abstract, dc_field_type_t type,
 
 
 static dc_status_t
-cochran_commander_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+cochran_commander_parser_walk (dc_parser_t *abstract, void *userstate, unsigned int end, sample_index_t *index, dc_sample_callback_t callback, void *userdata)
 {
 	cochran_commander_parser_t *parser = (cochran_commander_parser_t *) abstract;
+	cochran_commander_state_t *state = (cochran_commander_state_t *) userstate;
 	const cochran_parser_layout_t *layout = parser->layout;
 	const unsigned char *data = abstract->data;
 	const unsigned char *samples = data + layout->headersize;
-	const unsigned char *last_sample = NULL;
-
-	if (abstract->size < layout->headersize)
-		return DC_STATUS_DATAFORMAT;
-
-	unsigned int size = abstract->size - layout->headersize;
 
 	dc_sample_value_t sample = {0};
-	unsigned int time = 0, last_sample_time = 0;
-	unsigned int offset = 0;
-	double start_depth = 0;
-	int depth = 0;
-	unsigned int deco_obligation = 0;
-	unsigned int deco_ceiling = 0;
-	unsigned int corrupt_dive = 0;
-
-	// In rare circumstances Cochran computers won't record the end-of-dive
-	// log entry block. When the end-sample pointer is 0xFFFFFFFF it's corrupt.
-	// That means we don't really know where the dive samples end and we don't
-	// know what the dive summary values are (i.e. max depth, min temp)
-	if (array_uint32_le(data + layout->pt_profile_end) == 0xFFFFFFFF) {
-		corrupt_dive = 1;
-		dc_datetime_t d;
-		cochran_commander_parser_get_datetime(abstract, &d);
-
-		WARNING(abstract->context, "Incomplete dive on %02d/%02d/%02d at %02d:%02d:%02d, trying to parse samples",
-				d.year, d.month, d.day, d.hour, d.minute, d.second);
-
-		// Eliminate inter-dive events
-		size = cochran_commander_backparse(parser, samples, size);
-	}
 
 	// Cochran samples depth every second and varies between ascent rate
 	// and temp every other second.
 
-	// Prime values from the dive log section
-	if (parser->model == COCHRAN_MODEL_COMMANDER_AIR_NITROX ||
-		parser->model == COCHRAN_MODEL_COMMANDER_PRE21000) {
-		// Commander stores start depth in quarter-feet
-		start_depth = array_uint16_le (data + layout->start_depth) / 4.0;
-	} else {
-		// EMC stores start depth in 256ths of a foot.
-		start_depth = array_uint16_le (data + layout->start_depth) / 256.0;
-	}
+	// Report the values from the dive log section, unless resuming from
+	// a checkpoint.
+	if (state->offset == 0) {
+		sample.time = state->time;
+		if (callback) callback (DC_SAMPLE_TIME, sample, userdata);
 
-	last_sample_time = sample.time = time;
-	if (callback) callback (DC_SAMPLE_TIME, sample, userdata);
+		sample.depth = state->start_depth * FEET;
+		if (callback) callback (DC_SAMPLE_DEPTH, sample, userdata);
 
-	sample.depth = start_depth * FEET;
-	if (callback) callback (DC_SAMPLE_DEPTH, sample, userdata);
+		sample.temperature = (data[layout->start_temp] - 32.0) / 1.8;
+		if (callback) callback (DC_SAMPLE_TEMPERATURE, sample, userdata);
 
-	sample.temperature = (data[layout->start_temp] - 32.0) / 1.8;
-	if (callback) callback (DC_SAMPLE_TEMPERATURE, sample, userdata);
+		sample.gasmix = state->last_gasmix;
+		if (callback) callback(DC_SAMPLE_GASMIX, sample, userdata);
+	}
 
-	sample.gasmix = 0;
-	if (callback) callback(DC_SAMPLE_GASMIX, sample, userdata);
-	unsigned int last_gasmix = sample.gasmix;
+	while (state->offset < state->size) {
+		const unsigned char *s = samples + state->offset;
 
-	while (offset < size) {
-		const unsigned char *s = samples + offset;
+		if (state->time != state->last_sample_time) {
+			// Stop after the last sample in the requested range.
+			if (state->time > end)
+				return DC_STATUS_SUCCESS;
+
+			if (index && (state->time % SAMPLE_INDEX_INTERVAL) == 0)
+				sample_index_append (index, state->last_sample_time, state);
+		}
 
-		sample.time = time;
-		if (last_sample_time != sample.time) {
+		sample.time = state->time;
+		if (state->last_sample_time != sample.time) {
 			// We haven't issued this time yet.
-			last_sample_time = sample.time;
+			state->last_sample_time = sample.time;
 			if (callback) callback (DC_SAMPLE_TIME, sample, userdata);
 		}
 
 		// If corrupt_dive end before offset
-		if (corrupt_dive) {
+		if (state->corrupt_dive) {
 			// When we aren't sure where the sample data ends we can
 			// look for events that shouldn't be in the sample data.
 			// 0xFF is unwritten memory
@@ -592,7 +583,7 @@ cochran_commander_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callb
 				DEBUG(abstract->context, "Used corrupt dive breakout 1 on event %02x", s[0]);
 				break;
 			}
-			if (time > 1 && (s[0] == 0xE3 || s[0] == 0xF3)) {
+			if (state->time > 1 && (s[0] == 0xE3 || s[0] == 0xF3)) {
 				DEBUG(abstract->context, "Used corrupt dive breakout 2 on event %02x", s[0]);
 				break;
 			}
@@ -600,29 +591,29 @@ cochran_commander_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callb
 
 		// Check for event
 		if (s[0] & 0x80) {
-			offset += cochran_commander_handle_event(parser, s[0], callback, userdata);
+			state->offset += cochran_commander_handle_event(parser, s[0], callback, userdata);
 
 			// Events indicating change in deco status
 			switch (s[0]) {
 			case 0xC5:  // Deco obligation begins
-				deco_obligation = 1;
+				state->deco_obligation = 1;
 				break;
 			case 0xD8:  // Deco obligation ends
-				deco_obligation = 0;
+				state->deco_obligation = 0;
 				break;
 			case 0xAB:  // Decrement ceiling (deeper)
-				deco_ceiling += 10; // feet
+				state->deco_ceiling += 10; // feet
 
 				sample.deco.type = DC_DECO_DECOSTOP;
 				sample.deco.time = (array_uint16_le(s + 3) + 1) * 60;
-				sample.deco.depth = deco_ceiling * FEET;
+				sample.deco.depth = state->deco_ceiling * FEET;
 				if (callback) callback(DC_SAMPLE_DECO, sample, userdata);
 				break;
 			case 0xAD:  // Increment ceiling (shallower)
-				deco_ceiling -= 10; // feet
+				state->deco_ceiling -= 10; // feet
 
 				sample.deco.type = DC_DECO_DECOSTOP;
-				sample.deco.depth = deco_ceiling * FEET;
+				sample.deco.depth = state->deco_ceiling * FEET;
 				sample.deco.time = (array_uint16_le(s + 3) + 1) * 60;
 				if (callback) callback(DC_SAMPLE_DECO, sample, userdata);
 				break;
@@ -631,17 +622,17 @@ cochran_commander_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callb
 				break;
 			case 0xCD:  // Switched to deco blend
 			case 0xEF:  // Switched to gas blend 2
-				if (last_gasmix != 1) {
+				if (state->last_gasmix != 1) {
 					sample.gasmix = 1;
 					if (callback) callback(DC_SAMPLE_GASMIX, sample, userdata);
-					last_gasmix = sample.gasmix;
+					state->last_gasmix = sample.gasmix;
 				}
 				break;
 			case 0xF3:  // Switched to gas blend 1
-				if (last_gasmix != 0) {
+				if (state->last_gasmix != 0) {
 					sample.gasmix = 0;
 					if (callback) callback(DC_SAMPLE_GASMIX, sample, userdata);
-					last_gasmix = sample.gasmix;
+					state->last_gasmix = sample.gasmix;
 				}
 				break;
 			}
@@ -650,20 +641,20 @@ cochran_commander_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callb
 		}
 
 		// Make sure we have a full sample
-		if (offset + layout->samplesize > size)
+		if (state->offset + layout->samplesize > state->size)
 			break;
 
 		// Depth is logged as change in feet, bit 0x40 means negative depth
 		if (s[0] & 0x40)
-			depth -= (s[0] & 0x3f);
+			state->depth -= (s[0] & 0x3f);
 		else
-			depth += (s[0] & 0x3f);
+			state->depth += (s[0] & 0x3f);
 
-		sample.depth = (start_depth + depth / 4.0) * FEET;
+		sample.depth = (state->start_depth + state->depth / 4.0) * FEET;
 		if (callback) callback (DC_SAMPLE_DEPTH, sample, userdata);
 
 		// Ascent rate is logged in the 0th sample, temp in the 1st, repeat.
-		if (time % 2 == 0) {
+		if (state->time % 2 == 0) {
 			// Ascent rate
 			double ascent_rate = 0.0;
 			if (s[1] & 0x80)
@@ -687,10 +678,10 @@ cochran_commander_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callb
 			// The first 2 are either NDL or stop time at deepest stop (if in deco)
 			// The next 2 are total deco stop time.
 			unsigned int deco_time = 0;
-			switch (time % 24) {
+			switch (state->time % 24) {
 			case 21:
-				deco_time = last_sample[2] + s[2] * 256 + 1;
-				if (deco_obligation) {
+				deco_time = state->last_sample[2] + s[2] * 256 + 1;
+				if (state->deco_obligation) {
 					/* Deco time for deepest stop, unused */
 				} else {
 					/* Send deco NDL sample */
@@ -702,21 +693,98 @@ cochran_commander_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callb
 				break;
 			case 23:
 				/* Deco time, total obligation */
-				deco_time = last_sample[2] + s[2] * 256 + 1;
-				if (deco_obligation) {
+				deco_time = state->last_sample[2] + s[2] * 256 + 1;
+				if (state->deco_obligation) {
 					sample.deco.type = DC_DECO_DECOSTOP;
-					sample.deco.depth = deco_ceiling * FEET;
+					sample.deco.depth = state->deco_ceiling * FEET;
 					sample.deco.time = deco_time * 60;
 					if (callback) callback (DC_SAMPLE_DECO, sample, userdata);
 				}
 				break;
 			}
-			last_sample = s;
+			state->last_sample = s;
 		}
 
-		time++;
-		offset += layout->samplesize;
+		state->time++;
+		state->offset += layout->samplesize;
 	}
 
 	return DC_STATUS_SUCCESS;
 }
+
+static dc_status_t
+cochran_commander_parser_init (cochran_commander_parser_t *parser, cochran_commander_state_t *state)
+{
+	dc_parser_t *abstract = (dc_parser_t *) parser;
+	const cochran_parser_layout_t *layout = parser->layout;
+	const unsigned char *data = abstract->data;
+	const unsigned char *samples = data + layout->headersize;
+
+	if (abstract->size < layout->headersize)
+		return DC_STATUS_DATAFORMAT;
+
+	state->offset = 0;
+	state->size = abstract->size - layout->headersize;
+	state->corrupt_dive = 0;
+	state->time = 0;
+	state->last_sample_time = 0;
+	state->depth = 0;
+	state->deco_obligation = 0;
+	state->deco_ceiling = 0;
+	state->last_gasmix = 0;
+	state->last_sample = NULL;
+
+	// In rare circumstances Cochran computers won't record the end-of-dive
+	// log entry block. When the end-sample pointer is 0xFFFFFFFF it's corrupt.
+	// That means we don't really know where the dive samples end and we don't
+	// know what the dive summary values are (i.e. max depth, min temp)
+	if (array_uint32_le(data + layout->pt_profile_end) == 0xFFFFFFFF) {
+		state->corrupt_dive = 1;
+		dc_datetime_t d;
+		cochran_commander_parser_get_datetime(abstract, &d);
+
+		WARNING(abstract->context, "Incomplete dive on %02d/%02d/%02d at %02d:%02d:%02d, trying to parse samples",
+				d.year, d.month, d.day, d.hour, d.minute, d.second);
+
+		// Eliminate inter-dive events
+		state->size = cochran_commander_backparse(parser, samples, state->size);
+	}
+
+	// Prime values from the dive log section
+	if (parser->model == COCHRAN_MODEL_COMMANDER_AIR_NITROX ||
+		parser->model == COCHRAN_MODEL_COMMANDER_PRE21000) {
+		// Commander stores start depth in quarter-feet
+		state->start_depth = array_uint16_le (data + layout->start_depth) / 4.0;
+	} else {
+		// EMC stores start depth in 256ths of a foot.
+		state->start_depth = array_uint16_le (data + layout->start_depth) / 256.0;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+cochran_commander_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+{
+	cochran_commander_parser_t *parser = (cochran_commander_parser_t *) abstract;
+	cochran_commander_state_t state;
+
+	dc_status_t rc = cochran_commander_parser_init (parser, &state);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	return cochran_commander_parser_walk (abstract, &state, UINT_MAX, NULL, callback, userdata);
+}
+
+static dc_status_t
+cochran_commander_parser_samples_range (dc_parser_t *abstract, unsigned int begin, unsigned int end, dc_sample_callback_t callback, void *userdata)
+{
+	cochran_commander_parser_t *parser = (cochran_commander_parser_t *) abstract;
+	cochran_commander_state_t state;
+
+	dc_status_t rc = cochran_commander_parser_init (parser, &state);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	return sample_index_walk (abstract, begin, end, &state, sizeof (state), cochran_commander_parser_walk, callback, userdata);
+}
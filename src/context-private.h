@@ -26,7 +26,10 @@
 #include "config.h"
 #endif
 
+#include <stddef.h>
+
 #include <libdivecomputer/context.h>
+#include <libdivecomputer/device.h>
 #include <libdivecomputer/custom_io.h>
 
 #ifdef __cplusplus
@@ -49,6 +52,7 @@ extern "C" {
 
 #ifdef ENABLE_LOGGING
 #define HEXDUMP(context, loglevel, prefix, data, size) dc_context_hexdump (context, loglevel, __FILE__, __LINE__, FUNCTION, prefix, data, size)
+#define TRACE(context, type, prefix, data, size) dc_context_trace (context, type, __FILE__, __LINE__, FUNCTION, prefix, data, size)
 #define SYSERROR(context, errcode) dc_context_syserror (context, DC_LOGLEVEL_ERROR, __FILE__, __LINE__, FUNCTION, errcode)
 #define ERROR(context, ...) dc_context_log (context, DC_LOGLEVEL_ERROR, __FILE__, __LINE__, FUNCTION, __VA_ARGS__)
 #define WARNING(context, ...) dc_context_log (context, DC_LOGLEVEL_WARNING, __FILE__, __LINE__, FUNCTION, __VA_ARGS__)
@@ -56,6 +60,7 @@ extern "C" {
 #define DEBUG(context, ...) dc_context_log (context, DC_LOGLEVEL_DEBUG, __FILE__, __LINE__, FUNCTION, __VA_ARGS__)
 #else
 #define HEXDUMP(context, loglevel, prefix, data, size) UNUSED(context)
+#define TRACE(context, type, prefix, data, size) dc_context_trace (context, type, NULL, 0, NULL, prefix, data, size)
 #define SYSERROR(context, errcode) UNUSED(context)
 #define ERROR(context, ...) UNUSED(context)
 #define WARNING(context, ...) UNUSED(context)
@@ -72,6 +77,66 @@ dc_context_syserror (dc_context_t *context, dc_loglevel_t loglevel, const char *
 dc_status_t
 dc_context_hexdump (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *prefix, const unsigned char data[], unsigned int size);
 
+/*
+ * Record a transfer in the binary trace ring. Without a trace ring, the
+ * data is logged with HEXDUMP at the INFO level instead.
+ */
+dc_status_t
+dc_context_trace (dc_context_t *context, dc_trace_t type, const char *file, unsigned int line, const char *function, const char *prefix, const unsigned char data[], unsigned int size);
+
+dc_status_t
+dc_context_get_timing (dc_context_t *context, const char *name, unsigned int *value);
+
+/*
+ * Data shared by all parsers of a context, such as lookup tables that
+ * are expensive to build. The key identifies the owner of the data
+ * (typically the address of a static variable of the backend), and the
+ * destroy function is called when the context is freed.
+ *
+ * Parsers of the same context may run on different threads, so the
+ * shared data must only be looked up, added and modified while holding
+ * the context lock. The lock is not recursive.
+ */
+void
+dc_context_lock (dc_context_t *context);
+
+void
+dc_context_unlock (dc_context_t *context);
+
+void *
+dc_context_get_shared (dc_context_t *context, const void *key);
+
+dc_status_t
+dc_context_set_shared (dc_context_t *context, const void *key, void *data, void (*destroy) (void *data));
+
+/*
+ * Monotonic clock (microseconds), or zero on failure. Only on systems
+ * without clock_gettime, this falls back to the wall clock.
+ */
+unsigned long long
+dc_context_clock (void);
+
+/*
+ * Transfer statistics.
+ *
+ * The statistics are kept by the device, and collected by its transport.
+ * The driver passes the statistics buffer of the device to the transport
+ * after opening it (e.g. dc_serial_set_stats). These functions do nothing
+ * without a statistics buffer, and the clock returns zero, so the
+ * transport layer can always call them without a measurable overhead.
+ */
+unsigned long long
+dc_stats_clock (dc_stats_t *stats);
+
+void
+dc_stats_transfer (dc_stats_t *stats, dc_stats_class_t type, unsigned long long start, size_t nbytes, dc_status_t status);
+
+void
+dc_stats_sleep (dc_stats_t *stats, unsigned int milliseconds);
+
+void
+dc_stats_retry (dc_stats_t *stats);
+
 dc_custom_io_t*
 _dc_context_custom_io (dc_context_t *context);
 
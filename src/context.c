@@ -19,21 +19,89 @@
  * MA 02110-1301 USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <limits.h>
 
 #ifdef _WIN32
 #define NOGDI
 #include <windows.h>
 #else
 #include <sys/time.h>
+#include <time.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 #endif
 
 #include "context-private.h"
 #include <libdivecomputer/custom_io.h>
 
+#define MAXTIMING 16
+#define MAXSHARED 8
+
+#define TRACE_PADDING 0xFFFFFFFF
+#define TRACE_ALIGN(n) (((n) + 7) & ~7u)
+
+/*
+ * Full memory barrier, to publish the ring buffer contents before the
+ * index is updated (and the other way around on the consumer side).
+ */
+#if defined(_WIN32)
+#define BARRIER() MemoryBarrier ()
+#elif defined(__GNUC__)
+#define BARRIER() __sync_synchronize ()
+#else
+#define BARRIER()
+#endif
+
+typedef struct dc_context_timing_t {
+	char name[32];
+	unsigned int value;
+} dc_context_timing_t;
+
+typedef struct dc_context_shared_t {
+	const void *key;
+	void *data;
+	void (*destroy) (void *data);
+} dc_context_shared_t;
+
+/*
+ * Header of a record in the trace ring. The data follows immediately
+ * after the header, and the total size is padded to a multiple of
+ * eight bytes. A record that does not fit in the remaining space at the
+ * end of the ring is preceded by a padding record, or by nothing if
+ * there is not even room for a header.
+ */
+typedef struct dc_context_record_t {
+	unsigned long long timestamp;
+	const char *file;
+	const char *function;
+	unsigned int line;
+	unsigned int type;
+	unsigned int size;
+} dc_context_record_t;
+
+/*
+ * Single producer, single consumer ring buffer. The head and tail are
+ * free running counters, and the capacity is a power of two. Only the
+ * producer (the thread doing the I/O) modifies the head, and only the
+ * consumer modifies the tail.
+ */
+typedef struct dc_context_ring_t {
+	unsigned char *data;
+	unsigned int capacity;
+	volatile unsigned int head;
+	volatile unsigned int tail;
+	volatile unsigned int dropped;
+} dc_context_ring_t;
+
 struct dc_context_t {
 	dc_loglevel_t loglevel;
 	dc_logfunc_t logfunc;
@@ -48,6 +116,16 @@ struct dc_context_t {
 #endif
 	dc_custom_io_t *custom_io;
 	dc_user_device_t *user_device;
+	dc_context_timing_t timing[MAXTIMING];
+	unsigned int ntiming;
+	dc_context_ring_t trace;
+	dc_context_shared_t shared[MAXSHARED];
+	unsigned int nshared;
+#if defined(_WIN32)
+	CRITICAL_SECTION lock;
+#elif defined(HAVE_PTHREAD_H)
+	pthread_mutex_t lock;
+#endif
 };
 
 #ifdef ENABLE_LOGGING
@@ -200,6 +278,23 @@ dc_context_new (dc_context_t **out)
 
 	context->custom_io = NULL;
 
+	memset (context->timing, 0, sizeof (context->timing));
+	context->ntiming = 0;
+
+	memset (&context->trace, 0, sizeof (context->trace));
+
+	memset (context->shared, 0, sizeof (context->shared));
+	context->nshared = 0;
+
+#if defined(_WIN32)
+	InitializeCriticalSection (&context->lock);
+#elif defined(HAVE_PTHREAD_H)
+	if (pthread_mutex_init (&context->lock, NULL) != 0) {
+		free (context);
+		return DC_STATUS_NOMEMORY;
+	}
+#endif
+
 	*out = context;
 
 	return DC_STATUS_SUCCESS;
@@ -208,6 +303,19 @@ dc_context_new (dc_context_t **out)
 dc_status_t
 dc_context_free (dc_context_t *context)
 {
+	if (context) {
+		for (unsigned int i = 0; i < context->nshared; ++i) {
+			if (context->shared[i].destroy)
+				context->shared[i].destroy (context->shared[i].data);
+		}
+		free (context->trace.data);
+#if defined(_WIN32)
+		DeleteCriticalSection (&context->lock);
+#elif defined(HAVE_PTHREAD_H)
+		pthread_mutex_destroy (&context->lock);
+#endif
+	}
+
 	free (context);
 
 	return DC_STATUS_SUCCESS;
@@ -231,6 +339,205 @@ _dc_context_custom_io (dc_context_t *context)
 	return context->custom_io;
 }
 
+dc_status_t
+dc_context_set_timing (dc_context_t *context, const char *name, unsigned int value)
+{
+	if (context == NULL || name == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (strlen (name) >= sizeof (context->timing[0].name))
+		return DC_STATUS_INVALIDARGS;
+
+	// Replace an existing override.
+	for (unsigned int i = 0; i < context->ntiming; ++i) {
+		if (strcmp (context->timing[i].name, name) == 0) {
+			context->timing[i].value = value;
+			return DC_STATUS_SUCCESS;
+		}
+	}
+
+	if (context->ntiming >= MAXTIMING)
+		return DC_STATUS_NOMEMORY;
+
+	strcpy (context->timing[context->ntiming].name, name);
+	context->timing[context->ntiming].value = value;
+	context->ntiming++;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_context_get_timing (dc_context_t *context, const char *name, unsigned int *value)
+{
+	if (context == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	for (unsigned int i = 0; i < context->ntiming; ++i) {
+		if (strcmp (context->timing[i].name, name) == 0) {
+			if (value)
+				*value = context->timing[i].value;
+			return DC_STATUS_SUCCESS;
+		}
+	}
+
+	return DC_STATUS_UNSUPPORTED;
+}
+
+void
+dc_context_lock (dc_context_t *context)
+{
+	if (context == NULL)
+		return;
+
+#if defined(_WIN32)
+	EnterCriticalSection (&context->lock);
+#elif defined(HAVE_PTHREAD_H)
+	pthread_mutex_lock (&context->lock);
+#endif
+}
+
+void
+dc_context_unlock (dc_context_t *context)
+{
+	if (context == NULL)
+		return;
+
+#if defined(_WIN32)
+	LeaveCriticalSection (&context->lock);
+#elif defined(HAVE_PTHREAD_H)
+	pthread_mutex_unlock (&context->lock);
+#endif
+}
+
+void *
+dc_context_get_shared (dc_context_t *context, const void *key)
+{
+	if (context == NULL)
+		return NULL;
+
+	for (unsigned int i = 0; i < context->nshared; ++i) {
+		if (context->shared[i].key == key)
+			return context->shared[i].data;
+	}
+
+	return NULL;
+}
+
+dc_status_t
+dc_context_set_shared (dc_context_t *context, const void *key, void *data, void (*destroy) (void *data))
+{
+	if (context == NULL || key == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	for (unsigned int i = 0; i < context->nshared; ++i) {
+		if (context->shared[i].key == key)
+			return DC_STATUS_INVALIDARGS;
+	}
+
+	if (context->nshared >= MAXSHARED)
+		return DC_STATUS_NOMEMORY;
+
+	context->shared[context->nshared].key = key;
+	context->shared[context->nshared].data = data;
+	context->shared[context->nshared].destroy = destroy;
+	context->nshared++;
+
+	return DC_STATUS_SUCCESS;
+}
+
+unsigned long long
+dc_context_clock (void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER now, frequency;
+	QueryPerformanceFrequency (&frequency);
+	QueryPerformanceCounter (&now);
+	return (unsigned long long) (now.QuadPart / frequency.QuadPart) * 1000000 +
+		(unsigned long long) (now.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+#elif defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	struct timespec now;
+	if (clock_gettime (CLOCK_MONOTONIC, &now) != 0)
+		return 0;
+	return (unsigned long long) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#else
+	struct timeval now;
+	if (gettimeofday (&now, NULL) != 0)
+		return 0;
+	return (unsigned long long) now.tv_sec * 1000000 + now.tv_usec;
+#endif
+}
+
+unsigned long long
+dc_stats_clock (dc_stats_t *stats)
+{
+	if (stats == NULL)
+		return 0;
+
+	return dc_context_clock ();
+}
+
+void
+dc_stats_transfer (dc_stats_t *stats, dc_stats_class_t type, unsigned long long start, size_t nbytes, dc_status_t status)
+{
+	if (stats == NULL)
+		return;
+
+	// Elapsed time (microseconds). A failing clock, or a transfer that
+	// started before the statistics were enabled, counts as zero.
+	unsigned long long now = dc_stats_clock (stats);
+	unsigned long long elapsed = 0;
+	if (start && now > start)
+		elapsed = now - start;
+
+	switch (type) {
+	case DC_STATS_READ:
+		stats->nread += nbytes;
+		stats->waiting += elapsed;
+		break;
+	case DC_STATS_WRITE:
+		stats->nwritten += nbytes;
+		stats->waiting += elapsed;
+		break;
+	case DC_STATS_COMMAND:
+		stats->ntransfers++;
+		break;
+	default:
+		return;
+	}
+
+	if (status == DC_STATUS_TIMEOUT)
+		stats->ntimeouts++;
+
+	// Logarithmic histogram, with the first bucket for transfers
+	// below one millisecond, and the last one for everything above.
+	unsigned int bucket = 0;
+	unsigned long long milliseconds = elapsed / 1000;
+	while (milliseconds && bucket < DC_STATS_NBUCKETS - 1) {
+		milliseconds >>= 1;
+		bucket++;
+	}
+
+	stats->histogram[type][bucket]++;
+}
+
+void
+dc_stats_sleep (dc_stats_t *stats, unsigned int milliseconds)
+{
+	if (stats == NULL)
+		return;
+
+	stats->sleeping += (unsigned long long) milliseconds * 1000;
+}
+
+void
+dc_stats_retry (dc_stats_t *stats)
+{
+	if (stats == NULL)
+		return;
+
+	stats->nretries++;
+}
+
 dc_status_t
 dc_context_set_loglevel (dc_context_t *context, dc_loglevel_t loglevel)
 {
@@ -258,6 +565,153 @@ dc_context_set_logfunc (dc_context_t *context, dc_logfunc_t logfunc, void *userd
 	return DC_STATUS_SUCCESS;
 }
 
+dc_status_t
+dc_context_set_trace (dc_context_t *context, unsigned int size)
+{
+	if (context == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	free (context->trace.data);
+	memset (&context->trace, 0, sizeof (context->trace));
+
+	if (size == 0)
+		return DC_STATUS_SUCCESS;
+
+	// Round up to the next power of two, with room for at least
+	// a few records.
+	unsigned int capacity = 256;
+	while (capacity < size) {
+		if (capacity > UINT_MAX / 2)
+			return DC_STATUS_INVALIDARGS;
+		capacity *= 2;
+	}
+
+	context->trace.data = (unsigned char *) malloc (capacity);
+	if (context->trace.data == NULL)
+		return DC_STATUS_NOMEMORY;
+
+	context->trace.capacity = capacity;
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_context_get_trace (dc_context_t *context, dc_tracefunc_t tracefunc, void *userdata)
+{
+	if (context == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_context_ring_t *ring = &context->trace;
+	if (ring->data == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	const unsigned int hsize = TRACE_ALIGN (sizeof (dc_context_record_t));
+
+	unsigned int head = ring->head;
+	BARRIER ();
+
+	unsigned int tail = ring->tail;
+	while (tail != head) {
+		unsigned int offset = tail & (ring->capacity - 1);
+		unsigned int remaining = ring->capacity - offset;
+
+		// No room for a header at the end of the ring.
+		if (remaining < hsize) {
+			tail += remaining;
+			continue;
+		}
+
+		dc_context_record_t record;
+		memcpy (&record, ring->data + offset, sizeof (record));
+
+		if (record.type == TRACE_PADDING) {
+			tail += remaining;
+			continue;
+		}
+
+		if (tracefunc) {
+			tracefunc (context, (dc_trace_t) record.type, record.timestamp,
+				ring->data + offset + hsize, record.size,
+				record.file, record.line, record.function, userdata);
+		}
+
+		tail += TRACE_ALIGN (hsize + record.size);
+	}
+
+	BARRIER ();
+	ring->tail = tail;
+
+	unsigned int dropped = ring->dropped;
+	if (dropped) {
+		ring->dropped = 0;
+		WARNING (context, "Trace ring overflow (%u records dropped).", dropped);
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_context_trace (dc_context_t *context, dc_trace_t type, const char *file, unsigned int line, const char *function, const char *prefix, const unsigned char data[], unsigned int size)
+{
+	if (context == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	dc_context_ring_t *ring = &context->trace;
+	if (ring->data == NULL) {
+#ifdef ENABLE_LOGGING
+		return dc_context_hexdump (context, DC_LOGLEVEL_INFO, file, line, function, prefix, data, size);
+#else
+		return DC_STATUS_SUCCESS;
+#endif
+	}
+
+	const unsigned int hsize = TRACE_ALIGN (sizeof (dc_context_record_t));
+
+	unsigned int head = ring->head;
+	unsigned int tail = ring->tail;
+	BARRIER ();
+
+	unsigned int offset = head & (ring->capacity - 1);
+	unsigned int remaining = ring->capacity - offset;
+	unsigned int length = TRACE_ALIGN (hsize + size);
+
+	// Records that don't fit at the end of the ring are moved to the
+	// start, and the remaining space is skipped.
+	unsigned int skip = 0;
+	if (remaining < length)
+		skip = remaining;
+
+	if (size > ring->capacity || length > ring->capacity - skip ||
+		length + skip > ring->capacity - (head - tail)) {
+		ring->dropped++;
+		return DC_STATUS_NOMEMORY;
+	}
+
+	if (skip) {
+		if (skip >= hsize) {
+			dc_context_record_t padding = {0, NULL, NULL, 0, TRACE_PADDING, 0};
+			memcpy (ring->data + offset, &padding, sizeof (padding));
+		}
+		offset = 0;
+	}
+
+	dc_context_record_t record;
+	record.timestamp = dc_context_clock ();
+	record.file = file;
+	record.function = function;
+	record.line = line;
+	record.type = type;
+	record.size = size;
+	memcpy (ring->data + offset, &record, sizeof (record));
+	if (size)
+		memcpy (ring->data + offset + hsize, data, size);
+
+	BARRIER ();
+	ring->head = head + skip + length;
+
+	return DC_STATUS_SUCCESS;
+}
+
 dc_status_t
 dc_context_log (dc_context_t *context, dc_loglevel_t loglevel, const char *file, unsigned int line, const char *function, const char *format, ...)
 {
@@ -153,22 +153,28 @@ cressi_edy_packet (cressi_edy_device_t *device, const unsigned char command[], u
 static dc_status_t
 cressi_edy_transfer (cressi_edy_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize, int trailer)
 {
+	unsigned long long start = device_stats_begin (&device->base);
+
 	unsigned int nretries = 0;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	while ((rc = cressi_edy_packet (device, command, csize, answer, asize, trailer)) != DC_STATUS_SUCCESS) {
 		if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL)
-			return rc;
+			break;
 
 		// Abort if the maximum number of retries is reached.
 		if (nretries++ >= MAXRETRIES)
-			return rc;
+			break;
+
+		device_stats_retry (&device->base);
 
 		// Delay the next attempt.
 		dc_serial_sleep (device->port, 300);
 		dc_serial_purge (device->port, DC_DIRECTION_INPUT);
 	}
 
-	return DC_STATUS_SUCCESS;
+	device_stats_end (&device->base, start, rc);
+
+	return rc;
 }
 
 static dc_status_t
@@ -245,6 +251,8 @@ cressi_edy_device_open (dc_device_t **out, dc_context_t *context, const char *na
 		goto error_free;
 	}
 
+	dc_serial_set_stats (device->port, &device->base.stats);
+
 	// Set the serial communication protocol (1200 8N1).
 	status = dc_serial_configure (device->port, 1200, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -33,6 +33,8 @@
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &cressi_leonardo_device_vtable)
 
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
 #define SZ_MEMORY 32000
 
 #define RB_LOGBOOK_BEGIN 0x0100
@@ -47,6 +49,10 @@
 #define MAXRETRIES 4
 #define PACKETSIZE 32
 
+#define T_RETRY 0
+#define T_DTR   1
+#define T_RESET 2
+
 typedef struct cressi_leonardo_device_t {
 	dc_device_t base;
 	dc_serial_t *port;
@@ -70,6 +76,12 @@ static const dc_device_vtable_t cressi_leonardo_device_vtable = {
 	cressi_leonardo_device_close /* close */
 };
 
+static const dc_timing_t cressi_leonardo_timing[] = {
+	{"leonardo.retry", 100,  0, 1000, 50, TIMING_TURNAROUND}, // Drain time before retrying a corrupted packet.
+	{"leonardo.dtr",   200, 50, 1000,  0, 0}, // Duration of the DTR reset pulse.
+	{"leonardo.reset", 100, 20, 1000,  0, 0}, // Settle time after the DTR reset pulse.
+};
+
 static dc_status_t
 cressi_leonardo_extract_dives (dc_device_t *abstract, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
 
@@ -142,23 +154,29 @@ cressi_leonardo_packet (cressi_leonardo_device_t *device, const unsigned char co
 static dc_status_t
 cressi_leonardo_transfer (cressi_leonardo_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize)
 {
+	unsigned long long start = device_stats_begin (&device->base);
+
 	unsigned int nretries = 0;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	while ((rc = cressi_leonardo_packet (device, command, csize, answer, asize)) != DC_STATUS_SUCCESS) {
 		// Automatically discard a corrupted packet,
 		// and request a new one.
 		if (rc != DC_STATUS_PROTOCOL && rc != DC_STATUS_TIMEOUT)
-			return rc;
+			break;
 
 		// Abort if the maximum number of retries is reached.
 		if (nretries++ >= MAXRETRIES)
-			return rc;
+			break;
+
+		device_stats_retry (&device->base);
 
 		// Discard any garbage bytes.
-		dc_serial_sleep (device->port, 100);
+		dc_serial_sleep (device->port, device_timing_backoff (&device->base, T_RETRY));
 		dc_serial_purge (device->port, DC_DIRECTION_INPUT);
 	}
 
+	device_stats_end (&device->base, start, rc);
+
 	return rc;
 }
 
@@ -181,6 +199,7 @@ cressi_leonardo_device_open (dc_device_t **out, dc_context_t *context, const cha
 	// Set the default values.
 	device->port = NULL;
 	memset (device->fingerprint, 0, sizeof (device->fingerprint));
+	device_timing_init ((dc_device_t *) device, cressi_leonardo_timing, C_ARRAY_SIZE (cressi_leonardo_timing));
 
 	// Open the device.
 	status = dc_serial_open (&device->port, context, name);
@@ -189,6 +208,8 @@ cressi_leonardo_device_open (dc_device_t **out, dc_context_t *context, const cha
 		goto error_free;
 	}
 
+	dc_serial_set_stats (device->port, &device->base.stats);
+
 	// Set the serial communication protocol (115200 8N1).
 	status = dc_serial_configure (device->port, 115200, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -217,7 +238,7 @@ cressi_leonardo_device_open (dc_device_t **out, dc_context_t *context, const cha
 		goto error_close;
 	}
 
-	dc_serial_sleep (device->port, 200);
+	dc_serial_sleep (device->port, device_timing (&device->base, T_DTR));
 
 	// Clear the DTR line.
 	status = dc_serial_set_dtr (device->port, 0);
@@ -226,7 +247,7 @@ cressi_leonardo_device_open (dc_device_t **out, dc_context_t *context, const cha
 		goto error_close;
 	}
 
-	dc_serial_sleep (device->port, 100);
+	dc_serial_sleep (device->port, device_timing (&device->base, T_RESET));
 	dc_serial_purge (device->port, DC_DIRECTION_ALL);
 
 	*out = (dc_device_t *) device;
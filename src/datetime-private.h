@@ -0,0 +1,48 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2010 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#ifndef DC_DATETIME_PRIVATE_H
+#define DC_DATETIME_PRIVATE_H
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/datetime.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Local time conversions with the UTC offsets of the local time zone
+ * cached in the context, so the parsers don't have to go through the C
+ * library for every dive. Without a context, these are equivalent to
+ * dc_datetime_localtime and dc_datetime_mktime.
+ */
+
+dc_datetime_t *
+dc_datetime_localtime_cached (dc_context_t *context, dc_datetime_t *result, dc_ticks_t ticks);
+
+dc_ticks_t
+dc_datetime_mktime_cached (dc_context_t *context, const dc_datetime_t *dt);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* DC_DATETIME_PRIVATE_H */
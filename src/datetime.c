@@ -23,10 +23,54 @@
 #include "config.h"
 #endif
 
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <time.h>
 
 #include <libdivecomputer/datetime.h>
 
+#include "datetime-private.h"
+#include "context-private.h"
+
+#define SECONDS_PER_DAY 86400
+
+/*
+ * The UTC offsets of the local time zone are obtained from the C library
+ * and cached as a sorted table of intervals with a constant offset. On a
+ * cache miss, the interval around the timestamp is extended in steps of
+ * one day (up to eight weeks), and a transition is located by bisection.
+ */
+#define TZ_AHEAD 56
+#define TZ_MAXINTERVALS 64
+
+/*
+ * A step must never contain two transitions: a change and its reversal
+ * within the same step go unnoticed, and the bisection finds only one of
+ * them. The shortest time between two transitions in the tz database is
+ * almost four days (Africa/Freetown in 1939), and several zones change
+ * twice within one week (e.g. America/Recife in 2000), so the step is a
+ * single day.
+ */
+#define TZ_STEP  SECONDS_PER_DAY
+
+typedef struct dc_timezone_interval_t {
+	dc_ticks_t begin;
+	dc_ticks_t end;
+	int offset;
+} dc_timezone_interval_t;
+
+typedef struct dc_timezone_t {
+	dc_timezone_interval_t intervals[TZ_MAXINTERVALS];
+	unsigned int count;
+	// The TZ variable and the names of the time zone (standard and
+	// daylight saving time) the table was built for.
+	char *zone[3];
+} dc_timezone_t;
+
+// The key of the time zone table in the context.
+static const char timezone_key = 0;
+
 static struct tm *
 dc_localtime_r (const time_t *t, struct tm *tm)
 {
@@ -44,21 +88,293 @@ dc_localtime_r (const time_t *t, struct tm *tm)
 #endif
 }
 
-static struct tm *
-dc_gmtime_r (const time_t *t, struct tm *tm)
+static long long
+floordiv (long long a, long long b)
 {
-#ifdef HAVE_GMTIME_R
-	return gmtime_r (t, tm);
-#else
-	struct tm *p = gmtime (t);
-	if (p == NULL)
+	long long q = a / b;
+	if ((a % b) != 0 && ((a < 0) != (b < 0)))
+		q--;
+	return q;
+}
+
+/*
+ * Number of days since 1970-01-01 in the proleptic Gregorian calendar.
+ * The year is shifted to start in March, so the leap day is the last day
+ * of the year, and split into 400 year eras of 146097 days.
+ */
+static long long
+days_from_civil (long long year, long long month, long long day)
+{
+	// Normalize the month.
+	long long m = month - 1;
+	year += floordiv (m, 12);
+	m -= floordiv (m, 12) * 12;
+
+	if (m < 2)
+		year--;
+
+	long long era = floordiv (year, 400);
+	long long yoe = year - era * 400;
+	long long doy = (153 * (m < 2 ? m + 10 : m - 2) + 2) / 5 + day - 1;
+	long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - 719468;
+}
+
+static int
+civil_from_ticks (dc_datetime_t *result, dc_ticks_t ticks)
+{
+	long long days = floordiv (ticks, SECONDS_PER_DAY);
+	long long seconds = ticks - days * SECONDS_PER_DAY;
+
+	long long z = days + 719468;
+	long long era = floordiv (z, 146097);
+	long long doe = z - era * 146097;
+	long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	long long doy = doe - (yoe * 365 + yoe / 4 - yoe / 100);
+	long long mp = (5 * doy + 2) / 153;
+	long long month = mp < 10 ? mp + 3 : mp - 9;
+	long long year = era * 400 + yoe + (month <= 2);
+
+	// Same range as the tm structure.
+	if (year > INT_MAX || year - 1900 < INT_MIN)
+		return -1;
+
+	if (result) {
+		result->year = year;
+		result->month = month;
+		result->day = doy - (153 * mp + 2) / 5 + 1;
+		result->hour = seconds / 3600;
+		result->minute = (seconds % 3600) / 60;
+		result->second = seconds % 60;
+	}
+
+	return 0;
+}
+
+static int
+timezone_probe (dc_ticks_t ticks, int *offset)
+{
+	time_t t = ticks;
+	if (t != ticks)
+		return -1;
+
+	struct tm tm;
+	if (dc_localtime_r (&t, &tm) == NULL)
+		return -1;
+
+	long long local = days_from_civil (tm.tm_year + 1900LL, tm.tm_mon + 1, tm.tm_mday) * SECONDS_PER_DAY +
+		tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+
+	*offset = local - ticks;
+
+	return 0;
+}
+
+/*
+ * Extend the interval [begin,end] with offset in one direction (+1 or
+ * -1), and return the new boundary.
+ */
+static dc_ticks_t
+timezone_extend (dc_ticks_t boundary, int offset, int direction)
+{
+	for (unsigned int i = 0; i < TZ_AHEAD; ++i) {
+		if ((direction > 0 && boundary > LLONG_MAX - TZ_STEP) ||
+			(direction < 0 && boundary < LLONG_MIN + TZ_STEP))
+			break;
+
+		dc_ticks_t next = boundary + direction * TZ_STEP;
+
+		int value = 0;
+		if (timezone_probe (next, &value) != 0)
+			break;
+
+		if (value == offset) {
+			boundary = next;
+			continue;
+		}
+
+		// Locate the transition.
+		while (next - boundary > 1 || boundary - next > 1) {
+			dc_ticks_t middle = boundary + (next - boundary) / 2;
+			if (timezone_probe (middle, &value) != 0)
+				break;
+			if (value == offset) {
+				boundary = middle;
+			} else {
+				next = middle;
+			}
+		}
+		break;
+	}
+
+	return boundary;
+}
+
+static const dc_timezone_interval_t *
+timezone_lookup (dc_timezone_t *tz, dc_ticks_t ticks)
+{
+	// Find the last interval starting before the timestamp.
+	unsigned int lo = 0, hi = tz->count;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (tz->intervals[mid].begin <= ticks) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (lo > 0 && ticks <= tz->intervals[lo - 1].end)
+		return tz->intervals + lo - 1;
+
+	int offset = 0;
+	if (timezone_probe (ticks, &offset) != 0)
 		return NULL;
 
-	if (tm)
-		*tm = *p;
+	dc_ticks_t begin = timezone_extend (ticks, offset, -1);
+	dc_ticks_t end = timezone_extend (ticks, offset, +1);
 
-	return tm;
+	// Merge with the overlapping and adjacent intervals. Overlapping
+	// intervals with another offset are outdated and dropped.
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < tz->count; ++i) {
+		const dc_timezone_interval_t *interval = tz->intervals + i;
+		if (interval->end < begin - 1 || interval->begin > end + 1 ||
+			(interval->offset != offset && (interval->end < begin || interval->begin > end))) {
+			tz->intervals[count++] = *interval;
+		} else if (interval->offset == offset) {
+			if (begin > interval->begin)
+				begin = interval->begin;
+			if (end < interval->end)
+				end = interval->end;
+		}
+	}
+
+	// Start over when the table is full.
+	if (count == TZ_MAXINTERVALS)
+		count = 0;
+
+	unsigned int n = count;
+	while (n > 0 && tz->intervals[n - 1].begin > begin) {
+		tz->intervals[n] = tz->intervals[n - 1];
+		n--;
+	}
+
+	tz->intervals[n].begin = begin;
+	tz->intervals[n].end = end;
+	tz->intervals[n].offset = offset;
+	tz->count = count + 1;
+
+	return tz->intervals + n;
+}
+
+static dc_datetime_t *
+timezone_localtime (dc_timezone_t *tz, dc_datetime_t *result, dc_ticks_t ticks)
+{
+	const dc_timezone_interval_t *interval = timezone_lookup (tz, ticks);
+	if (interval == NULL)
+		return NULL;
+
+	if (civil_from_ticks (result, ticks + interval->offset) != 0)
+		return NULL;
+
+	return result;
+}
+
+static dc_ticks_t
+timezone_mktime (dc_timezone_t *tz, const dc_datetime_t *dt)
+{
+	dc_ticks_t local = dc_datetime_timegm (dt);
+
+	// All candidates are within one day of the local time. If the
+	// offset is constant over that range, the solution is unique and
+	// there is no need to guess the daylight saving time like mktime.
+	const dc_timezone_interval_t *interval = NULL;
+	if (timezone_lookup (tz, local + 2 * SECONDS_PER_DAY) == NULL ||
+		(interval = timezone_lookup (tz, local - 2 * SECONDS_PER_DAY)) == NULL ||
+		interval->end < local + 2 * SECONDS_PER_DAY)
+		return dc_datetime_mktime (dt);
+
+	return local - interval->offset;
+}
+
+static int
+timezone_same (const char *a, const char *b)
+{
+	if (a == NULL || b == NULL)
+		return a == b;
+
+	return strcmp (a, b) == 0;
+}
+
+/*
+ * Clear the table when the time zone changed since the table was built,
+ * either with the TZ variable, or with the names of the time zone, which
+ * are updated by tzset (e.g. when the system time zone changes).
+ */
+static void
+timezone_validate (dc_timezone_t *tz)
+{
+	const char *zone[3] = {getenv ("TZ"), NULL, NULL};
+#if defined(HAVE_DECL_TZNAME) && HAVE_DECL_TZNAME
+	zone[1] = tzname[0];
+	zone[2] = tzname[1];
 #endif
+
+	unsigned int i = 0;
+	while (i < 3 && timezone_same (tz->zone[i], zone[i]))
+		i++;
+	if (i == 3)
+		return;
+
+	tz->count = 0;
+	for (i = 0; i < 3; ++i) {
+		free (tz->zone[i]);
+		tz->zone[i] = zone[i] ? strdup (zone[i]) : NULL;
+	}
+}
+
+static void
+timezone_free (void *data)
+{
+	dc_timezone_t *tz = (dc_timezone_t *) data;
+
+	for (unsigned int i = 0; i < 3; ++i)
+		free (tz->zone[i]);
+	free (tz);
+}
+
+/*
+ * Get the interval table of the context. The table is only accessed
+ * with the context lock held.
+ */
+static dc_timezone_t *
+timezone_get (dc_context_t *context)
+{
+	dc_timezone_t *tz = (dc_timezone_t *) dc_context_get_shared (context, &timezone_key);
+	if (tz) {
+		timezone_validate (tz);
+		return tz;
+	}
+
+	if (context == NULL)
+		return NULL;
+
+	tz = (dc_timezone_t *) malloc (sizeof (dc_timezone_t));
+	if (tz == NULL)
+		return NULL;
+
+	tz->count = 0;
+	memset (tz->zone, 0, sizeof (tz->zone));
+	timezone_validate (tz);
+
+	if (dc_context_set_shared (context, &timezone_key, tz, timezone_free) != DC_STATUS_SUCCESS) {
+		timezone_free (tz);
+		return NULL;
+	}
+
+	return tz;
 }
 
 dc_ticks_t
@@ -93,21 +409,9 @@ dc_datetime_t *
 dc_datetime_gmtime (dc_datetime_t *result,
                     dc_ticks_t ticks)
 {
-	time_t t = ticks;
-
-	struct tm tm;
-	if (dc_gmtime_r (&t, &tm) == NULL)
+	if (civil_from_ticks (result, ticks) != 0)
 		return NULL;
 
-	if (result) {
-		result->year = tm.tm_year + 1900;
-		result->month = tm.tm_mon + 1;
-		result->day = tm.tm_mday;
-		result->hour = tm.tm_hour;
-		result->minute = tm.tm_min;
-		result->second = tm.tm_sec;
-	}
-
 	return result;
 }
 
@@ -128,3 +432,83 @@ dc_datetime_mktime (const dc_datetime_t *dt)
 
 	return mktime (&tm);
 }
+
+dc_ticks_t
+dc_datetime_timegm (const dc_datetime_t *dt)
+{
+	if (dt == NULL)
+		return -1;
+
+	return days_from_civil (dt->year, dt->month, dt->day) * SECONDS_PER_DAY +
+		dt->hour * 3600LL + dt->minute * 60LL + dt->second;
+}
+
+dc_datetime_t *
+dc_datetime_localtime_cached (dc_context_t *context, dc_datetime_t *result, dc_ticks_t ticks)
+{
+	// The lookups update the table, which is shared by all parsers of
+	// the context.
+	dc_context_lock (context);
+	dc_timezone_t *tz = timezone_get (context);
+	if (tz)
+		result = timezone_localtime (tz, result, ticks);
+	dc_context_unlock (context);
+
+	if (tz == NULL)
+		return dc_datetime_localtime (result, ticks);
+
+	return result;
+}
+
+dc_ticks_t
+dc_datetime_mktime_cached (dc_context_t *context, const dc_datetime_t *dt)
+{
+	if (dt == NULL)
+		return -1;
+
+	dc_ticks_t ticks = -1;
+
+	dc_context_lock (context);
+	dc_timezone_t *tz = timezone_get (context);
+	if (tz)
+		ticks = timezone_mktime (tz, dt);
+	dc_context_unlock (context);
+
+	if (tz == NULL)
+		return dc_datetime_mktime (dt);
+
+	return ticks;
+}
+
+dc_status_t
+dc_datetime_localtime_batch (dc_datetime_t result[], const dc_ticks_t ticks[], unsigned int count)
+{
+	if (count && (result == NULL || ticks == NULL))
+		return DC_STATUS_INVALIDARGS;
+
+	// The table only lives for this call, so it does not need to be
+	// invalidated when the time zone changes.
+	dc_timezone_t tz;
+	tz.count = 0;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		if (timezone_localtime (&tz, result + i, ticks[i]) == NULL)
+			return DC_STATUS_DATAFORMAT;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+dc_status_t
+dc_datetime_gmtime_batch (dc_datetime_t result[], const dc_ticks_t ticks[], unsigned int count)
+{
+	if (count && (result == NULL || ticks == NULL))
+		return DC_STATUS_INVALIDARGS;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		if (civil_from_ticks (result + i, ticks[i]) != 0)
+			return DC_STATUS_DATAFORMAT;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
@@ -35,6 +35,38 @@ extern "C" {
 
 #define EVENT_PROGRESS_INITIALIZER {0, UINT_MAX}
 
+#define TIMING_MAX 8
+
+/*
+ * Protocol timing parameter.
+ *
+ * The name is prefixed with the name of the driver (e.g. "atom2.delay"),
+ * to avoid clashes between the overrides of different drivers. The value
+ * is the default delay (in milliseconds), and the minimum and maximum
+ * are the bounds enforced on both the user overrides and the runtime
+ * adjustments.
+ *
+ * A non-zero step marks an adaptive parameter, which is increased by that
+ * amount for every retry of an exchange after the first one (see
+ * device_timing_backoff). With the TIMING_TURNAROUND flag, it is also
+ * raised to the measured turnaround time of the successful exchanges. After
+ * a series of successful exchanges, the parameter decays again by one step,
+ * until it is back at its initial value, or for the TIMING_TURNAROUND
+ * parameters at the measured turnaround time (but not below the minimum).
+ *
+ * The initializers always list all six fields, including the flags.
+ */
+#define TIMING_TURNAROUND 0x01
+
+typedef struct dc_timing_t {
+	const char *name;
+	unsigned int value;
+	unsigned int minimum;
+	unsigned int maximum;
+	unsigned int step;
+	unsigned int flags;
+} dc_timing_t;
+
 struct dc_device_t;
 struct dc_device_vtable_t;
 
@@ -54,6 +86,23 @@ struct dc_device_t {
 	// Cached events for the parsers.
 	dc_event_devinfo_t devinfo;
 	dc_event_clock_t clock;
+	// Protocol timing parameters.
+	const dc_timing_t *timing;
+	unsigned int ntiming;
+	unsigned int timing_value[TIMING_MAX];
+	unsigned int timing_initial[TIMING_MAX];
+	unsigned int timing_failed;
+	unsigned int timing_successes;
+	unsigned long long timing_turnaround;
+	// Transfer statistics.
+	dc_stats_t stats;
+	// Progress event throttling.
+	unsigned int progress_interval;
+	unsigned int progress_delta;
+	unsigned int progress_pending;
+	unsigned long long progress_time;
+	dc_event_progress_t progress_last;
+	dc_event_progress_t progress_next;
 };
 
 struct dc_device_vtable_t {
@@ -86,9 +135,35 @@ dc_device_deallocate (dc_device_t *device);
 void
 device_event_emit (dc_device_t *device, dc_event_type_t event, const void *data);
 
+void
+device_event_flush (dc_device_t *device);
+
 int
 device_is_cancelled (dc_device_t *device);
 
+void
+device_timing_init (dc_device_t *device, const dc_timing_t timing[], unsigned int count);
+
+unsigned int
+device_timing (dc_device_t *device, unsigned int id);
+
+unsigned int
+device_timing_backoff (dc_device_t *device, unsigned int id);
+
+/*
+ * Mark the begin and end of an exchange with the device. Besides the
+ * transfer statistics, this measures the turnaround time and decays the
+ * adaptive timing parameters after a series of successful exchanges.
+ */
+unsigned long long
+device_stats_begin (dc_device_t *device);
+
+void
+device_stats_end (dc_device_t *device, unsigned long long start, dc_status_t status);
+
+void
+device_stats_retry (dc_device_t *device);
+
 dc_status_t
 device_dump_read (dc_device_t *device, unsigned char data[], unsigned int size, unsigned int blocksize);
 
@@ -90,6 +90,23 @@ dc_device_allocate (dc_context_t *context, const dc_device_vtable_t *vtable)
 	memset (&device->devinfo, 0, sizeof (device->devinfo));
 	memset (&device->clock, 0, sizeof (device->clock));
 
+	device->timing = NULL;
+	device->ntiming = 0;
+	memset (device->timing_value, 0, sizeof (device->timing_value));
+	memset (device->timing_initial, 0, sizeof (device->timing_initial));
+	device->timing_failed = 0;
+	device->timing_successes = 0;
+	device->timing_turnaround = 0;
+
+	memset (&device->stats, 0, sizeof (device->stats));
+
+	device->progress_interval = 0;
+	device->progress_delta = 0;
+	device->progress_pending = 0;
+	device->progress_time = 0;
+	memset (&device->progress_last, 0, sizeof (device->progress_last));
+	memset (&device->progress_next, 0, sizeof (device->progress_next));
+
 	return device;
 }
 
@@ -268,6 +285,30 @@ dc_device_set_events (dc_device_t *device, unsigned int events, dc_event_callbac
 }
 
 
+/*
+ * Throttle the progress events. An event is only delivered if at least
+ * interval milliseconds have elapsed, and the progress has increased by
+ * at least delta, since the last delivered event. The first and final
+ * events are always delivered. Passing zero for both values (which is
+ * the default) delivers every event.
+ */
+dc_status_t
+dc_device_set_progress (dc_device_t *device, unsigned int interval, unsigned int delta)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	device->progress_interval = interval;
+	device->progress_delta = delta;
+	device->progress_pending = 0;
+	device->progress_time = 0;
+	memset (&device->progress_last, 0, sizeof (device->progress_last));
+	memset (&device->progress_next, 0, sizeof (device->progress_next));
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 dc_status_t
 dc_device_set_fingerprint (dc_device_t *device, const unsigned char data[], unsigned int size)
 {
@@ -281,6 +322,213 @@ dc_device_set_fingerprint (dc_device_t *device, const unsigned char data[], unsi
 }
 
 
+// Number of successful exchanges before the adaptive parameters decay.
+#define TIMING_DECAY 8
+
+static unsigned int
+device_timing_clamp (const dc_timing_t *timing, unsigned int value)
+{
+	if (value < timing->minimum)
+		return timing->minimum;
+	if (value > timing->maximum)
+		return timing->maximum;
+	return value;
+}
+
+
+static const dc_timing_t *
+device_timing_lookup (dc_device_t *device, const char *name, unsigned int *id)
+{
+	for (unsigned int i = 0; i < device->ntiming; ++i) {
+		if (strcmp (device->timing[i].name, name) == 0) {
+			if (id)
+				*id = i;
+			return device->timing + i;
+		}
+	}
+
+	return NULL;
+}
+
+
+void
+device_timing_init (dc_device_t *device, const dc_timing_t timing[], unsigned int count)
+{
+	assert (device != NULL);
+	assert (count <= TIMING_MAX);
+
+	device->timing = timing;
+	device->ntiming = count;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		// Apply the user override (if any) from the context.
+		unsigned int value = timing[i].value;
+		if (dc_context_get_timing (device->context, timing[i].name, &value) == DC_STATUS_SUCCESS) {
+			INFO (device->context, "Timing: %s=%u ms (default %u ms)", timing[i].name, value, timing[i].value);
+		}
+
+		device->timing_value[i] = device_timing_clamp (timing + i, value);
+		device->timing_initial[i] = device->timing_value[i];
+	}
+}
+
+
+unsigned int
+device_timing (dc_device_t *device, unsigned int id)
+{
+	assert (device != NULL);
+	assert (id < device->ntiming);
+
+	return device->timing_value[id];
+}
+
+
+unsigned int
+device_timing_backoff (dc_device_t *device, unsigned int id)
+{
+	assert (device != NULL);
+	assert (id < device->ntiming);
+
+	const dc_timing_t *timing = device->timing + id;
+
+	// Exclude this exchange from the turnaround measurements. The first
+	// retry of an exchange uses the current value, and only the next
+	// retries back off.
+	if (device->timing_failed++ == 0)
+		return device->timing_value[id];
+
+	// Fixed parameters are never adjusted at runtime.
+	if (timing->step == 0)
+		return device->timing_value[id];
+
+	unsigned int value = device->timing_value[id];
+	if (value < timing->maximum) {
+		value = device_timing_clamp (timing, value + timing->step);
+
+		// Wait at least for the measured turnaround time.
+		if (timing->flags & TIMING_TURNAROUND) {
+			unsigned long long turnaround = (device->timing_turnaround + 999) / 1000;
+			if (turnaround > timing->maximum)
+				value = timing->maximum;
+			else if (turnaround > value)
+				value = turnaround;
+		}
+
+		DEBUG (device->context, "Timing: %s increased to %u ms", timing->name, value);
+		device->timing_value[id] = value;
+	}
+
+	return value;
+}
+
+
+static void
+device_timing_exchange (dc_device_t *device, unsigned long long elapsed, dc_status_t status)
+{
+	// Only the exchanges that succeeded without any retries are taken
+	// into account. Any failure restarts the series.
+	if (status != DC_STATUS_SUCCESS || device->timing_failed) {
+		device->timing_failed = 0;
+		device->timing_successes = 0;
+		return;
+	}
+
+	// Moving average of the turnaround time.
+	if (device->timing_turnaround == 0)
+		device->timing_turnaround = elapsed;
+	else
+		device->timing_turnaround = (device->timing_turnaround * 7 + elapsed) / 8;
+
+	if (++device->timing_successes < TIMING_DECAY)
+		return;
+
+	device->timing_successes = 0;
+
+	// Decay the adaptive parameters towards their initial value, or
+	// towards the measured turnaround time (which can be below the
+	// initial value), but never below the minimum.
+	for (unsigned int i = 0; i < device->ntiming; ++i) {
+		const dc_timing_t *timing = device->timing + i;
+		unsigned int value = device->timing_value[i];
+		unsigned int target = device->timing_initial[i];
+		if (timing->flags & TIMING_TURNAROUND) {
+			unsigned long long turnaround = (device->timing_turnaround + 999) / 1000;
+			target = device_timing_clamp (timing, turnaround > timing->maximum ? timing->maximum : turnaround);
+		}
+		if (timing->step == 0 || value <= target)
+			continue;
+
+		if (value - target > timing->step)
+			value -= timing->step;
+		else
+			value = target;
+
+		DEBUG (device->context, "Timing: %s decreased to %u ms", timing->name, value);
+		device->timing_value[i] = value;
+	}
+}
+
+
+dc_status_t
+dc_device_set_timing (dc_device_t *device, const char *name, unsigned int value)
+{
+	unsigned int id = 0;
+
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (name == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	const dc_timing_t *timing = device_timing_lookup (device, name, &id);
+	if (timing == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	device->timing_value[id] = device_timing_clamp (timing, value);
+	device->timing_initial[id] = device->timing_value[id];
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+dc_device_get_timing (dc_device_t *device, const char *name, unsigned int *value)
+{
+	unsigned int id = 0;
+
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (name == NULL || value == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	if (device_timing_lookup (device, name, &id) == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	*value = device->timing_value[id];
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+dc_device_timing_foreach (dc_device_t *device, dc_timing_callback_t callback, void *userdata)
+{
+	if (device == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (callback == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	for (unsigned int i = 0; i < device->ntiming; ++i) {
+		const dc_timing_t *timing = device->timing + i;
+		callback (timing->name, device->timing_value[i], timing->minimum, timing->maximum, userdata);
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 dc_status_t
 dc_device_read (dc_device_t *device, unsigned int address, unsigned char data[], unsigned int size)
 {
@@ -316,7 +564,67 @@ dc_device_dump (dc_device_t *device, dc_buffer_t *buffer)
 	if (device->vtable->dump == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
-	return device->vtable->dump (device, buffer);
+	dc_status_t rc = device->vtable->dump (device, buffer);
+
+	device_event_flush (device);
+
+	return rc;
+}
+
+
+dc_status_t
+dc_device_get_stats (dc_device_t *device, dc_stats_t *stats)
+{
+	if (device == NULL || stats == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	*stats = device->stats;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+dc_device_reset_stats (dc_device_t *device)
+{
+	if (device == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	memset (&device->stats, 0, sizeof (device->stats));
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+unsigned long long
+device_stats_begin (dc_device_t *device)
+{
+	if (device == NULL)
+		return 0;
+
+	return dc_context_clock ();
+}
+
+
+void
+device_stats_end (dc_device_t *device, unsigned long long start, dc_status_t status)
+{
+	if (device == NULL)
+		return;
+
+	device_timing_exchange (device, dc_context_clock () - start, status);
+
+	dc_stats_transfer (&device->stats, DC_STATS_COMMAND, start, 0, status);
+}
+
+
+void
+device_stats_retry (dc_device_t *device)
+{
+	if (device == NULL)
+		return;
+
+	dc_stats_retry (&device->stats);
 }
 
 
@@ -366,7 +674,11 @@ dc_device_foreach (dc_device_t *device, dc_dive_callback_t callback, void *userd
 	if (device->vtable->foreach == NULL)
 		return DC_STATUS_UNSUPPORTED;
 
-	return device->vtable->foreach (device, callback, userdata);
+	dc_status_t rc = device->vtable->foreach (device, callback, userdata);
+
+	device_event_flush (device);
+
+	return rc;
 }
 
 
@@ -392,6 +704,48 @@ dc_device_close (dc_device_t *device)
 }
 
 
+/*
+ * Check whether a progress event should be delivered. Suppressed events
+ * are remembered, such that the most recent one can still be delivered
+ * with device_event_flush.
+ */
+static int
+device_event_progress (dc_device_t *device, const dc_event_progress_t *progress)
+{
+	if (device->progress_interval == 0 && device->progress_delta == 0)
+		return 1;
+
+	const dc_event_progress_t *last = &device->progress_last;
+
+	int deliver = 0;
+	unsigned long long now = 0;
+	if (device->progress_time == 0 ||
+		progress->current == progress->maximum ||
+		progress->current < last->current ||
+		progress->maximum != last->maximum) {
+		// The first and final events, and the events indicating a
+		// restart or a change of the maximum, are always delivered.
+		now = dc_context_clock ();
+		deliver = 1;
+	} else if (progress->current - last->current >= device->progress_delta) {
+		now = dc_context_clock ();
+		if (now - device->progress_time >= (unsigned long long) device->progress_interval * 1000)
+			deliver = 1;
+	}
+
+	if (deliver) {
+		device->progress_time = now ? now : 1;
+		device->progress_last = *progress;
+		device->progress_pending = 0;
+	} else {
+		device->progress_next = *progress;
+		device->progress_pending = 1;
+	}
+
+	return deliver;
+}
+
+
 void
 device_event_emit (dc_device_t *device, dc_event_type_t event, const void *data)
 {
@@ -440,10 +794,29 @@ device_event_emit (dc_device_t *device, dc_event_type_t event, const void *data)
 	if ((event & device->event_mask) == 0)
 		return;
 
+	if (event == DC_EVENT_PROGRESS && !device_event_progress (device, progress))
+		return;
+
 	device->event_callback (device, event, data, device->event_userdata);
 }
 
 
+void
+device_event_flush (dc_device_t *device)
+{
+	if (device == NULL || !device->progress_pending)
+		return;
+
+	device->progress_pending = 0;
+	device->progress_last = device->progress_next;
+
+	if (device->event_callback == NULL || (device->event_mask & DC_EVENT_PROGRESS) == 0)
+		return;
+
+	device->event_callback (device, DC_EVENT_PROGRESS, &device->progress_last, device->event_userdata);
+}
+
+
 int
 device_is_cancelled (dc_device_t *device)
 {
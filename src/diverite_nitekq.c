@@ -173,6 +173,8 @@ diverite_nitekq_device_open (dc_device_t **out, dc_context_t *context, const cha
 		goto error_free;
 	}
 
+	dc_serial_set_stats (device->port, &device->base.stats);
+
 	// Set the serial communication protocol (9600 8N1).
 	status = dc_serial_configure (device->port, 9600, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
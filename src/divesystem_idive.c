@@ -141,6 +141,8 @@ divesystem_idive_device_open (dc_device_t **out, dc_context_t *context, const ch
 		goto error_free;
 	}
 
+	dc_serial_set_stats (device->port, &device->base.stats);
+
 	// Set the serial communication protocol (115200 8N1).
 	status = dc_serial_configure (device->port, 115200, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -366,6 +368,8 @@ divesystem_idive_transfer (divesystem_idive_device_t *device, const unsigned cha
 	dc_status_t status = DC_STATUS_SUCCESS;
 	unsigned int errcode = 0;
 
+	unsigned long long start = device_stats_begin (&device->base);
+
 	unsigned int nretries = 0;
 	while ((status = divesystem_idive_packet (device, command, csize, answer, asize, &errcode)) != DC_STATUS_SUCCESS) {
 		// Automatically discard a corrupted packet,
@@ -381,10 +385,14 @@ divesystem_idive_transfer (divesystem_idive_device_t *device, const unsigned cha
 		if (nretries++ >= MAXRETRIES)
 			break;
 
+		device_stats_retry (&device->base);
+
 		// Delay the next attempt.
 		dc_serial_sleep (device->port, 100);
 	}
 
+	device_stats_end (&device->base, start, status);
+
 	if (errorcode) {
 		*errorcode = errcode;
 	}
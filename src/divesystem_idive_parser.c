@@ -23,6 +23,7 @@
 
 #include "divesystem_idive.h"
 #include "context-private.h"
+#include "datetime-private.h"
 #include "parser-private.h"
 #include "array.h"
 
@@ -78,6 +79,7 @@ static const dc_parser_vtable_t divesystem_idive_parser_vtable = {
 	divesystem_idive_parser_get_datetime, /* datetime */
 	divesystem_idive_parser_get_field, /* fields */
 	divesystem_idive_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_range */
 	NULL /* destroy */
 };
 
@@ -150,7 +152,7 @@ divesystem_idive_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *date
 
 	dc_ticks_t ticks = array_uint32_le(abstract->data + 7) + EPOCH;
 
-	if (!dc_datetime_localtime (datetime, ticks))
+	if (!dc_datetime_localtime_cached (abstract->context, datetime, ticks))
         return DC_STATUS_DATAFORMAT;
 
 	return DC_STATUS_SUCCESS;
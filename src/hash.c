@@ -0,0 +1,127 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+#include "hash.h"
+
+#define PRIME1 0x9E3779B185EBCA87ULL
+#define PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PRIME3 0x165667B19E3779F9ULL
+#define PRIME4 0x85EBCA77C2B2AE63ULL
+#define PRIME5 0x27D4EB2F165667C5ULL
+
+#define ROTL(x,n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+static unsigned long long
+hash_read64 (const unsigned char data[])
+{
+	return
+		((unsigned long long) data[0]      ) |
+		((unsigned long long) data[1] <<  8) |
+		((unsigned long long) data[2] << 16) |
+		((unsigned long long) data[3] << 24) |
+		((unsigned long long) data[4] << 32) |
+		((unsigned long long) data[5] << 40) |
+		((unsigned long long) data[6] << 48) |
+		((unsigned long long) data[7] << 56);
+}
+
+static unsigned int
+hash_read32 (const unsigned char data[])
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((unsigned int) data[3] << 24);
+}
+
+static unsigned long long
+hash_round (unsigned long long acc, unsigned long long input)
+{
+	acc += input * PRIME2;
+	acc = ROTL (acc, 31);
+	return acc * PRIME1;
+}
+
+static unsigned long long
+hash_merge (unsigned long long acc, unsigned long long value)
+{
+	acc ^= hash_round (0, value);
+	return acc * PRIME1 + PRIME4;
+}
+
+unsigned long long
+hash_xxh64 (const unsigned char data[], size_t size, unsigned long long seed)
+{
+	const unsigned char *p = data;
+	const unsigned char *end = data + size;
+	unsigned long long h = 0;
+
+	if (size >= 32) {
+		// Four independent lanes of 8 bytes each.
+		unsigned long long v1 = seed + PRIME1 + PRIME2;
+		unsigned long long v2 = seed + PRIME2;
+		unsigned long long v3 = seed;
+		unsigned long long v4 = seed - PRIME1;
+
+		do {
+			v1 = hash_round (v1, hash_read64 (p + 0));
+			v2 = hash_round (v2, hash_read64 (p + 8));
+			v3 = hash_round (v3, hash_read64 (p + 16));
+			v4 = hash_round (v4, hash_read64 (p + 24));
+			p += 32;
+		} while (p + 32 <= end);
+
+		h = ROTL (v1, 1) + ROTL (v2, 7) + ROTL (v3, 12) + ROTL (v4, 18);
+		h = hash_merge (h, v1);
+		h = hash_merge (h, v2);
+		h = hash_merge (h, v3);
+		h = hash_merge (h, v4);
+	} else {
+		h = seed + PRIME5;
+	}
+
+	h += size;
+
+	// The remaining bytes.
+	while (p + 8 <= end) {
+		h ^= hash_round (0, hash_read64 (p));
+		h = ROTL (h, 27) * PRIME1 + PRIME4;
+		p += 8;
+	}
+
+	if (p + 4 <= end) {
+		h ^= hash_read32 (p) * PRIME1;
+		h = ROTL (h, 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+
+	while (p < end) {
+		h ^= *p * PRIME5;
+		h = ROTL (h, 11) * PRIME1;
+		p++;
+	}
+
+	// Final avalanche.
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+
+	return h;
+}
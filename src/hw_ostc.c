@@ -44,8 +44,8 @@
 #define SZ_FW_190 0x8000
 #define SZ_FW_NEW 0x10000
 
-#define SZ_FIRMWARE 0x17F40
-#define SZ_BLOCK    0x40
+#define SZ_FIRMWARE HW_OSTC_FIRMWARE_SIZE
+#define SZ_BLOCK    HW_OSTC_FIRMWARE_BLOCK
 
 #define ACK     0x4B /* "K" for ok */
 #define NAK     0x4E /* "N" for not ok */
@@ -62,11 +62,6 @@ typedef struct hw_ostc_device_t {
 	unsigned char fingerprint[5];
 } hw_ostc_device_t;
 
-typedef struct hw_ostc_firmware_t {
-	unsigned char data[SZ_FIRMWARE];
-	unsigned char bitmap[SZ_FIRMWARE / SZ_BLOCK];
-} hw_ostc_firmware_t;
-
 static dc_status_t hw_ostc_device_set_fingerprint (dc_device_t *abstract, const unsigned char data[], unsigned int size);
 static dc_status_t hw_ostc_device_dump (dc_device_t *abstract, dc_buffer_t *buffer);
 static dc_status_t hw_ostc_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, void *userdata);
@@ -147,6 +142,8 @@ hw_ostc_device_open (dc_device_t **out, dc_context_t *context, const char *name)
 		goto error_free;
 	}
 
+	dc_serial_set_stats (device->port, &device->base.stats);
+
 	// Set the serial communication protocol (115200 8N1).
 	status = dc_serial_configure (device->port, 115200, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -678,7 +675,7 @@ hw_ostc_extract_dives (dc_device_t *abstract, const unsigned char data[], unsign
 }
 
 
-static dc_status_t
+dc_status_t
 hw_ostc_firmware_readfile (hw_ostc_firmware_t *firmware, dc_context_t *context, const char *filename)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
@@ -700,45 +697,51 @@ hw_ostc_firmware_readfile (hw_ostc_firmware_t *firmware, dc_context_t *context,
 		return rc;
 	}
 
-	// Read the hex file.
-	unsigned int lba = 0;
-	dc_ihex_entry_t entry;
-	while ((rc = dc_ihex_file_read (file, &entry)) == DC_STATUS_SUCCESS) {
-		if (entry.type == 0) {
-			// Data record.
-			unsigned int address = (lba << 16) + entry.address;
-			if (address + entry.length > SZ_FIRMWARE) {
-				WARNING (context, "Ignoring out of range record (0x%08x,%u).", address, entry.length);
-				continue;
-			}
+	// Allocate memory for the data ranges.
+	dc_buffer_t *buffer = dc_buffer_new (SZ_FIRMWARE);
+	if (buffer == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		dc_ihex_file_close (file);
+		return DC_STATUS_NOMEMORY;
+	}
 
-			// Copy the record to the buffer.
-			memcpy (firmware->data + address, entry.data, entry.length);
+	// Read the hex file, one contiguous range at a time.
+	unsigned int address = 0;
+	while ((rc = dc_ihex_file_read_range (file, &address, buffer)) == DC_STATUS_SUCCESS) {
+		const unsigned char *data = dc_buffer_get_data (buffer);
+		unsigned int length = dc_buffer_get_size (buffer);
 
-			// Mark the corresponding blocks in the bitmap.
-			unsigned int begin = address / SZ_BLOCK;
-			unsigned int end = (address + entry.length + SZ_BLOCK - 1) / SZ_BLOCK;
-			for (unsigned int i = begin; i < end; ++i) {
-				firmware->bitmap[i] = 1;
-			}
-		} else if (entry.type == 1) {
-			// End of file record.
-			break;
-		} else if (entry.type == 4) {
-			// Extended linear address record.
-			lba = array_uint16_be (entry.data);
-		} else {
-			ERROR (context, "Unexpected record type.");
-			dc_ihex_file_close (file);
-			return DC_STATUS_DATAFORMAT;
+		// The records are merged into a single range, so a range that
+		// crosses the end of the firmware is clipped, to keep the data
+		// in front of it.
+		if (address >= SZ_FIRMWARE) {
+			WARNING (context, "Ignoring out of range record (0x%08x,%u).", address, length);
+			continue;
+		} else if (length > SZ_FIRMWARE - address) {
+			WARNING (context, "Ignoring %u bytes beyond the end of the firmware (0x%08x,%u).",
+				length - (SZ_FIRMWARE - address), address, length);
+			length = SZ_FIRMWARE - address;
+		}
+
+		// Copy the range to the buffer.
+		memcpy (firmware->data + address, data, length);
+
+		// Mark the corresponding blocks in the bitmap.
+		unsigned int begin = address / SZ_BLOCK;
+		unsigned int end = (address + length + SZ_BLOCK - 1) / SZ_BLOCK;
+		for (unsigned int i = begin; i < end; ++i) {
+			firmware->bitmap[i] = 1;
 		}
 	}
 	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_DONE) {
 		ERROR (context, "Failed to read the record.");
+		dc_buffer_free (buffer);
 		dc_ihex_file_close (file);
 		return rc;
 	}
 
+	dc_buffer_free (buffer);
+
 	// Close the file.
 	dc_ihex_file_close (file);
 
@@ -763,7 +766,7 @@ hw_ostc_firmware_readfile (hw_ostc_firmware_t *firmware, dc_context_t *context,
 	const unsigned char header[] = {0xA0, 0xEF, 0xBF, 0xF0};
 	memcpy (firmware->data, header, sizeof (header));
 
-	return rc;
+	return DC_STATUS_SUCCESS;
 }
 
 
@@ -37,6 +37,21 @@ hw_ostc_device_open (dc_device_t **device, dc_context_t *context, const char *na
 dc_status_t
 hw_ostc_parser_create (dc_parser_t **parser, dc_context_t *context, unsigned int serial, unsigned int hwos);
 
+#define HW_OSTC_FIRMWARE_SIZE  0x17F40
+#define HW_OSTC_FIRMWARE_BLOCK 0x40
+
+/*
+ * The firmware image, with a flag for each block that is present in
+ * the hex file.
+ */
+typedef struct hw_ostc_firmware_t {
+	unsigned char data[HW_OSTC_FIRMWARE_SIZE];
+	unsigned char bitmap[HW_OSTC_FIRMWARE_SIZE / HW_OSTC_FIRMWARE_BLOCK];
+} hw_ostc_firmware_t;
+
+dc_status_t
+hw_ostc_firmware_readfile (hw_ostc_firmware_t *firmware, dc_context_t *context, const char *filename);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -47,6 +47,8 @@
 #define SZ_FWINFO     4
 #define SZ_FIRMWARE   0x01E000        // 120KB
 #define SZ_FIRMWARE_BLOCK    0x1000   //   4KB
+#define SZ_FIRMWARE_BATCH    0x8000   //  32KB
+#define NBLOCKS (SZ_FIRMWARE / SZ_FIRMWARE_BLOCK)
 #define FIRMWARE_AREA      0x3E0000
 
 #define RB_LOGBOOK_SIZE_COMPACT  16
@@ -346,6 +348,8 @@ hw_ostc3_device_open (dc_device_t **out, dc_context_t *context, const char *name
 		goto error_free;
 	}
 
+	dc_serial_set_stats (device->port, &device->base.stats);
+
 	// Set the serial communication protocol (115200 8N1).
 	status = dc_serial_configure (device->port, 115200, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -1039,8 +1043,8 @@ hw_ostc3_firmware_readfile3 (hw_ostc3_firmware_t *firmware, dc_context_t *contex
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	FILE *fp = NULL;
 	unsigned char iv[16] = {0};
-	unsigned char tmpbuf[16] = {0};
 	unsigned char encrypted[16] = {0};
+	AES128_CFB_t aes;
 	unsigned int bytes = 0, addr = 0;
 	unsigned char checksum[4];
 
@@ -1067,8 +1071,8 @@ hw_ostc3_firmware_readfile3 (hw_ostc3_firmware_t *firmware, dc_context_t *contex
 	}
 	bytes += 16;
 
-	// Load the iv for AES-FCB-mode
-	AES128_ECB_encrypt (iv, ostc3_key, tmpbuf);
+	// Load the key and iv for AES-CFB-mode
+	AES128_CFB_init (&aes, ostc3_key, iv);
 
 	for (addr = 0; addr < SZ_FIRMWARE; addr += 16, bytes += 16) {
 		rc = hw_ostc3_firmware_readline (fp, context, bytes, encrypted, sizeof(encrypted));
@@ -1078,12 +1082,8 @@ hw_ostc3_firmware_readfile3 (hw_ostc3_firmware_t *firmware, dc_context_t *contex
 			return rc;
 		}
 
-		// Decrypt AES-FCB data
-		for (unsigned int i = 0; i < 16; i++)
-			firmware->data[addr + i] = encrypted[i] ^ tmpbuf[i];
-
-		// Run the next round of encryption
-		AES128_ECB_encrypt (encrypted, ostc3_key, tmpbuf);
+		// Decrypt AES-CFB data
+		AES128_CFB_decrypt_buffer (&aes, firmware->data + addr, encrypted, sizeof(encrypted));
 	}
 
 	// This file format contains a tail with the checksum in
@@ -1227,48 +1227,137 @@ hw_ostc3_firmware_upgrade (dc_device_t *abstract, unsigned int checksum)
 
 
 static dc_status_t
-hw_ostc3_device_fwupdate3 (dc_device_t *abstract, const char *filename)
+hw_ostc3_firmware_compare (hw_ostc3_device_t *device, dc_event_progress_t *progress, const unsigned char data[], const unsigned char select[], unsigned char differ[], const char *message)
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
-	hw_ostc3_device_t *device = (hw_ostc3_device_t *) abstract;
-	dc_context_t *context = (abstract ? abstract->context : NULL);
-
-	// Enable progress notifications.
-	// load, erase, upload FZ, verify FZ, reprogram
-	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
-	progress.maximum = 3 + SZ_FIRMWARE * 2 / SZ_FIRMWARE_BLOCK;
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+	dc_device_t *abstract = (dc_device_t *) device;
 
-	// Allocate memory for the firmware data.
-	hw_ostc3_firmware_t *firmware = (hw_ostc3_firmware_t *) malloc (sizeof (hw_ostc3_firmware_t));
-	if (firmware == NULL) {
-		ERROR (context, "Failed to allocate memory.");
+	// Allocate memory for the batch.
+	unsigned char *batch = (unsigned char *) malloc (SZ_FIRMWARE_BATCH);
+	if (batch == NULL) {
+		ERROR (abstract->context, "Failed to allocate memory.");
 		return DC_STATUS_NOMEMORY;
 	}
 
-	// Read the hex file.
-	rc = hw_ostc3_firmware_readfile3 (firmware, context, filename);
-	if (rc != DC_STATUS_SUCCESS) {
-		free (firmware);
-		return rc;
+	// Read back each run of selected blocks, with as few read
+	// commands as possible, and compare it with the firmware image.
+	unsigned int i = 0;
+	while (i < NBLOCKS) {
+		if (!select[i]) {
+			differ[i] = 0;
+			i++;
+			continue;
+		}
+
+		unsigned int n = 1;
+		while (i + n < NBLOCKS && select[i + n] && n < SZ_FIRMWARE_BATCH / SZ_FIRMWARE_BLOCK)
+			n++;
+
+		char status[SZ_DISPLAY + 1]; // Status message on the display
+		snprintf (status, sizeof(status), " %s %2d%%", message, (100 * i) / NBLOCKS);
+		hw_ostc3_device_display (abstract, status);
+
+		unsigned int offset = i * SZ_FIRMWARE_BLOCK;
+		rc = hw_ostc3_firmware_block_read (device, FIRMWARE_AREA + offset, batch, n * SZ_FIRMWARE_BLOCK);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to read block.");
+			free (batch);
+			return rc;
+		}
+
+		for (unsigned int j = 0; j < n; ++j) {
+			differ[i + j] = memcmp (data + offset + j * SZ_FIRMWARE_BLOCK, batch + j * SZ_FIRMWARE_BLOCK, SZ_FIRMWARE_BLOCK) != 0;
+		}
+
+		// The blocks are compared.
+		progress->current += n;
+		device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
+
+		i += n;
 	}
 
-	// Device open and firmware loaded
-	progress.current++;
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+	free (batch);
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+hw_ostc3_firmware_upload (hw_ostc3_device_t *device, dc_event_progress_t *progress, const hw_ostc3_firmware_t *firmware, const unsigned char changed[])
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_device_t *abstract = (dc_device_t *) device;
+	dc_context_t *context = abstract->context;
+
+	hw_ostc3_device_display (abstract, " Erasing FW...");
+
+	// Erase each run of changed blocks with a single command.
+	unsigned int i = 0;
+	while (i < NBLOCKS) {
+		if (!changed[i]) {
+			i++;
+			continue;
+		}
+
+		unsigned int n = 1;
+		while (i + n < NBLOCKS && changed[i + n])
+			n++;
+
+		rc = hw_ostc3_firmware_erase (device, FIRMWARE_AREA + i * SZ_FIRMWARE_BLOCK, n * SZ_FIRMWARE_BLOCK);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR (context, "Failed to erase old firmware");
+			return rc;
+		}
+
+		i += n;
+	}
+
+	// Memory erased
+	progress->current++;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
+
+	hw_ostc3_device_display (abstract, " Uploading...");
+
+	for (i = 0; i < NBLOCKS; ++i) {
+		unsigned int len = i * SZ_FIRMWARE_BLOCK;
+
+		if (changed[i]) {
+			char status[SZ_DISPLAY + 1]; // Status message on the display
+			snprintf (status, sizeof(status), " Uploading %2d%%", (100 * len) / SZ_FIRMWARE);
+			hw_ostc3_device_display (abstract, status);
+
+			rc = hw_ostc3_firmware_block_write (device, FIRMWARE_AREA + len, firmware->data + len, SZ_FIRMWARE_BLOCK);
+			if (rc != DC_STATUS_SUCCESS) {
+				ERROR (context, "Failed to write block to device");
+				return rc;
+			}
+		}
+
+		// One block uploaded (or skipped)
+		progress->current++;
+		device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+hw_ostc3_firmware_upload_safe (hw_ostc3_device_t *device, dc_event_progress_t *progress, const hw_ostc3_firmware_t *firmware)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_device_t *abstract = (dc_device_t *) device;
+	dc_context_t *context = abstract->context;
 
 	hw_ostc3_device_display (abstract, " Erasing FW...");
 
 	rc = hw_ostc3_firmware_erase (device, FIRMWARE_AREA, SZ_FIRMWARE);
 	if (rc != DC_STATUS_SUCCESS) {
 		ERROR (context, "Failed to erase old firmware");
-		free (firmware);
 		return rc;
 	}
 
 	// Memory erased
-	progress.current++;
-	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+	progress->current++;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
 
 	hw_ostc3_device_display (abstract, " Uploading...");
 
@@ -1280,12 +1369,11 @@ hw_ostc3_device_fwupdate3 (dc_device_t *abstract, const char *filename)
 		rc = hw_ostc3_firmware_block_write (device, FIRMWARE_AREA + len, firmware->data + len, SZ_FIRMWARE_BLOCK);
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (context, "Failed to write block to device");
-			free(firmware);
 			return rc;
 		}
 		// One block uploaded
-		progress.current++;
-		device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+		progress->current++;
+		device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
 	}
 
 	hw_ostc3_device_display (abstract, " Verifying...");
@@ -1299,18 +1387,128 @@ hw_ostc3_device_fwupdate3 (dc_device_t *abstract, const char *filename)
 		rc = hw_ostc3_firmware_block_read (device, FIRMWARE_AREA + len, block, sizeof (block));
 		if (rc != DC_STATUS_SUCCESS) {
 			ERROR (context, "Failed to read block.");
-			free (firmware);
 			return rc;
 		}
 		if (memcmp (firmware->data + len, block, sizeof (block)) != 0) {
 			ERROR (context, "Failed verify.");
 			hw_ostc3_device_display (abstract, " Verify FAILED");
-			free (firmware);
 			return DC_STATUS_PROTOCOL;
 		}
 		// One block verified
-		progress.current++;
+		progress->current++;
+		device_event_emit (abstract, DC_EVENT_PROGRESS, progress);
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+static dc_status_t
+hw_ostc3_device_fwupdate3 (dc_device_t *abstract, const char *filename)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	hw_ostc3_device_t *device = (hw_ostc3_device_t *) abstract;
+	dc_context_t *context = (abstract ? abstract->context : NULL);
+
+	// Enable progress notifications.
+	// load, compare FZ, erase, upload FZ, verify FZ, reprogram
+	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+	progress.maximum = 3 + NBLOCKS * 3;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	// Allocate memory for the firmware data.
+	hw_ostc3_firmware_t *firmware = (hw_ostc3_firmware_t *) malloc (sizeof (hw_ostc3_firmware_t));
+	if (firmware == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	// Read the hex file.
+	rc = hw_ostc3_firmware_readfile3 (firmware, context, filename);
+	if (rc != DC_STATUS_SUCCESS) {
+		free (firmware);
+		return rc;
+	}
+
+	// Device open and firmware loaded
+	progress.current++;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	// Compare the firmware image with the current contents of the
+	// firmware area, to find the blocks that need to be uploaded. The
+	// blocks that are already identical (for example when the same
+	// firmware is flashed again) are skipped. If none of the blocks in
+	// the first batch is identical, the firmware is most likely a
+	// different version, and the remaining blocks are not compared.
+	unsigned char select[NBLOCKS], changed[NBLOCKS], differ[NBLOCKS];
+	unsigned int first = SZ_FIRMWARE_BATCH / SZ_FIRMWARE_BLOCK;
+	memset (select, 0, sizeof (select));
+	memset (select, 1, first);
+	rc = hw_ostc3_firmware_compare (device, &progress, firmware->data, select, changed, "Comparing");
+	if (rc == DC_STATUS_SUCCESS) {
+		unsigned int identical = 0;
+		for (unsigned int i = 0; i < first; ++i) {
+			if (!changed[i])
+				identical++;
+		}
+
+		if (identical) {
+			memset (select, 0, first);
+			memset (select + first, 1, NBLOCKS - first);
+			rc = hw_ostc3_firmware_compare (device, &progress, firmware->data, select, differ, "Comparing");
+			memcpy (changed + first, differ + first, NBLOCKS - first);
+		} else {
+			memset (changed + first, 1, NBLOCKS - first);
+			progress.current += NBLOCKS - first;
+			device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+		}
+	}
+	if (rc == DC_STATUS_SUCCESS) {
+		// Firmware area compared
+		unsigned int current = progress.current;
+
+		rc = hw_ostc3_firmware_upload (device, &progress, firmware, changed);
+		if (rc != DC_STATUS_SUCCESS) {
+			free (firmware);
+			return rc;
+		}
+
+		// Verify the uploaded blocks, with the same batched reads.
+		rc = hw_ostc3_firmware_compare (device, &progress, firmware->data, changed, differ, "Verifying");
+		if (rc != DC_STATUS_SUCCESS) {
+			free (firmware);
+			return rc;
+		}
+
+		// Blocks that are not uploaded are not verified again.
+		progress.current = current + 1 + 2 * NBLOCKS;
 		device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+		for (unsigned int i = 0; i < NBLOCKS; ++i) {
+			if (differ[i]) {
+				WARNING (context, "Failed to verify block %u, falling back to a full upload.", i);
+				rc = DC_STATUS_PROTOCOL;
+				progress.current = current;
+				break;
+			}
+		}
+	} else if (rc != DC_STATUS_CANCELLED) {
+		WARNING (context, "Failed to compare the firmware area, falling back to a full upload.");
+		progress.current = 1 + NBLOCKS;
+	}
+
+	if (rc == DC_STATUS_CANCELLED) {
+		free (firmware);
+		return rc;
+	}
+
+	// Fall back to erasing, uploading and verifying the entire
+	// firmware area, one block at a time.
+	if (rc != DC_STATUS_SUCCESS) {
+		rc = hw_ostc3_firmware_upload_safe (device, &progress, firmware);
+		if (rc != DC_STATUS_SUCCESS) {
+			free (firmware);
+			return rc;
+		}
 	}
 
 	hw_ostc3_device_display (abstract, " Programming...");
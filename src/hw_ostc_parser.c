@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 
 #ifdef _MSC_VER
 #define snprintf _snprintf
@@ -32,6 +33,7 @@
 #include "hw_ostc.h"
 #include "hw_ostc3.h"
 #include "context-private.h"
+#include "datetime-private.h"
 #include "parser-private.h"
 #include "array.h"
 
@@ -120,10 +122,17 @@ typedef struct hw_ostc_parser_t {
 	hw_ostc_gasmix_t gasmix[NGASMIXES];
 } hw_ostc_parser_t;
 
+typedef struct hw_ostc_state_t {
+	unsigned int offset;
+	unsigned int nsamples;
+	unsigned int time;
+} hw_ostc_state_t;
+
 static dc_status_t hw_ostc_parser_set_data (dc_parser_t *abstract, const unsigned char *data, unsigned int size);
 static dc_status_t hw_ostc_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t hw_ostc_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t hw_ostc_parser_samples_range (dc_parser_t *abstract, unsigned int begin, unsigned int end, dc_sample_callback_t callback, void *userdata);
 
 static const dc_parser_vtable_t hw_ostc_parser_vtable = {
 	sizeof(hw_ostc_parser_t),
@@ -132,6 +141,7 @@ static const dc_parser_vtable_t hw_ostc_parser_vtable = {
 	hw_ostc_parser_get_datetime, /* datetime */
 	hw_ostc_parser_get_field, /* fields */
 	hw_ostc_parser_samples_foreach, /* samples_foreach */
+	hw_ostc_parser_samples_range, /* samples_range */
 	NULL /* destroy */
 };
 
@@ -437,13 +447,13 @@ hw_ostc_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime)
 		if (datetime)
 			*datetime = dt;
 	} else {
-		dc_ticks_t ticks = dc_datetime_mktime (&dt);
+		dc_ticks_t ticks = dc_datetime_mktime_cached (abstract->context, &dt);
 		if (ticks == (dc_ticks_t) -1)
 			return DC_STATUS_DATAFORMAT;
 
 		ticks -= divetime;
 
-		if (!dc_datetime_localtime (datetime, ticks))
+		if (!dc_datetime_localtime_cached (abstract->context, datetime, ticks))
 			return DC_STATUS_DATAFORMAT;
 	}
 
@@ -655,17 +665,13 @@ hw_ostc_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned
 
 
 static dc_status_t
-hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+hw_ostc_parser_walk (dc_parser_t *abstract, void *userstate, unsigned int end, sample_index_t *index, dc_sample_callback_t callback, void *userdata)
 {
 	hw_ostc_parser_t *parser = (hw_ostc_parser_t *) abstract;
+	hw_ostc_state_t *state = (hw_ostc_state_t *) userstate;
 	const unsigned char *data = abstract->data;
 	unsigned int size = abstract->size;
 
-	// Cache the parser data.
-	dc_status_t rc = hw_ostc_parser_cache (parser);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
-
 	unsigned int version = parser->version;
 	unsigned int header = parser->header;
 	const hw_ostc_layout_t *layout = parser->layout;
@@ -744,15 +750,22 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 		firmware = array_uint16_be (data + layout->firmware);
 	}
 
-	unsigned int time = 0;
-	unsigned int nsamples = 0;
-
-	unsigned int offset = header;
-	if (version == 0x23 || version == 0x24)
-		offset += 5 + 3 * nconfig;
+	unsigned int time = state->time;
+	unsigned int nsamples = state->nsamples;
+	unsigned int offset = state->offset;
 	while (offset + 3 <= size) {
 		dc_sample_value_t sample = {0};
 
+		if (time > end)
+			return DC_STATUS_SUCCESS;
+
+		if (index && nsamples && (nsamples % SAMPLE_INDEX_INTERVAL) == 0) {
+			state->offset = offset;
+			state->nsamples = nsamples;
+			state->time = time;
+			sample_index_append (index, time, state);
+		}
+
 		nsamples++;
 
 		// Time (seconds).
@@ -1040,3 +1053,48 @@ hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t call
 
 	return DC_STATUS_SUCCESS;
 }
+
+static void
+hw_ostc_parser_init (hw_ostc_parser_t *parser, hw_ostc_state_t *state)
+{
+	const unsigned char *data = parser->base.data;
+
+	// Skip the extended sample configuration.
+	state->offset = parser->header;
+	if (parser->version == 0x23 || parser->version == 0x24)
+		state->offset += 5 + 3 * data[parser->header + 4];
+	state->nsamples = 0;
+	state->time = 0;
+}
+
+static dc_status_t
+hw_ostc_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+{
+	hw_ostc_parser_t *parser = (hw_ostc_parser_t *) abstract;
+	hw_ostc_state_t state;
+
+	// Cache the parser data.
+	dc_status_t rc = hw_ostc_parser_cache (parser);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	hw_ostc_parser_init (parser, &state);
+
+	return hw_ostc_parser_walk (abstract, &state, UINT_MAX, NULL, callback, userdata);
+}
+
+static dc_status_t
+hw_ostc_parser_samples_range (dc_parser_t *abstract, unsigned int begin, unsigned int end, dc_sample_callback_t callback, void *userdata)
+{
+	hw_ostc_parser_t *parser = (hw_ostc_parser_t *) abstract;
+	hw_ostc_state_t state;
+
+	// Cache the parser data.
+	dc_status_t rc = hw_ostc_parser_cache (parser);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	hw_ostc_parser_init (parser, &state);
+
+	return sample_index_walk (abstract, begin, end, &state, sizeof (state), hw_ostc_parser_walk, callback, userdata);
+}
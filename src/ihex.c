@@ -29,15 +29,21 @@
 #include "checksum.h"
 #include "array.h"
 
+#define BLOCKSIZE 65536
+
 struct dc_ihex_file_t {
 	dc_context_t *context;
-	FILE *fp;
+	unsigned char *data;
+	size_t size;
+	size_t offset;
+	unsigned int base;
 };
 
 dc_status_t
 dc_ihex_file_open (dc_ihex_file_t **result, dc_context_t *context, const char *filename)
 {
 	dc_ihex_file_t *file = NULL;
+	FILE *fp = NULL;
 
 	if (result == NULL || filename == NULL) {
 		ERROR (context, "Invalid arguments.");
@@ -51,64 +57,95 @@ dc_ihex_file_open (dc_ihex_file_t **result, dc_context_t *context, const char *f
 	}
 
 	file->context = context;
+	file->data = NULL;
+	file->size = 0;
+	file->offset = 0;
+	file->base = 0;
 
-	file->fp = fopen (filename, "rb");
-	if (file->fp == NULL) {
+	fp = fopen (filename, "rb");
+	if (fp == NULL) {
 		ERROR (context, "Failed to open the file.");
 		free (file);
 		return DC_STATUS_IO;
 	}
 
+	/* Read the entire file into memory, in large blocks. The records are
+	 * parsed directly from the memory buffer afterwards, instead of
+	 * issuing several small reads for every record. */
+	size_t capacity = 0;
+	while (1) {
+		if (file->size == capacity) {
+			size_t n = capacity ? capacity * 2 : BLOCKSIZE;
+			unsigned char *data = (unsigned char *) realloc (file->data, n);
+			if (data == NULL) {
+				ERROR (context, "Failed to allocate memory.");
+				fclose (fp);
+				free (file->data);
+				free (file);
+				return DC_STATUS_NOMEMORY;
+			}
+			file->data = data;
+			capacity = n;
+		}
+
+		size_t n = fread (file->data + file->size, 1, capacity - file->size, fp);
+		file->size += n;
+		if (file->size != capacity) {
+			if (ferror (fp)) {
+				ERROR (context, "Failed to read the file.");
+				fclose (fp);
+				free (file->data);
+				free (file);
+				return DC_STATUS_IO;
+			}
+			break;
+		}
+	}
+
+	fclose (fp);
+
 	*result = file;
 
 	return DC_STATUS_SUCCESS;
 }
 
-dc_status_t
-dc_ihex_file_read (dc_ihex_file_t *file, dc_ihex_entry_t *entry)
+static dc_status_t
+dc_ihex_file_parse (dc_ihex_file_t *file, dc_ihex_entry_t *entry)
 {
-	unsigned char ascii[9 + 2 * 255 + 2] = {0};
+	const unsigned char *ascii = NULL;
 	unsigned char data[4 + 255 + 1] = {0};
 	unsigned int type, length, address;
 	unsigned char csum_a, csum_b;
-	size_t n;
-
-	if (file == NULL || entry == NULL) {
-		ERROR (file ? file->context : NULL, "Invalid arguments.");
-		return DC_STATUS_INVALIDARGS;
-	}
 
-	/* Read the start code. */
+	/* Find the start code. */
 	while (1) {
-		n = fread (ascii, 1, 1, file->fp);
-		if (n != 1) {
-			if (feof (file->fp)) {
-				return DC_STATUS_DONE;
-			} else {
-				ERROR (file->context, "Failed to read the start code.");
-				return DC_STATUS_IO;
-			}
+		if (file->offset >= file->size) {
+			return DC_STATUS_DONE;
 		}
 
-		if (ascii[0] == ':')
+		unsigned char c = file->data[file->offset++];
+		if (c == ':')
 			break;
 
 		/* Ignore CR and LF characters. */
-		if (ascii[0] != '\n' && ascii[0] != '\r') {
-			ERROR (file->context, "Unexpected character (0x%02x).", ascii[0]);
+		if (c != '\n' && c != '\r') {
+			ERROR (file->context, "Unexpected character (0x%02x).", c);
 			return DC_STATUS_DATAFORMAT;
 		}
 	}
 
-	/* Read the record length, address and type. */
-	n = fread (ascii + 1, 1, 8, file->fp);
-	if (n != 8) {
+	/* Get the record length, address and type. */
+	if (file->size - file->offset < 8) {
+		file->offset = file->size;
 		ERROR (file->context, "Failed to read the header.");
 		return DC_STATUS_IO;
 	}
 
+	ascii = file->data + file->offset;
+	file->offset += 8;
+
 	/* Convert to binary representation. */
-	if (array_convert_hex2bin (ascii + 1, 8, data, 4) != 0) {
+	if (array_convert_hex2bin (ascii, 8, data, 4) != 0) {
 		ERROR (file->context, "Invalid hexadecimal character.");
 		return DC_STATUS_DATAFORMAT;
 	}
@@ -116,15 +153,18 @@ dc_ihex_file_read (dc_ihex_file_t *file, dc_ihex_entry_t *entry)
 	/* Get the record length. */
 	length = data[0];
 
-	/* Read the record payload. */
-	n = fread (ascii + 9, 1, 2 * length + 2, file->fp);
-	if (n != 2 * length + 2) {
+	/* Get the record payload. */
+	if (file->size - file->offset < 2 * length + 2) {
+		file->offset = file->size;
 		ERROR (file->context, "Failed to read the data.");
 		return DC_STATUS_IO;
 	}
 
+	ascii = file->data + file->offset;
+	file->offset += 2 * length + 2;
+
 	/* Convert to binary representation. */
-	if (array_convert_hex2bin (ascii + 9, 2 * length + 2, data + 4, length + 1) != 0) {
+	if (array_convert_hex2bin (ascii, 2 * length + 2, data + 4, length + 1) != 0) {
 		ERROR (file->context, "Invalid hexadecimal character.");
 		return DC_STATUS_DATAFORMAT;
 	}
@@ -142,7 +182,7 @@ dc_ihex_file_read (dc_ihex_file_t *file, dc_ihex_entry_t *entry)
 
 	/* Get the record type. */
 	type = data[3];
-	if (type < 0 || type > 5) {
+	if (type > 5) {
 		ERROR (file->context, "Invalid record type (0x%02x).", type);
 		return DC_STATUS_DATAFORMAT;
 	}
@@ -181,6 +221,81 @@ dc_ihex_file_read (dc_ihex_file_t *file, dc_ihex_entry_t *entry)
 	return DC_STATUS_SUCCESS;
 }
 
+dc_status_t
+dc_ihex_file_read (dc_ihex_file_t *file, dc_ihex_entry_t *entry)
+{
+	if (file == NULL || entry == NULL) {
+		ERROR (file ? file->context : NULL, "Invalid arguments.");
+		return DC_STATUS_INVALIDARGS;
+	}
+
+	return dc_ihex_file_parse (file, entry);
+}
+
+dc_status_t
+dc_ihex_file_read_range (dc_ihex_file_t *file, unsigned int *address, dc_buffer_t *buffer)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+	dc_ihex_entry_t entry;
+	unsigned int begin = 0, end = 0;
+
+	if (file == NULL || address == NULL || buffer == NULL) {
+		ERROR (file ? file->context : NULL, "Invalid arguments.");
+		return DC_STATUS_INVALIDARGS;
+	}
+
+	dc_buffer_clear (buffer);
+
+	while (1) {
+		/* Remember the start of the record, to be able to push it back
+		 * when it doesn't belong to the current range. */
+		size_t offset = file->offset;
+
+		rc = dc_ihex_file_parse (file, &entry);
+		if (rc == DC_STATUS_DONE)
+			break;
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+
+		if (entry.type == 0) {
+			/* Data record. */
+			unsigned int addr = file->base + entry.address;
+			if (end != begin && addr != end) {
+				file->offset = offset;
+				break;
+			}
+
+			if (end == begin) {
+				begin = end = addr;
+			}
+
+			if (!dc_buffer_append (buffer, entry.data, entry.length)) {
+				ERROR (file->context, "Insufficient buffer space available.");
+				return DC_STATUS_NOMEMORY;
+			}
+
+			end += entry.length;
+		} else if (entry.type == 1) {
+			/* End of file record. Anything after it is ignored. */
+			file->offset = file->size;
+			break;
+		} else if (entry.type == 4) {
+			/* Extended linear address record. */
+			file->base = array_uint16_be (entry.data) << 16;
+		} else {
+			ERROR (file->context, "Unexpected record type.");
+			return DC_STATUS_DATAFORMAT;
+		}
+	}
+
+	if (end == begin)
+		return DC_STATUS_DONE;
+
+	*address = begin;
+
+	return DC_STATUS_SUCCESS;
+}
+
 dc_status_t
 dc_ihex_file_reset (dc_ihex_file_t *file)
 {
@@ -189,7 +304,8 @@ dc_ihex_file_reset (dc_ihex_file_t *file)
 		return DC_STATUS_INVALIDARGS;
 	}
 
-	rewind (file->fp);
+	file->offset = 0;
+	file->base = 0;
 
 	return DC_STATUS_SUCCESS;
 }
@@ -198,7 +314,7 @@ dc_status_t
 dc_ihex_file_close (dc_ihex_file_t *file)
 {
 	if (file) {
-		fclose (file->fp);
+		free (file->data);
 		free (file);
 	}
 
@@ -24,6 +24,7 @@
 
 #include <libdivecomputer/common.h>
 #include <libdivecomputer/context.h>
+#include <libdivecomputer/buffer.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -44,6 +45,16 @@ dc_ihex_file_open (dc_ihex_file_t **file, dc_context_t *context, const char *fil
 dc_status_t
 dc_ihex_file_read (dc_ihex_file_t *file, dc_ihex_entry_t *entry);
 
+/*
+ * Read the next contiguous range of data. Consecutive data records are
+ * merged into a single range, with the extended linear address records
+ * already applied to the returned (absolute) address. Returns
+ * DC_STATUS_DONE after the end of file record, and DC_STATUS_DATAFORMAT
+ * for any other record type.
+ */
+dc_status_t
+dc_ihex_file_read_range (dc_ihex_file_t *file, unsigned int *address, dc_buffer_t *buffer);
+
 dc_status_t
 dc_ihex_file_reset (dc_ihex_file_t *file);
 
@@ -88,6 +88,7 @@ typedef int s_errcode_t;
 
 struct dc_irda_t {
 	dc_context_t *context;
+	dc_stats_t *stats;
 #ifdef _WIN32
 	SOCKET fd;
 #else
@@ -134,6 +135,7 @@ dc_irda_open (dc_irda_t **out, dc_context_t *context)
 
 	// Library context.
 	device->context = context;
+	device->stats = NULL;
 
 	// Default to blocking reads.
 	device->timeout = -1;
@@ -239,6 +241,21 @@ dc_irda_set_timeout (dc_irda_t *device, int timeout)
 #endif
 }
 
+dc_status_t
+dc_irda_set_stats (dc_irda_t *device, dc_stats_t *stats)
+{
+#ifdef IRDA
+	if (device == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	device->stats = stats;
+
+	return DC_STATUS_SUCCESS;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
 
 #define DISCOVER_MAX_DEVICES 16	// Maximum number of devices.
 #define DISCOVER_MAX_RETRIES 4	// Maximum number of retries.
@@ -452,6 +469,8 @@ dc_irda_read (dc_irda_t *device, void *data, size_t size, size_t *actual)
 		goto out_invalidargs;
 	}
 
+	unsigned long long start = dc_stats_clock (device->stats);
+
 	while (nbytes < size) {
 		fd_set fds;
 		FD_ZERO (&fds);
@@ -497,7 +516,8 @@ dc_irda_read (dc_irda_t *device, void *data, size_t size, size_t *actual)
 	}
 
 out:
-	HEXDUMP (device->context, DC_LOGLEVEL_INFO, "Read", (unsigned char *) data, nbytes);
+	dc_stats_transfer (device->stats, DC_STATS_READ, start, nbytes, status);
+	TRACE (device->context, DC_TRACE_READ, "Read", (unsigned char *) data, nbytes);
 
 out_invalidargs:
 	if (actual)
@@ -521,6 +541,8 @@ dc_irda_write (dc_irda_t *device, const void *data, size_t size, size_t *actual)
 		goto out_invalidargs;
 	}
 
+	unsigned long long start = dc_stats_clock (device->stats);
+
 	while (nbytes < size) {
 		fd_set fds;
 		FD_ZERO (&fds);
@@ -558,7 +580,8 @@ dc_irda_write (dc_irda_t *device, const void *data, size_t size, size_t *actual)
 	}
 
 out:
-	HEXDUMP (device->context, DC_LOGLEVEL_INFO, "Write", (unsigned char *) data, nbytes);
+	dc_stats_transfer (device->stats, DC_STATS_WRITE, start, nbytes, status);
+	TRACE (device->context, DC_TRACE_WRITE, "Write", (unsigned char *) data, nbytes);
 
 out_invalidargs:
 	if (actual)
@@ -24,6 +24,7 @@
 
 #include <libdivecomputer/common.h>
 #include <libdivecomputer/context.h>
+#include <libdivecomputer/device.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -97,6 +98,17 @@ dc_irda_close (dc_irda_t *irda);
 dc_status_t
 dc_irda_set_timeout (dc_irda_t *irda, int timeout);
 
+/**
+ * Set the statistics buffer for the transfers of the connection.
+ *
+ * @param[in]  irda   A valid IrDA connection.
+ * @param[in]  stats  The statistics buffer, or NULL to disable them.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_irda_set_stats (dc_irda_t *irda, dc_stats_t *stats);
+
 /**
  * Enumerate the IrDA devices.
  *
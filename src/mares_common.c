@@ -27,6 +27,9 @@
 #include "mares_common.h"
 #include "checksum.h"
 #include "array.h"
+#include "rbstream.h"
+
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
 
 #define MAXRETRIES 4
 
@@ -46,6 +49,11 @@
 #define FREEDIVE 2
 #define GAUGE    3
 
+static const dc_timing_t mares_common_timing[] = {
+	{"puck.delay",   0, 0,  500,  0, 0}, // Delay before sending a command.
+	{"puck.retry", 100, 0, 1000, 50, TIMING_TURNAROUND}, // Drain time before retrying a corrupted packet.
+};
+
 void
 mares_common_device_init (mares_common_device_t *device)
 {
@@ -54,7 +62,7 @@ mares_common_device_init (mares_common_device_t *device)
 	// Set the default values.
 	device->port = NULL;
 	device->echo = 0;
-	device->delay = 0;
+	device_timing_init ((dc_device_t *) device, mares_common_timing, C_ARRAY_SIZE (mares_common_timing));
 }
 
 
@@ -87,8 +95,9 @@ mares_common_packet (mares_common_device_t *device, const unsigned char command[
 	if (device_is_cancelled (abstract))
 		return DC_STATUS_CANCELLED;
 
-	if (device->delay) {
-		dc_serial_sleep (device->port, device->delay);
+	unsigned int delay = device_timing (abstract, MARES_COMMON_T_DELAY);
+	if (delay) {
+		dc_serial_sleep (device->port, delay);
 	}
 
 	// Send the command to the device.
@@ -142,23 +151,29 @@ mares_common_packet (mares_common_device_t *device, const unsigned char command[
 static dc_status_t
 mares_common_transfer (mares_common_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize)
 {
+	unsigned long long start = device_stats_begin (&device->base);
+
 	unsigned int nretries = 0;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	while ((rc = mares_common_packet (device, command, csize, answer, asize)) != DC_STATUS_SUCCESS) {
 		// Automatically discard a corrupted packet,
 		// and request a new one.
 		if (rc != DC_STATUS_PROTOCOL && rc != DC_STATUS_TIMEOUT)
-			return rc;
+			break;
 
 		// Abort if the maximum number of retries is reached.
 		if (nretries++ >= MAXRETRIES)
-			return rc;
+			break;
+
+		device_stats_retry (&device->base);
 
 		// Discard any garbage bytes.
-		dc_serial_sleep (device->port, 100);
+		dc_serial_sleep (device->port, device_timing_backoff (&device->base, MARES_COMMON_T_RETRY));
 		dc_serial_purge (device->port, DC_DIRECTION_INPUT);
 	}
 
+	device_stats_end (&device->base, start, rc);
+
 	return rc;
 }
 
@@ -203,6 +218,195 @@ mares_common_device_read (dc_device_t *abstract, unsigned int address, unsigned
 }
 
 
+static dc_status_t
+mares_common_rbstream_fill (dc_rbstream_t *rbstream, dc_event_progress_t *progress, unsigned char buffer[], unsigned int size, unsigned int *available, unsigned int required)
+{
+	if (required > size)
+		required = size;
+
+	if (*available >= required)
+		return DC_STATUS_SUCCESS;
+
+	// The ringbuffer stream reads backwards, so the new data
+	// is located immediately before the data already available.
+	dc_status_t rc = dc_rbstream_read (rbstream, progress, buffer + size - required, required - *available);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	*available = required;
+
+	return DC_STATUS_SUCCESS;
+}
+
+
+dc_status_t
+mares_common_device_fetch (dc_device_t *abstract, const mares_common_layout_t *layout, const unsigned char fingerprint[], dc_buffer_t *buffer)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	assert (layout != NULL);
+
+	// Erase the current contents of the buffer and
+	// allocate the required amount of memory.
+	if (!dc_buffer_clear (buffer) || !dc_buffer_resize (buffer, layout->memsize)) {
+		ERROR (abstract->context, "Insufficient buffer space available.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	unsigned char *data = dc_buffer_get_data (buffer);
+
+	// Memory that is not downloaded is marked as empty, which makes
+	// mares_common_extract_dives stop at the oldest downloaded dive.
+	memset (data, 0xFF, layout->memsize);
+
+	// Enable progress notifications.
+	unsigned int rb_profile_size = layout->rb_profile_end - layout->rb_profile_begin;
+	dc_event_progress_t progress = EVENT_PROGRESS_INITIALIZER;
+	progress.maximum = layout->rb_profile_begin + rb_profile_size;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	// Read the header.
+	rc = dc_device_read (abstract, 0, data, layout->rb_profile_begin);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to read the header.");
+		return rc;
+	}
+
+	progress.current += layout->rb_profile_begin;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+	// Get the freedive mode for this model.
+	unsigned int model = data[1];
+	unsigned int freedive = FREEDIVE;
+	if (model == NEMOWIDE || model == NEMOAIR || model == PUCK || model == PUCKAIR)
+		freedive = GAUGE;
+
+	// Get the end of the profile ring buffer.
+	unsigned int eop = array_uint16_le (data + 0x6B);
+	if (eop < layout->rb_profile_begin || eop >= layout->rb_profile_end) {
+		ERROR (abstract->context, "Ringbuffer pointer out of range (0x%04x).", eop);
+		return DC_STATUS_DATAFORMAT;
+	}
+
+	// Linear buffer for the profile ringbuffer, with the most recent
+	// data at the end (same layout as in mares_common_extract_dives).
+	unsigned char *profile = (unsigned char *) malloc (rb_profile_size);
+	if (profile == NULL) {
+		ERROR (abstract->context, "Failed to allocate memory.");
+		return DC_STATUS_NOMEMORY;
+	}
+
+	dc_rbstream_t *rbstream = NULL;
+	rc = dc_rbstream_new (&rbstream, abstract, 1, PACKETSIZE, layout->rb_profile_begin, layout->rb_profile_end, eop);
+	if (rc != DC_STATUS_SUCCESS) {
+		ERROR (abstract->context, "Failed to create the ringbuffer stream.");
+		free (profile);
+		return rc;
+	}
+
+	// Walk backwards through the dives, and download only the data up to
+	// (and including) the dive matching the fingerprint. The dive sizes
+	// are calculated exactly as in mares_common_extract_dives.
+	unsigned int available = 0;
+	unsigned int freedives = 0;
+	unsigned int nfreedives = 0;
+	unsigned int offset = rb_profile_size;
+	while (offset >= 3) {
+		rc = mares_common_rbstream_fill (rbstream, &progress, profile, rb_profile_size, &available, rb_profile_size - offset + 3);
+		if (rc != DC_STATUS_SUCCESS)
+			goto error;
+
+		unsigned int extra = 0;
+		const unsigned char marker[3] = {0xAA, 0xBB, 0xCC};
+		if (memcmp (profile + offset - 3, marker, sizeof (marker)) == 0) {
+			if (model == PUCKAIR)
+				extra = 7;
+			else
+				extra = 12;
+		}
+
+		if (offset < extra + 3)
+			break;
+
+		rc = mares_common_rbstream_fill (rbstream, &progress, profile, rb_profile_size, &available, rb_profile_size - offset + extra + 3);
+		if (rc != DC_STATUS_SUCCESS)
+			goto error;
+
+		unsigned int mode = profile[offset - extra - 1];
+		if (mode == 0xFF)
+			break;
+
+		unsigned int header_size = 53;
+		unsigned int sample_size = 2;
+		if (extra) {
+			if (model == PUCKAIR)
+				sample_size = 3;
+			else
+				sample_size = 5;
+		}
+		if (mode == freedive) {
+			header_size = 28;
+			sample_size = 6;
+			nfreedives++;
+		}
+
+		unsigned int nsamples = array_uint16_le (profile + offset - extra - 3);
+
+		unsigned int nbytes = 2 + nsamples * sample_size + header_size + extra;
+		if (offset < nbytes)
+			break;
+
+		offset -= nbytes;
+
+		rc = mares_common_rbstream_fill (rbstream, &progress, profile, rb_profile_size, &available, rb_profile_size - offset);
+		if (rc != DC_STATUS_SUCCESS)
+			goto error;
+
+		// The profile data of the most recent freedive session is stored
+		// in a separate memory area.
+		if (mode == freedive && nfreedives == 1)
+			freedives = 1;
+
+		unsigned int fp_offset = offset + nbytes - extra - FP_OFFSET;
+		if (fingerprint && memcmp (profile + fp_offset, fingerprint, FP_SIZE) == 0)
+			break;
+	}
+
+	// Copy the downloaded part of the ringbuffer back to its original
+	// location in the memory image.
+	unsigned int skip = rb_profile_size - available;
+	unsigned int len_a = layout->rb_profile_end - eop;
+	if (skip < len_a) {
+		memcpy (data + eop + skip, profile + skip, len_a - skip);
+		memcpy (data + layout->rb_profile_begin, profile + len_a, available - (len_a - skip));
+	} else {
+		memcpy (data + layout->rb_profile_begin + (skip - len_a), profile + skip, available);
+	}
+
+	// Read the freedive profile data.
+	if (freedives && layout->rb_freedives_end > layout->rb_freedives_begin) {
+		rc = dc_device_read (abstract, layout->rb_freedives_begin,
+			data + layout->rb_freedives_begin,
+			layout->rb_freedives_end - layout->rb_freedives_begin);
+		if (rc != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to read the freedive data.");
+			goto error;
+		}
+
+		progress.current += layout->rb_freedives_end - layout->rb_freedives_begin;
+	}
+
+	// Emit the final progress event.
+	progress.maximum = progress.current;
+	device_event_emit (abstract, DC_EVENT_PROGRESS, &progress);
+
+error:
+	dc_rbstream_free (rbstream);
+	free (profile);
+	return rc;
+}
+
+
 dc_status_t
 mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *layout, const unsigned char fingerprint[], const unsigned char data[], dc_dive_callback_t callback, void *userdata)
 {
@@ -31,6 +31,9 @@ extern "C" {
 
 #define PACKETSIZE 0x20
 
+#define MARES_COMMON_T_DELAY 0
+#define MARES_COMMON_T_RETRY 1
+
 typedef struct mares_common_layout_t {
 	unsigned int memsize;
 	unsigned int rb_profile_begin;
@@ -43,7 +46,6 @@ typedef struct mares_common_device_t {
 	dc_device_t base;
 	dc_serial_t *port;
 	unsigned int echo;
-	unsigned int delay;
 } mares_common_device_t;
 
 void
@@ -52,6 +54,9 @@ mares_common_device_init (mares_common_device_t *device);
 dc_status_t
 mares_common_device_read (dc_device_t *abstract, unsigned int address, unsigned char data[], unsigned int size);
 
+dc_status_t
+mares_common_device_fetch (dc_device_t *abstract, const mares_common_layout_t *layout, const unsigned char fingerprint[], dc_buffer_t *buffer);
+
 dc_status_t
 mares_common_extract_dives (dc_context_t *context, const mares_common_layout_t *layout, const unsigned char fingerprint[], const unsigned char data[], dc_dive_callback_t callback, void *userdata);
 
@@ -33,9 +33,13 @@
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &mares_darwin_device_vtable)
 
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
 #define DARWIN    0
 #define DARWINAIR 1
 
+#define T_SETTLE  2
+
 typedef struct mares_darwin_layout_t {
 	// Memory size.
 	unsigned int memsize;
@@ -93,6 +97,13 @@ static const mares_darwin_layout_t mares_darwinair_layout = {
 	3       /* samplesize */
 };
 
+// The first entries must match the mares_common parameters.
+static const dc_timing_t mares_darwin_timing[] = {
+	{"darwin.delay",   50, 10,  500,  0, 0}, // Delay before sending a command.
+	{"darwin.retry",  100,  0, 1000, 50, TIMING_TURNAROUND}, // Drain time before retrying a corrupted packet.
+	{"darwin.settle", 100, 20, 1000,  0, 0}, // Settle time after setting the DTR/RTS lines.
+};
+
 static dc_status_t
 mares_darwin_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
 
@@ -115,6 +126,9 @@ mares_darwin_device_open (dc_device_t **out, dc_context_t *context, const char *
 	// Initialize the base class.
 	mares_common_device_init (&device->base);
 
+	// Override the base class timing.
+	device_timing_init ((dc_device_t *) device, mares_darwin_timing, C_ARRAY_SIZE (mares_darwin_timing));
+
 	// Set the default values.
 	memset (device->fingerprint, 0, sizeof (device->fingerprint));
 	device->model = model;
@@ -130,6 +144,8 @@ mares_darwin_device_open (dc_device_t **out, dc_context_t *context, const char *
 		goto error_free;
 	}
 
+	dc_serial_set_stats (device->base.port, &device->base.base.stats);
+
 	// Set the serial communication protocol (9600 8N1).
 	status = dc_serial_configure (device->base.port, 9600, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -159,12 +175,11 @@ mares_darwin_device_open (dc_device_t **out, dc_context_t *context, const char *
 	}
 
 	// Make sure everything is in a sane state.
-	dc_serial_sleep (device->base.port, 100);
+	dc_serial_sleep (device->base.port, device_timing ((dc_device_t *) device, T_SETTLE));
 	dc_serial_purge (device->base.port, DC_DIRECTION_ALL);
 
 	// Override the base class values.
 	device->base.echo = 1;
-	device->base.delay = 50;
 
 	*out = (dc_device_t *) device;
 
@@ -20,6 +20,7 @@
  */
 
 #include <stdlib.h>
+#include <limits.h>
 
 #include <libdivecomputer/units.h>
 
@@ -62,10 +63,19 @@ struct mares_iconhd_parser_t {
 	unsigned int oxygen[NGASMIXES];
 };
 
+typedef struct mares_iconhd_state_t {
+	unsigned int offset;
+	unsigned int nsamples;
+	unsigned int time;
+	// Previous gas mix.
+	unsigned int gasmix_previous;
+} mares_iconhd_state_t;
+
 static dc_status_t mares_iconhd_parser_set_data (dc_parser_t *abstract, const unsigned char *data, unsigned int size);
 static dc_status_t mares_iconhd_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t mares_iconhd_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t mares_iconhd_parser_samples_range (dc_parser_t *abstract, unsigned int begin, unsigned int end, dc_sample_callback_t callback, void *userdata);
 
 static const dc_parser_vtable_t mares_iconhd_parser_vtable = {
 	sizeof(mares_iconhd_parser_t),
@@ -74,6 +84,7 @@ static const dc_parser_vtable_t mares_iconhd_parser_vtable = {
 	mares_iconhd_parser_get_datetime, /* datetime */
 	mares_iconhd_parser_get_field, /* fields */
 	mares_iconhd_parser_samples_foreach, /* samples_foreach */
+	mares_iconhd_parser_samples_range, /* samples_range */
 	NULL /* destroy */
 };
 
@@ -484,14 +495,10 @@ mares_iconhd_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsi
 
 
 static dc_status_t
-mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+mares_iconhd_parser_walk (dc_parser_t *abstract, void *userstate, unsigned int end, sample_index_t *index, dc_sample_callback_t callback, void *userdata)
 {
 	mares_iconhd_parser_t *parser = (mares_iconhd_parser_t *) abstract;
-
-	// Cache the parser data.
-	dc_status_t rc = mares_iconhd_parser_cache (parser);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	mares_iconhd_state_t *state = (mares_iconhd_state_t *) userstate;
 
 	const unsigned char *data = abstract->data;
 
@@ -503,15 +510,19 @@ mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 		WARNING(abstract->context, "Multiple samples per second are not supported!");
 	}
 
-	// Previous gas mix - initialize with impossible value
-	unsigned int gasmix_previous = 0xFFFFFFFF;
-
-	unsigned int time = 0;
-	unsigned int offset = 4;
-	unsigned int nsamples = 0;
-	while (nsamples < parser->nsamples) {
+	unsigned int time = state->time;
+	unsigned int offset = state->offset;
+	unsigned int nsamples = state->nsamples;
+	while (nsamples < parser->nsamples && time <= end) {
 		dc_sample_value_t sample = {0};
 
+		if (index && nsamples && (nsamples % SAMPLE_INDEX_INTERVAL) == 0) {
+			state->offset = offset;
+			state->nsamples = nsamples;
+			state->time = time;
+			sample_index_append (index, time, state);
+		}
+
 		if (parser->model == SMARTAPNEA) {
 			unsigned int maxdepth = array_uint16_le (data + offset + 0);
 			unsigned int divetime = array_uint16_le (data + offset + 2);
@@ -590,10 +601,10 @@ mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 					ERROR (abstract->context, "Invalid gas mix index.");
 					return DC_STATUS_DATAFORMAT;
 				}
-				if (gasmix != gasmix_previous) {
+				if (gasmix != state->gasmix_previous) {
 					sample.gasmix = gasmix;
 					if (callback) callback (DC_SAMPLE_GASMIX, sample, userdata);
-					gasmix_previous = gasmix;
+					state->gasmix_previous = gasmix;
 				}
 			}
 
@@ -617,5 +628,51 @@ mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 		}
 	}
 
+	state->offset = offset;
+	state->nsamples = nsamples;
+	state->time = time;
+
 	return DC_STATUS_SUCCESS;
 }
+
+static void
+mares_iconhd_parser_init (mares_iconhd_parser_t *parser, mares_iconhd_state_t *state)
+{
+	state->offset = 4;
+	state->nsamples = 0;
+	state->time = 0;
+	// Initialize with an impossible value.
+	state->gasmix_previous = 0xFFFFFFFF;
+}
+
+static dc_status_t
+mares_iconhd_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+{
+	mares_iconhd_parser_t *parser = (mares_iconhd_parser_t *) abstract;
+	mares_iconhd_state_t state;
+
+	// Cache the parser data.
+	dc_status_t rc = mares_iconhd_parser_cache (parser);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	mares_iconhd_parser_init (parser, &state);
+
+	return mares_iconhd_parser_walk (abstract, &state, UINT_MAX, NULL, callback, userdata);
+}
+
+static dc_status_t
+mares_iconhd_parser_samples_range (dc_parser_t *abstract, unsigned int begin, unsigned int end, dc_sample_callback_t callback, void *userdata)
+{
+	mares_iconhd_parser_t *parser = (mares_iconhd_parser_t *) abstract;
+	mares_iconhd_state_t state;
+
+	// Cache the parser data.
+	dc_status_t rc = mares_iconhd_parser_cache (parser);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	mares_iconhd_parser_init (parser, &state);
+
+	return sample_index_walk (abstract, begin, end, &state, sizeof (state), mares_iconhd_parser_walk, callback, userdata);
+}
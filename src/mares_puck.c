@@ -115,6 +115,8 @@ mares_puck_device_open (dc_device_t **out, dc_context_t *context, const char *na
 		goto error_free;
 	}
 
+	dc_serial_set_stats (device->base.port, &device->base.base.stats);
+
 	// Set the serial communication protocol (38400 8N1).
 	status = dc_serial_configure (device->base.port, 38400, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -246,7 +248,8 @@ mares_puck_device_foreach (dc_device_t *abstract, dc_dive_callback_t callback, v
 	if (buffer == NULL)
 		return DC_STATUS_NOMEMORY;
 
-	dc_status_t rc = mares_puck_device_dump (abstract, buffer);
+	// Download only the dives newer than the fingerprint.
+	dc_status_t rc = mares_common_device_fetch (abstract, device->layout, device->fingerprint, buffer);
 	if (rc != DC_STATUS_SUCCESS) {
 		dc_buffer_free (buffer);
 		return rc;
@@ -33,6 +33,8 @@
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &oceanic_atom2_device_vtable.base)
 
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
 #define VTX        0x4557
 #define I750TC     0x455A
 
@@ -52,10 +54,13 @@
 #define ACK 0x5A
 #define NAK 0xA5
 
+#define T_DELAY  0
+#define T_RETRY  1
+#define T_SETTLE 2
+
 typedef struct oceanic_atom2_device_t {
 	oceanic_common_device_t base;
 	dc_serial_t *port;
-	unsigned int delay;
 	unsigned int bigpage;
 	unsigned char cache[256];
 	unsigned int cached;
@@ -459,6 +464,12 @@ static const oceanic_common_layout_t aqualung_i450t_layout = {
 	0, /* pt_mode_serial */
 };
 
+static const dc_timing_t oceanic_atom2_timing[] = {
+	{"atom2.delay",    0,  0, MAXDELAY, 1, 0}, // Inter packet delay.
+	{"atom2.retry",  100,  0,     1000, 0, 0}, // Delay before resending a rejected command.
+	{"atom2.settle", 100, 20,     1000, 0, 0}, // Time for the interface to settle and draw power up.
+};
+
 static dc_status_t
 oceanic_atom2_packet (oceanic_atom2_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize, unsigned int crc_size)
 {
@@ -468,8 +479,9 @@ oceanic_atom2_packet (oceanic_atom2_device_t *device, const unsigned char comman
 	if (device_is_cancelled (abstract))
 		return DC_STATUS_CANCELLED;
 
-	if (device->delay) {
-		dc_serial_sleep (device->port, device->delay);
+	unsigned int delay = device_timing (abstract, T_DELAY);
+	if (delay) {
+		dc_serial_sleep (device->port, delay);
 	}
 
 	// Send the command to the dive computer.
@@ -535,26 +547,31 @@ oceanic_atom2_transfer (oceanic_atom2_device_t *device, const unsigned char comm
 	// a NAK byte, we try to resend the command a number of times before
 	// returning an error.
 
+	unsigned long long start = device_stats_begin ((dc_device_t *) device);
+
 	unsigned int nretries = 0;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	while ((rc = oceanic_atom2_packet (device, command, csize, answer, asize, crc_size)) != DC_STATUS_SUCCESS) {
 		if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL)
-			return rc;
+			break;
 
 		// Abort if the maximum number of retries is reached.
 		if (nretries++ >= MAXRETRIES)
-			return rc;
+			break;
+
+		device_stats_retry ((dc_device_t *) device);
 
 		// Increase the inter packet delay.
-		if (device->delay < MAXDELAY)
-			device->delay++;
+		device_timing_backoff ((dc_device_t *) device, T_DELAY);
 
 		// Delay the next attempt.
-		dc_serial_sleep (device->port, 100);
+		dc_serial_sleep (device->port, device_timing ((dc_device_t *) device, T_RETRY));
 		dc_serial_purge (device->port, DC_DIRECTION_INPUT);
 	}
 
-	return DC_STATUS_SUCCESS;
+	device_stats_end ((dc_device_t *) device, start, rc);
+
+	return rc;
 }
 
 
@@ -592,7 +609,7 @@ oceanic_atom2_device_open (dc_device_t **out, dc_context_t *context, const char
 
 	// Set the default values.
 	device->port = NULL;
-	device->delay = 0;
+	device_timing_init ((dc_device_t *) device, oceanic_atom2_timing, C_ARRAY_SIZE (oceanic_atom2_timing));
 	device->bigpage = 1; // no big pages
 	device->cached = INVALID;
 	memset(device->cache, 0, sizeof(device->cache));
@@ -604,6 +621,8 @@ oceanic_atom2_device_open (dc_device_t **out, dc_context_t *context, const char
 		goto error_free;
 	}
 
+	dc_serial_set_stats (device->port, &device->base.base.stats);
+
 	// Get the correct baudrate.
 	unsigned int baudrate = 38400;
 	if (model == VTX || model == I750TC) {
@@ -624,8 +643,8 @@ oceanic_atom2_device_open (dc_device_t **out, dc_context_t *context, const char
 		goto error_close;
 	}
 
-	// Give the interface 100 ms to settle and draw power up.
-	dc_serial_sleep (device->port, 100);
+	// Give the interface some time to settle and draw power up.
+	dc_serial_sleep (device->port, device_timing ((dc_device_t *) device, T_SETTLE));
 
 	// Set the DTR/RTS lines.
 	dc_serial_set_dtr(device->port, 1);
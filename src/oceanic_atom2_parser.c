@@ -33,6 +33,8 @@
 
 #define ISINSTANCE(parser) dc_parser_isinstance((parser), &oceanic_atom2_parser_vtable)
 
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
 #define ATOM1       0x4250
 #define EPICA       0x4257
 #define VT3         0x4258
@@ -96,13 +98,102 @@
 #define HEADER  1
 #define PROFILE 2
 
+// Date and time format.
+#define DATETIME_DEFAULT 0
+#define DATETIME_OC1     1
+#define DATETIME_VT3     2
+#define DATETIME_ZENAIR  3
+#define DATETIME_F10     4
+#define DATETIME_TX1     5
+#define DATETIME_A300CS  6
+
+// Location of the dive mode.
+#define MODE_NORMAL   0 /* Always open circuit */
+#define MODE_FREEDIVE 1 /* Always freedive */
+#define MODE_BYTE1    2 /* Bits 5-6 of byte 1 */
+#define MODE_BYTE2    3 /* Bits 6-7 of byte 2 */
+
+// Temperature (°F) in the samples. The delta formats store a two bit
+// delta in byte 7, with the sign bit in byte 0 or 5. The sign bit
+// means a negative delta for the formats with the N suffix.
+#define TEMP_NONE    0
+#define TEMP_BYTE1   1
+#define TEMP_BYTE3   2
+#define TEMP_BYTE6   3
+#define TEMP_BYTE11  4
+#define TEMP_PACKED  5
+#define TEMP_DELTA0  6
+#define TEMP_DELTA0N 7
+#define TEMP_DELTA5  8
+#define TEMP_DELTA5N 9
+
+// Tank pressure (psi) in the samples.
+#define PRESSURE_NONE   0
+#define PRESSURE_DELTA  1
+#define PRESSURE_PACKED 2
+#define PRESSURE_OC1    3
+#define PRESSURE_TX1    4
+#define PRESSURE_A300CS 5
+
+// Tank switch sample.
+#define TANK_DEFAULT  0
+#define TANK_ATOM2    1
+#define TANK_DATAMASK 2
+#define TANK_A300CS   3
+
+// Depth (1/16 ft) in the samples.
+#define DEPTH_DEFAULT  0
+#define DEPTH_OC1      1
+#define DEPTH_ATOM1    2
+#define DEPTH_FREEDIVE 3
+
+// Decompression status in the samples.
+#define DECO_NONE   0
+#define DECO_ZEN    1
+#define DECO_ATOM31 2
+#define DECO_TX1    3
+#define DECO_A300CS 4
+
+// Remaining bottom time in the samples.
+#define RBT_NONE   0
+#define RBT_ATOM31 1
+#define RBT_VISION 2
+#define RBT_I450T  3
+
+// Layout flags.
+#define TIMESTAMP  0x01 /* Absolute timestamps in the samples */
+#define GASSWITCH  0x02 /* Gas mix index in the samples */
+#define SALINITY   0x04 /* Water type in the header */
+#define GASMIXES   0x08 /* Number of gas mixes in the header */
+#define SAMPLERATE 0x10 /* Freedive sample rate in the header */
+
+typedef struct oceanic_atom2_layout_t {
+	unsigned int model;
+	unsigned int headersize;
+	unsigned int footersize;
+	unsigned int header; /* Offset of the header sample */
+	unsigned int oxygen;
+	unsigned int helium;
+	unsigned int ngasmixes;
+	unsigned int datetime;
+	unsigned int mode;
+	unsigned int samplesize;
+	unsigned int interval; /* Offset of the sample interval */
+	unsigned int temperature;
+	unsigned int pressure;
+	unsigned int tank;
+	unsigned int depth;
+	unsigned int deco;
+	unsigned int rbt;
+	unsigned int flags;
+} oceanic_atom2_layout_t;
+
 typedef struct oceanic_atom2_parser_t oceanic_atom2_parser_t;
 
 struct oceanic_atom2_parser_t {
 	dc_parser_t base;
 	unsigned int model;
-	unsigned int headersize;
-	unsigned int footersize;
+	const oceanic_atom2_layout_t *layout;
 	unsigned int serial;
 	// Cached fields.
 	unsigned int cached;
@@ -128,9 +219,139 @@ static const dc_parser_vtable_t oceanic_atom2_parser_vtable = {
 	oceanic_atom2_parser_get_datetime, /* datetime */
 	oceanic_atom2_parser_get_field, /* fields */
 	oceanic_atom2_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_range */
 	NULL /* destroy */
 };
 
+/*
+ * The layout of the dives, indexed by model number. The first line of
+ * each entry describes the logbook header, the second line the samples.
+ * Models that are not listed use the default layout.
+ */
+static const oceanic_atom2_layout_t oceanic_atom2_layouts[] = {
+	{ATOM1,     0x28, 0x10, 0x20, 0x24, 0x00, 3, DATETIME_DEFAULT, MODE_NORMAL,
+		0x08, 0x17, TEMP_BYTE6,   PRESSURE_DELTA,  TANK_DEFAULT,  DEPTH_ATOM1,    DECO_NONE,   RBT_NONE,   0},
+	{EPICA,     0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_DEFAULT, MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA0N, PRESSURE_DELTA,  TANK_ATOM2,    DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{VT3,       0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_VT3,     MODE_BYTE2,
+		0x08, 0x17, TEMP_DELTA0,  PRESSURE_DELTA,  TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{T3A,       0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_VT3,     MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA0,  PRESSURE_DELTA,  TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{ATOM2,     0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_DEFAULT, MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA0N, PRESSURE_DELTA,  TANK_ATOM2,    DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{GEO,       0x38, 0x10, 0x30, 0x34, 0x00, 3, DATETIME_DEFAULT, MODE_NORMAL,
+		0x08, 0x17, TEMP_BYTE6,   PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{MANTA,     0x38, 0x10, 0x30, 0x34, 0x00, 3, DATETIME_DEFAULT, MODE_NORMAL,
+		0x08, 0x17, TEMP_BYTE6,   PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{DATAMASK,  0x38, 0x10, 0x30, 0x33, 0x00, 1, DATETIME_VT3,     MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA0,  PRESSURE_DELTA,  TANK_DATAMASK, DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{COMPUMASK, 0x38, 0x10, 0x30, 0x33, 0x00, 1, DATETIME_VT3,     MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA0,  PRESSURE_DELTA,  TANK_DATAMASK, DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{OC1A,      0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_OC1,     MODE_NORMAL,
+		0x10, 0x17, TEMP_BYTE3,   PRESSURE_OC1,    TANK_DEFAULT,  DEPTH_OC1,      DECO_NONE,   RBT_NONE,   0},
+	{F10A,      0x30, 0x00, 0x28, 0x00, 0x00, 0, DATETIME_F10,     MODE_FREEDIVE,
+		0x02, 0x00, TEMP_NONE,    PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_FREEDIVE, DECO_NONE,   RBT_NONE,   0},
+	{WISDOM2,   0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_DEFAULT, MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA0N, PRESSURE_DELTA,  TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{INSIGHT2,  0x38, 0x10, 0x30, 0x34, 0x00, 3, DATETIME_VT3,     MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA0,  PRESSURE_DELTA,  TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{ELEMENT2,  0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_DEFAULT, MODE_NORMAL,
+		0x08, 0x17, TEMP_BYTE6,   PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{VEO20,     0x38, 0x10, 0x30, 0x34, 0x00, 3, DATETIME_VT3,     MODE_BYTE1,
+		0x08, 0x17, TEMP_BYTE3,   PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_OC1,      DECO_NONE,   RBT_NONE,   0},
+	{VEO30,     0x38, 0x10, 0x30, 0x34, 0x00, 3, DATETIME_VT3,     MODE_BYTE1,
+		0x08, 0x17, TEMP_BYTE3,   PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_OC1,      DECO_NONE,   RBT_NONE,   0},
+	{ZEN,       0x38, 0x10, 0x30, 0x34, 0x00, 2, DATETIME_DEFAULT, MODE_NORMAL,
+		0x08, 0x17, TEMP_BYTE6,   PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_ZEN,    RBT_NONE,   0},
+	{ZENAIR,    0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_ZENAIR,  MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA5N, PRESSURE_PACKED, TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{ATMOSAI2,  0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_DEFAULT, MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA0N, PRESSURE_DELTA,  TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{PROPLUS21, 0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_DEFAULT, MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA0N, PRESSURE_DELTA,  TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{GEO20,     0x38, 0x10, 0x30, 0x34, 0x00, 3, DATETIME_VT3,     MODE_NORMAL,
+		0x08, 0x17, TEMP_BYTE3,   PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_OC1,      DECO_NONE,   RBT_NONE,   0},
+	{VT4,       0x58, 0x10, 0x30, 0x34, 0x00, 4, DATETIME_OC1,     MODE_NORMAL,
+		0x08, 0x17, TEMP_PACKED,  PRESSURE_PACKED, TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{OC1B,      0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_OC1,     MODE_NORMAL,
+		0x10, 0x17, TEMP_BYTE3,   PRESSURE_OC1,    TANK_DEFAULT,  DEPTH_OC1,      DECO_NONE,   RBT_NONE,   0},
+	{VOYAGER2G, 0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_ZENAIR,  MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA5N, PRESSURE_DELTA,  TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{ATOM3,     0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_OC1,     MODE_NORMAL,
+		0x08, 0x17, TEMP_PACKED,  PRESSURE_PACKED, TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{DG03,      0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_VT3,     MODE_BYTE2,
+		0x08, 0x17, TEMP_DELTA5,  PRESSURE_PACKED, TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_ZEN,    RBT_NONE,   0},
+	{OCS,       0x38, 0x10, 0x30, 0x34, 0x00, 3, DATETIME_OC1,     MODE_BYTE1,
+		0x08, 0x17, TEMP_BYTE1,   PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{OC1C,      0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_OC1,     MODE_NORMAL,
+		0x10, 0x17, TEMP_BYTE3,   PRESSURE_OC1,    TANK_DEFAULT,  DEPTH_OC1,      DECO_NONE,   RBT_NONE,   0},
+	{VT41,      0x58, 0x10, 0x30, 0x34, 0x00, 4, DATETIME_OC1,     MODE_NORMAL,
+		0x08, 0x17, TEMP_PACKED,  PRESSURE_PACKED, TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{EPICB,     0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_DEFAULT, MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA0N, PRESSURE_DELTA,  TANK_ATOM2,    DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{T3B,       0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_VT3,     MODE_BYTE2,
+		0x08, 0x17, TEMP_DELTA0,  PRESSURE_DELTA,  TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{ATOM31,    0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_OC1,     MODE_NORMAL,
+		0x08, 0x17, TEMP_PACKED,  PRESSURE_PACKED, TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_ATOM31, RBT_ATOM31, 0},
+	{A300AI,    0x48, 0x10, 0x30, 0x34, 0x00, 4, DATETIME_OC1,     MODE_NORMAL,
+		0x08, 0x17, TEMP_PACKED,  PRESSURE_PACKED, TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{WISDOM3,   0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_DEFAULT, MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA0N, PRESSURE_DELTA,  TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{A300,      0x38, 0x10, 0x30, 0x34, 0x00, 3, DATETIME_DEFAULT, MODE_NORMAL,
+		0x08, 0x17, TEMP_BYTE3,   PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_OC1,      DECO_NONE,   RBT_NONE,   0},
+	{TX1,       0x68, 0x10, 0x60, 0x3E, 0x48, 6, DATETIME_TX1,     MODE_NORMAL,
+		0x10, 0x17, TEMP_BYTE1,   PRESSURE_TX1,    TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_TX1,    RBT_NONE,   GASSWITCH},
+	{MUNDIAL2,  0x30, 0x00, 0x28, 0x00, 0x00, 0, DATETIME_F10,     MODE_FREEDIVE,
+		0x02, 0x00, TEMP_NONE,    PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_FREEDIVE, DECO_NONE,   RBT_NONE,   0},
+	{AMPHOS,    0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_ZENAIR,  MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA5N, PRESSURE_DELTA,  TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{AMPHOSAIR, 0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_ZENAIR,  MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA5N, PRESSURE_PACKED, TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{PROPLUS3,  0x38, 0x10, 0x30, 0x34, 0x00, 3, DATETIME_VT3,     MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA5,  PRESSURE_PACKED, TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0},
+	{F11A,      0x50, 0x00, 0x48, 0x00, 0x00, 0, DATETIME_F10,     MODE_FREEDIVE,
+		0x02, 0x29, TEMP_NONE,    PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_FREEDIVE, DECO_NONE,   RBT_NONE,   SAMPLERATE},
+	{OCI,       0x48, 0x10, 0x40, 0x28, 0x00, 4, DATETIME_OC1,     MODE_NORMAL,
+		0x10, 0x17, TEMP_BYTE3,   PRESSURE_OC1,    TANK_DEFAULT,  DEPTH_OC1,      DECO_NONE,   RBT_NONE,   0},
+	{A300CS,    0x50, 0x10, 0x48, 0x2A, 0x00, 4, DATETIME_A300CS,  MODE_NORMAL,
+		0x10, 0x1F, TEMP_BYTE11,  PRESSURE_A300CS, TANK_A300CS,   DEPTH_DEFAULT,  DECO_A300CS, RBT_NONE,   SALINITY | GASMIXES},
+	{MUNDIAL3,  0x30, 0x00, 0x28, 0x00, 0x00, 0, DATETIME_F10,     MODE_FREEDIVE,
+		0x02, 0x00, TEMP_NONE,    PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_FREEDIVE, DECO_NONE,   RBT_NONE,   0},
+	{F10B,      0x30, 0x00, 0x28, 0x00, 0x00, 0, DATETIME_F10,     MODE_FREEDIVE,
+		0x02, 0x00, TEMP_NONE,    PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_FREEDIVE, DECO_NONE,   RBT_NONE,   0},
+	{F11B,      0x50, 0x00, 0x48, 0x00, 0x00, 0, DATETIME_F10,     MODE_FREEDIVE,
+		0x02, 0x29, TEMP_NONE,    PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_FREEDIVE, DECO_NONE,   RBT_NONE,   SAMPLERATE},
+	{XPAIR,     0x48, 0x10, 0x30, 0x34, 0x00, 4, DATETIME_OC1,     MODE_NORMAL,
+		0x08, 0x17, TEMP_PACKED,  PRESSURE_PACKED, TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_ATOM31, RBT_VISION, 0},
+	{VISION,    0x48, 0x10, 0x30, 0x34, 0x00, 4, DATETIME_OC1,     MODE_NORMAL,
+		0x08, 0x17, TEMP_PACKED,  PRESSURE_PACKED, TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_ATOM31, RBT_VISION, 0},
+	{VTX,       0x50, 0x10, 0x48, 0x2A, 0x00, 4, DATETIME_A300CS,  MODE_NORMAL,
+		0x10, 0x1F, TEMP_BYTE11,  PRESSURE_A300CS, TANK_A300CS,   DEPTH_DEFAULT,  DECO_A300CS, RBT_NONE,   SALINITY | GASMIXES},
+	{I300,      0x38, 0x10, 0x30, 0x34, 0x00, 3, DATETIME_VT3,     MODE_NORMAL,
+		0x08, 0x17, TEMP_BYTE3,   PRESSURE_NONE,   TANK_DEFAULT,  DEPTH_OC1,      DECO_NONE,   RBT_NONE,   0},
+	{I750TC,    0x50, 0x10, 0x48, 0x2A, 0x00, 4, DATETIME_A300CS,  MODE_NORMAL,
+		0x10, 0x1F, TEMP_BYTE11,  PRESSURE_A300CS, TANK_A300CS,   DEPTH_DEFAULT,  DECO_A300CS, RBT_NONE,   SALINITY | GASMIXES},
+	{I450T,     0x50, 0x10, 0x48, 0x30, 0x00, 3, DATETIME_A300CS,  MODE_NORMAL,
+		0x10, 0x1F, TEMP_BYTE3,   PRESSURE_OC1,    TANK_DEFAULT,  DEPTH_OC1,      DECO_A300CS, RBT_I450T,  TIMESTAMP},
+	{I550,      0x38, 0x10, 0x30, 0x34, 0x00, 3, DATETIME_OC1,     MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA5,  PRESSURE_PACKED, TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_ATOM31, RBT_VISION, 0},
+};
+
+static const oceanic_atom2_layout_t oceanic_atom2_layout_default = {
+	0,          0x48, 0x10, 0x40, 0x44, 0x00, 3, DATETIME_DEFAULT, MODE_NORMAL,
+		0x08, 0x17, TEMP_DELTA0,  PRESSURE_DELTA,  TANK_DEFAULT,  DEPTH_DEFAULT,  DECO_NONE,   RBT_NONE,   0
+};
+
+static const oceanic_atom2_layout_t *
+oceanic_atom2_parser_layout (unsigned int model)
+{
+	for (unsigned int i = 0; i < C_ARRAY_SIZE(oceanic_atom2_layouts); ++i) {
+		if (oceanic_atom2_layouts[i].model == model)
+			return oceanic_atom2_layouts + i;
+	}
+
+	return &oceanic_atom2_layout_default;
+}
 
 dc_status_t
 oceanic_atom2_parser_create (dc_parser_t **out, dc_context_t *context, unsigned int model, unsigned int serial)
@@ -149,34 +370,7 @@ oceanic_atom2_parser_create (dc_parser_t **out, dc_context_t *context, unsigned
 
 	// Set the default values.
 	parser->model = model;
-	parser->headersize = 9 * PAGESIZE / 2;
-	parser->footersize = 2 * PAGESIZE / 2;
-	if (model == DATAMASK || model == COMPUMASK ||
-		model == GEO || model == GEO20 ||
-		model == VEO20 || model == VEO30 ||
-		model == OCS || model == PROPLUS3 ||
-		model == A300 || model == MANTA ||
-		model == INSIGHT2 || model == ZEN ||
-		model == I300 || model == I550) {
-		parser->headersize -= PAGESIZE;
-	} else if (model == VT4 || model == VT41) {
-		parser->headersize += PAGESIZE;
-	} else if (model == TX1) {
-		parser->headersize += 2 * PAGESIZE;
-	} else if (model == ATOM1) {
-		parser->headersize -= 2 * PAGESIZE;
-	} else if (model == F10A || model == F10B ||
-		model == MUNDIAL2 || model == MUNDIAL3) {
-		parser->headersize = 3 * PAGESIZE;
-		parser->footersize = 0;
-	} else if (model == F11A || model == F11B) {
-		parser->headersize = 5 * PAGESIZE;
-		parser->footersize = 0;
-	} else if (model == A300CS || model == VTX ||
-		model == I450T || model == I750TC) {
-		parser->headersize = 5 * PAGESIZE;
-	}
-
+	parser->layout = oceanic_atom2_parser_layout (model);
 	parser->serial = serial;
 	parser->cached = 0;
 	parser->header = 0;
@@ -222,11 +416,10 @@ static dc_status_t
 oceanic_atom2_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime)
 {
 	oceanic_atom2_parser_t *parser = (oceanic_atom2_parser_t *) abstract;
+	const oceanic_atom2_layout_t *layout = parser->layout;
 
 	unsigned int header = 8;
-	if (parser->model == F10A || parser->model == F10B ||
-		parser->model == F11A || parser->model == F11B ||
-		parser->model == MUNDIAL2 || parser->model == MUNDIAL3)
+	if (layout->datetime == DATETIME_F10)
 		header = 32;
 
 	if (abstract->size < header)
@@ -238,60 +431,29 @@ oceanic_atom2_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetim
 		// AM/PM bit of the 12-hour clock.
 		unsigned int pm = p[1] & 0x80;
 
-		switch (parser->model) {
-		case OC1A:
-		case OC1B:
-		case OC1C:
-		case OCS:
-		case VT4:
-		case VT41:
-		case ATOM3:
-		case ATOM31:
-		case A300AI:
-		case OCI:
-		case I550:
-		case VISION:
-		case XPAIR:
+		switch (layout->datetime) {
+		case DATETIME_OC1:
 			datetime->year   = ((p[5] & 0xE0) >> 5) + ((p[7] & 0xE0) >> 2) + 2000;
 			datetime->month  = (p[3] & 0x0F);
 			datetime->day    = ((p[0] & 0x80) >> 3) + ((p[3] & 0xF0) >> 4);
 			datetime->hour   = bcd2dec (p[1] & 0x1F);
 			datetime->minute = bcd2dec (p[0] & 0x7F);
 			break;
-		case VT3:
-		case VEO20:
-		case VEO30:
-		case DG03:
-		case T3A:
-		case T3B:
-		case GEO20:
-		case PROPLUS3:
-		case DATAMASK:
-		case COMPUMASK:
-		case INSIGHT2:
-		case I300:
+		case DATETIME_VT3:
 			datetime->year   = ((p[3] & 0xE0) >> 1) + (p[4] & 0x0F) + 2000;
 			datetime->month  = (p[4] & 0xF0) >> 4;
 			datetime->day    = p[3] & 0x1F;
 			datetime->hour   = bcd2dec (p[1] & 0x1F);
 			datetime->minute = bcd2dec (p[0]);
 			break;
-		case ZENAIR:
-		case AMPHOS:
-		case AMPHOSAIR:
-		case VOYAGER2G:
+		case DATETIME_ZENAIR:
 			datetime->year   = (p[3] & 0x1F) + 2000;
 			datetime->month  = (p[7] & 0xF0) >> 4;
 			datetime->day    = ((p[3] & 0x80) >> 3) + ((p[5] & 0xF0) >> 4);
 			datetime->hour   = bcd2dec (p[1] & 0x1F);
 			datetime->minute = bcd2dec (p[0]);
 			break;
-		case F10A:
-		case F10B:
-		case F11A:
-		case F11B:
-		case MUNDIAL2:
-		case MUNDIAL3:
+		case DATETIME_F10:
 			datetime->year   = bcd2dec (p[6]) + 2000;
 			datetime->month  = bcd2dec (p[7]);
 			datetime->day    = bcd2dec (p[8]);
@@ -299,17 +461,14 @@ oceanic_atom2_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetim
 			datetime->minute = bcd2dec (p[12]);
 			pm = p[13] & 0x80;
 			break;
-		case TX1:
+		case DATETIME_TX1:
 			datetime->year   = bcd2dec (p[13]) + 2000;
 			datetime->month  = bcd2dec (p[14]);
 			datetime->day    = bcd2dec (p[15]);
 			datetime->hour   = p[11];
 			datetime->minute = p[10];
 			break;
-		case A300CS:
-		case VTX:
-		case I450T:
-		case I750TC:
+		case DATETIME_A300CS:
 			datetime->year   = (p[10]) + 2000;
 			datetime->month  = (p[8]);
 			datetime->day    = (p[9]);
@@ -378,59 +537,37 @@ oceanic_atom2_parser_cache (oceanic_atom2_parser_t *parser)
 		return DC_STATUS_SUCCESS;
 	}
 
+	const oceanic_atom2_layout_t *layout = parser->layout;
+
 	// Get the total amount of bytes before and after the profile data.
-	unsigned int headersize = parser->headersize;
-	unsigned int footersize = parser->footersize;
-	if (size < headersize + footersize)
+	if (size < layout->headersize + layout->footersize)
 		return DC_STATUS_DATAFORMAT;
 
 	// Get the offset to the header and footer sample.
-	unsigned int header = headersize - PAGESIZE / 2;
-	unsigned int footer = size - footersize;
-	if (parser->model == VT4 || parser->model == VT41 ||
-		parser->model == A300AI || parser->model == VISION ||
-		parser->model == XPAIR) {
-		header = 3 * PAGESIZE;
-	}
+	unsigned int header = layout->header;
+	unsigned int footer = size - layout->footersize;
 
 	// Get the dive mode.
 	unsigned int mode = NORMAL;
-	if (parser->model == F10A || parser->model == F10B ||
-		parser->model == F11A || parser->model == F11B ||
-		parser->model == MUNDIAL2 || parser->model == MUNDIAL3) {
+	switch (layout->mode) {
+	case MODE_FREEDIVE:
 		mode = FREEDIVE;
-	} else if (parser->model == T3B || parser->model == VT3 ||
-		parser->model == DG03) {
-		mode = (data[2] & 0xC0) >> 6;
-	} else if (parser->model == VEO20 || parser->model == VEO30 ||
-		parser->model == OCS) {
+		break;
+	case MODE_BYTE1:
 		mode = (data[1] & 0x60) >> 5;
+		break;
+	case MODE_BYTE2:
+		mode = (data[2] & 0xC0) >> 6;
+		break;
 	}
 
 	// Get the gas mixes.
-	unsigned int ngasmixes = 0;
-	unsigned int o2_offset = 0;
-	unsigned int he_offset = 0;
+	unsigned int ngasmixes = layout->ngasmixes;
+	unsigned int o2_offset = layout->oxygen;
+	unsigned int he_offset = layout->helium;
 	if (mode == FREEDIVE) {
 		ngasmixes = 0;
-	} else if (parser->model == DATAMASK || parser->model == COMPUMASK) {
-		ngasmixes = 1;
-		o2_offset = header + 3;
-	} else if (parser->model == VT4 || parser->model == VT41 ||
-		parser->model == A300AI || parser->model == VISION ||
-		parser->model == XPAIR) {
-		o2_offset = header + 4;
-		ngasmixes = 4;
-	} else if (parser->model == OCI) {
-		o2_offset = 0x28;
-		ngasmixes = 4;
-	} else if (parser->model == TX1) {
-		o2_offset = 0x3E;
-		he_offset = 0x48;
-		ngasmixes = 6;
-	} else if (parser->model == A300CS || parser->model == VTX ||
-		parser->model == I750TC) {
-		o2_offset = 0x2A;
+	} else if (layout->flags & GASMIXES) {
 		if (data[0x39] & 0x04) {
 			ngasmixes = 1;
 		} else if (data[0x39] & 0x08) {
@@ -440,15 +577,6 @@ oceanic_atom2_parser_cache (oceanic_atom2_parser_t *parser)
 		} else {
 			ngasmixes = 4;
 		}
-	} else if (parser->model == I450T) {
-		o2_offset = 0x30;
-		ngasmixes = 3;
-	} else if (parser->model == ZEN) {
-		o2_offset = header + 4;
-		ngasmixes = 2;
-	} else {
-		o2_offset = header + 4;
-		ngasmixes = 3;
 	}
 
 	// Cache the data for later use.
@@ -510,17 +638,13 @@ oceanic_atom2_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, uns
 	if (value) {
 		switch (type) {
 		case DC_FIELD_DIVETIME:
-			if (parser->model == F10A || parser->model == F10B ||
-				parser->model == F11A || parser->model == F11B ||
-				parser->model == MUNDIAL2 || parser->model == MUNDIAL3)
+			if (parser->layout->mode == MODE_FREEDIVE)
 				*((unsigned int *) value) = bcd2dec (data[2]) + bcd2dec (data[3]) * 60;
 			else
 				*((unsigned int *) value) = parser->divetime;
 			break;
 		case DC_FIELD_MAXDEPTH:
-			if (parser->model == F10A || parser->model == F10B ||
-				parser->model == F11A || parser->model == F11B ||
-				parser->model == MUNDIAL2 || parser->model == MUNDIAL3)
+			if (parser->layout->mode == MODE_FREEDIVE)
 				*((double *) value) = array_uint16_le (data + 4) / 16.0 * FEET;
 			else
 				*((double *) value) = (array_uint16_le (data + parser->footer + 4) & 0x0FFF) / 16.0 * FEET;
@@ -534,8 +658,7 @@ oceanic_atom2_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, uns
 			gasmix->nitrogen = 1.0 - gasmix->oxygen - gasmix->helium;
 			break;
 		case DC_FIELD_SALINITY:
-			if (parser->model == A300CS || parser->model == VTX ||
-				parser->model == I750TC) {
+			if (parser->layout->flags & SALINITY) {
 				if (data[0x18] & 0x80) {
 					water->type = DC_WATER_FRESH;
 				} else {
@@ -616,11 +739,38 @@ oceanic_atom2_parser_vendor (oceanic_atom2_parser_t *parser, const unsigned char
 	}
 }
 
+static unsigned int
+oceanic_atom2_temperature_delta (unsigned int type, unsigned int temperature, const unsigned char *sample)
+{
+	unsigned int negative = 0;
+	switch (type) {
+	case TEMP_DELTA0:
+		negative = !(sample[0] & 0x80);
+		break;
+	case TEMP_DELTA0N:
+		negative = sample[0] & 0x80;
+		break;
+	case TEMP_DELTA5:
+		negative = !(sample[5] & 0x04);
+		break;
+	case TEMP_DELTA5N:
+		negative = sample[5] & 0x04;
+		break;
+	}
+
+	unsigned int delta = (sample[7] & 0x0C) >> 2;
+	if (negative)
+		return temperature - delta;
+	else
+		return temperature + delta;
+}
+
 static dc_status_t
 oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	oceanic_atom2_parser_t *parser = (oceanic_atom2_parser_t *) abstract;
+	const oceanic_atom2_layout_t *layout = parser->layout;
 
 	const unsigned char *data = abstract->data;
 	unsigned int size = abstract->size;
@@ -635,11 +785,7 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 	unsigned int interval = 1;
 	unsigned int samplerate = 1;
 	if (parser->mode != FREEDIVE) {
-		unsigned int idx = 0x17;
-		if (parser->model == A300CS || parser->model == VTX ||
-			parser->model == I450T || parser->model == I750TC)
-			idx = 0x1f;
-		switch (data[idx] & 0x03) {
+		switch (data[layout->interval] & 0x03) {
 		case 0:
 			interval = 2;
 			break;
@@ -653,9 +799,8 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 			interval = 60;
 			break;
 		}
-	} else if (parser->model == F11A || parser->model == F11B) {
-		unsigned int idx = 0x29;
-		switch (data[idx] & 0x03) {
+	} else if (layout->flags & SAMPLERATE) {
+		switch (data[layout->interval] & 0x03) {
 		case 0:
 			interval = 1;
 			samplerate = 4;
@@ -679,34 +824,20 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 		}
 	}
 
-	unsigned int samplesize = PAGESIZE / 2;
-	if (parser->mode == FREEDIVE) {
-		if (parser->model == F10A || parser->model == F10B ||
-			parser->model == F11A || parser->model == F11B ||
-			parser->model == MUNDIAL2 || parser->model == MUNDIAL3) {
-			samplesize = 2;
-		} else {
-			samplesize = 4;
-		}
-	} else if (parser->model == OC1A || parser->model == OC1B ||
-		parser->model == OC1C || parser->model == OCI ||
-		parser->model == TX1 || parser->model == A300CS ||
-		parser->model == VTX || parser->model == I450T ||
-		parser->model == I750TC) {
-		samplesize = PAGESIZE;
-	}
-
-	unsigned int have_temperature = 1, have_pressure = 1;
-	if (parser->mode == FREEDIVE) {
-		have_temperature = 0;
-		have_pressure = 0;
-	} else if (parser->model == VEO30 || parser->model == OCS ||
-		parser->model == ELEMENT2 || parser->model == VEO20 ||
-		parser->model == A300 || parser->model == ZEN ||
-		parser->model == GEO || parser->model == GEO20 ||
-		parser->model == MANTA || parser->model == I300) {
-		have_pressure = 0;
+	// Get the sample format. The models with a freedive mode in the
+	// logbook header store only the depth in 4 byte samples.
+	unsigned int samplesize = layout->samplesize;
+	unsigned int temperature_type = layout->temperature;
+	unsigned int pressure_type = layout->pressure;
+	unsigned int depth_type = layout->depth;
+	if (parser->mode == FREEDIVE && layout->mode != MODE_FREEDIVE) {
+		samplesize = 4;
+		temperature_type = TEMP_NONE;
+		pressure_type = PRESSURE_NONE;
+		depth_type = DEPTH_FREEDIVE;
 	}
+	unsigned int have_temperature = temperature_type != TEMP_NONE;
+	unsigned int have_pressure = pressure_type != PRESSURE_NONE;
 
 	// Initial temperature.
 	unsigned int temperature = 0;
@@ -719,8 +850,7 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 	unsigned int pressure = 0;
 	if (have_pressure) {
 		unsigned int idx = 2;
-		if (parser->model == A300CS || parser->model == VTX ||
-			parser->model == I750TC)
+		if (pressure_type == PRESSURE_A300CS)
 			idx = 16;
 		pressure = array_uint16_le(data + parser->header + idx);
 		if (pressure == 10000)
@@ -733,8 +863,9 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 	unsigned int count = 0;
 	unsigned int complete = 1;
 	unsigned int previous = 0;
-	unsigned int offset = parser->headersize;
-	while (offset + samplesize <= size - parser->footersize) {
+	unsigned int offset = layout->headersize;
+	unsigned int end = size - layout->footersize;
+	while (offset + samplesize <= end) {
 		dc_sample_value_t sample = {0};
 
 		// Ignore empty samples.
@@ -760,7 +891,7 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 		unsigned int length = samplesize;
 		if (sampletype == 0xBB) {
 			length = PAGESIZE;
-			if (offset + length > size - parser->footersize) {
+			if (offset + length > end) {
 				ERROR (abstract->context, "Buffer overflow detected!");
 				return DC_STATUS_DATAFORMAT;
 			}
@@ -768,22 +899,27 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 
 		// Check for a tank switch sample.
 		if (sampletype == 0xAA) {
-			if (parser->model == DATAMASK || parser->model == COMPUMASK) {
+			switch (layout->tank) {
+			case TANK_DATAMASK:
 				// Tank pressure (1 psi) and number
 				tank = 0;
 				pressure = (((data[offset + 7] << 8) + data[offset + 6]) & 0x0FFF);
-			} else if (parser->model == A300CS || parser->model == VTX ||
-				parser->model == I750TC) {
+				break;
+			case TANK_A300CS:
 				// Tank pressure (1 psi) and number (one based index)
 				tank = (data[offset + 1] & 0x03) - 1;
 				pressure = ((data[offset + 7] << 8) + data[offset + 6]) & 0x0FFF;
-			} else {
+				break;
+			case TANK_ATOM2:
+				// Tank pressure (2 psi) and number (one based index)
+				tank = (data[offset + 1] & 0x03) - 1;
+				pressure = (((data[offset + 3] << 8) + data[offset + 4]) & 0x0FFF) * 2;
+				break;
+			default:
 				// Tank pressure (2 psi) and number (one based index)
 				tank = (data[offset + 1] & 0x03) - 1;
-				if (parser->model == ATOM2 || parser->model == EPICA || parser->model == EPICB)
-					pressure = (((data[offset + 3] << 8) + data[offset + 4]) & 0x0FFF) * 2;
-				else
-					pressure = (((data[offset + 4] << 8) + data[offset + 5]) & 0x0FFF) * 2;
+				pressure = (((data[offset + 4] << 8) + data[offset + 5]) & 0x0FFF) * 2;
+				break;
 			}
 		} else if (sampletype == 0xBB) {
 			// The surface time is not always a nice multiple of the samplerate.
@@ -822,7 +958,7 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 			}
 
 			// Time.
-			if (parser->model == I450T) {
+			if (layout->flags & TIMESTAMP) {
 				unsigned int minute = bcd2dec(data[offset + 0]);
 				unsigned int hour   = bcd2dec(data[offset + 1] & 0x0F);
 				unsigned int second = bcd2dec(data[offset + 2]);
@@ -850,45 +986,25 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 
 			// Temperature (°F)
 			if (have_temperature) {
-				if (parser->model == GEO || parser->model == ATOM1 ||
-					parser->model == ELEMENT2 || parser->model == MANTA ||
-					parser->model == ZEN) {
-					temperature = data[offset + 6];
-				} else if (parser->model == GEO20 || parser->model == VEO20 ||
-					parser->model == VEO30 || parser->model == OC1A ||
-					parser->model == OC1B || parser->model == OC1C ||
-					parser->model == OCI || parser->model == A300 ||
-					parser->model == I450T || parser->model == I300) {
-					temperature = data[offset + 3];
-				} else if (parser->model == OCS || parser->model == TX1) {
+				switch (temperature_type) {
+				case TEMP_BYTE1:
 					temperature = data[offset + 1];
-				} else if (parser->model == VT4 || parser->model == VT41 ||
-					parser->model == ATOM3 || parser->model == ATOM31 ||
-					parser->model == A300AI || parser->model == VISION ||
-					parser->model == XPAIR) {
-					temperature = ((data[offset + 7] & 0xF0) >> 4) | ((data[offset + 7] & 0x0C) << 2) | ((data[offset + 5] & 0x0C) << 4);
-				} else if (parser->model == A300CS || parser->model == VTX ||
-					parser->model == I750TC) {
+					break;
+				case TEMP_BYTE3:
+					temperature = data[offset + 3];
+					break;
+				case TEMP_BYTE6:
+					temperature = data[offset + 6];
+					break;
+				case TEMP_BYTE11:
 					temperature = data[offset + 11];
-				} else {
-					unsigned int sign;
-					if (parser->model == DG03 || parser->model == PROPLUS3 ||
-						parser->model == I550)
-						sign = (~data[offset + 5] & 0x04) >> 2;
-					else if (parser->model == VOYAGER2G || parser->model == AMPHOS ||
-						parser->model == AMPHOSAIR || parser->model == ZENAIR)
-						sign = (data[offset + 5] & 0x04) >> 2;
-					else if (parser->model == ATOM2 || parser->model == PROPLUS21 ||
-						parser->model == EPICA || parser->model == EPICB ||
-						parser->model == ATMOSAI2 ||
-						parser->model == WISDOM2 || parser->model == WISDOM3)
-						sign = (data[offset + 0] & 0x80) >> 7;
-					else
-						sign = (~data[offset + 0] & 0x80) >> 7;
-					if (sign)
-						temperature -= (data[offset + 7] & 0x0C) >> 2;
-					else
-						temperature += (data[offset + 7] & 0x0C) >> 2;
+					break;
+				case TEMP_PACKED:
+					temperature = ((data[offset + 7] & 0xF0) >> 4) | ((data[offset + 7] & 0x0C) << 2) | ((data[offset + 5] & 0x0C) << 4);
+					break;
+				default:
+					temperature = oceanic_atom2_temperature_delta (temperature_type, temperature, data + offset);
+					break;
 				}
 				sample.temperature = (temperature - 32.0) * (5.0 / 9.0);
 				if (callback) callback (DC_SAMPLE_TEMPERATURE, sample, userdata);
@@ -896,22 +1012,21 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 
 			// Tank Pressure (psi)
 			if (have_pressure) {
-				if (parser->model == OC1A || parser->model == OC1B ||
-					parser->model == OC1C || parser->model == OCI ||
-					parser->model == I450T)
+				switch (pressure_type) {
+				case PRESSURE_OC1:
 					pressure = (data[offset + 10] + (data[offset + 11] << 8)) & 0x0FFF;
-				else if (parser->model == VT4 || parser->model == VT41||
-					parser->model == ATOM3 || parser->model == ATOM31 ||
-					parser->model == ZENAIR ||parser->model == A300AI ||
-					parser->model == DG03 || parser->model == PROPLUS3 ||
-					parser->model == AMPHOSAIR || parser->model == I550 ||
-					parser->model == VISION || parser->model == XPAIR)
+					break;
+				case PRESSURE_PACKED:
 					pressure = (((data[offset + 0] & 0x03) << 8) + data[offset + 1]) * 5;
-				else if (parser->model == TX1 || parser->model == A300CS ||
-					parser->model == VTX || parser->model == I750TC)
+					break;
+				case PRESSURE_TX1:
+				case PRESSURE_A300CS:
 					pressure = array_uint16_le (data + offset + 4);
-				else
+					break;
+				default:
 					pressure -= data[offset + 1];
+					break;
+				}
 				sample.pressure.tank = tank;
 				sample.pressure.value = pressure * PSI / BAR;
 				if (callback) callback (DC_SAMPLE_PRESSURE, sample, userdata);
@@ -919,61 +1034,58 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 
 			// Depth (1/16 ft)
 			unsigned int depth;
-			if (parser->mode == FREEDIVE)
+			switch (depth_type) {
+			case DEPTH_FREEDIVE:
 				depth = array_uint16_le (data + offset);
-			else if (parser->model == GEO20 || parser->model == VEO20 ||
-				parser->model == VEO30 || parser->model == OC1A ||
-				parser->model == OC1B || parser->model == OC1C ||
-				parser->model == OCI || parser->model == A300 ||
-				parser->model == I450T || parser->model == I300)
+				break;
+			case DEPTH_OC1:
 				depth = (data[offset + 4] + (data[offset + 5] << 8)) & 0x0FFF;
-			else if (parser->model == ATOM1)
+				break;
+			case DEPTH_ATOM1:
 				depth = data[offset + 3] * 16;
-			else
+				break;
+			default:
 				depth = (data[offset + 2] + (data[offset + 3] << 8)) & 0x0FFF;
+				break;
+			}
 			sample.depth = depth / 16.0 * FEET;
 			if (callback) callback (DC_SAMPLE_DEPTH, sample, userdata);
 
 			// Gas mix
-			unsigned int have_gasmix = 0;
-			unsigned int gasmix = 0;
-			if (parser->model == TX1) {
-				gasmix = data[offset] & 0x07;
-				have_gasmix = 1;
-			}
-			if (have_gasmix && gasmix != gasmix_previous) {
-				if (gasmix < 1 || gasmix > parser->ngasmixes) {
-					ERROR (abstract->context, "Invalid gas mix index (%u).", gasmix);
-					return DC_STATUS_DATAFORMAT;
+			if (layout->flags & GASSWITCH) {
+				unsigned int gasmix = data[offset] & 0x07;
+				if (gasmix != gasmix_previous) {
+					if (gasmix < 1 || gasmix > parser->ngasmixes) {
+						ERROR (abstract->context, "Invalid gas mix index (%u).", gasmix);
+						return DC_STATUS_DATAFORMAT;
+					}
+					sample.gasmix = gasmix - 1;
+					if (callback) callback (DC_SAMPLE_GASMIX, sample, userdata);
+					gasmix_previous = gasmix;
 				}
-				sample.gasmix = gasmix - 1;
-				if (callback) callback (DC_SAMPLE_GASMIX, sample, userdata);
-				gasmix_previous = gasmix;
 			}
 
 			// NDL / Deco
-			unsigned int have_deco = 0;
-			unsigned int decostop = 0, decotime = 0;
-			if (parser->model == A300CS || parser->model == VTX ||
-				parser->model == I450T || parser->model == I750TC) {
-				decostop = (data[offset + 15] & 0x70) >> 4;
-				decotime = array_uint16_le(data + offset + 6) & 0x03FF;
-				have_deco = 1;
-			} else if (parser->model == ZEN || parser->model == DG03) {
-				decostop = (data[offset + 5] & 0xF0) >> 4;
-				decotime = array_uint16_le(data + offset + 4) & 0x0FFF;
-				have_deco = 1;
-			} else if (parser->model == TX1) {
-				decostop = data[offset + 10];
-				decotime = array_uint16_le(data + offset + 6);
-				have_deco = 1;
-			} else if (parser->model == ATOM31 || parser->model == VISION ||
-				parser->model == XPAIR || parser->model == I550) {
-				decostop = (data[offset + 5] & 0xF0) >> 4;
-				decotime = array_uint16_le(data + offset + 4) & 0x03FF;
-				have_deco = 1;
-			}
-			if (have_deco) {
+			if (layout->deco != DECO_NONE) {
+				unsigned int decostop = 0, decotime = 0;
+				switch (layout->deco) {
+				case DECO_A300CS:
+					decostop = (data[offset + 15] & 0x70) >> 4;
+					decotime = array_uint16_le(data + offset + 6) & 0x03FF;
+					break;
+				case DECO_ZEN:
+					decostop = (data[offset + 5] & 0xF0) >> 4;
+					decotime = array_uint16_le(data + offset + 4) & 0x0FFF;
+					break;
+				case DECO_TX1:
+					decostop = data[offset + 10];
+					decotime = array_uint16_le(data + offset + 6);
+					break;
+				case DECO_ATOM31:
+					decostop = (data[offset + 5] & 0xF0) >> 4;
+					decotime = array_uint16_le(data + offset + 4) & 0x03FF;
+					break;
+				}
 				if (decostop) {
 					sample.deco.type = DC_DECO_DECOSTOP;
 					sample.deco.depth = decostop * 10 * FEET;
@@ -985,20 +1097,20 @@ oceanic_atom2_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_
 				if (callback) callback (DC_SAMPLE_DECO, sample, userdata);
 			}
 
-			unsigned int have_rbt = 0;
-			unsigned int rbt = 0;
-			if (parser->model == ATOM31) {
-				rbt = array_uint16_le(data + offset + 6) & 0x01FF;
-				have_rbt = 1;
-			} else if (parser->model == I450T) {
-				rbt = array_uint16_le(data + offset + 8) & 0x01FF;
-				have_rbt = 1;
-			} else if (parser->model == VISION || parser->model == XPAIR ||
-				parser->model == I550) {
-				rbt = array_uint16_le(data + offset + 6) & 0x03FF;
-				have_rbt = 1;
-			}
-			if (have_rbt) {
+			// Remaining bottom time
+			if (layout->rbt != RBT_NONE) {
+				unsigned int rbt = 0;
+				switch (layout->rbt) {
+				case RBT_ATOM31:
+					rbt = array_uint16_le(data + offset + 6) & 0x01FF;
+					break;
+				case RBT_I450T:
+					rbt = array_uint16_le(data + offset + 8) & 0x01FF;
+					break;
+				case RBT_VISION:
+					rbt = array_uint16_le(data + offset + 6) & 0x03FF;
+					break;
+				}
 				sample.rbt = rbt;
 				if (callback) callback (DC_SAMPLE_RBT, sample, userdata);
 			}
@@ -32,12 +32,18 @@
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &oceanic_veo250_device_vtable.base)
 
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
 #define MAXRETRIES 2
 #define MULTIPAGE  4
 
 #define ACK 0x5A
 #define NAK 0xA5
 
+#define T_RETRY   0
+#define T_SETTLE  1
+#define T_VERSION 2
+
 typedef struct oceanic_veo250_device_t {
 	oceanic_common_device_t base;
 	dc_serial_t *port;
@@ -125,6 +131,12 @@ oceanic_veo250_send (oceanic_veo250_device_t *device, const unsigned char comman
 }
 
 
+static const dc_timing_t oceanic_veo250_timing[] = {
+	{"veo250.retry",   100,  0, 1000, 50, 0}, // Delay before resending a rejected command.
+	{"veo250.settle",  100, 20, 1000,  0, 0}, // Time for the interface to settle and draw power up.
+	{"veo250.version", 100, 20, 1000,  0, 0}, // Delay before sending the version command.
+};
+
 static dc_status_t
 oceanic_veo250_transfer (oceanic_veo250_device_t *device, const unsigned char command[], unsigned int csize, unsigned char answer[], unsigned int asize)
 {
@@ -137,34 +149,40 @@ oceanic_veo250_transfer (oceanic_veo250_device_t *device, const unsigned char co
 	// a NAK byte, we try to resend the command a number of times before
 	// returning an error.
 
+	unsigned long long start = device_stats_begin (abstract);
+
 	unsigned int nretries = 0;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	while ((rc = oceanic_veo250_send (device, command, csize)) != DC_STATUS_SUCCESS) {
 		if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL)
-			return rc;
+			break;
 
 		// Abort if the maximum number of retries is reached.
 		if (nretries++ >= MAXRETRIES)
-			return rc;
+			break;
+
+		device_stats_retry (abstract);
 
 		// Delay the next attempt.
-		dc_serial_sleep (device->port, 100);
+		dc_serial_sleep (device->port, device_timing_backoff (abstract, T_RETRY));
 	}
 
-	// Receive the answer of the dive computer.
-	status = dc_serial_read (device->port, answer, asize, NULL);
-	if (status != DC_STATUS_SUCCESS) {
-		ERROR (abstract->context, "Failed to receive the answer.");
-		return status;
+	if (rc == DC_STATUS_SUCCESS) {
+		// Receive the answer of the dive computer.
+		status = dc_serial_read (device->port, answer, asize, NULL);
+		if (status != DC_STATUS_SUCCESS) {
+			ERROR (abstract->context, "Failed to receive the answer.");
+			rc = status;
+		} else if (answer[asize - 1] != NAK) {
+			// Verify the last byte of the answer.
+			ERROR (abstract->context, "Unexpected answer byte.");
+			rc = DC_STATUS_PROTOCOL;
+		}
 	}
 
-	// Verify the last byte of the answer.
-	if (answer[asize - 1] != NAK) {
-		ERROR (abstract->context, "Unexpected answer byte.");
-		return DC_STATUS_PROTOCOL;
-	}
+	device_stats_end (abstract, start, rc);
 
-	return DC_STATUS_SUCCESS;
+	return rc;
 }
 
 
@@ -249,6 +267,7 @@ oceanic_veo250_device_open (dc_device_t **out, dc_context_t *context, const char
 	// Set the default values.
 	device->port = NULL;
 	device->last = 0;
+	device_timing_init ((dc_device_t *) device, oceanic_veo250_timing, C_ARRAY_SIZE (oceanic_veo250_timing));
 
 	// Open the device.
 	status = dc_serial_open (&device->port, context, name);
@@ -257,6 +276,8 @@ oceanic_veo250_device_open (dc_device_t **out, dc_context_t *context, const char
 		goto error_free;
 	}
 
+	dc_serial_set_stats (device->port, &device->base.base.stats);
+
 	// Set the serial communication protocol (9600 8N1).
 	status = dc_serial_configure (device->port, 9600, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -285,8 +306,8 @@ oceanic_veo250_device_open (dc_device_t **out, dc_context_t *context, const char
 		goto error_close;
 	}
 
-	// Give the interface 100 ms to settle and draw power up.
-	dc_serial_sleep (device->port, 100);
+	// Give the interface some time to settle and draw power up.
+	dc_serial_sleep (device->port, device_timing ((dc_device_t *) device, T_SETTLE));
 
 	// Make sure everything is in a sane state.
 	dc_serial_purge (device->port, DC_DIRECTION_ALL);
@@ -298,7 +319,7 @@ oceanic_veo250_device_open (dc_device_t **out, dc_context_t *context, const char
 	}
 
 	// Delay the sending of the version command.
-	dc_serial_sleep (device->port, 100);
+	dc_serial_sleep (device->port, device_timing ((dc_device_t *) device, T_VERSION));
 
 	// Switch the device from surface mode into download mode. Before sending
 	// this command, the device needs to be in PC mode (manually activated by
@@ -33,12 +33,14 @@ struct dc_parser_t;
 struct dc_parser_vtable_t;
 
 typedef struct dc_parser_vtable_t dc_parser_vtable_t;
+typedef struct sample_index_t sample_index_t;
 
 struct dc_parser_t {
 	const dc_parser_vtable_t *vtable;
 	dc_context_t *context;
 	const unsigned char *data;
 	unsigned int size;
+	sample_index_t *index;
 };
 
 struct dc_parser_vtable_t {
@@ -54,6 +56,8 @@ struct dc_parser_vtable_t {
 
 	dc_status_t (*samples_foreach) (dc_parser_t *parser, dc_sample_callback_t callback, void *userdata);
 
+	dc_status_t (*samples_range) (dc_parser_t *parser, unsigned int begin, unsigned int end, dc_sample_callback_t callback, void *userdata);
+
 	dc_status_t (*destroy) (dc_parser_t *parser);
 };
 
@@ -76,6 +80,25 @@ typedef struct sample_statistics_t {
 void
 sample_statistics_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata);
 
+/*
+ * The sample index stores a checkpoint every SAMPLE_INDEX_INTERVAL
+ * samples: the time of the last sample before the checkpoint and a
+ * copy of the parser specific decoder state (offset, running values,
+ * etc). A parser supports time range queries by decoding its samples
+ * with a walk function, which starts from the given state, stops once
+ * the samples are past the end time, and passes its state to
+ * sample_index_append while the index is being built.
+ */
+#define SAMPLE_INDEX_INTERVAL 64
+
+typedef dc_status_t (*sample_walk_t) (dc_parser_t *parser, void *state, unsigned int end, sample_index_t *index, dc_sample_callback_t callback, void *userdata);
+
+void
+sample_index_append (sample_index_t *index, unsigned int time, const void *state);
+
+dc_status_t
+sample_index_walk (dc_parser_t *parser, unsigned int begin, unsigned int end, void *state, size_t size, sample_walk_t walk, dc_sample_callback_t callback, void *userdata);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
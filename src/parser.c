@@ -20,8 +20,12 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <assert.h>
 
+#include <libdivecomputer/buffer.h>
+
 #include "suunto_d9.h"
 #include "suunto_eon.h"
 #include "suunto_eonsteel.h"
@@ -62,6 +66,29 @@
 
 #define REACTPROWHITE 0x4354
 
+struct sample_index_t {
+	size_t size;
+	unsigned int complete;
+	unsigned int failed;
+	dc_buffer_t *times;
+	dc_buffer_t *states;
+};
+
+typedef struct sample_range_t {
+	unsigned int begin;
+	unsigned int end;
+	unsigned int active;
+	dc_sample_callback_t callback;
+	void *userdata;
+} sample_range_t;
+
+typedef struct sample_decimate_t {
+	dc_sample_bucket_t *buckets;
+	unsigned int nbuckets;
+	unsigned int divetime;
+	dc_sample_bucket_t *current;
+} sample_decimate_t;
+
 static dc_status_t
 dc_parser_new_internal (dc_parser_t **out, dc_context_t *context, dc_family_t family, unsigned int model, unsigned int serial, unsigned int devtime, dc_ticks_t systime)
 {
@@ -216,6 +243,7 @@ dc_parser_allocate (dc_context_t *context, const dc_parser_vtable_t *vtable)
 	parser->context = context;
 	parser->data = NULL;
 	parser->size = 0;
+	parser->index = NULL;
 
 	return parser;
 }
@@ -223,6 +251,15 @@ dc_parser_allocate (dc_context_t *context, const dc_parser_vtable_t *vtable)
 void
 dc_parser_deallocate (dc_parser_t *parser)
 {
+	if (parser == NULL)
+		return;
+
+	if (parser->index) {
+		dc_buffer_free (parser->index->times);
+		dc_buffer_free (parser->index->states);
+		free (parser->index);
+	}
+
 	free (parser);
 }
 
@@ -258,6 +295,10 @@ dc_parser_set_data (dc_parser_t *parser, const unsigned char *data, unsigned int
 	parser->data = data;
 	parser->size = size;
 
+	// Invalidate the sample index.
+	if (parser->index)
+		parser->index->complete = 0;
+
 	return parser->vtable->set_data (parser, data, size);
 }
 
@@ -300,6 +341,138 @@ dc_parser_samples_foreach (dc_parser_t *parser, dc_sample_callback_t callback, v
 }
 
 
+static void
+sample_range_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	sample_range_t *range = (sample_range_t *) userdata;
+
+	if (type == DC_SAMPLE_TIME)
+		range->active = value.time >= range->begin && value.time <= range->end;
+
+	if (range->active && range->callback)
+		range->callback (type, value, range->userdata);
+}
+
+dc_status_t
+dc_parser_samples_range (dc_parser_t *parser, unsigned int begin, unsigned int end, dc_sample_callback_t callback, void *userdata)
+{
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (begin > end)
+		return DC_STATUS_INVALIDARGS;
+
+	// Samples reported before the first time sample belong to the
+	// start of the dive.
+	sample_range_t range = {begin, end, begin == 0, callback, userdata};
+
+	if (parser->vtable->samples_range)
+		return parser->vtable->samples_range (parser, begin, end, sample_range_cb, &range);
+
+	// Without an index, all samples are decoded and filtered.
+	if (parser->vtable->samples_foreach == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	return parser->vtable->samples_foreach (parser, sample_range_cb, &range);
+}
+
+
+static void
+sample_summary_add (dc_sample_summary_t *summary, double value)
+{
+	if (summary->count == 0 || value < summary->minimum)
+		summary->minimum = value;
+	if (summary->count == 0 || value > summary->maximum)
+		summary->maximum = value;
+
+	// The sum, until all samples are processed.
+	summary->mean += value;
+	summary->count++;
+}
+
+static void
+sample_decimate_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	sample_decimate_t *decimate = (sample_decimate_t *) userdata;
+	unsigned int idx = 0;
+
+	switch (type) {
+	case DC_SAMPLE_TIME:
+		if (decimate->divetime)
+			idx = (unsigned long long) value.time * decimate->nbuckets / decimate->divetime;
+		if (idx >= decimate->nbuckets)
+			idx = decimate->nbuckets - 1;
+		decimate->current = decimate->buckets + idx;
+		// Samples past the dive time end up in the last bucket.
+		if (value.time >= decimate->current->end)
+			decimate->current->end = value.time + 1;
+		break;
+	case DC_SAMPLE_DEPTH:
+		sample_summary_add (&decimate->current->depth, value.depth);
+		break;
+	case DC_SAMPLE_TEMPERATURE:
+		sample_summary_add (&decimate->current->temperature, value.temperature);
+		break;
+	default:
+		break;
+	}
+}
+
+dc_status_t
+dc_parser_samples_decimated (dc_parser_t *parser, dc_sample_bucket_t buckets[], unsigned int nbuckets)
+{
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	if (parser == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	if (buckets == NULL || nbuckets == 0)
+		return DC_STATUS_INVALIDARGS;
+
+	if (parser->vtable->samples_foreach == NULL)
+		return DC_STATUS_UNSUPPORTED;
+
+	// The bucket size is based on the dive time. Without a dive time,
+	// an extra pass over the samples is needed to find the last one.
+	unsigned int divetime = 0;
+	rc = dc_parser_get_field (parser, DC_FIELD_DIVETIME, 0, &divetime);
+	if (rc != DC_STATUS_SUCCESS && rc != DC_STATUS_UNSUPPORTED)
+		return rc;
+
+	if (divetime == 0) {
+		sample_statistics_t statistics = SAMPLE_STATISTICS_INITIALIZER;
+		rc = parser->vtable->samples_foreach (parser, sample_statistics_cb, &statistics);
+		if (rc != DC_STATUS_SUCCESS)
+			return rc;
+		divetime = statistics.divetime;
+	}
+
+	// A sample at time t goes into bucket t * nbuckets / divetime, so
+	// each bucket starts at the first time that maps onto it.
+	for (unsigned int i = 0; i < nbuckets; ++i) {
+		memset (buckets + i, 0, sizeof (buckets[i]));
+		buckets[i].begin = ((unsigned long long) i * divetime + nbuckets - 1) / nbuckets;
+		if (i)
+			buckets[i - 1].end = buckets[i].begin;
+	}
+	buckets[nbuckets - 1].end = divetime;
+
+	sample_decimate_t decimate = {buckets, nbuckets, divetime, buckets};
+	rc = parser->vtable->samples_foreach (parser, sample_decimate_cb, &decimate);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	for (unsigned int i = 0; i < nbuckets; ++i) {
+		if (buckets[i].depth.count)
+			buckets[i].depth.mean /= buckets[i].depth.count;
+		if (buckets[i].temperature.count)
+			buckets[i].temperature.mean /= buckets[i].temperature.count;
+	}
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 dc_status_t
 dc_parser_destroy (dc_parser_t *parser)
 {
@@ -335,3 +508,106 @@ sample_statistics_cb (dc_sample_type_t type, dc_sample_value_t value, void *user
 		break;
 	}
 }
+
+
+void
+sample_index_append (sample_index_t *index, unsigned int time, const void *state)
+{
+	if (index == NULL || index->failed)
+		return;
+
+	// The lookup requires increasing timestamps.
+	size_t count = dc_buffer_get_size (index->times) / sizeof (time);
+	if (count) {
+		unsigned int previous = 0;
+		memcpy (&previous, dc_buffer_get_data (index->times) + (count - 1) * sizeof (time), sizeof (time));
+		if (time < previous) {
+			index->failed = 1;
+			return;
+		}
+	}
+
+	if (!dc_buffer_append (index->times, (const unsigned char *) &time, sizeof (time)) ||
+		!dc_buffer_append (index->states, (const unsigned char *) state, index->size)) {
+		index->failed = 1;
+	}
+}
+
+static const unsigned char *
+sample_index_lookup (sample_index_t *index, unsigned int time)
+{
+	const unsigned char *times = dc_buffer_get_data (index->times);
+	size_t count = dc_buffer_get_size (index->times) / sizeof (time);
+
+	// Find the last checkpoint before the given time. All samples
+	// before that checkpoint have an earlier timestamp.
+	size_t lo = 0, hi = count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		unsigned int value = 0;
+		memcpy (&value, times + mid * sizeof (value), sizeof (value));
+		if (value < time)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == 0)
+		return NULL;
+
+	return dc_buffer_get_data (index->states) + (lo - 1) * index->size;
+}
+
+dc_status_t
+sample_index_walk (dc_parser_t *parser, unsigned int begin, unsigned int end, void *state, size_t size, sample_walk_t walk, dc_sample_callback_t callback, void *userdata)
+{
+	sample_index_t *index = parser->index;
+
+	if (index == NULL) {
+		index = (sample_index_t *) malloc (sizeof (sample_index_t));
+		if (index == NULL) {
+			ERROR (parser->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+
+		index->size = size;
+		index->complete = 0;
+		index->failed = 0;
+		index->times = dc_buffer_new (0);
+		index->states = dc_buffer_new (0);
+		parser->index = index;
+
+		if (index->times == NULL || index->states == NULL) {
+			ERROR (parser->context, "Failed to allocate memory.");
+			return DC_STATUS_NOMEMORY;
+		}
+	}
+
+	if (index->complete) {
+		// Resume from the nearest checkpoint.
+		const unsigned char *checkpoint = sample_index_lookup (index, begin);
+		if (checkpoint)
+			memcpy (state, checkpoint, size);
+
+		return walk (parser, state, end, NULL, callback, userdata);
+	}
+
+	// Build the index while decoding all samples.
+	dc_buffer_clear (index->times);
+	dc_buffer_clear (index->states);
+	index->size = size;
+	index->failed = 0;
+
+	dc_status_t status = walk (parser, state, UINT_MAX, index, callback, userdata);
+	if (status != DC_STATUS_SUCCESS)
+		return status;
+
+	// Without checkpoints, the samples are decoded from the start.
+	if (index->failed) {
+		dc_buffer_clear (index->times);
+		dc_buffer_clear (index->states);
+	}
+	index->complete = 1;
+
+	return DC_STATUS_SUCCESS;
+}
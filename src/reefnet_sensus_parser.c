@@ -25,6 +25,7 @@
 
 #include "reefnet_sensus.h"
 #include "context-private.h"
+#include "datetime-private.h"
 #include "parser-private.h"
 #include "array.h"
 
@@ -60,6 +61,7 @@ static const dc_parser_vtable_t reefnet_sensus_parser_vtable = {
 	reefnet_sensus_parser_get_datetime, /* datetime */
 	reefnet_sensus_parser_get_field, /* fields */
 	reefnet_sensus_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_range */
 	NULL /* destroy */
 };
 
@@ -135,7 +137,7 @@ reefnet_sensus_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *dateti
 
 	dc_ticks_t ticks = parser->systime - (parser->devtime - timestamp);
 
-	if (!dc_datetime_localtime (datetime, ticks))
+	if (!dc_datetime_localtime_cached (abstract->context, datetime, ticks))
 		return DC_STATUS_DATAFORMAT;
 
 	return DC_STATUS_SUCCESS;
@@ -26,6 +26,7 @@
 
 #include "reefnet_sensuspro.h"
 #include "context-private.h"
+#include "datetime-private.h"
 #include "parser-private.h"
 #include "array.h"
 
@@ -59,6 +60,7 @@ static const dc_parser_vtable_t reefnet_sensuspro_parser_vtable = {
 	reefnet_sensuspro_parser_get_datetime, /* datetime */
 	reefnet_sensuspro_parser_get_field, /* fields */
 	reefnet_sensuspro_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_range */
 	NULL /* destroy */
 };
 
@@ -134,7 +136,7 @@ reefnet_sensuspro_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *dat
 
 	dc_ticks_t ticks = parser->systime - (parser->devtime - timestamp);
 
-	if (!dc_datetime_localtime (datetime, ticks))
+	if (!dc_datetime_localtime_cached (abstract->context, datetime, ticks))
 		return DC_STATUS_DATAFORMAT;
 
 	return DC_STATUS_SUCCESS;
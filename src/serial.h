@@ -24,6 +24,7 @@
 
 #include <libdivecomputer/common.h>
 #include <libdivecomputer/context.h>
+#include <libdivecomputer/device.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -172,6 +173,17 @@ dc_serial_configure (dc_serial_t *serial, unsigned int baudrate, unsigned int da
 dc_status_t
 dc_serial_set_timeout (dc_serial_t *serial, int timeout);
 
+/**
+ * Set the statistics buffer for the transfers of the connection.
+ *
+ * @param[in]  serial  A valid serial connection.
+ * @param[in]  stats   The statistics buffer, or NULL to disable them.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_serial_set_stats (dc_serial_t *serial, dc_stats_t *stats);
+
 /**
  * Set the state of the half duplex emulation.
  *
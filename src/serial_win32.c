@@ -31,6 +31,8 @@
 struct dc_serial_t {
 	/* Library context. */
 	dc_context_t *context;
+	/* Transfer statistics of the device. */
+	dc_stats_t *stats;
 	/*
 	 * The file descriptor corresponding to the serial port.
 	 */
@@ -151,6 +153,7 @@ dc_serial_open (dc_serial_t **out, dc_context_t *context, const char *name)
 
 	// Library context.
 	device->context = context;
+	device->stats = NULL;
 
 	// Default to full-duplex.
 	device->halfduplex = 0;
@@ -394,6 +397,17 @@ dc_serial_set_timeout (dc_serial_t *device, int timeout)
 	return DC_STATUS_SUCCESS;
 }
 
+dc_status_t
+dc_serial_set_stats (dc_serial_t *device, dc_stats_t *stats)
+{
+	if (device == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	device->stats = stats;
+
+	return DC_STATUS_SUCCESS;
+}
+
 dc_status_t
 dc_serial_set_halfduplex (dc_serial_t *device, unsigned int value)
 {
@@ -428,9 +442,12 @@ dc_serial_read (dc_serial_t *device, void *data, size_t size, size_t *actual)
 		goto out_invalidargs;
 	}
 
+	unsigned long long start = dc_stats_clock (device->stats);
+
 	RETURN_IF_CUSTOM_SERIAL(device->context,
 			{
-				HEXDUMP (device->context, DC_LOGLEVEL_INFO, "Custom Read", (unsigned char *) data, nbytes);
+				dc_stats_transfer (device->stats, DC_STATS_READ, start, nbytes, _rc);
+				TRACE (device->context, DC_TRACE_READ, "Custom Read", (unsigned char *) data, nbytes);
 				if (actual)
 					*actual = nbytes;
 			},
@@ -448,7 +465,8 @@ dc_serial_read (dc_serial_t *device, void *data, size_t size, size_t *actual)
 	}
 
 out:
-	HEXDUMP (device->context, DC_LOGLEVEL_INFO, "Read", (unsigned char *) data, dwRead);
+	dc_stats_transfer (device->stats, DC_STATS_READ, start, dwRead, status);
+	TRACE (device->context, DC_TRACE_READ, "Read", (unsigned char *) data, dwRead);
 
 out_invalidargs:
 	if (actual)
@@ -469,9 +487,12 @@ dc_serial_write (dc_serial_t *device, const void *data, size_t size, size_t *act
 		goto out_invalidargs;
 	}
 
+	unsigned long long start = dc_stats_clock (device->stats);
+
 	RETURN_IF_CUSTOM_SERIAL(device->context,
 			{
-				HEXDUMP (device->context, DC_LOGLEVEL_INFO, "Custom Write", (unsigned char *) data, nbytes);
+				dc_stats_transfer (device->stats, DC_STATS_WRITE, start, nbytes, _rc);
+				TRACE (device->context, DC_TRACE_WRITE, "Custom Write", (unsigned char *) data, nbytes);
 				if (actual)
 					*actual = nbytes;
 			},
@@ -528,7 +549,8 @@ dc_serial_write (dc_serial_t *device, const void *data, size_t size, size_t *act
 	}
 
 out:
-	HEXDUMP (device->context, DC_LOGLEVEL_INFO, "Write", (unsigned char *) data, dwWritten);
+	dc_stats_transfer (device->stats, DC_STATS_WRITE, start, dwWritten, status);
+	TRACE (device->context, DC_TRACE_WRITE, "Write", (unsigned char *) data, dwWritten);
 
 out_invalidargs:
 	if (actual)
@@ -718,6 +740,8 @@ dc_serial_sleep (dc_serial_t *device, unsigned int timeout)
 
 	INFO (device->context, "Sleep: value=%u", timeout);
 
+	dc_stats_sleep (device->stats, timeout);
+
 	Sleep (timeout);
 
 	return DC_STATUS_SUCCESS;
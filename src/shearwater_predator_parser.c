@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <limits.h>
 
 #ifdef _MSC_VER
 #define snprintf _snprintf
@@ -79,10 +80,21 @@ struct shearwater_predator_parser_t {
 	dc_field_string_t strings[MAXSTRINGS];
 };
 
+typedef struct shearwater_predator_state_t {
+	unsigned int offset;
+	unsigned int nsamples;
+	unsigned int time;
+	// Previous gas mix.
+	unsigned int o2_previous;
+	unsigned int he_previous;
+} shearwater_predator_state_t;
+
 static dc_status_t shearwater_predator_parser_set_data (dc_parser_t *abstract, const unsigned char *data, unsigned int size);
 static dc_status_t shearwater_predator_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t shearwater_predator_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t shearwater_predator_parser_samples_range (dc_parser_t *abstract, unsigned int begin, unsigned int end, dc_sample_callback_t callback, void *userdata);
+static dc_status_t shearwater_predator_parser_destroy (dc_parser_t *abstract);
 
 static const dc_parser_vtable_t shearwater_predator_parser_vtable = {
 	sizeof(shearwater_predator_parser_t),
@@ -91,7 +103,8 @@ static const dc_parser_vtable_t shearwater_predator_parser_vtable = {
 	shearwater_predator_parser_get_datetime, /* datetime */
 	shearwater_predator_parser_get_field, /* fields */
 	shearwater_predator_parser_samples_foreach, /* samples_foreach */
-	NULL /* destroy */
+	shearwater_predator_parser_samples_range, /* samples_range */
+	shearwater_predator_parser_destroy /* destroy */
 };
 
 static const dc_parser_vtable_t shearwater_petrel_parser_vtable = {
@@ -101,7 +114,8 @@ static const dc_parser_vtable_t shearwater_petrel_parser_vtable = {
 	shearwater_predator_parser_get_datetime, /* datetime */
 	shearwater_predator_parser_get_field, /* fields */
 	shearwater_predator_parser_samples_foreach, /* samples_foreach */
-	NULL /* destroy */
+	shearwater_predator_parser_samples_range, /* samples_range */
+	shearwater_predator_parser_destroy /* destroy */
 };
 
 
@@ -119,6 +133,17 @@ shearwater_predator_find_gasmix (shearwater_predator_parser_t *parser, unsigned
 }
 
 
+static void
+shearwater_predator_clear_strings (shearwater_predator_parser_t *parser)
+{
+	for (unsigned int i = 0; i < MAXSTRINGS; ++i) {
+		free ((void *) parser->strings[i].value);
+	}
+
+	memset (parser->strings, 0, sizeof (parser->strings));
+}
+
+
 dc_status_t
 shearwater_common_parser_create (dc_parser_t **out, dc_context_t *context, unsigned int model, unsigned int serial)
 {
@@ -159,6 +184,7 @@ shearwater_common_parser_create (dc_parser_t **out, dc_context_t *context, unsig
 		parser->helium[i] = 0;
 	}
 	parser->mode = DC_DIVEMODE_OC;
+	memset (parser->strings, 0, sizeof (parser->strings));
 
 	*out = (dc_parser_t *) parser;
 
@@ -186,6 +212,17 @@ shearwater_predator_parser_set_data (dc_parser_t *abstract, const unsigned char
 }
 
 
+static dc_status_t
+shearwater_predator_parser_destroy (dc_parser_t *abstract)
+{
+	shearwater_predator_parser_t *parser = (shearwater_predator_parser_t *) abstract;
+
+	shearwater_predator_clear_strings (parser);
+
+	return DC_STATUS_SUCCESS;
+}
+
+
 static dc_status_t
 shearwater_predator_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime)
 {
@@ -369,7 +406,7 @@ shearwater_predator_parser_cache (shearwater_predator_parser_t *parser)
 		parser->logversion = data[127];
 	INFO(abstract->context, "Shearwater log version %u\n", parser->logversion);
 
-	memset(parser->strings, 0, sizeof(parser->strings));
+	shearwater_predator_clear_strings (parser);
 
 	// Adjust the footersize for the final block.
 	if (parser->model > PREDATOR || array_uint16_be (data + size - footersize) == 0xFFFD) {
@@ -540,7 +577,8 @@ shearwater_predator_parser_get_field (dc_parser_t *abstract, dc_field_type_t typ
 			if (flags < MAXSTRINGS) {
 				dc_field_string_t *p = parser->strings + flags;
 				if (p->desc) {
-					*string = *p;
+					string->desc = p->desc;
+					string->value = strdup(p->value);
 					break;
 				}
 			}
@@ -555,40 +593,36 @@ shearwater_predator_parser_get_field (dc_parser_t *abstract, dc_field_type_t typ
 
 
 static dc_status_t
-shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+shearwater_predator_parser_walk (dc_parser_t *abstract, void *userstate, unsigned int end, sample_index_t *index, dc_sample_callback_t callback, void *userdata)
 {
 	shearwater_predator_parser_t *parser = (shearwater_predator_parser_t *) abstract;
+	shearwater_predator_state_t *state = (shearwater_predator_state_t *) userstate;
 
 	const unsigned char *data = abstract->data;
 	unsigned int size = abstract->size;
 
-	// Cache the parser data.
-	dc_status_t rc = shearwater_predator_parser_cache (parser);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
-
 	// Get the unit system.
 	unsigned int units = data[8];
 
-	// Previous gas mix.
-	unsigned int o2_previous = 0, he_previous = 0;
-
-	unsigned int time = 0;
-	unsigned int offset = parser->headersize;
 	unsigned int length = size - parser->footersize;
 
-	while (offset < length) {
+	while (state->offset < length && state->time <= end) {
 		dc_sample_value_t sample = {0};
+		unsigned int offset = state->offset;
 
 		// Ignore empty samples.
 		if (array_isequal (data + offset, parser->samplesize, 0x00)) {
-			offset += parser->samplesize;
+			state->offset += parser->samplesize;
 			continue;
 		}
 
+		if (index && state->nsamples && (state->nsamples % SAMPLE_INDEX_INTERVAL) == 0)
+			sample_index_append (index, state->time, state);
+		state->nsamples++;
+
 		// Time (seconds).
-		time += 10;
-		sample.time = time;
+		state->time += 10;
+		sample.time = state->time;
 		if (callback) callback (DC_SAMPLE_TIME, sample, userdata);
 
 		// Depth (1/10 m or ft).
@@ -657,7 +691,7 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 		// Gaschange.
 		unsigned int o2 = data[offset + 7];
 		unsigned int he = data[offset + 8];
-		if (o2 != o2_previous || he != he_previous) {
+		if (o2 != state->o2_previous || he != state->he_previous) {
 			unsigned int idx = shearwater_predator_find_gasmix (parser, o2, he);
 			if (idx >= parser->ngasmixes) {
 				ERROR (abstract->context, "Invalid gas mix.");
@@ -666,8 +700,8 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 
 			sample.gasmix = idx;
 			if (callback) callback (DC_SAMPLE_GASMIX, sample, userdata);
-			o2_previous = o2;
-			he_previous = he;
+			state->o2_previous = o2;
+			state->he_previous = he;
 		}
 
 		// Deco stop / NDL.
@@ -714,7 +748,49 @@ shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_cal
 			}
 		}
 
-		offset += parser->samplesize;
+		state->offset += parser->samplesize;
 	}
 	return DC_STATUS_SUCCESS;
 }
+
+static void
+shearwater_predator_parser_init (shearwater_predator_parser_t *parser, shearwater_predator_state_t *state)
+{
+	state->offset = parser->headersize;
+	state->nsamples = 0;
+	state->time = 0;
+	state->o2_previous = 0;
+	state->he_previous = 0;
+}
+
+static dc_status_t
+shearwater_predator_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+{
+	shearwater_predator_parser_t *parser = (shearwater_predator_parser_t *) abstract;
+	shearwater_predator_state_t state;
+
+	// Cache the parser data.
+	dc_status_t rc = shearwater_predator_parser_cache (parser);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	shearwater_predator_parser_init (parser, &state);
+
+	return shearwater_predator_parser_walk (abstract, &state, UINT_MAX, NULL, callback, userdata);
+}
+
+static dc_status_t
+shearwater_predator_parser_samples_range (dc_parser_t *abstract, unsigned int begin, unsigned int end, dc_sample_callback_t callback, void *userdata)
+{
+	shearwater_predator_parser_t *parser = (shearwater_predator_parser_t *) abstract;
+	shearwater_predator_state_t state;
+
+	// Cache the parser data.
+	dc_status_t rc = shearwater_predator_parser_cache (parser);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	shearwater_predator_parser_init (parser, &state);
+
+	return sample_index_walk (abstract, begin, end, &state, sizeof (state), shearwater_predator_parser_walk, callback, userdata);
+}
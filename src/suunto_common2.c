@@ -65,19 +65,25 @@ suunto_common2_transfer (dc_device_t *abstract, const unsigned char command[], u
 	// returning an error. Usually the dive computer will respond
 	// again during one of the retries.
 
+	unsigned long long start = device_stats_begin (abstract);
+
 	unsigned int nretries = 0;
 	dc_status_t rc = DC_STATUS_SUCCESS;
 	while ((rc = VTABLE (abstract)->packet (abstract, command, csize, answer, asize, size)) != DC_STATUS_SUCCESS) {
 		// Automatically discard a corrupted packet,
 		// and request a new one.
 		if (rc != DC_STATUS_TIMEOUT && rc != DC_STATUS_PROTOCOL)
-			return rc;
+			break;
 
 		// Abort if the maximum number of retries is reached.
 		if (nretries++ >= MAXRETRIES)
-			return rc;
+			break;
+
+		device_stats_retry (abstract);
 	}
 
+	device_stats_end (abstract, start, rc);
+
 	return rc;
 }
 
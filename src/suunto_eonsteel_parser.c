@@ -24,14 +24,14 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <math.h>
-#include <stdarg.h>
 
 /* Wow. MSC is truly crap */
 #ifdef _MSC_VER
 #define snprintf _snprintf
-#define vsnprintf _vsnprintf
 #endif
 
+#include <libdivecomputer/buffer.h>
+
 #include "suunto_eonsteel.h"
 #include "context-private.h"
 #include "parser-private.h"
@@ -81,19 +81,93 @@ enum eon_sample {
 
 #define EON_MAX_GROUP 16
 
+#define MAXENUM 100
+
 struct type_desc {
 	const char *desc, *format, *mod;
+	const char **enums; // Decoded enumeration strings (MAXENUM entries)
 	unsigned int size;
+	unsigned int entry; // Index of the defining entry (one based)
 	enum eon_sample type[EON_MAX_GROUP];
+	struct type_desc *previous; // Earlier definition of a redefined type
 };
 
 #define MAXTYPE 512
 #define MAXGASES 16
 #define MAXSTRINGS 32
+#define MAXDESCRIPTORS 8
+
+/*
+ * The decoded type descriptors of a dive.
+ *
+ * Every dive of the same firmware carries the same set of descriptors,
+ * so the decoded tables are kept in a small cache that is attached to
+ * the context, and shared by all parsers. The tables are immutable
+ * once they are built, and reference counted because a parser can
+ * still use a table that has been evicted from the cache. The cache
+ * and the reference counts are only accessed with the context lock
+ * held, because the parsers can run on different threads.
+ *
+ * The key is the descriptor block: the text length and the contents of
+ * the descriptor of every entry, in file order. A descriptor is only
+ * valid from its own entry on, so a table can also be used for a dive
+ * whose descriptor block is a prefix of its key. That only holds if
+ * every type is defined once: a table with a redefined type is never
+ * added to the cache, and only used by the dive it was built for.
+ */
+typedef struct eon_descriptors_t {
+	struct eon_descriptors_t *next;
+	unsigned int refcount;
+	unsigned int size;
+	unsigned char *block;
+	struct type_desc type_desc[MAXTYPE];
+} eon_descriptors_t;
+
+typedef struct eon_descriptor_cache_t {
+	eon_descriptors_t *head;
+	unsigned int count;
+} eon_descriptor_cache_t;
+
+// The key of the descriptor cache in the context.
+static const char descriptor_cache_key = 0;
+
+/*
+ * The sample records of a dive, in file order. The index is built
+ * during the only traversal of the entries, so the samples can be
+ * iterated without walking the entries again.
+ */
+typedef struct eon_record_t {
+	unsigned int offset; // Offset of the record data
+	unsigned int size;
+	unsigned int type;
+	unsigned int entry; // Defining entry of the type descriptor
+} eon_record_t;
+
+/*
+ * The string fields are only formatted when they are requested.
+ * The field cache keeps the location of the record and its format.
+ */
+enum eon_string {
+	EON_STRING_UTF8,	// utf8
+	EON_STRING_PERCENT,	// uint8 ("%d %%")
+	EON_STRING_ADJUSTMENT,	// int8 ("P%d")
+	EON_STRING_TIME,	// uint32 seconds ("%d:%02d" hours and minutes)
+};
+
+struct eon_string_field {
+	const char *desc;
+	enum eon_string format;
+	unsigned int offset, size;
+};
 
 typedef struct suunto_eonsteel_parser_t {
 	dc_parser_t base;
-	struct type_desc type_desc[MAXTYPE];
+	eon_descriptors_t *descriptors;
+	dc_buffer_t *block;	// Descriptor block of the current dive
+	int building;		// Decoding into a new table
+	dc_status_t status;	// Status of the traversal
+	eon_record_t *records;
+	unsigned int nrecords, maxrecords;
 	// field cache
 	struct {
 		unsigned int initialized;
@@ -108,7 +182,7 @@ typedef struct suunto_eonsteel_parser_t {
 		double lowsetpoint;
 		double highsetpoint;
 		double customsetpoint;
-		dc_field_string_t strings[MAXSTRINGS];
+		struct eon_string_field strings[MAXSTRINGS];
 		dc_tankinfo_t tankinfo[MAXGASES];
 		double tanksize[MAXGASES];
 		double tankworkingpressure[MAXGASES];
@@ -150,7 +224,7 @@ static const struct {
 	{ "Events.DiveTimer.Time",		ES_none },
 };
 
-static enum eon_sample lookup_descriptor_type(suunto_eonsteel_parser_t *eon, struct type_desc *desc)
+static enum eon_sample lookup_descriptor_type(struct type_desc *desc)
 {
 	int i;
 	const char *name = desc->desc;
@@ -192,7 +266,7 @@ static const char *desc_type_name(enum eon_sample type)
 	return "Unknown";
 }
 
-static int lookup_descriptor_size(suunto_eonsteel_parser_t *eon, struct type_desc *desc)
+static int lookup_descriptor_size(struct type_desc *desc)
 {
 	const char *format = desc->format;
 	unsigned char c;
@@ -216,7 +290,7 @@ static int lookup_descriptor_size(suunto_eonsteel_parser_t *eon, struct type_des
 	return 0;
 }
 
-static int fill_in_group_details(suunto_eonsteel_parser_t *eon, struct type_desc *desc)
+static int fill_in_group_details(dc_context_t *context, struct type_desc table[], struct type_desc *desc)
 {
 	int subtype = 0;
 	const char *grp = desc->desc;
@@ -227,29 +301,29 @@ static int fill_in_group_details(suunto_eonsteel_parser_t *eon, struct type_desc
 		long index;
 
 		index = strtol(grp, &end, 10);
-		if (index < 0 || index > MAXTYPE || end == grp) {
-			ERROR(eon->base.context, "Group type descriptor '%s' does not parse", desc->desc);
+		if (index < 0 || index >= MAXTYPE || end == grp) {
+			ERROR(context, "Group type descriptor '%s' does not parse", desc->desc);
 			break;
 		}
-		base = eon->type_desc + index;
+		base = table + index;
 		if (!base->desc) {
-			ERROR(eon->base.context, "Group type descriptor '%s' has undescribed index %ld", desc->desc, index);
+			ERROR(context, "Group type descriptor '%s' has undescribed index %ld", desc->desc, index);
 			break;
 		}
 		if (!base->size) {
-			ERROR(eon->base.context, "Group type descriptor '%s' uses unsized sub-entry '%s'", desc->desc, base->desc);
+			ERROR(context, "Group type descriptor '%s' uses unsized sub-entry '%s'", desc->desc, base->desc);
 			break;
 		}
 		if (!base->type[0]) {
-			ERROR(eon->base.context, "Group type descriptor '%s' has non-enumerated sub-entry '%s'", desc->desc, base->desc);
+			ERROR(context, "Group type descriptor '%s' has non-enumerated sub-entry '%s'", desc->desc, base->desc);
 			break;
 		}
 		if (base->type[1]) {
-			ERROR(eon->base.context, "Group type descriptor '%s' has a recursive group sub-entry '%s'", desc->desc, base->desc);
+			ERROR(context, "Group type descriptor '%s' has a recursive group sub-entry '%s'", desc->desc, base->desc);
 			break;
 		}
 		if (subtype >= EON_MAX_GROUP-1) {
-			ERROR(eon->base.context, "Group type descriptor '%s' has too many sub-entries", desc->desc);
+			ERROR(context, "Group type descriptor '%s' has too many sub-entries", desc->desc);
 			break;
 		}
 		desc->size += base->size;
@@ -261,13 +335,83 @@ static int fill_in_group_details(suunto_eonsteel_parser_t *eon, struct type_desc
 			grp = end+1;
 			continue;
 		default:
-			ERROR(eon->base.context, "Group type descriptor '%s' has unparseable index %ld", desc->desc, index);
+			ERROR(context, "Group type descriptor '%s' has unparseable index %ld", desc->desc, index);
 			return -1;
 		}
 	}
 	return -1;
 }
 
+/*
+ * Decode the strings of an enumeration.
+ *
+ * Enumerations have the enum values in the "format" string,
+ * and all start with "enum:" followed by a comma-separated list
+ * of enumeration values and strings. Example:
+ *
+ * "enum:0=NoFly Time,1=Depth,2=Surface Time,3=..."
+ *
+ * The table of string pointers and the strings themselves are
+ * stored in a single allocation.
+ */
+static int fill_in_enum_details(struct type_desc *desc)
+{
+	const char *str = desc->format;
+	const char **enums;
+	char *text;
+	unsigned char c;
+
+	if (!str || strncmp(str, "enum:", 5))
+		return 0;
+	str += 5;
+
+	enums = (const char **) calloc(1, MAXENUM * sizeof(*enums) + strlen(str) + 1);
+	if (!enums)
+		return -1;
+	text = (char *) (enums + MAXENUM);
+
+	while ((c = *str) != 0) {
+		unsigned char n;
+		const char *begin, *end;
+
+		str++;
+		if (!isdigit(c))
+			continue;
+		n = c - '0';
+
+		// We only handle one or two digits
+		if (isdigit(*str)) {
+			n = n*10 + *str - '0';
+			str++;
+		}
+
+		begin = end = str;
+		while ((c = *str) != 0) {
+			str++;
+			if (c == ',')
+				break;
+			end = str;
+		}
+
+		// Verify that it has the 'n=string' format and skip the equals sign
+		if (*begin != '=')
+			continue;
+		begin++;
+
+		// The first string of a value wins
+		if (enums[n])
+			continue;
+
+		memcpy(text, begin, end-begin);
+		text[end-begin] = 0;
+		enums[n] = text;
+		text += end-begin+1;
+	}
+
+	desc->enums = enums;
+	return 0;
+}
+
 /*
  * Here we cache descriptor data so that we don't have
  * to re-parse the string all the time. That way we can
@@ -278,16 +422,19 @@ static int fill_in_group_details(suunto_eonsteel_parser_t *eon, struct type_desc
  * base types) or are "GRP" types that are a group of said
  * types and are a set of numbers.
  */
-static int fill_in_desc_details(suunto_eonsteel_parser_t *eon, struct type_desc *desc)
+static int fill_in_desc_details(dc_context_t *context, struct type_desc table[], struct type_desc *desc)
 {
 	if (!desc->desc)
 		return 0;
 
 	if (isdigit(desc->desc[0]))
-		return fill_in_group_details(eon, desc);
+		return fill_in_group_details(context, table, desc);
+
+	if (fill_in_enum_details(desc) < 0)
+		ERROR(context, "out of memory");
 
-	desc->size = lookup_descriptor_size(eon, desc);
-	desc->type[0] = lookup_descriptor_type(eon, desc);
+	desc->size = lookup_descriptor_size(desc);
+	desc->type[0] = lookup_descriptor_type(desc);
 	return 0;
 }
 
@@ -298,10 +445,15 @@ desc_free (struct type_desc desc[], unsigned int count)
 		free((void *)desc[i].desc);
 		free((void *)desc[i].format);
 		free((void *)desc[i].mod);
+		free((void *)desc[i].enums);
+		if (desc[i].previous) {
+			desc_free(desc[i].previous, 1);
+			free(desc[i].previous);
+		}
 	}
 }
 
-static int record_type(suunto_eonsteel_parser_t *eon, unsigned short type, const char *name, int namelen)
+static int record_type(dc_context_t *context, struct type_desc table[], unsigned short type, const char *name, unsigned int entry)
 {
 	struct type_desc desc;
 	const char *next;
@@ -322,12 +474,12 @@ static int record_type(suunto_eonsteel_parser_t *eon, unsigned short type, const
 		}
 
 		if (len < 5 || name[0] != '<' || name[4] != '>') {
-			ERROR(eon->base.context, "Unexpected type description: %.*s", len, name);
+			ERROR(context, "Unexpected type description: %.*s", len, name);
 			return -1;
 		}
 		p = (char *) malloc(len-4);
 		if (!p) {
-			ERROR(eon->base.context, "out of memory");
+			ERROR(context, "out of memory");
 			desc_free(&desc, 1);
 			return -1;
 		}
@@ -347,15 +499,15 @@ static int record_type(suunto_eonsteel_parser_t *eon, unsigned short type, const
 			desc.mod = p;
 			break;
 		default:
-			ERROR(eon->base.context, "Unknown type descriptor: %.*s", len, name);
+			ERROR(context, "Unknown type descriptor: %.*s", len, name);
 			desc_free(&desc, 1);
 			free(p);
 			return -1;
 		}
 	} while ((name = next) != NULL);
 
-	if (type > MAXTYPE) {
-		ERROR(eon->base.context, "Type out of range (%04x: '%s' '%s' '%s')",
+	if (type >= MAXTYPE) {
+		ERROR(context, "Type out of range (%04x: '%s' '%s' '%s')",
 			type,
 			desc.desc ? desc.desc : "",
 			desc.format ? desc.format : "",
@@ -364,47 +516,322 @@ static int record_type(suunto_eonsteel_parser_t *eon, unsigned short type, const
 		return -1;
 	}
 
-	fill_in_desc_details(eon, &desc);
+	desc.entry = entry;
+	fill_in_desc_details(context, table, &desc);
+
+	// Keep the earlier definition of a redefined type, for the
+	// records in between both definitions.
+	if (table[type].entry) {
+		desc.previous = (struct type_desc *) malloc(sizeof(struct type_desc));
+		if (!desc.previous) {
+			ERROR(context, "out of memory");
+			desc_free(&desc, 1);
+			return -1;
+		}
+		*desc.previous = table[type];
+	}
 
-	desc_free(eon->type_desc + type, 1);
-	eon->type_desc[type] = desc;
+	table[type] = desc;
 	return 0;
 }
 
-static int traverse_entry(suunto_eonsteel_parser_t *eon, const unsigned char *p, int len, eon_data_cb_t callback, void *user)
+static void show_descriptor(dc_context_t *context, int nr, struct type_desc *desc)
 {
-	const unsigned char *name, *data, *end, *last, *one_past_end = p + len;
-	int textlen, type;
-	int rc;
+	int i;
+
+	if (!desc->desc)
+		return;
+	DEBUG(context, "Descriptor %d: '%s', size %d bytes", nr, desc->desc, desc->size);
+	if (desc->format)
+		DEBUG(context, "    format '%s'", desc->format);
+	if (desc->mod)
+		DEBUG(context, "    mod '%s'", desc->mod);
+	for (i = 0; i < EON_MAX_GROUP; i++) {
+		enum eon_sample type = desc->type[i];
+		if (!type)
+			continue;
+		DEBUG(context, "    %d: %d (%s)", i, type, desc_type_name(type));
+	}
+}
+
+static void descriptors_release(eon_descriptors_t *descriptors)
+{
+	if (!descriptors || --descriptors->refcount)
+		return;
+
+	desc_free(descriptors->type_desc, MAXTYPE);
+	free(descriptors->block);
+	free(descriptors);
+}
+
+static void descriptor_cache_free(void *data)
+{
+	eon_descriptor_cache_t *cache = (eon_descriptor_cache_t *) data;
+	eon_descriptors_t *descriptors = cache->head;
+
+	while (descriptors) {
+		eon_descriptors_t *next = descriptors->next;
+		descriptors_release(descriptors);
+		descriptors = next;
+	}
+
+	free(cache);
+}
+
+static eon_descriptor_cache_t *descriptor_cache(dc_context_t *context)
+{
+	eon_descriptor_cache_t *cache;
+
+	cache = (eon_descriptor_cache_t *) dc_context_get_shared(context, &descriptor_cache_key);
+	if (cache || !context)
+		return cache;
+
+	cache = (eon_descriptor_cache_t *) calloc(1, sizeof(eon_descriptor_cache_t));
+	if (cache && dc_context_set_shared(context, &descriptor_cache_key, cache, descriptor_cache_free) != DC_STATUS_SUCCESS) {
+		free(cache);
+		cache = NULL;
+	}
+
+	return cache;
+}
+
+/*
+ * Find a cached table for a dive with the given (partial) descriptor
+ * block, and move it to the front of the cache.
+ */
+static eon_descriptors_t *descriptors_find(eon_descriptor_cache_t *cache, const unsigned char *block, unsigned int size)
+{
+	eon_descriptors_t *descriptors, **pp;
+
+	if (!cache)
+		return NULL;
+
+	for (pp = &cache->head; (descriptors = *pp) != NULL; pp = &descriptors->next) {
+		if (descriptors->size >= size && !memcmp(descriptors->block, block, size)) {
+			*pp = descriptors->next;
+			descriptors->next = cache->head;
+			cache->head = descriptors;
+			return descriptors;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Add a new table to the cache, and evict the least recently used
+ * table when the cache is full.
+ */
+static void descriptors_insert(eon_descriptor_cache_t *cache, eon_descriptors_t *descriptors)
+{
+	eon_descriptors_t **pp;
+
+	if (!cache)
+		return;
+
+	descriptors->next = cache->head;
+	cache->head = descriptors;
+	descriptors->refcount++;
+
+	if (++cache->count > MAXDESCRIPTORS) {
+		for (pp = &cache->head; (*pp)->next; pp = &(*pp)->next)
+			;
+		descriptors_release(*pp);
+		*pp = NULL;
+		cache->count--;
+	}
+}
+
+/*
+ * Decode all the descriptors of a (partial) descriptor block into a
+ * new table. Just like for the remaining descriptors, an invalid
+ * descriptor is reported, but doesn't stop the parsing.
+ */
+static eon_descriptors_t *descriptors_build(dc_context_t *context, const unsigned char *block, unsigned int size)
+{
+	eon_descriptors_t *descriptors;
+	unsigned int offset = 0, entry = 0;
+
+	descriptors = (eon_descriptors_t *) calloc(1, sizeof(eon_descriptors_t));
+	if (!descriptors) {
+		ERROR(context, "out of memory");
+		return NULL;
+	}
+	descriptors->refcount = 1;
+
+	while (offset < size) {
+		unsigned int textlen = array_uint32_le(block + offset);
+		const unsigned char *name = block + offset + 4;
+
+		record_type(context, descriptors->type_desc, array_uint16_le(name), (const char *) name + 2, ++entry);
+		offset += 4 + textlen + 1;
+	}
+
+	return descriptors;
+}
+
+/*
+ * Resolve the descriptor of an entry, while traversing a new dive.
+ *
+ * As long as the descriptors match the table of the previous dive (or
+ * of another cached dive), the decoded descriptors are reused as-is.
+ * Otherwise the descriptors are decoded into a new table, which is
+ * added to the cache once the whole dive has been traversed.
+ */
+static int resolve_descriptor(suunto_eonsteel_parser_t *eon, unsigned int entry, const unsigned char *name, unsigned int textlen)
+{
+	dc_context_t *context = eon->base.context;
+	eon_descriptors_t *descriptors = eon->descriptors;
+	unsigned int offset = dc_buffer_get_size(eon->block);
+	const unsigned char *block;
+	unsigned int size;
+	unsigned char header[4];
+
+	// Every descriptor is stored as the four byte text length, the
+	// two byte type and the text, followed by a terminating NUL byte.
+	array_uint32_le_set(header, textlen);
+	if (!dc_buffer_append(eon->block, header, sizeof(header)) ||
+		!dc_buffer_append(eon->block, name, textlen) ||
+		!dc_buffer_append(eon->block, (const unsigned char *) "", 1)) {
+		ERROR(context, "out of memory");
+		eon->status = DC_STATUS_NOMEMORY;
+		return -1;
+	}
+
+	block = dc_buffer_get_data(eon->block);
+	size = dc_buffer_get_size(eon->block);
+
+	if (eon->building) {
+		record_type(context, descriptors->type_desc, array_uint16_le(name), (const char *) name + 2, entry);
+		return 0;
+	}
+
+	if (descriptors && descriptors->size >= size &&
+		!memcmp(descriptors->block + offset, block + offset, size - offset))
+		return 0;
+
+	dc_context_lock(context);
+	descriptors = descriptors_find(descriptor_cache(context), block, size);
+	if (descriptors)
+		descriptors->refcount++;
+	dc_context_unlock(context);
+
+	if (!descriptors) {
+		descriptors = descriptors_build(context, block, size);
+		if (!descriptors) {
+			eon->status = DC_STATUS_NOMEMORY;
+			return -1;
+		}
+		eon->building = 1;
+	}
+
+	dc_context_lock(context);
+	descriptors_release(eon->descriptors);
+	dc_context_unlock(context);
+	eon->descriptors = descriptors;
+
+	return 0;
+}
+
+/*
+ * Finish the descriptors of a new dive. A newly decoded table gets a
+ * copy of its key, and is added to the cache, unless it has a redefined
+ * type.
+ */
+static int finish_descriptors(suunto_eonsteel_parser_t *eon)
+{
+	eon_descriptors_t *descriptors = eon->descriptors;
+	unsigned int size = dc_buffer_get_size(eon->block);
+	int redefined = 0;
+
+	if (eon->status != DC_STATUS_SUCCESS)
+		return -1;
+	if (!eon->building)
+		return 0;
+
+	eon->building = 0;
+
+	for (unsigned int i = 0; i < MAXTYPE; ++i) {
+		show_descriptor(eon->base.context, i, descriptors->type_desc + i);
+		if (descriptors->type_desc[i].previous)
+			redefined = 1;
+	}
+
+	if (redefined)
+		return 0;
+
+	descriptors->block = (unsigned char *) malloc(size);
+	if (!descriptors->block) {
+		ERROR(eon->base.context, "out of memory");
+		return -1;
+	}
+	memcpy(descriptors->block, dc_buffer_get_data(eon->block), size);
+	descriptors->size = size;
+
+	dc_context_lock(eon->base.context);
+	descriptors_insert(descriptor_cache(eon->base.context), descriptors);
+	dc_context_unlock(eon->base.context);
+
+	return 0;
+}
+
+/*
+ * Parse the header of an entry, and return a pointer to the
+ * descriptor (the two type bytes followed by the text), or NULL
+ * for a bad entry.
+ */
+static const unsigned char *entry_descriptor(suunto_eonsteel_parser_t *eon, const unsigned char *p, int len, unsigned int *textlen)
+{
+	const unsigned char *name;
 
 	// First two bytes: zero and text length
 	if (p[0]) {
 		HEXDUMP(eon->base.context, DC_LOGLEVEL_DEBUG, "next", p, 8);
 		ERROR(eon->base.context, "Bad dive entry (%02x)", p[0]);
-		return -1;
+		return NULL;
 	}
-	textlen = p[1];
+	*textlen = p[1];
 
 	name = p + 2;
-	if (textlen == 0xff) {
-		textlen = array_uint32_le(name);
+	if (*textlen == 0xff) {
+		if (len < 6)
+			return NULL;
+		*textlen = array_uint32_le(name);
 		name += 4;
 	}
 
 	// Two bytes of 'type' followed by the name/descriptor, followed by the data
-	data = name + textlen;
-	type = array_uint16_le(name);
-	name += 2;
+	if (*textlen < 3 || *textlen > len - (name - p)) {
+		ERROR(eon->base.context, "Bad dive entry length (%u)", *textlen);
+		return NULL;
+	}
 
-	if (*name != '<') {
+	if (name[2] != '<') {
 		HEXDUMP(eon->base.context, DC_LOGLEVEL_DEBUG, "bad", p, 16);
-		return -1;
+		return NULL;
 	}
 
-	record_type(eon, type, (const char *) name, textlen-3);
+	return name;
+}
+
+static int traverse_entry(suunto_eonsteel_parser_t *eon, const unsigned char *p, int len, unsigned int entry, eon_data_cb_t callback, void *user)
+{
+	const struct type_desc *type_desc;
+	const unsigned char *name, *end, *last, *one_past_end = p + len;
+	unsigned int textlen;
+	int rc;
+
+	name = entry_descriptor(eon, p, len, &textlen);
+	if (!name)
+		return -1;
 
-	end = data;
-	last = data;
+	// A descriptor is only valid from its own entry on.
+	if (resolve_descriptor(eon, entry, name, textlen) < 0)
+		return -1;
+	type_desc = eon->descriptors->type_desc;
+
+	end = name + textlen;
+	last = end;
 	while (end < one_past_end && *end) {
 		const unsigned char *begin = end;
 		unsigned int type = *end++;
@@ -423,11 +850,11 @@ static int traverse_entry(suunto_eonsteel_parser_t *eon, const unsigned char *p,
 			end += 4;
 		}
 
-		if (type > MAXTYPE || !eon->type_desc[type].desc) {
+		if (type >= MAXTYPE || !type_desc[type].desc || type_desc[type].entry > entry) {
 			HEXDUMP(eon->base.context, DC_LOGLEVEL_DEBUG, "last", last, 16);
 			HEXDUMP(eon->base.context, DC_LOGLEVEL_DEBUG, "this", begin, 16);
 		} else {
-			rc = callback(type, eon->type_desc+type, end, len, user);
+			rc = callback(type, type_desc+type, end, len, user);
 			if (rc < 0)
 				return rc;
 		}
@@ -443,6 +870,7 @@ static int traverse_data(suunto_eonsteel_parser_t *eon, eon_data_cb_t callback,
 {
 	const unsigned char *data = eon->base.data;
 	int len = eon->base.size;
+	unsigned int entry = 0;
 
 	// Dive files start with "SBEM" and four NUL characters
 	// Additionally, we've prepended the time as an extra
@@ -454,7 +882,7 @@ static int traverse_data(suunto_eonsteel_parser_t *eon, eon_data_cb_t callback,
 	len -= 12;
 
 	while (len > 4) {
-		int i = traverse_entry(eon, data, len, callback, user);
+		int i = traverse_entry(eon, data, len, ++entry, callback, user);
 		if (i < 0)
 			return 1;
 		len -= i;
@@ -611,66 +1039,13 @@ static void sample_gas_switch_event(struct sample_data *info, unsigned short idx
 
 /*
  * Look up the string from an enumeration.
- *
- * Enumerations have the enum values in the "format" string,
- * and all start with "enum:" followed by a comma-separated list
- * of enumeration values and strings. Example:
- *
- * "enum:0=NoFly Time,1=Depth,2=Surface Time,3=..."
  */
 static const char *lookup_enum(const struct type_desc *desc, unsigned char value)
 {
-	const char *str = desc->format;
-	unsigned char c;
-
-	if (!str)
-		return NULL;
-	if (strncmp(str, "enum:", 5))
+	if (!desc->enums || value >= MAXENUM)
 		return NULL;
-	str += 5;
-
-	while ((c = *str) != 0) {
-		unsigned char n;
-		const char *begin, *end;
-		char *ret;
-
-		str++;
-		if (!isdigit(c))
-			continue;
-		n = c - '0';
-
-		// We only handle one or two digits
-		if (isdigit(*str)) {
-			n = n*10 + *str - '0';
-			str++;
-		}
-
-		begin = end = str;
-		while ((c = *str) != 0) {
-			str++;
-			if (c == ',')
-				break;
-			end = str;
-		}
-
-		// Verify that it has the 'n=string' format and skip the equals sign
-		if (*begin != '=')
-			continue;
-		begin++;
-
-		// Is it the value we're looking for?
-		if (n != value)
-			continue;
-
-		ret = (char *)malloc(end - begin + 1);
-		if (!ret)
-			break;
 
-		memcpy(ret, begin, end-begin);
-		ret[end-begin] = 0;
-		return ret;
-	}
-	return NULL;
+	return desc->enums[value];
 }
 
 /*
@@ -962,21 +1337,74 @@ suunto_eonsteel_parser_samples_foreach(dc_parser_t *abstract, dc_sample_callback
 	suunto_eonsteel_parser_t *eon = (suunto_eonsteel_parser_t *) abstract;
 	struct sample_data data = { eon, callback, userdata, 0 };
 
-	traverse_data(eon, traverse_samples, &data);
+	for (unsigned int i = 0; i < eon->nrecords; ++i) {
+		const eon_record_t *record = eon->records + i;
+		const struct type_desc *desc = eon->descriptors->type_desc + record->type;
+
+		// The record of a redefined type uses the definition at the time.
+		while (desc->entry > record->entry)
+			desc = desc->previous;
+
+		traverse_samples(record->type, desc, eon->base.data + record->offset, record->size, &data);
+	}
+
 	return DC_STATUS_SUCCESS;
 }
 
 static dc_status_t get_string_field(suunto_eonsteel_parser_t *eon, unsigned idx, dc_field_string_t *value)
 {
-	if (idx < MAXSTRINGS) {
-		dc_field_string_t *res = eon->cache.strings+idx;
-		if (res->desc && res->value) {
-			*value = *res;
-			return DC_STATUS_SUCCESS;
-		}
+	const struct eon_string_field *field;
+	const unsigned char *data, *nul;
+	unsigned int time, size;
+	char buffer[256], *text;
 
+	if (idx >= MAXSTRINGS || !eon->cache.strings[idx].desc)
+		return DC_STATUS_UNSUPPORTED;
+
+	field = eon->cache.strings + idx;
+	data = eon->base.data + field->offset;
+
+	/*
+	 * We ignore the return value from snprintf, and we
+	 * always NUL-terminate the destination buffer ourselves.
+	 *
+	 * That way we don't have to worry about random bad legacy
+	 * implementations.
+	 */
+	buffer[sizeof(buffer)-1] = 0;
+	switch (field->format) {
+	case EON_STRING_UTF8:
+		nul = (const unsigned char *) memchr(data, 0, field->size);
+		size = nul ? nul - data : field->size;
+		text = (char *) malloc(size + 1);
+		if (text) {
+			memcpy(text, data, size);
+			text[size] = 0;
+		}
+		value->value = text;
+		break;
+	case EON_STRING_PERCENT:
+		(void) snprintf(buffer, sizeof(buffer)-1, "%d %%", data[0]);
+		value->value = strdup(buffer);
+		break;
+	case EON_STRING_ADJUSTMENT:
+		(void) snprintf(buffer, sizeof(buffer)-1, "P%d", *(const signed char *)data);
+		value->value = strdup(buffer);
+		break;
+	case EON_STRING_TIME:
+		time = array_uint32_le(data) / 60;
+		(void) snprintf(buffer, sizeof(buffer)-1, "%d:%02d", time / 60, time % 60);
+		value->value = strdup(buffer);
+		break;
+	default:
+		return DC_STATUS_UNSUPPORTED;
 	}
-	return DC_STATUS_UNSUPPORTED;
+
+	if (!value->value)
+		return DC_STATUS_NOMEMORY;
+
+	value->desc = field->desc;
+	return DC_STATUS_SUCCESS;
 }
 
 // Ugly define thing makes the code much easier to read
@@ -1173,42 +1601,24 @@ static int add_gas_workpressure(suunto_eonsteel_parser_t *eon, float wp)
 	return 0;
 }
 
-static int add_string(suunto_eonsteel_parser_t *eon, const char *desc, const char *value)
+static int add_string(suunto_eonsteel_parser_t *eon, const char *desc, enum eon_string format, const unsigned char *data, int len)
 {
 	int i;
 
 	eon->cache.initialized |= 1 << DC_FIELD_STRING;
 	for (i = 0; i < MAXSTRINGS; i++) {
-		dc_field_string_t *str = eon->cache.strings+i;
+		struct eon_string_field *str = eon->cache.strings+i;
 		if (str->desc)
 			continue;
 		str->desc = desc;
-		str->value = strdup(value);
+		str->format = format;
+		str->offset = data - eon->base.data;
+		str->size = len;
 		break;
 	}
 	return 0;
 }
 
-static int add_string_fmt(suunto_eonsteel_parser_t *eon, const char *desc, const char *fmt, ...)
-{
-	char buffer[256];
-	va_list ap;
-
-	/*
-	 * We ignore the return value from vsnprintf, and we
-	 * always NUL-terminate the destination buffer ourselves.
-	 *
-	 * That way we don't have to worry about random bad legacy
-	 * implementations.
-	 */
-	va_start(ap, fmt);
-	buffer[sizeof(buffer)-1] = 0;
-	(void) vsnprintf(buffer, sizeof(buffer)-1, fmt, ap);
-	va_end(ap);
-
-	return add_string(eon, desc, buffer);
-}
-
 static float get_le32_float(const unsigned char *src)
 {
 	union {
@@ -1233,15 +1643,15 @@ static int traverse_device_fields(suunto_eonsteel_parser_t *eon, const struct ty
 {
 	const char *name = desc->desc + strlen("sml.DeviceLog.Device.");
 	if (!strcmp(name, "SerialNumber"))
-		return add_string(eon, "Serial", data);
+		return add_string(eon, "Serial", EON_STRING_UTF8, data, len);
 	if (!strcmp(name, "Info.HW"))
-		return add_string(eon, "HW Version", data);
+		return add_string(eon, "HW Version", EON_STRING_UTF8, data, len);
 	if (!strcmp(name, "Info.SW"))
-		return add_string(eon, "FW Version", data);
+		return add_string(eon, "FW Version", EON_STRING_UTF8, data, len);
 	if (!strcmp(name, "Info.BatteryAtStart"))
-		return add_string(eon, "Battery at start", data);
+		return add_string(eon, "Battery at start", EON_STRING_UTF8, data, len);
 	if (!strcmp(name, "Info.BatteryAtEnd"))
-		return add_string(eon, "Battery at end", data);
+		return add_string(eon, "Battery at end", EON_STRING_UTF8, data, len);
 	return 0;
 }
 
@@ -1273,7 +1683,7 @@ static int traverse_gas_fields(suunto_eonsteel_parser_t *eon, const struct type_
 		return add_gas_he(eon, data[0]);
 
 	if (!strcmp(name, ".Gas.TransmitterID"))
-		return add_string(eon, "Transmitter ID", data);
+		return add_string(eon, "Transmitter ID", EON_STRING_UTF8, data, len);
 
 	if (!strcmp(name, ".Gas.TankSize"))
 		return add_gas_size(eon, get_le32_float(data));
@@ -1291,10 +1701,10 @@ static int traverse_gas_fields(suunto_eonsteel_parser_t *eon, const struct type_
 		return 0;
 
 	if (!strcmp(name, ".Gas.TransmitterStartBatteryCharge"))
-		return add_string_fmt(eon, "Transmitter Battery at start", "%d %%", data[0]);
+		return add_string(eon, "Transmitter Battery at start", EON_STRING_PERCENT, data, len);
 
 	if (!strcmp(name, ".Gas.TransmitterEndBatteryCharge"))
-		return add_string_fmt(eon, "Transmitter Battery at end", "%d %%", data[0]);
+		return add_string(eon, "Transmitter Battery at end", EON_STRING_PERCENT, data, len);
 
 	return 0;
 }
@@ -1353,22 +1763,19 @@ static int traverse_diving_fields(suunto_eonsteel_parser_t *eon, const struct ty
 	}
 
 	if (!strcmp(name, "Algorithm"))
-		return add_string(eon, "Deco algorithm", data);
+		return add_string(eon, "Deco algorithm", EON_STRING_UTF8, data, len);
 
 	if (!strcmp(name, "DiveMode")) {
 		if (!strncmp((const char *)data, "CCR", 3)) {
 			eon->cache.divemode = DC_DIVEMODE_CC;
 			eon->cache.initialized |= 1 << DC_FIELD_DIVEMODE;
 		}
-		return add_string(eon, "Dive Mode", data);
+		return add_string(eon, "Dive Mode", EON_STRING_UTF8, data, len);
 	}
 
 	/* Signed byte of conservatism (-2 .. +2) */
-	if (!strcmp(name, "Conservatism")) {
-		int val = *(signed char *)data;
-
-		return add_string_fmt(eon, "Personal Adjustment", "P%d", val);
-	}
+	if (!strcmp(name, "Conservatism"))
+		return add_string(eon, "Personal Adjustment", EON_STRING_ADJUSTMENT, data, len);
 
 	if (!strcmp(name, "LowSetPoint")) {
 		unsigned int pressure = array_uint32_le(data); // in SI units - Pascal
@@ -1384,15 +1791,11 @@ static int traverse_diving_fields(suunto_eonsteel_parser_t *eon, const struct ty
 
 	// Time recoded in seconds.
 	// Let's just agree to ignore seconds
-	if (!strcmp(name, "DesaturationTime")) {
-		unsigned int time = array_uint32_le(data) / 60;
-		return add_string_fmt(eon, "Desaturation Time", "%d:%02d", time / 60, time % 60);
-	}
+	if (!strcmp(name, "DesaturationTime"))
+		return add_string(eon, "Desaturation Time", EON_STRING_TIME, data, len);
 
-	if (!strcmp(name, "SurfaceTime")) {
-		unsigned int time = array_uint32_le(data) / 60;
-		return add_string_fmt(eon, "Surface Time", "%d:%02d", time / 60, time % 60);
-	}
+	if (!strcmp(name, "SurfaceTime"))
+		return add_string(eon, "Surface Time", EON_STRING_TIME, data, len);
 
 	return 0;
 }
@@ -1421,7 +1824,7 @@ static int traverse_header_fields(suunto_eonsteel_parser_t *eon, const struct ty
 		return 0;
 	}
 	if (!strcmp(name, "DateTime"))
-		return add_string(eon, "Dive ID", data);
+		return add_string(eon, "Dive ID", EON_STRING_UTF8, data, len);
 
 	return 0;
 }
@@ -1471,16 +1874,42 @@ static int traverse_sample_fields(suunto_eonsteel_parser_t *eon, const struct ty
 	return 0;
 }
 
+static int index_sample_record(suunto_eonsteel_parser_t *eon, unsigned short type, const struct type_desc *desc, const unsigned char *data, int len)
+{
+	eon_record_t *record;
+
+	if (eon->nrecords == eon->maxrecords) {
+		unsigned int maxrecords = eon->maxrecords ? eon->maxrecords * 2 : 1024;
+		eon_record_t *records = (eon_record_t *) realloc(eon->records, maxrecords * sizeof(eon_record_t));
+		if (!records) {
+			ERROR(eon->base.context, "out of memory");
+			eon->status = DC_STATUS_NOMEMORY;
+			return -1;
+		}
+		eon->records = records;
+		eon->maxrecords = maxrecords;
+	}
+
+	record = eon->records + eon->nrecords++;
+	record->offset = data - eon->base.data;
+	record->size = len;
+	record->type = type;
+	record->entry = desc->entry;
+	return 0;
+}
+
 static int traverse_fields(unsigned short type, const struct type_desc *desc, const unsigned char *data, int len, void *user)
 {
 	suunto_eonsteel_parser_t *eon = (suunto_eonsteel_parser_t *) user;
 
-	// Sample type? Do basic maxdepth and time parsing
-	if (desc->type[0])
+	// Sample type? Do basic maxdepth and time parsing, and add it
+	// to the index for the sample iteration.
+	if (desc->type[0]) {
 		traverse_sample_fields(eon, desc, data, len);
-	else
-		traverse_dynamic_fields(eon, desc, data, len);
+		return index_sample_record(eon, type, desc, data, len);
+	}
 
+	traverse_dynamic_fields(eon, desc, data, len);
 	return 0;
 }
 
@@ -1497,40 +1926,27 @@ static void initialize_field_caches(suunto_eonsteel_parser_t *eon)
 	eon->cache.divetime /= 1000;
 }
 
-static void show_descriptor(suunto_eonsteel_parser_t *eon, int nr, struct type_desc *desc)
-{
-	int i;
-
-	if (!desc->desc)
-		return;
-	DEBUG(eon->base.context, "Descriptor %d: '%s', size %d bytes", nr, desc->desc, desc->size);
-	if (desc->format)
-		DEBUG(eon->base.context, "    format '%s'", desc->format);
-	if (desc->mod)
-		DEBUG(eon->base.context, "    mod '%s'", desc->mod);
-	for (i = 0; i < EON_MAX_GROUP; i++) {
-		enum eon_sample type = desc->type[i];
-		if (!type)
-			continue;
-		DEBUG(eon->base.context, "    %d: %d (%s)", i, type, desc_type_name(type));
-	}
-}
-
-static void show_all_descriptors(suunto_eonsteel_parser_t *eon)
-{
-	for (unsigned int i = 0; i < MAXTYPE; ++i)
-		show_descriptor(eon, i, eon->type_desc+i);
-}
-
 static dc_status_t
 suunto_eonsteel_parser_set_data(dc_parser_t *parser, const unsigned char *data, unsigned int size)
 {
 	suunto_eonsteel_parser_t *eon = (suunto_eonsteel_parser_t *) parser;
 
-	desc_free(eon->type_desc, MAXTYPE);
-	memset(eon->type_desc, 0, sizeof(eon->type_desc));
+	dc_buffer_clear(eon->block);
+	eon->building = 0;
+	eon->status = DC_STATUS_SUCCESS;
+	eon->nrecords = 0;
+
 	initialize_field_caches(eon);
-	show_all_descriptors(eon);
+	if (finish_descriptors(eon) < 0) {
+		dc_context_lock(parser->context);
+		descriptors_release(eon->descriptors);
+		dc_context_unlock(parser->context);
+		eon->descriptors = NULL;
+		eon->nrecords = 0;
+		memset(&eon->cache, 0, sizeof(eon->cache));
+		return DC_STATUS_NOMEMORY;
+	}
+
 	return DC_STATUS_SUCCESS;
 }
 
@@ -1539,7 +1955,11 @@ suunto_eonsteel_parser_destroy(dc_parser_t *parser)
 {
 	suunto_eonsteel_parser_t *eon = (suunto_eonsteel_parser_t *) parser;
 
-	desc_free(eon->type_desc, MAXTYPE);
+	dc_context_lock(parser->context);
+	descriptors_release(eon->descriptors);
+	dc_context_unlock(parser->context);
+	dc_buffer_free(eon->block);
+	free(eon->records);
 
 	return DC_STATUS_SUCCESS;
 }
@@ -1551,6 +1971,7 @@ static const dc_parser_vtable_t suunto_eonsteel_parser_vtable = {
 	suunto_eonsteel_parser_get_datetime, /* datetime */
 	suunto_eonsteel_parser_get_field, /* fields */
 	suunto_eonsteel_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_range */
 	suunto_eonsteel_parser_destroy /* destroy */
 };
 
@@ -1568,7 +1989,18 @@ suunto_eonsteel_parser_create(dc_parser_t **out, dc_context_t *context, unsigned
 		return DC_STATUS_NOMEMORY;
 	}
 
-	memset(&parser->type_desc, 0, sizeof(parser->type_desc));
+	parser->descriptors = NULL;
+	parser->building = 0;
+	parser->status = DC_STATUS_SUCCESS;
+	parser->records = NULL;
+	parser->nrecords = parser->maxrecords = 0;
+	parser->block = dc_buffer_new(0);
+	if (parser->block == NULL) {
+		ERROR (context, "Failed to allocate memory.");
+		dc_parser_deallocate ((dc_parser_t *) parser);
+		return DC_STATUS_NOMEMORY;
+	}
+
 	memset(&parser->cache, 0, sizeof(parser->cache));
 
 	*out = (dc_parser_t *) parser;
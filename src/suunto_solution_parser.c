@@ -50,6 +50,7 @@ static const dc_parser_vtable_t suunto_solution_parser_vtable = {
 	NULL, /* datetime */
 	suunto_solution_parser_get_field, /* fields */
 	suunto_solution_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_range */
 	NULL /* destroy */
 };
 
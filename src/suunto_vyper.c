@@ -33,6 +33,8 @@
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &suunto_vyper_device_vtable)
 
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
 #define MIN(a,b)	(((a) < (b)) ? (a) : (b))
 #define MAX(a,b)	(((a) > (b)) ? (a) : (b))
 
@@ -44,6 +46,10 @@
 #define HDR_DEVINFO_BEGIN   (HDR_DEVINFO_SPYDER)
 #define HDR_DEVINFO_END     (HDR_DEVINFO_VYPER + 6)
 
+#define T_SETTLE  0
+#define T_COMMAND 1
+#define T_ECHO    2
+
 typedef struct suunto_vyper_device_t {
 	suunto_common_device_t base;
 	dc_serial_t *port;
@@ -82,6 +88,14 @@ static const suunto_common_layout_t suunto_spyder_layout = {
 	3 /* peek */
 };
 
+// The echo delay must stay between the arrival of the echo (40 ms)
+// and the disappearance of the reply (500 ms), see suunto_vyper_send.
+static const dc_timing_t suunto_vyper_timing[] = {
+	{"vyper.settle",  100, 20, 1000, 0, 0}, // Time for the interface to settle and draw power up.
+	{"vyper.command", 500, 50, 2000, 0, 0}, // Delay before sending a command.
+	{"vyper.echo",    200, 40,  450, 0, 0}, // Delay before discarding the echo.
+};
+
 
 dc_status_t
 suunto_vyper_device_open (dc_device_t **out, dc_context_t *context, const char *name)
@@ -104,6 +118,7 @@ suunto_vyper_device_open (dc_device_t **out, dc_context_t *context, const char *
 
 	// Set the default values.
 	device->port = NULL;
+	device_timing_init ((dc_device_t *) device, suunto_vyper_timing, C_ARRAY_SIZE (suunto_vyper_timing));
 
 	// Open the device.
 	status = dc_serial_open (&device->port, context, name);
@@ -112,6 +127,8 @@ suunto_vyper_device_open (dc_device_t **out, dc_context_t *context, const char *
 		goto error_free;
 	}
 
+	dc_serial_set_stats (device->port, &device->base.base.stats);
+
 	// Set the serial communication protocol (2400 8O1).
 	status = dc_serial_configure (device->port, 2400, 8, DC_PARITY_ODD, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -133,8 +150,8 @@ suunto_vyper_device_open (dc_device_t **out, dc_context_t *context, const char *
 		goto error_close;
 	}
 
-	// Give the interface 100 ms to settle and draw power up.
-	dc_serial_sleep (device->port, 100);
+	// Give the interface some time to settle and draw power up.
+	dc_serial_sleep (device->port, device_timing ((dc_device_t *) device, T_SETTLE));
 
 	// Make sure everything is in a sane state.
 	dc_serial_purge (device->port, DC_DIRECTION_ALL);
@@ -174,7 +191,7 @@ suunto_vyper_send (suunto_vyper_device_t *device, const unsigned char command[],
 	dc_status_t status = DC_STATUS_SUCCESS;
 	dc_device_t *abstract = (dc_device_t *) device;
 
-	dc_serial_sleep (device->port, 500);
+	dc_serial_sleep (device->port, device_timing (abstract, T_COMMAND));
 
 	// Set RTS to send the command.
 	dc_serial_set_rts (device->port, 1);
@@ -197,7 +214,7 @@ suunto_vyper_send (suunto_vyper_device_t *device, const unsigned char command[],
 	// receive the reply before RTS is cleared. We have to wait some time
 	// before clearing RTS (around 30ms). But if we wait too long (> 500ms),
 	// the reply disappears again.
-	dc_serial_sleep (device->port, 200);
+	dc_serial_sleep (device->port, device_timing (abstract, T_ECHO));
 	dc_serial_purge (device->port, DC_DIRECTION_INPUT);
 
 	// Clear RTS to receive the reply.
@@ -43,6 +43,8 @@
 struct dc_usbhid_t {
 	/* Library context. */
 	dc_context_t *context;
+	/* Transfer statistics of the device. */
+	dc_stats_t *stats;
 	/* Internal state. */
 #if defined(HAVE_LIBUSB) && !defined(__APPLE__)
 	libusb_context *ctx;
@@ -163,6 +165,7 @@ dc_usbhid_open (dc_usbhid_t **out, dc_context_t *context, unsigned int vid, unsi
 
 	// Library context.
 	usbhid->context = context;
+	usbhid->stats = NULL;
 
 #if defined(HAVE_LIBUSB) && !defined(__APPLE__)
 	struct libusb_device **devices = NULL;
@@ -398,6 +401,21 @@ dc_usbhid_set_timeout (dc_usbhid_t *usbhid, int timeout)
 #endif
 }
 
+dc_status_t
+dc_usbhid_set_stats (dc_usbhid_t *usbhid, dc_stats_t *stats)
+{
+#ifdef USBHID
+	if (usbhid == NULL)
+		return DC_STATUS_INVALIDARGS;
+
+	usbhid->stats = stats;
+
+	return DC_STATUS_SUCCESS;
+#else
+	return DC_STATUS_UNSUPPORTED;
+#endif
+}
+
 dc_status_t
 dc_usbhid_read (dc_usbhid_t *usbhid, void *data, size_t size, size_t *actual)
 {
@@ -410,6 +428,8 @@ dc_usbhid_read (dc_usbhid_t *usbhid, void *data, size_t size, size_t *actual)
 		goto out_invalidargs;
 	}
 
+	unsigned long long start = dc_stats_clock (usbhid->stats);
+
 #if defined(HAVE_LIBUSB) && !defined(__APPLE__)
 	int rc = libusb_interrupt_transfer (usbhid->handle, usbhid->endpoint_in, data, size, &nbytes, usbhid->timeout);
 	if (rc != LIBUSB_SUCCESS) {
@@ -428,7 +448,8 @@ dc_usbhid_read (dc_usbhid_t *usbhid, void *data, size_t size, size_t *actual)
 #endif
 
 out:
-	HEXDUMP (usbhid->context, DC_LOGLEVEL_INFO, "Read", (unsigned char *) data, nbytes);
+	dc_stats_transfer (usbhid->stats, DC_STATS_READ, start, nbytes, status);
+	TRACE (usbhid->context, DC_TRACE_READ, "Read", (unsigned char *) data, nbytes);
 
 out_invalidargs:
 	if (actual)
@@ -452,6 +473,8 @@ dc_usbhid_write (dc_usbhid_t *usbhid, const void *data, size_t size, size_t *act
 		goto out_invalidargs;
 	}
 
+	unsigned long long start = dc_stats_clock (usbhid->stats);
+
 #if defined(HAVE_LIBUSB) && !defined(__APPLE__)
 	int rc = libusb_interrupt_transfer (usbhid->handle, usbhid->endpoint_out, (void *) data, size, &nbytes, 0);
 	if (rc != LIBUSB_SUCCESS) {
@@ -470,7 +493,8 @@ dc_usbhid_write (dc_usbhid_t *usbhid, const void *data, size_t size, size_t *act
 #endif
 
 out:
-	HEXDUMP (usbhid->context, DC_LOGLEVEL_INFO, "Write", (unsigned char *) data, nbytes);
+	dc_stats_transfer (usbhid->stats, DC_STATS_WRITE, start, nbytes, status);
+	TRACE (usbhid->context, DC_TRACE_WRITE, "Write", (unsigned char *) data, nbytes);
 
 out_invalidargs:
 	if (actual)
@@ -24,6 +24,7 @@
 
 #include <libdivecomputer/common.h>
 #include <libdivecomputer/context.h>
+#include <libdivecomputer/device.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -88,6 +89,17 @@ dc_usbhid_close (dc_usbhid_t *usbhid);
 dc_status_t
 dc_usbhid_set_timeout (dc_usbhid_t *usbhid, int timeout);
 
+/**
+ * Set the statistics buffer for the transfers of the connection.
+ *
+ * @param[in]  usbhid  A valid USB HID connection.
+ * @param[in]  stats   The statistics buffer, or NULL to disable them.
+ * @returns #DC_STATUS_SUCCESS on success, or another #dc_status_t code
+ * on failure.
+ */
+dc_status_t
+dc_usbhid_set_stats (dc_usbhid_t *usbhid, dc_stats_t *stats);
+
 /**
  * Read data from the USB HID connection.
  *
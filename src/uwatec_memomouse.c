@@ -32,11 +32,18 @@
 
 #define ISINSTANCE(device) dc_device_isinstance((device), &uwatec_memomouse_device_vtable)
 
+#define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
+
 #define PACKETSIZE 126
 
 #define ACK 0x60
 #define NAK 0xA8
 
+#define T_GREETING 0
+#define T_COMMAND  1
+#define T_WAITING  2
+#define T_DTR      3
+
 typedef struct uwatec_memomouse_device_t {
 	dc_device_t base;
 	dc_serial_t *port;
@@ -61,6 +68,13 @@ static const dc_device_vtable_t uwatec_memomouse_device_vtable = {
 	uwatec_memomouse_device_close /* close */
 };
 
+static const dc_timing_t uwatec_memomouse_timing[] = {
+	{"memomouse.greeting", 300, 50, 1000, 0, 0}, // Interval between the rejected greeting packets.
+	{"memomouse.command",   50, 10,  500, 0, 0}, // Delay before sending the command.
+	{"memomouse.waiting",  100, 10, 1000, 0, 0}, // Polling interval while waiting for the data.
+	{"memomouse.dtr",      500, 50, 2000, 0, 0}, // Time for the interface to notice the DTR line.
+};
+
 static dc_status_t
 uwatec_memomouse_extract_dives (dc_device_t *device, const unsigned char data[], unsigned int size, dc_dive_callback_t callback, void *userdata);
 
@@ -85,6 +99,7 @@ uwatec_memomouse_device_open (dc_device_t **out, dc_context_t *context, const ch
 	device->timestamp = 0;
 	device->systime = (dc_ticks_t) -1;
 	device->devtime = 0;
+	device_timing_init ((dc_device_t *) device, uwatec_memomouse_timing, C_ARRAY_SIZE (uwatec_memomouse_timing));
 
 	// Open the device.
 	status = dc_serial_open (&device->port, context, name);
@@ -93,6 +108,8 @@ uwatec_memomouse_device_open (dc_device_t **out, dc_context_t *context, const ch
 		goto error_free;
 	}
 
+	dc_serial_set_stats (device->port, &device->base.stats);
+
 	// Set the serial communication protocol (9600 8N1).
 	status = dc_serial_configure (device->port, 9600, 8, DC_PARITY_NONE, DC_STOPBITS_ONE, DC_FLOWCONTROL_NONE);
 	if (status != DC_STATUS_SUCCESS) {
@@ -358,7 +375,7 @@ uwatec_memomouse_dump_internal (uwatec_memomouse_device_t *device, dc_buffer_t *
 			return status;
 		}
 
-		dc_serial_sleep (device->port, 300);
+		dc_serial_sleep (device->port, device_timing (abstract, T_GREETING));
 	}
 
 	// Read the ID string.
@@ -381,7 +398,7 @@ uwatec_memomouse_dump_internal (uwatec_memomouse_device_t *device, dc_buffer_t *
 
 	// Wait a small amount of time before sending the command.
 	// Without this delay, the transfer will fail most of the time.
-	dc_serial_sleep (device->port, 50);
+	dc_serial_sleep (device->port, device_timing (abstract, T_COMMAND));
 
 	// Keep send the command to the device,
 	// until the ACK answer is received.
@@ -417,7 +434,7 @@ uwatec_memomouse_dump_internal (uwatec_memomouse_device_t *device, dc_buffer_t *
 			return DC_STATUS_CANCELLED;
 
 		device_event_emit (&device->base, DC_EVENT_WAITING, NULL);
-		dc_serial_sleep (device->port, 100);
+		dc_serial_sleep (device->port, device_timing (abstract, T_WAITING));
 	}
 
 	// Fetch the current system time.
@@ -457,7 +474,7 @@ uwatec_memomouse_device_dump (dc_device_t *abstract, dc_buffer_t *buffer)
 
 	// Give the interface some time to notice the DTR
 	// line change from a previous transfer (if any).
-	dc_serial_sleep (device->port, 500);
+	dc_serial_sleep (device->port, device_timing (abstract, T_DTR));
 
 	// Set the DTR line.
 	rc = dc_serial_set_dtr (device->port, 1);
@@ -25,6 +25,7 @@
 
 #include "uwatec_memomouse.h"
 #include "context-private.h"
+#include "datetime-private.h"
 #include "parser-private.h"
 #include "array.h"
 
@@ -50,6 +51,7 @@ static const dc_parser_vtable_t uwatec_memomouse_parser_vtable = {
 	uwatec_memomouse_parser_get_datetime, /* datetime */
 	uwatec_memomouse_parser_get_field, /* fields */
 	uwatec_memomouse_parser_samples_foreach, /* samples_foreach */
+	NULL, /* samples_range */
 	NULL /* destroy */
 };
 
@@ -98,7 +100,7 @@ uwatec_memomouse_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *date
 
 	dc_ticks_t ticks = parser->systime - (parser->devtime - timestamp) / 2;
 
-	if (!dc_datetime_localtime (datetime, ticks))
+	if (!dc_datetime_localtime_cached (abstract->context, datetime, ticks))
 		return DC_STATUS_DATAFORMAT;
 
 	return DC_STATUS_SUCCESS;
@@ -170,6 +170,8 @@ uwatec_smart_device_open (dc_device_t **out, dc_context_t *context)
 		goto error_free;
 	}
 
+	dc_irda_set_stats (device->socket, &device->base.stats);
+
 	// Discover the device.
 	status = dc_irda_discover (device->socket, uwatec_smart_discovery, device);
 	if (status != DC_STATUS_SUCCESS) {
@@ -416,26 +418,28 @@ uwatec_smart_extract_dives (dc_device_t *abstract, const unsigned char data[], u
 
 	const unsigned char header[4] = {0xa5, 0xa5, 0x5a, 0x5a};
 
-	// Search the data stream for start markers.
+	// Search the data stream for start markers. A marker must end before
+	// the last byte of the data, or before the last byte preceding the
+	// previous marker.
 	unsigned int previous = size;
-	unsigned int current = (size >= 4 ? size - 4 : 0);
-	while (current > 0) {
-		current--;
-		if (memcmp (data + current, header, sizeof (header)) == 0) {
-			// Get the length of the profile data.
-			unsigned int len = array_uint32_le (data + current + 4);
-
-			// Check for a buffer overflow.
-			if (current + len > previous)
-				return DC_STATUS_DATAFORMAT;
-
-			if (callback && !callback (data + current, len, data + current + 8, 4, userdata))
-				return DC_STATUS_SUCCESS;
-
-			// Prepare for the next dive.
-			previous = current;
-			current = (current >= 4 ? current - 4 : 0);
-		}
+	unsigned int limit = (size >= 1 ? size - 1 : 0);
+	const unsigned char *marker = NULL;
+	while ((marker = array_search_backward (data, limit, header, sizeof (header))) != NULL) {
+		unsigned int current = marker - data - sizeof (header);
+
+		// Get the length of the profile data.
+		unsigned int len = array_uint32_le (data + current + 4);
+
+		// Check for a buffer overflow.
+		if (current + len > previous)
+			return DC_STATUS_DATAFORMAT;
+
+		if (callback && !callback (data + current, len, data + current + 8, 4, userdata))
+			return DC_STATUS_SUCCESS;
+
+		// Prepare for the next dive.
+		previous = current;
+		limit = (current >= 1 ? current - 1 : 0);
 	}
 
 	return DC_STATUS_SUCCESS;
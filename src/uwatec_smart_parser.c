@@ -21,11 +21,13 @@
 
 #include <stdlib.h>
 #include <string.h>	// memcmp
+#include <limits.h>
 
 #include <libdivecomputer/units.h>
 
 #include "uwatec_smart.h"
 #include "context-private.h"
+#include "datetime-private.h"
 #include "parser-private.h"
 #include "array.h"
 
@@ -34,6 +36,9 @@
 #define C_ARRAY_SIZE(array) (sizeof (array) / sizeof *(array))
 
 #define NBITS 8
+#define NTYPES 32
+
+#define MULTIBYTE 0xFF
 
 #define SMARTPRO      0x10
 #define GALILEO       0x11
@@ -110,6 +115,14 @@ typedef struct uwatec_smart_sample_info_t {
 	unsigned int extrabytes;
 } uwatec_smart_sample_info_t;
 
+typedef struct uwatec_smart_decoder_t {
+	unsigned int offset;  /* Offset of the first data byte */
+	unsigned int mask;    /* Data bits in the first data byte */
+	unsigned int ndata;   /* Number of data bytes */
+	unsigned int length;  /* Total length (type and data bytes) */
+	unsigned int signbit; /* Sign bit of the data value */
+} uwatec_smart_decoder_t;
+
 typedef struct uwatec_smart_event_info_t {
 	uwatec_smart_event_t type;
 	unsigned int mask;
@@ -140,6 +153,8 @@ struct uwatec_smart_parser_t {
 	const uwatec_smart_header_info_t *header;
 	unsigned int headersize;
 	unsigned int nsamples;
+	unsigned char identify[256];
+	uwatec_smart_decoder_t decoder[NTYPES];
 	const uwatec_smart_event_info_t *events[NEVENTS];
 	unsigned int nevents[NEVENTS];
 	// Cached fields.
@@ -153,10 +168,31 @@ struct uwatec_smart_parser_t {
 	dc_divemode_t divemode;
 };
 
+typedef struct uwatec_smart_state_t {
+	unsigned int offset;
+	unsigned int nsamples;
+	unsigned int time;
+	unsigned int calibrated;
+	unsigned int rbt;
+	unsigned int tank;
+	unsigned int gasmix;
+	double depth, depth_calibration;
+	double temperature;
+	double pressure;
+	unsigned int heartrate;
+	unsigned int bearing;
+	unsigned int bookmark;
+	// Previous gas mix.
+	unsigned int gasmix_previous;
+	unsigned int have_depth, have_temperature, have_pressure, have_rbt,
+		have_heartrate, have_bearing;
+} uwatec_smart_state_t;
+
 static dc_status_t uwatec_smart_parser_set_data (dc_parser_t *abstract, const unsigned char *data, unsigned int size);
 static dc_status_t uwatec_smart_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime);
 static dc_status_t uwatec_smart_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsigned int flags, void *value);
 static dc_status_t uwatec_smart_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata);
+static dc_status_t uwatec_smart_parser_samples_range (dc_parser_t *abstract, unsigned int begin, unsigned int end, dc_sample_callback_t callback, void *userdata);
 
 static const dc_parser_vtable_t uwatec_smart_parser_vtable = {
 	sizeof(uwatec_smart_parser_t),
@@ -165,6 +201,7 @@ static const dc_parser_vtable_t uwatec_smart_parser_vtable = {
 	uwatec_smart_parser_get_datetime, /* datetime */
 	uwatec_smart_parser_get_field, /* fields */
 	uwatec_smart_parser_samples_foreach, /* samples_foreach */
+	uwatec_smart_parser_samples_range, /* samples_range */
 	NULL /* destroy */
 };
 
@@ -413,6 +450,95 @@ uwatec_smart_find_tank (uwatec_smart_parser_t *parser, unsigned int id)
        return i;
 }
 
+static unsigned int
+uwatec_smart_identify (const unsigned char data[], unsigned int size)
+{
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < size; ++i) {
+		unsigned char value = data[i];
+		for (unsigned int j = 0; j < NBITS; ++j) {
+			unsigned char mask = 1 << (NBITS - 1 - j);
+			if ((value & mask) == 0)
+				return count;
+			count++;
+		}
+	}
+
+	return (unsigned int) -1;
+}
+
+
+static unsigned int
+uwatec_galileo_identify (unsigned char value)
+{
+	// Bits: 0ddd dddd
+	if ((value & 0x80) == 0)
+		return 0;
+
+	// Bits: 100d dddd
+	if ((value & 0xE0) == 0x80)
+		return 1;
+
+	// Bits: 1XXX dddd
+	if ((value & 0xF0) != 0xF0)
+		return (value & 0x70) >> 4;
+
+	// Bits: 1111 XXXX
+	return (value & 0x0F) + 7;
+}
+
+/*
+ * Build the lookup tables for decoding the bitstream. The type of a
+ * sample can almost always be identified from its first byte, except
+ * for the Smart type bits which continue past a leading 0xFF byte. The
+ * position and size of the data bits only depend on the sample type,
+ * so they are also calculated only once.
+ */
+static void
+uwatec_smart_parser_init_decoder (uwatec_smart_parser_t *parser, int galileo)
+{
+	for (unsigned int i = 0; i < 256; ++i) {
+		unsigned char value = i;
+		if (galileo) {
+			parser->identify[i] = uwatec_galileo_identify (value);
+		} else if (value == 0xFF) {
+			parser->identify[i] = MULTIBYTE;
+		} else {
+			parser->identify[i] = uwatec_smart_identify (&value, 1);
+		}
+	}
+
+	for (unsigned int i = 0; i < parser->nsamples; ++i) {
+		const uwatec_smart_sample_info_t *info = parser->samples + i;
+		uwatec_smart_decoder_t *decoder = parser->decoder + i;
+
+		// Data bits stored in the last type byte.
+		unsigned int nbits = 0;
+		unsigned int mask = 0xFF;
+		unsigned int ndata = 0;
+		unsigned int n = info->ntypebits % NBITS;
+		if (n > 0) {
+			if (info->ignoretype) {
+				mask = 0;
+			} else {
+				nbits = NBITS - n;
+				mask = 0xFF >> n;
+			}
+			ndata++;
+		}
+
+		// Extra data bytes.
+		nbits += info->extrabytes * NBITS;
+		ndata += info->extrabytes;
+
+		decoder->offset = info->ntypebits / NBITS;
+		decoder->mask = mask;
+		decoder->ndata = ndata;
+		decoder->length = decoder->offset + ndata;
+		decoder->signbit = nbits ? 1U << (nbits - 1) : 0;
+	}
+}
+
 static dc_status_t
 uwatec_smart_parser_cache (uwatec_smart_parser_t *parser)
 {
@@ -548,6 +674,7 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, unsigned i
 {
 	dc_status_t status = DC_STATUS_SUCCESS;
 	uwatec_smart_parser_t *parser = NULL;
+	int galileo = 0;
 
 	if (out == NULL)
 		return DC_STATUS_INVALIDARGS;
@@ -593,6 +720,7 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, unsigned i
 		parser->nevents[0] = C_ARRAY_SIZE (uwatec_smart_galileo_events_0);
 		parser->nevents[1] = C_ARRAY_SIZE (uwatec_smart_galileo_events_1);
 		parser->nevents[2] = C_ARRAY_SIZE (uwatec_smart_galileo_events_2);
+		galileo = 1;
 		break;
 	case ALADINTEC:
 		parser->headersize = 108;
@@ -634,6 +762,8 @@ uwatec_smart_parser_create (dc_parser_t **out, dc_context_t *context, unsigned i
 		goto error_free;
 	}
 
+	uwatec_smart_parser_init_decoder (parser, galileo);
+
 	parser->cached = 0;
 	parser->trimix = 0;
 	parser->ngasmixes = 0;
@@ -713,7 +843,7 @@ uwatec_smart_parser_get_datetime (dc_parser_t *abstract, dc_datetime_t *datetime
 	} else {
 		// For devices without timezone support, the current timezone of
 		// the host system is used.
-		if (!dc_datetime_localtime (datetime, ticks))
+		if (!dc_datetime_localtime_cached (abstract->context, datetime, ticks))
 			return DC_STATUS_DATAFORMAT;
 	}
 
@@ -811,109 +941,19 @@ uwatec_smart_parser_get_field (dc_parser_t *abstract, dc_field_type_t type, unsi
 }
 
 
-static unsigned int
-uwatec_smart_identify (const unsigned char data[], unsigned int size)
-{
-	unsigned int count = 0;
-	for (unsigned int i = 0; i < size; ++i) {
-		unsigned char value = data[i];
-		for (unsigned int j = 0; j < NBITS; ++j) {
-			unsigned char mask = 1 << (NBITS - 1 - j);
-			if ((value & mask) == 0)
-				return count;
-			count++;
-		}
-	}
-
-	return (unsigned int) -1;
-}
-
-
-static unsigned int
-uwatec_galileo_identify (unsigned char value)
-{
-	// Bits: 0ddd dddd
-	if ((value & 0x80) == 0)
-		return 0;
-
-	// Bits: 100d dddd
-	if ((value & 0xE0) == 0x80)
-		return 1;
-
-	// Bits: 1XXX dddd
-	if ((value & 0xF0) != 0xF0)
-		return (value & 0x70) >> 4;
-
-	// Bits: 1111 XXXX
-	return (value & 0x0F) + 7;
-}
-
-
-static unsigned int
-uwatec_smart_fixsignbit (unsigned int x, unsigned int n)
-{
-	if (n <= 0 || n > 32)
-		return 0;
-
-	unsigned int signbit = (1 << (n - 1));
-	unsigned int mask = (0xFFFFFFFF << n);
-
-	// When turning a two's-complement number with a certain number
-	// of bits into one with more bits, the sign bit must be repeated
-	// in all the extra bits.
-	if ((x & signbit) == signbit)
-		return x | mask;
-	else
-		return x & ~mask;
-}
-
-
 static dc_status_t
-uwatec_smart_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+uwatec_smart_parser_walk (dc_parser_t *abstract, void *userstate, unsigned int end, sample_index_t *index, dc_sample_callback_t callback, void *userdata)
 {
 	uwatec_smart_parser_t *parser = (uwatec_smart_parser_t*) abstract;
+	uwatec_smart_state_t *state = (uwatec_smart_state_t *) userstate;
 
 	const unsigned char *data = abstract->data;
 	unsigned int size = abstract->size;
 
-	// Cache the parser data.
-	dc_status_t rc = uwatec_smart_parser_cache (parser);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
-
 	const uwatec_smart_sample_info_t *table = parser->samples;
 	unsigned int entries = parser->nsamples;
-	unsigned int header = parser->headersize;
-	if (parser->trimix) {
-		header = 0xB1;
-	}
-
-	// Get the maximum number of alarm bytes.
-	unsigned int nalarms = 0;
-	for (unsigned int i = 0; i < entries; ++i) {
-		if (table[i].type == ALARMS &&
-			table[i].index >= nalarms)
-		{
-			nalarms = table[i].index + 1;
-		}
-	}
 
 	int complete = 0;
-	int calibrated = 0;
-
-	unsigned int time = 0;
-	unsigned int rbt = 99;
-	unsigned int tank = 0;
-	unsigned int gasmix = 0;
-	double depth = 0, depth_calibration = 0;
-	double temperature = 0;
-	double pressure = 0;
-	unsigned int heartrate = 0;
-	unsigned int bearing = 0;
-	unsigned int bookmark = 0;
-
-	// Previous gas mix - initialize with impossible value
-	unsigned int gasmix_previous = 0xFFFFFFFF;
 
 	double salinity = (parser->watertype == DC_WATER_SALT ? SALT : FRESH);
 
@@ -922,23 +962,63 @@ uwatec_smart_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 		interval = 1;
 	}
 
-	int have_depth = 0, have_temperature = 0, have_pressure = 0, have_rbt = 0,
-		have_heartrate = 0, have_bearing = 0;
+	unsigned int offset = state->offset;
+	unsigned int nsamples = state->nsamples;
+	unsigned int time = state->time;
+	unsigned int calibrated = state->calibrated;
+	unsigned int rbt = state->rbt;
+	unsigned int tank = state->tank;
+	unsigned int gasmix = state->gasmix;
+	double depth = state->depth, depth_calibration = state->depth_calibration;
+	double temperature = state->temperature;
+	double pressure = state->pressure;
+	unsigned int heartrate = state->heartrate;
+	unsigned int bearing = state->bearing;
+	unsigned int bookmark = state->bookmark;
+	unsigned int gasmix_previous = state->gasmix_previous;
+	unsigned int have_depth = state->have_depth, have_temperature = state->have_temperature,
+		have_pressure = state->have_pressure, have_rbt = state->have_rbt,
+		have_heartrate = state->have_heartrate, have_bearing = state->have_bearing;
+
+	unsigned int checkpoint = SAMPLE_INDEX_INTERVAL;
 
-	unsigned int offset = header;
 	while (offset < size) {
 		dc_sample_value_t sample = {0};
 
+		// Stop after the last sample in the requested range.
+		if (time > end)
+			return DC_STATUS_SUCCESS;
+
+		// The checkpoint is keyed on the last sample before it.
+		if (index && nsamples >= checkpoint) {
+			state->offset = offset;
+			state->nsamples = nsamples;
+			state->time = time;
+			state->calibrated = calibrated;
+			state->rbt = rbt;
+			state->tank = tank;
+			state->gasmix = gasmix;
+			state->depth = depth;
+			state->depth_calibration = depth_calibration;
+			state->temperature = temperature;
+			state->pressure = pressure;
+			state->heartrate = heartrate;
+			state->bearing = bearing;
+			state->bookmark = bookmark;
+			state->gasmix_previous = gasmix_previous;
+			state->have_depth = have_depth;
+			state->have_temperature = have_temperature;
+			state->have_pressure = have_pressure;
+			state->have_rbt = have_rbt;
+			state->have_heartrate = have_heartrate;
+			state->have_bearing = have_bearing;
+			sample_index_append (index, time - interval, state);
+			checkpoint += SAMPLE_INDEX_INTERVAL;
+		}
+
 		// Process the type bits in the bitstream.
-		unsigned int id = 0;
-		if (parser->model == GALILEO || parser->model == GALILEOTRIMIX ||
-			parser->model == ALADIN2G || parser->model == MERIDIAN ||
-			parser->model == CHROMIS || parser->model == MANTIS2 ||
-			parser->model == G2) {
-			// Uwatec Galileo
-			id = uwatec_galileo_identify (data[offset]);
-		} else {
-			// Uwatec Smart
+		unsigned int id = parser->identify[data[offset]];
+		if (id == MULTIBYTE) {
 			id = uwatec_smart_identify (data + offset, size - offset);
 		}
 		if (id >= entries) {
@@ -946,41 +1026,35 @@ uwatec_smart_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 			return DC_STATUS_DATAFORMAT;
 		}
 
-		// Skip the processed type bytes.
-		offset += table[id].ntypebits / NBITS;
-
-		// Process the remaining data bits.
-		unsigned int nbits = 0;
-		unsigned int value = 0;
-		unsigned int n = table[id].ntypebits % NBITS;
-		if (n > 0) {
-			nbits = NBITS - n;
-			value = data[offset] & (0xFF >> n);
-			if (table[id].ignoretype) {
-				// Ignore any data bits that are stored in
-				// the last type byte for certain samples.
-				nbits = 0;
-				value = 0;
-			}
-			offset++;
-		}
-
 		// Check for buffer overflows.
-		if (offset + table[id].extrabytes > size) {
+		const uwatec_smart_decoder_t *decoder = parser->decoder + id;
+		if (offset + decoder->length > size) {
 			ERROR (abstract->context, "Incomplete sample data.");
 			return DC_STATUS_DATAFORMAT;
 		}
 
-		// Process the extra data bytes.
-		for (unsigned int i = 0; i < table[id].extrabytes; ++i) {
-			nbits += NBITS;
-			value <<= NBITS;
-			value += data[offset];
-			offset++;
+		// Process the data bits. The data bits in the last type byte
+		// (if any) are already masked out for the samples where they
+		// need to be ignored.
+		const unsigned char *p = data + offset + decoder->offset;
+		unsigned int value = 0;
+		switch (decoder->ndata) {
+		case 1:
+			value = p[0] & decoder->mask;
+			break;
+		case 2:
+			value = ((p[0] & decoder->mask) << 8) | p[1];
+			break;
+		case 3:
+			value = ((p[0] & decoder->mask) << 16) | (p[1] << 8) | p[2];
+			break;
+		default:
+			break;
 		}
+		offset += decoder->length;
 
 		// Fix the sign bit.
-		signed int svalue = uwatec_smart_fixsignbit (value, nbits);
+		signed int svalue = (signed int) ((value ^ decoder->signbit) - decoder->signbit);
 
 		// Parse the value.
 		unsigned int idx = 0;
@@ -1201,6 +1275,7 @@ uwatec_smart_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 			}
 
 			time += interval;
+			nsamples++;
 			complete--;
 		}
 	}
@@ -1209,3 +1284,51 @@ uwatec_smart_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t
 
 	return DC_STATUS_SUCCESS;
 }
+
+static void
+uwatec_smart_parser_init (uwatec_smart_parser_t *parser, uwatec_smart_state_t *state)
+{
+	memset (state, 0, sizeof (*state));
+
+	state->offset = parser->headersize;
+	if (parser->trimix) {
+		state->offset = 0xB1;
+	}
+
+	state->rbt = 99;
+
+	// Previous gas mix - initialize with impossible value
+	state->gasmix_previous = 0xFFFFFFFF;
+}
+
+static dc_status_t
+uwatec_smart_parser_samples_foreach (dc_parser_t *abstract, dc_sample_callback_t callback, void *userdata)
+{
+	uwatec_smart_parser_t *parser = (uwatec_smart_parser_t*) abstract;
+	uwatec_smart_state_t state;
+
+	// Cache the parser data.
+	dc_status_t rc = uwatec_smart_parser_cache (parser);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	uwatec_smart_parser_init (parser, &state);
+
+	return uwatec_smart_parser_walk (abstract, &state, UINT_MAX, NULL, callback, userdata);
+}
+
+static dc_status_t
+uwatec_smart_parser_samples_range (dc_parser_t *abstract, unsigned int begin, unsigned int end, dc_sample_callback_t callback, void *userdata)
+{
+	uwatec_smart_parser_t *parser = (uwatec_smart_parser_t*) abstract;
+	uwatec_smart_state_t state;
+
+	// Cache the parser data.
+	dc_status_t rc = uwatec_smart_parser_cache (parser);
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+
+	uwatec_smart_parser_init (parser, &state);
+
+	return sample_index_walk (abstract, begin, end, &state, sizeof (state), uwatec_smart_parser_walk, callback, userdata);
+}
@@ -0,0 +1,196 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+/*
+ * Compare the table based hex conversion and the word based
+ * array_isequal with a plain byte loop, for random lengths and
+ * alignments. The hex input has mixed case digits, and sometimes an
+ * invalid character, which has to stop the conversion at the same byte.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+
+#define MAXSIZE 512
+#define MAXALIGN 16
+#define NRANDOM 100000
+
+static unsigned int g_seed = 1;
+
+static unsigned int
+random_next (void)
+{
+	// Xorshift generator, to get the same sequence on every platform.
+	g_seed ^= g_seed << 13;
+	g_seed ^= g_seed >> 17;
+	g_seed ^= g_seed << 5;
+	return g_seed;
+}
+
+static int
+reference_isequal (const unsigned char data[], unsigned int size, unsigned char value)
+{
+	for (unsigned int i = 0; i < size; ++i) {
+		if (data[i] != value)
+			return 0;
+	}
+
+	return 1;
+}
+
+static int
+reference_bin2hex (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize)
+{
+	if (osize != 2 * isize)
+		return -1;
+
+	const unsigned char ascii[] = {
+		'0', '1', '2', '3', '4', '5', '6', '7',
+		'8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
+
+	for (unsigned int i = 0; i < isize; ++i) {
+		output[i * 2 + 0] = ascii[(input[i] >> 4) & 0x0F];
+		output[i * 2 + 1] = ascii[input[i] & 0x0F];
+	}
+
+	return 0;
+}
+
+static int
+reference_hex2bin (const unsigned char input[], unsigned int isize, unsigned char output[], unsigned int osize)
+{
+	if (isize != 2 * osize)
+		return -1;
+
+	for (unsigned int i = 0; i < osize; ++i) {
+		unsigned char value = 0;
+		for (unsigned int j = 0; j < 2; ++j) {
+			unsigned char number = 0;
+			unsigned char ascii = input[i * 2 + j];
+			if (ascii >= '0' && ascii <= '9')
+				number = ascii - '0';
+			else if (ascii >= 'A' && ascii <= 'F')
+				number = 10 + ascii - 'A';
+			else if (ascii >= 'a' && ascii <= 'f')
+				number = 10 + ascii - 'a';
+			else
+				return -1; /* Invalid character */
+
+			value <<= 4;
+			value += number;
+		}
+		output[i] = value;
+	}
+
+	return 0;
+}
+
+static int
+check_isequal (const unsigned char data[], unsigned int size, unsigned int offset, unsigned char value)
+{
+	if (array_isequal (data, size, value) != reference_isequal (data, size, value)) {
+		fprintf (stderr, "FAIL: array_isequal (size=%u, offset=%u)\n", size, offset);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int
+check_bin2hex (const unsigned char input[], unsigned int isize, unsigned int osize, unsigned int offset)
+{
+	unsigned char output[2 * MAXSIZE + 2], expected[2 * MAXSIZE + 2];
+	memset (output, 0xEE, sizeof (output));
+	memset (expected, 0xEE, sizeof (expected));
+
+	int rc = array_convert_bin2hex (input, isize, output, osize);
+	if (rc != reference_bin2hex (input, isize, expected, osize) ||
+		memcmp (output, expected, sizeof (output)) != 0) {
+		fprintf (stderr, "FAIL: array_convert_bin2hex (size=%u, offset=%u)\n", isize, offset);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int
+check_hex2bin (const unsigned char input[], unsigned int isize, unsigned int osize, unsigned int offset)
+{
+	unsigned char output[MAXSIZE + 1], expected[MAXSIZE + 1];
+	memset (output, 0xEE, sizeof (output));
+	memset (expected, 0xEE, sizeof (expected));
+
+	int rc = array_convert_hex2bin (input, isize, output, osize);
+	if (rc != reference_hex2bin (input, isize, expected, osize) ||
+		memcmp (output, expected, sizeof (output)) != 0) {
+		fprintf (stderr, "FAIL: array_convert_hex2bin (size=%u, offset=%u)\n", isize, offset);
+		return 1;
+	}
+
+	return 0;
+}
+
+int
+main (void)
+{
+	int failed = 0;
+	unsigned char buffer[2 * MAXSIZE + MAXALIGN];
+
+	static const char digits[] = "0123456789ABCDEFabcdef";
+
+	for (unsigned int i = 0; i < NRANDOM; ++i) {
+		unsigned int size = random_next () % (i % 8 ? 64 : MAXSIZE + 1);
+		unsigned int offset = random_next () % MAXALIGN;
+
+		// A run of equal bytes, with a single different byte half of
+		// the time.
+		unsigned char value = random_next () & 0xFF;
+		memset (buffer, value, sizeof (buffer));
+		if (size && (random_next () & 1))
+			buffer[offset + random_next () % size] ^= 1 << (random_next () % 8);
+		failed |= check_isequal (buffer + offset, size, offset, value);
+
+		// Random binary data, with a wrong output size now and then.
+		for (unsigned int j = 0; j < sizeof (buffer); ++j)
+			buffer[j] = random_next () & 0xFF;
+		unsigned int osize = 2 * size + (i % 64 == 0);
+		failed |= check_bin2hex (buffer + offset, size, osize, offset);
+
+		// Hex digits in mixed case, with an invalid character (any
+		// byte which is not a digit) once in a while.
+		for (unsigned int j = 0; j < sizeof (buffer); ++j)
+			buffer[j] = digits[random_next () % (sizeof (digits) - 1)];
+		if (size && i % 4 == 0) {
+			unsigned char c = 0;
+			do {
+				c = random_next () & 0xFF;
+			} while (c != 0 && strchr (digits, c) != NULL);
+			buffer[offset + random_next () % (2 * size)] = c;
+		}
+		unsigned int isize = 2 * size + (i % 64 == 1);
+		failed |= check_hex2bin (buffer + offset, isize, size, offset);
+	}
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+/*
+ * Compare the marker search functions with a plain memcmp at every
+ * position, for random lengths, alignments and markers. The data uses
+ * only a few distinct byte values, so the markers are found often, and
+ * there are many partial matches.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+
+#define MAXSIZE 1024
+#define MAXALIGN 16
+#define MAXMARKER 10
+#define NRANDOM 200000
+
+static unsigned int g_seed = 1;
+
+static unsigned int
+random_next (void)
+{
+	// Xorshift generator, to get the same sequence on every platform.
+	g_seed ^= g_seed << 13;
+	g_seed ^= g_seed >> 17;
+	g_seed ^= g_seed << 5;
+	return g_seed;
+}
+
+static const unsigned char *
+reference_search_forward (const unsigned char *data, unsigned int size,
+                          const unsigned char *marker, unsigned int msize)
+{
+	while (size >= msize) {
+		if (memcmp (data, marker, msize) == 0)
+			return data;
+		size--;
+		data++;
+	}
+	return NULL;
+}
+
+static const unsigned char *
+reference_search_backward (const unsigned char *data, unsigned int size,
+                           const unsigned char *marker, unsigned int msize)
+{
+	data += size;
+	while (size >= msize) {
+		if (memcmp (data - msize, marker, msize) == 0)
+			return data;
+		size--;
+		data--;
+	}
+	return NULL;
+}
+
+static int
+check (const unsigned char data[], unsigned int size, unsigned int offset, const unsigned char marker[], unsigned int msize)
+{
+	int failed = 0;
+
+	if (array_search_forward (data, size, marker, msize) !=
+		reference_search_forward (data, size, marker, msize)) {
+		fprintf (stderr, "FAIL: array_search_forward (size=%u, offset=%u, msize=%u)\n", size, offset, msize);
+		failed = 1;
+	}
+	if (array_search_backward (data, size, marker, msize) !=
+		reference_search_backward (data, size, marker, msize)) {
+		fprintf (stderr, "FAIL: array_search_backward (size=%u, offset=%u, msize=%u)\n", size, offset, msize);
+		failed = 1;
+	}
+
+	return failed;
+}
+
+int
+main (void)
+{
+	int failed = 0;
+	unsigned char buffer[MAXSIZE + MAXALIGN];
+	unsigned char marker[MAXMARKER];
+
+	for (unsigned int i = 0; i < NRANDOM; ++i) {
+		// Alternate between data with two, four and all byte values.
+		unsigned int nvalues = (i % 3 == 0) ? 2 : (i % 3 == 1) ? 4 : 256;
+		for (unsigned int j = 0; j < sizeof (buffer); ++j)
+			buffer[j] = random_next () % nvalues;
+
+		// Keep most buffers small, where the tail handling matters.
+		unsigned int size = random_next () % (i % 8 ? 64 : MAXSIZE + 1);
+		unsigned int offset = random_next () % MAXALIGN;
+		unsigned int msize = random_next () % (MAXMARKER + 1);
+
+		// Take the marker from the data (to get a match) half of the
+		// time, and make a random one the other half.
+		if (size >= msize && (random_next () & 1)) {
+			memcpy (marker, buffer + offset + random_next () % (size - msize + 1), msize);
+		} else {
+			for (unsigned int j = 0; j < msize; ++j)
+				marker[j] = random_next () % nvalues;
+		}
+
+		failed |= check (buffer + offset, size, offset, marker, msize);
+	}
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
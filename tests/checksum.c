@@ -0,0 +1,175 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+/*
+ * Compare the word based checksum routines with a plain byte loop, for
+ * random lengths and alignments. Besides random data, the buffers are
+ * also filled with all 0xFF bytes, which is the worst case for the
+ * overflow of the lanes in the additive checksums.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "checksum.h"
+
+#define MAXSIZE 0x10000
+#define MAXALIGN 16
+#define NRANDOM 2000
+
+static unsigned int g_seed = 1;
+
+static unsigned int
+random_next (void)
+{
+	// Xorshift generator, to get the same sequence on every platform.
+	g_seed ^= g_seed << 13;
+	g_seed ^= g_seed >> 17;
+	g_seed ^= g_seed << 5;
+	return g_seed;
+}
+
+static unsigned char
+reference_add_uint4 (const unsigned char data[], unsigned int size, unsigned char init)
+{
+	unsigned char crc = init;
+	for (unsigned int i = 0; i < size; ++i) {
+		crc += (data[i] & 0xF0) >> 4;
+		crc += (data[i] & 0x0F);
+	}
+
+	return crc;
+}
+
+static unsigned char
+reference_add_uint8 (const unsigned char data[], unsigned int size, unsigned char init)
+{
+	unsigned char crc = init;
+	for (unsigned int i = 0; i < size; ++i)
+		crc += data[i];
+
+	return crc;
+}
+
+static unsigned short
+reference_add_uint16 (const unsigned char data[], unsigned int size, unsigned short init)
+{
+	unsigned short crc = init;
+	for (unsigned int i = 0; i < size; ++i)
+		crc += data[i];
+
+	return crc;
+}
+
+static unsigned char
+reference_xor_uint8 (const unsigned char data[], unsigned int size, unsigned char init)
+{
+	unsigned char crc = init;
+	for (unsigned int i = 0; i < size; ++i)
+		crc ^= data[i];
+
+	return crc;
+}
+
+static unsigned short
+reference_crc_ccitt_uint16 (const unsigned char data[], unsigned int size)
+{
+	unsigned short crc = 0xffff;
+	for (unsigned int i = 0; i < size; ++i) {
+		crc ^= data[i] << 8;
+		for (unsigned int j = 0; j < 8; ++j) {
+			if (crc & 0x8000)
+				crc = (crc << 1) ^ 0x1021;
+			else
+				crc = crc << 1;
+		}
+	}
+
+	return crc;
+}
+
+static int
+check (const unsigned char data[], unsigned int size, unsigned int offset)
+{
+	int failed = 0;
+	unsigned char init8 = random_next () & 0xFF;
+	unsigned short init16 = random_next () & 0xFFFF;
+
+	if (checksum_add_uint4 (data, size, init8) != reference_add_uint4 (data, size, init8)) {
+		fprintf (stderr, "FAIL: checksum_add_uint4 (size=%u, offset=%u)\n", size, offset);
+		failed = 1;
+	}
+	if (checksum_add_uint8 (data, size, init8) != reference_add_uint8 (data, size, init8)) {
+		fprintf (stderr, "FAIL: checksum_add_uint8 (size=%u, offset=%u)\n", size, offset);
+		failed = 1;
+	}
+	if (checksum_add_uint16 (data, size, init16) != reference_add_uint16 (data, size, init16)) {
+		fprintf (stderr, "FAIL: checksum_add_uint16 (size=%u, offset=%u)\n", size, offset);
+		failed = 1;
+	}
+	if (checksum_xor_uint8 (data, size, init8) != reference_xor_uint8 (data, size, init8)) {
+		fprintf (stderr, "FAIL: checksum_xor_uint8 (size=%u, offset=%u)\n", size, offset);
+		failed = 1;
+	}
+	if (checksum_crc_ccitt_uint16 (data, size) != reference_crc_ccitt_uint16 (data, size)) {
+		fprintf (stderr, "FAIL: checksum_crc_ccitt_uint16 (size=%u, offset=%u)\n", size, offset);
+		failed = 1;
+	}
+
+	return failed;
+}
+
+int
+main (void)
+{
+	int failed = 0;
+
+	unsigned char *buffer = (unsigned char *) malloc (MAXSIZE + MAXALIGN);
+	if (buffer == NULL) {
+		fprintf (stderr, "Failed to allocate memory.\n");
+		return EXIT_FAILURE;
+	}
+
+	for (unsigned int fill = 0; fill < 2; ++fill) {
+		for (unsigned int i = 0; i < MAXSIZE + MAXALIGN; ++i)
+			buffer[i] = fill ? 0xFF : random_next () & 0xFF;
+
+		// All the small sizes, at every alignment.
+		for (unsigned int size = 0; size <= 256; ++size) {
+			for (unsigned int offset = 0; offset < MAXALIGN; ++offset) {
+				failed |= check (buffer + offset, size, offset);
+			}
+		}
+
+		// Random sizes, up to several times the number of words
+		// summed before the lanes are folded.
+		for (unsigned int i = 0; i < NRANDOM; ++i) {
+			unsigned int size = random_next () % (MAXSIZE + 1);
+			unsigned int offset = random_next () % MAXALIGN;
+			failed |= check (buffer + offset, size, offset);
+		}
+	}
+
+	free (buffer);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
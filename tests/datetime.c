@@ -0,0 +1,101 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+/*
+ * Compare the cached local time conversion with the C library, in time
+ * zones with two transitions within a few days, and after changing the
+ * time zone of the process. Without the tz database, all zones are UTC,
+ * and the test passes without testing much.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/datetime.h>
+
+#include "datetime-private.h"
+
+#define HOUR 3600
+#define DAY (24 * HOUR)
+
+static int
+check_zone (dc_context_t *context, const char *zone, dc_ticks_t begin, dc_ticks_t end, dc_ticks_t step)
+{
+	int failed = 0;
+
+	setenv ("TZ", zone, 1);
+	tzset ();
+
+	for (dc_ticks_t ticks = begin; ticks <= end; ticks += step) {
+		dc_datetime_t expected = {0}, cached = {0};
+		if (dc_datetime_localtime (&expected, ticks) == NULL ||
+			dc_datetime_localtime_cached (context, &cached, ticks) == NULL ||
+			memcmp (&expected, &cached, sizeof (expected)) != 0) {
+			fprintf (stderr, "FAIL: %s at %lld (%04d-%02d-%02d %02d:%02d:%02d instead of %04d-%02d-%02d %02d:%02d:%02d)\n",
+				zone, (long long) ticks,
+				cached.year, cached.month, cached.day, cached.hour, cached.minute, cached.second,
+				expected.year, expected.month, expected.day, expected.hour, expected.minute, expected.second);
+			failed = 1;
+			break;
+		}
+	}
+
+	return failed;
+}
+
+int
+main (void)
+{
+#ifdef _WIN32
+	// No setenv and no tz database.
+	return 77;
+#else
+	int failed = 0;
+	dc_context_t *context = NULL;
+
+	if (dc_context_new (&context) != DC_STATUS_SUCCESS) {
+		fprintf (stderr, "Failed to create the context.\n");
+		return EXIT_FAILURE;
+	}
+
+	// Daylight saving time for a single week, in October 2000.
+	failed |= check_zone (context, "America/Recife", 970000000 - 30 * DAY, 970000000 + 60 * DAY, HOUR);
+
+	// The same timestamps, after switching to other zones. The table of
+	// the previous zone must not be used anymore.
+	failed |= check_zone (context, "Europe/Brussels", 970000000 - 30 * DAY, 970000000 + 60 * DAY, HOUR);
+	failed |= check_zone (context, "UTC", 970000000 - 30 * DAY, 970000000 + 60 * DAY, HOUR);
+	failed |= check_zone (context, "America/Recife", 970000000 - 30 * DAY, 970000000 + 60 * DAY, HOUR);
+
+	// Two transitions four days apart, in September 1939.
+	failed |= check_zone (context, "Africa/Freetown", -957000000 - 30 * DAY, -957000000 + 30 * DAY, HOUR);
+
+	// A few decades of a regular zone.
+	failed |= check_zone (context, "Europe/Brussels", 0, 1500000000, 7 * HOUR + 13);
+
+	dc_context_free (context);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+#endif
+}
@@ -0,0 +1,174 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+/*
+ * Load firmware images with data beyond the end of the OSTC firmware,
+ * and check that the data in front of the end is kept.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libdivecomputer/context.h>
+
+#include "hw_ostc.h"
+
+#define FILENAME "hw_ostc_firmware.hex"
+
+#define SZ_FIRMWARE HW_OSTC_FIRMWARE_SIZE
+#define SZ_BLOCK    HW_OSTC_FIRMWARE_BLOCK
+
+static int failed = 0;
+
+#define CHECK(expr) \
+	do { \
+		if (!(expr)) { \
+			fprintf (stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); \
+			failed = 1; \
+		} \
+	} while (0)
+
+static unsigned char
+pattern (unsigned int address)
+{
+	return (address * 7 + (address >> 8)) & 0xFF;
+}
+
+static void
+write_record (FILE *fp, unsigned int type, unsigned int address, const unsigned char data[], unsigned int size)
+{
+	unsigned char csum = size + (address >> 8) + address + type;
+
+	fprintf (fp, ":%02X%04X%02X", size, address & 0xFFFF, type);
+	for (unsigned int i = 0; i < size; ++i) {
+		fprintf (fp, "%02X", data[i]);
+		csum += data[i];
+	}
+	fprintf (fp, "%02X\n", (unsigned char) -csum);
+}
+
+/*
+ * Write the data ranges as one hex file, with 16 byte data records and
+ * an extended linear address record for every 64K segment.
+ */
+static void
+write_hexfile (const unsigned int ranges[][2], unsigned int count)
+{
+	FILE *fp = fopen (FILENAME, "w");
+	if (fp == NULL) {
+		perror (FILENAME);
+		exit (EXIT_FAILURE);
+	}
+
+	unsigned int segment = 0;
+	for (unsigned int i = 0; i < count; ++i) {
+		for (unsigned int address = ranges[i][0]; address < ranges[i][1]; address += 16) {
+			if ((address >> 16) != segment) {
+				segment = address >> 16;
+				unsigned char data[2] = {segment >> 8, segment & 0xFF};
+				write_record (fp, 4, 0, data, sizeof (data));
+			}
+
+			unsigned char data[16];
+			for (unsigned int j = 0; j < sizeof (data); ++j)
+				data[j] = pattern (address + j);
+			write_record (fp, 0, address, data, sizeof (data));
+		}
+	}
+
+	write_record (fp, 1, 0, NULL, 0);
+	fclose (fp);
+}
+
+/*
+ * Check the data of a range that is expected in the image. The first
+ * instruction and the last block are always replaced by the firmware
+ * loader.
+ */
+static int
+check_range (const hw_ostc_firmware_t *firmware, unsigned int begin, unsigned int end)
+{
+	if (begin < 4)
+		begin = 4;
+	if (end > SZ_FIRMWARE - SZ_BLOCK)
+		end = SZ_FIRMWARE - SZ_BLOCK;
+
+	for (unsigned int address = begin; address < end; ++address) {
+		if (firmware->data[address] != pattern (address))
+			return 0;
+		if (!firmware->bitmap[address / SZ_BLOCK])
+			return 0;
+	}
+
+	return 1;
+}
+
+int
+main (void)
+{
+	dc_context_t *context = NULL;
+	dc_status_t rc = DC_STATUS_SUCCESS;
+
+	hw_ostc_firmware_t *firmware = (hw_ostc_firmware_t *) malloc (sizeof (hw_ostc_firmware_t));
+	if (firmware == NULL || dc_context_new (&context) != DC_STATUS_SUCCESS) {
+		fprintf (stderr, "Failed to initialize the test.\n");
+		return EXIT_FAILURE;
+	}
+
+	dc_context_set_loglevel (context, DC_LOGLEVEL_ERROR);
+
+	// A complete image, without any data beyond the end.
+	const unsigned int inside[][2] = {{0, SZ_FIRMWARE - SZ_BLOCK}};
+	write_hexfile (inside, 1);
+	rc = hw_ostc_firmware_readfile (firmware, context, FILENAME);
+	CHECK (rc == DC_STATUS_SUCCESS);
+	CHECK (check_range (firmware, 0, SZ_FIRMWARE));
+
+	// A single contiguous range that runs past the end of the firmware.
+	const unsigned int across[][2] = {{0, SZ_FIRMWARE + 0xC0}};
+	write_hexfile (across, 1);
+	rc = hw_ostc_firmware_readfile (firmware, context, FILENAME);
+	CHECK (rc == DC_STATUS_SUCCESS);
+	CHECK (check_range (firmware, 0, SZ_FIRMWARE));
+
+	// A range crossing the end, with a record straddling the end, and
+	// another range completely beyond the end.
+	const unsigned int partial[][2] = {{0, 0x100}, {0x17E00, SZ_FIRMWARE + 8}, {0x18000, 0x18100}};
+	write_hexfile (partial, 3);
+	rc = hw_ostc_firmware_readfile (firmware, context, FILENAME);
+	CHECK (rc == DC_STATUS_SUCCESS);
+	CHECK (check_range (firmware, 0, 0x100));
+	CHECK (check_range (firmware, 0x17E00, SZ_FIRMWARE));
+	CHECK (!firmware->bitmap[0x100 / SZ_BLOCK]);
+
+	// The last block is always present, with the "goto main"
+	// instruction from the start of the firmware.
+	CHECK (firmware->bitmap[SZ_FIRMWARE / SZ_BLOCK - 1]);
+	for (unsigned int i = 0; i < 8; ++i)
+		CHECK (firmware->data[SZ_FIRMWARE - 8 + i] == pattern (i));
+
+	remove (FILENAME);
+	dc_context_free (context);
+	free (firmware);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+/*
+ * libdivecomputer
+ *
+ * Copyright (C) 2017 Jef Driesen
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301 USA
+ */
+
+/*
+ * Parse a dive that redefines a type halfway, from a depth into a
+ * temperature, and a second dive with only the first half of the
+ * descriptors. Every record has to be parsed with the definition that
+ * was valid at its own entry, also when the decoded descriptors of the
+ * first dive are still around in the cache of the context.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libdivecomputer/context.h>
+#include <libdivecomputer/parser.h>
+
+#include "suunto_eonsteel.h"
+
+#define T_TIME  1
+#define T_VALUE 2
+
+#define MAXSAMPLES 16
+
+typedef struct sample_t {
+	dc_sample_type_t type;
+	double value;
+} sample_t;
+
+typedef struct samples_t {
+	sample_t samples[MAXSAMPLES];
+	unsigned int count;
+} samples_t;
+
+static void
+append (unsigned char data[], unsigned int *size, const void *bytes, unsigned int n)
+{
+	memcpy (data + *size, bytes, n);
+	*size += n;
+}
+
+static void
+append_entry (unsigned char data[], unsigned int *size, unsigned int type, const char *text)
+{
+	unsigned int textlen = 2 + strlen (text) + 1;
+	unsigned char header[4] = {0, textlen, type & 0xFF, (type >> 8) & 0xFF};
+
+	append (data, size, header, sizeof (header));
+	append (data, size, text, textlen - 2);
+}
+
+static void
+append_record (unsigned char data[], unsigned int *size, unsigned int type, unsigned int value)
+{
+	unsigned char record[4] = {type, 2, value & 0xFF, (value >> 8) & 0xFF};
+
+	append (data, size, record, sizeof (record));
+}
+
+/*
+ * The depth records follow the depth definition of the value type.
+ * With the redefinition, the records after it are temperatures.
+ */
+static unsigned int
+build_dive (unsigned char data[], int redefine)
+{
+	unsigned int size = 0;
+
+	append (data, &size, "\x00\x00\x00\x00SBEM\x00\x00\x00\x00", 12);
+	append_entry (data, &size, T_TIME, "<PTH>sml.DeviceLog.Samples+Sample.Time\n<FRM>duint16,precision=3");
+	append_entry (data, &size, T_VALUE, "<PTH>sml.DeviceLog.Samples.Sample.Depth\n<FRM>uint16,precision=2,nillable=65535");
+	append_record (data, &size, T_TIME, 10000);
+	append_record (data, &size, T_VALUE, 1000);
+	append_record (data, &size, T_TIME, 10000);
+	append_record (data, &size, T_VALUE, 2000);
+
+	if (redefine) {
+		append_entry (data, &size, T_VALUE, "<PTH>sml.DeviceLog.Samples.Sample.Temperature\n<FRM>int16,precision=2,nillable=-3000");
+		append_record (data, &size, T_TIME, 10000);
+		append_record (data, &size, T_VALUE, 150);
+	}
+
+	return size;
+}
+
+static void
+sample_cb (dc_sample_type_t type, dc_sample_value_t value, void *userdata)
+{
+	samples_t *samples = (samples_t *) userdata;
+
+	if (samples->count == MAXSAMPLES)
+		return;
+
+	sample_t *sample = samples->samples + samples->count++;
+	sample->type = type;
+	switch (type) {
+	case DC_SAMPLE_TIME:
+		sample->value = value.time;
+		break;
+	case DC_SAMPLE_DEPTH:
+		sample->value = value.depth;
+		break;
+	case DC_SAMPLE_TEMPERATURE:
+		sample->value = value.temperature;
+		break;
+	default:
+		sample->value = 0.0;
+		break;
+	}
+}
+
+static int
+check (dc_parser_t *parser, const char *name, const unsigned char data[], unsigned int size, const sample_t expected[], unsigned int count)
+{
+	samples_t samples = {{{0}}, 0};
+
+	if (dc_parser_set_data (parser, data, size) != DC_STATUS_SUCCESS ||
+		dc_parser_samples_foreach (parser, sample_cb, &samples) != DC_STATUS_SUCCESS) {
+		fprintf (stderr, "FAIL: %s (parsing)\n", name);
+		return 1;
+	}
+
+	if (samples.count != count) {
+		fprintf (stderr, "FAIL: %s (%u samples instead of %u)\n", name, samples.count, count);
+		return 1;
+	}
+
+	for (unsigned int i = 0; i < count; ++i) {
+		if (samples.samples[i].type != expected[i].type ||
+			samples.samples[i].value != expected[i].value) {
+			fprintf (stderr, "FAIL: %s (sample %u is type %u, value %g instead of type %u, value %g)\n",
+				name, i, samples.samples[i].type, samples.samples[i].value, expected[i].type, expected[i].value);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int
+main (void)
+{
+	int failed = 0;
+	dc_context_t *context = NULL;
+	dc_parser_t *parser = NULL;
+	unsigned char redefined[512], prefix[512];
+
+	static const sample_t expected[] = {
+		{DC_SAMPLE_TIME, 10.0},
+		{DC_SAMPLE_DEPTH, 10.0},
+		{DC_SAMPLE_TIME, 20.0},
+		{DC_SAMPLE_DEPTH, 20.0},
+		{DC_SAMPLE_TIME, 30.0},
+		{DC_SAMPLE_TEMPERATURE, 15.0},
+	};
+
+	unsigned int rsize = build_dive (redefined, 1);
+	unsigned int psize = build_dive (prefix, 0);
+
+	if (dc_context_new (&context) != DC_STATUS_SUCCESS ||
+		suunto_eonsteel_parser_create (&parser, context, 0) != DC_STATUS_SUCCESS) {
+		fprintf (stderr, "Failed to create the parser.\n");
+		dc_context_free (context);
+		return EXIT_FAILURE;
+	}
+
+	failed |= check (parser, "redefined", redefined, rsize, expected, 6);
+	failed |= check (parser, "prefix", prefix, psize, expected, 4);
+	failed |= check (parser, "redefined again", redefined, rsize, expected, 6);
+
+	dc_parser_destroy (parser);
+	dc_context_free (context);
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}